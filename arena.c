@@ -0,0 +1,143 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "intern.h"
+
+#define INITIAL_CHUNK_SIZE 4096
+#define MAX_CHUNK_SIZE (1024 * 1024)
+
+union arena_align {
+	long l;
+	double d;
+	long double ld;
+	void *p;
+};
+
+#define ALIGNMENT sizeof(union arena_align)
+
+struct mrsh_arena_chunk {
+	struct mrsh_arena_chunk *prev;
+	size_t size, used;
+	union arena_align data[];
+};
+
+static char *chunk_data(struct mrsh_arena_chunk *chunk) {
+	return (char *)chunk->data;
+}
+
+static void keep_spare(struct mrsh_arena *arena,
+		struct mrsh_arena_chunk *chunk) {
+	if (arena->spare == NULL || arena->spare->size < chunk->size) {
+		free(arena->spare);
+		arena->spare = chunk;
+	} else {
+		free(chunk);
+	}
+}
+
+static struct mrsh_arena_chunk *arena_grow(struct mrsh_arena *arena,
+		size_t size) {
+	struct mrsh_arena_chunk *chunk;
+	if (arena->spare != NULL && arena->spare->size >= size) {
+		chunk = arena->spare;
+		arena->spare = NULL;
+	} else {
+		size_t chunk_size = INITIAL_CHUNK_SIZE;
+		if (arena->chunk != NULL) {
+			chunk_size = 2 * arena->chunk->size;
+			if (chunk_size > MAX_CHUNK_SIZE) {
+				chunk_size = MAX_CHUNK_SIZE;
+			}
+		}
+		if (chunk_size < size) {
+			chunk_size = size;
+		}
+
+		chunk = malloc(sizeof(struct mrsh_arena_chunk) + chunk_size);
+		if (chunk == NULL) {
+			return NULL;
+		}
+		chunk->size = chunk_size;
+	}
+
+	chunk->used = 0;
+	chunk->prev = arena->chunk;
+	arena->chunk = chunk;
+	return chunk;
+}
+
+void *arena_alloc(struct mrsh_arena *arena, size_t size) {
+	if (size > SIZE_MAX - ALIGNMENT) {
+		return NULL;
+	}
+	size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+	struct mrsh_arena_chunk *chunk = arena->chunk;
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		chunk = arena_grow(arena, size);
+		if (chunk == NULL) {
+			return NULL;
+		}
+	}
+
+	void *ptr = chunk_data(chunk) + chunk->used;
+	chunk->used += size;
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+char *arena_strndup(struct mrsh_arena *arena, const char *str, size_t len) {
+	char *dup = arena_alloc(arena, len + 1);
+	if (dup == NULL) {
+		return NULL;
+	}
+	if (len > 0) {
+		memcpy(dup, str, len);
+	}
+	dup[len] = '\0';
+	return dup;
+}
+
+char *arena_strdup(struct mrsh_arena *arena, const char *str) {
+	return arena_strndup(arena, str, strlen(str));
+}
+
+void arena_adopt_atom(struct mrsh_arena *arena, const char *atom) {
+	// On allocation failure, the atom is never released
+	mrsh_array_add(&arena->atoms, (void *)atom);
+}
+
+struct mrsh_arena_mark arena_mark(const struct mrsh_arena *arena) {
+	struct mrsh_arena_mark mark = {
+		.chunk = arena->chunk,
+		.atoms = arena->atoms.len,
+	};
+	if (arena->chunk != NULL) {
+		mark.used = arena->chunk->used;
+	}
+	return mark;
+}
+
+void arena_release(struct mrsh_arena *arena, struct mrsh_arena_mark mark) {
+	while (arena->chunk != mark.chunk) {
+		struct mrsh_arena_chunk *chunk = arena->chunk;
+		arena->chunk = chunk->prev;
+		keep_spare(arena, chunk);
+	}
+	if (arena->chunk != NULL) {
+		arena->chunk->used = mark.used;
+	}
+
+	for (size_t i = mark.atoms; i < arena->atoms.len; ++i) {
+		atom_unref(arena->atoms.data[i]);
+	}
+	arena->atoms.len = mark.atoms;
+}
+
+void arena_finish(struct mrsh_arena *arena) {
+	arena_release(arena, (struct mrsh_arena_mark){0});
+	free(arena->spare);
+	arena->spare = NULL;
+	mrsh_array_finish(&arena->atoms);
+}
@@ -1,14 +1,117 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <ctype.h>
+#include <limits.h>
 #include <mrsh/buffer.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "ast.h"
+#include "intern.h"
+#include "line_table.h"
+#include "stats.h"
+
+void *ast_alloc(struct mrsh_arena *arena, size_t size) {
+	++lib_stats.allocations;
+	if (arena != NULL) {
+		return arena_alloc(arena, size);
+	}
+	return calloc(1, size);
+}
+
+char *ast_strndup(struct mrsh_arena *arena, const char *str, size_t len) {
+	++lib_stats.allocations;
+	if (arena != NULL) {
+		return arena_strndup(arena, str, len);
+	}
+	// str may be NULL if len is zero, e.g. when taken from an empty buffer
+	char *dup = malloc(len + 1);
+	if (dup == NULL) {
+		return NULL;
+	}
+	if (len > 0) {
+		memcpy(dup, str, len);
+	}
+	dup[len] = '\0';
+	return dup;
+}
+
+char *ast_strdup(struct mrsh_arena *arena, const char *str) {
+	++lib_stats.allocations;
+	if (arena != NULL) {
+		return arena_strdup(arena, str);
+	}
+	return strdup(str);
+}
+
+char *ast_buffer_steal(struct mrsh_arena *arena, struct mrsh_buffer *buf) {
+	if (arena == NULL) {
+		return mrsh_buffer_steal(buf);
+	}
+	char *str = ast_strndup(arena, buf->data, buf->len);
+	mrsh_buffer_finish(buf);
+	return str;
+}
+
+void ast_free(struct mrsh_arena *arena, void *ptr) {
+	if (arena == NULL) {
+		free(ptr);
+	}
+}
+
+bool ast_array_reserve(struct mrsh_arena *arena, struct mrsh_array *array,
+		size_t cap) {
+	if (arena == NULL) {
+		return mrsh_array_reserve(array, cap);
+	}
+	if (array->cap >= cap) {
+		return true;
+	}
+
+	void **data = arena_alloc(arena, cap * sizeof(void *));
+	if (data == NULL) {
+		return false;
+	}
+	if (array->len > 0) {
+		memcpy(data, array->data, array->len * sizeof(void *));
+	}
+	array->data = data;
+	array->cap = cap;
+	return true;
+}
+
+ssize_t ast_array_add(struct mrsh_arena *arena, struct mrsh_array *array,
+		void *value) {
+	if (array->len == array->cap) {
+		size_t cap = 2 * array->cap;
+		if (cap < 4) {
+			cap = 4;
+		}
+		if (!ast_array_reserve(arena, array, cap)) {
+			return -1;
+		}
+	}
+	return mrsh_array_add(array, value);
+}
+
+void ast_array_finish(struct mrsh_arena *arena, struct mrsh_array *array) {
+	if (arena == NULL) {
+		mrsh_array_finish(array);
+	} else {
+		*array = (struct mrsh_array){0};
+	}
+}
+
+void ast_own_atom(struct mrsh_arena *arena, const char *atom) {
+	if (atom != NULL && arena != NULL) {
+		arena_adopt_atom(arena, atom);
+	}
+}
 
 bool mrsh_position_valid(const struct mrsh_position *pos) {
-	return pos->line > 0;
+	return pos->offset1 > 0;
 }
 
 bool mrsh_range_valid(const struct mrsh_range *range) {
@@ -55,7 +158,7 @@ void mrsh_word_destroy(struct mrsh_word *word) {
 		return;
 	case MRSH_WORD_PARAMETER:;
 		struct mrsh_word_parameter *wp = mrsh_word_get_parameter(word);
-		free(wp->name);
+		atom_unref(wp->name);
 		mrsh_word_destroy(wp->arg);
 		free(wp);
 		return;
@@ -99,26 +202,32 @@ void mrsh_assignment_destroy(struct mrsh_assignment *assign) {
 	if (assign == NULL) {
 		return;
 	}
-	free(assign->name);
+	atom_unref(assign->name);
 	mrsh_word_destroy(assign->value);
 	free(assign);
 }
 
-void command_list_array_finish(struct mrsh_array *cmds) {
-	for (size_t i = 0; i < cmds->len; ++i) {
-		struct mrsh_command_list *l = cmds->data[i];
-		mrsh_command_list_destroy(l);
+void command_list_array_finish(struct mrsh_arena *arena,
+		struct mrsh_array *cmds) {
+	if (arena == NULL) {
+		for (size_t i = 0; i < cmds->len; ++i) {
+			struct mrsh_command_list *l = cmds->data[i];
+			mrsh_command_list_destroy(l);
+		}
 	}
-	mrsh_array_finish(cmds);
+	ast_array_finish(arena, cmds);
 }
 
-void case_item_destroy(struct mrsh_case_item *item) {
+void case_item_destroy(struct mrsh_arena *arena, struct mrsh_case_item *item) {
+	if (arena != NULL) {
+		return;
+	}
 	for (size_t j = 0; j < item->patterns.len; ++j) {
 		struct mrsh_word *pattern = item->patterns.data[j];
 		mrsh_word_destroy(pattern);
 	}
 	mrsh_array_finish(&item->patterns);
-	command_list_array_finish(&item->body);
+	command_list_array_finish(NULL, &item->body);
 	free(item);
 }
 
@@ -150,18 +259,18 @@ void mrsh_command_destroy(struct mrsh_command *cmd) {
 		return;
 	case MRSH_BRACE_GROUP:;
 		struct mrsh_brace_group *bg = mrsh_command_get_brace_group(cmd);
-		command_list_array_finish(&bg->body);
+		command_list_array_finish(NULL, &bg->body);
 		free(bg);
 		return;
 	case MRSH_SUBSHELL:;
 		struct mrsh_subshell *s = mrsh_command_get_subshell(cmd);
-		command_list_array_finish(&s->body);
+		command_list_array_finish(NULL, &s->body);
 		free(s);
 		return;
 	case MRSH_IF_CLAUSE:;
 		struct mrsh_if_clause *ic = mrsh_command_get_if_clause(cmd);
-		command_list_array_finish(&ic->condition);
-		command_list_array_finish(&ic->body);
+		command_list_array_finish(NULL, &ic->condition);
+		command_list_array_finish(NULL, &ic->body);
 		mrsh_command_destroy(ic->else_part);
 		free(ic);
 		return;
@@ -173,13 +282,13 @@ void mrsh_command_destroy(struct mrsh_command *cmd) {
 			mrsh_word_destroy(word);
 		}
 		mrsh_array_finish(&fc->word_list);
-		command_list_array_finish(&fc->body);
+		command_list_array_finish(NULL, &fc->body);
 		free(fc);
 		return;
 	case MRSH_LOOP_CLAUSE:;
 		struct mrsh_loop_clause *lc = mrsh_command_get_loop_clause(cmd);
-		command_list_array_finish(&lc->condition);
-		command_list_array_finish(&lc->body);
+		command_list_array_finish(NULL, &lc->condition);
+		command_list_array_finish(NULL, &lc->body);
 		free(lc);
 		return;
 	case MRSH_CASE_CLAUSE:;
@@ -187,7 +296,7 @@ void mrsh_command_destroy(struct mrsh_command *cmd) {
 		mrsh_word_destroy(cc->word);
 		for (size_t i = 0; i < cc->items.len; ++i) {
 			struct mrsh_case_item *item = cc->items.data[i];
-			case_item_destroy(item);
+			case_item_destroy(NULL, item);
 		}
 		mrsh_array_finish(&cc->items);
 		free(cc);
@@ -197,6 +306,7 @@ void mrsh_command_destroy(struct mrsh_command *cmd) {
 			mrsh_command_get_function_definition(cmd);
 		free(fd->name);
 		mrsh_command_destroy(fd->body);
+		free(fd->body_source);
 		for (size_t i = 0; i < fd->io_redirects.len; ++i) {
 			struct mrsh_io_redirect *redir = fd->io_redirects.data[i];
 			mrsh_io_redirect_destroy(redir);
@@ -208,6 +318,25 @@ void mrsh_command_destroy(struct mrsh_command *cmd) {
 	abort();
 }
 
+void ast_word_destroy(struct mrsh_arena *arena, struct mrsh_word *word) {
+	if (arena == NULL) {
+		mrsh_word_destroy(word);
+	}
+}
+
+void ast_command_destroy(struct mrsh_arena *arena, struct mrsh_command *cmd) {
+	if (arena == NULL) {
+		mrsh_command_destroy(cmd);
+	}
+}
+
+void ast_and_or_list_destroy(struct mrsh_arena *arena,
+		struct mrsh_and_or_list *and_or_list) {
+	if (arena == NULL) {
+		mrsh_and_or_list_destroy(and_or_list);
+	}
+}
+
 void mrsh_and_or_list_destroy(struct mrsh_and_or_list *and_or_list) {
 	if (and_or_list == NULL) {
 		return;
@@ -233,12 +362,24 @@ void mrsh_and_or_list_destroy(struct mrsh_and_or_list *and_or_list) {
 	abort();
 }
 
-struct mrsh_command_list *mrsh_command_list_create(void) {
-	struct mrsh_command_list *list = calloc(1, sizeof(struct mrsh_command_list));
+struct mrsh_command_list *command_list_create(struct mrsh_arena *arena) {
+	struct mrsh_command_list *list =
+		ast_alloc(arena, sizeof(struct mrsh_command_list));
 	list->node.type = MRSH_NODE_COMMAND_LIST;
 	return list;
 }
 
+struct mrsh_command_list *mrsh_command_list_create(void) {
+	return command_list_create(NULL);
+}
+
+void ast_program_destroy(struct mrsh_arena *arena,
+		struct mrsh_program *prog) {
+	if (arena == NULL) {
+		mrsh_program_destroy(prog);
+	}
+}
+
 void mrsh_command_list_destroy(struct mrsh_command_list *l) {
 	if (l == NULL) {
 		return;
@@ -248,18 +389,75 @@ void mrsh_command_list_destroy(struct mrsh_command_list *l) {
 	free(l);
 }
 
-struct mrsh_program *mrsh_program_create(void) {
-	struct mrsh_program *prog = calloc(1, sizeof(struct mrsh_program));
+struct mrsh_program_priv {
+	struct mrsh_program pub;
+
+	// The arena all nodes of the program are allocated from, if the program
+	// owns it
+	struct mrsh_arena *arena;
+	// Newlines of the source, used to get line and column numbers
+	struct mrsh_line_table *lines;
+};
+
+static struct mrsh_program_priv *program_get_priv(
+		const struct mrsh_program *prog) {
+	return (struct mrsh_program_priv *)prog;
+}
+
+struct mrsh_program *program_create(struct mrsh_arena *arena) {
+	struct mrsh_program_priv *priv =
+		ast_alloc(arena, sizeof(struct mrsh_program_priv));
+	if (priv == NULL) {
+		return NULL;
+	}
+	struct mrsh_program *prog = &priv->pub;
 	prog->node.type = MRSH_NODE_PROGRAM;
 	return prog;
 }
 
+struct mrsh_program *mrsh_program_create(void) {
+	return program_create(NULL);
+}
+
+void program_set_arena(struct mrsh_program *prog, struct mrsh_arena *arena) {
+	struct mrsh_program_priv *priv = program_get_priv(prog);
+	assert(priv->arena == NULL);
+	priv->arena = arena;
+}
+
+void program_set_line_table(struct mrsh_program *prog,
+		struct mrsh_line_table *lines) {
+	struct mrsh_program_priv *priv = program_get_priv(prog);
+	line_table_unref(priv->lines);
+	priv->lines = line_table_ref(lines);
+}
+
+struct mrsh_line_table *program_get_line_table(
+		const struct mrsh_program *prog) {
+	return program_get_priv(prog)->lines;
+}
+
+void mrsh_program_location(const struct mrsh_program *prog,
+		const struct mrsh_position *pos, struct mrsh_location *loc) {
+	line_table_lookup(program_get_line_table(prog), pos, loc);
+}
+
 void mrsh_program_destroy(struct mrsh_program *prog) {
 	if (prog == NULL) {
 		return;
 	}
 
-	command_list_array_finish(&prog->body);
+	struct mrsh_program_priv *priv = program_get_priv(prog);
+	line_table_unref(priv->lines);
+	if (priv->arena != NULL) {
+		// The program itself lives in the arena, no need to walk the tree
+		struct mrsh_arena *arena = priv->arena;
+		arena_finish(arena);
+		free(arena);
+		return;
+	}
+
+	command_list_array_finish(NULL, &prog->body);
 	free(prog);
 }
 
@@ -290,9 +488,10 @@ struct mrsh_program *mrsh_node_get_program(const struct mrsh_node *node) {
 	return (struct mrsh_program *)node;
 }
 
-struct mrsh_word_string *mrsh_word_string_create(char *str,
-		bool single_quoted) {
-	struct mrsh_word_string *ws = calloc(1, sizeof(struct mrsh_word_string));
+struct mrsh_word_string *word_string_create(struct mrsh_arena *arena,
+		char *str, bool single_quoted) {
+	struct mrsh_word_string *ws =
+		ast_alloc(arena, sizeof(struct mrsh_word_string));
 	ws->word.node.type = MRSH_NODE_WORD;
 	ws->word.type = MRSH_WORD_STRING;
 	ws->str = str;
@@ -300,23 +499,86 @@ struct mrsh_word_string *mrsh_word_string_create(char *str,
 	return ws;
 }
 
-struct mrsh_word_parameter *mrsh_word_parameter_create(char *name,
-		enum mrsh_word_parameter_op op, bool colon, struct mrsh_word *arg) {
+struct mrsh_word_string *mrsh_word_string_create(char *str,
+		bool single_quoted) {
+	return word_string_create(NULL, str, single_quoted);
+}
+
+static void classify_parameter(struct mrsh_word_parameter *wp) {
+	const char *name = wp->name;
+	if (name[0] != '\0' && name[1] == '\0') {
+		switch (name[0]) {
+		case '@':
+			wp->kind = MRSH_PARAM_KIND_AT;
+			return;
+		case '*':
+			wp->kind = MRSH_PARAM_KIND_STAR;
+			return;
+		case '#':
+			wp->kind = MRSH_PARAM_KIND_HASH;
+			return;
+		case '?':
+			wp->kind = MRSH_PARAM_KIND_QMARK;
+			return;
+		case '-':
+			wp->kind = MRSH_PARAM_KIND_MINUS;
+			return;
+		case '$':
+			wp->kind = MRSH_PARAM_KIND_DOLLAR;
+			return;
+		case '!':
+			wp->kind = MRSH_PARAM_KIND_BANG;
+			return;
+		}
+	}
+
+	if (isdigit((unsigned char)name[0])) {
+		long position = 0;
+		const char *c = name;
+		while (isdigit((unsigned char)*c)) {
+			if (position <= INT_MAX) {
+				position = 10 * position + (*c - '0');
+			}
+			++c;
+		}
+		if (*c == '\0') {
+			wp->kind = MRSH_PARAM_KIND_POSITIONAL;
+			wp->position = position <= INT_MAX ? (int)position : -1;
+			return;
+		}
+	}
+
+	wp->kind = strcmp(name, "LINENO") == 0 ?
+		MRSH_PARAM_KIND_LINENO : MRSH_PARAM_KIND_NAME;
+}
+
+struct mrsh_word_parameter *word_parameter_create(struct mrsh_arena *arena,
+		const char *name, enum mrsh_word_parameter_op op, bool colon,
+		struct mrsh_word *arg) {
 	struct mrsh_word_parameter *wp =
-		calloc(1, sizeof(struct mrsh_word_parameter));
+		ast_alloc(arena, sizeof(struct mrsh_word_parameter));
 	wp->word.node.type = MRSH_NODE_WORD;
 	wp->word.type = MRSH_WORD_PARAMETER;
+	ast_own_atom(arena, name);
 	wp->name = name;
+	classify_parameter(wp);
 	wp->op = op;
 	wp->colon = colon;
 	wp->arg = arg;
 	return wp;
 }
 
-struct mrsh_word_command *mrsh_word_command_create(struct mrsh_program *prog,
-		bool back_quoted) {
+struct mrsh_word_parameter *mrsh_word_parameter_create(char *name,
+		enum mrsh_word_parameter_op op, bool colon, struct mrsh_word *arg) {
+	const char *atom = intern(name);
+	free(name);
+	return word_parameter_create(NULL, atom, op, colon, arg);
+}
+
+struct mrsh_word_command *word_command_create(struct mrsh_arena *arena,
+		struct mrsh_program *prog, bool back_quoted) {
 	struct mrsh_word_command *wc =
-		calloc(1, sizeof(struct mrsh_word_command));
+		ast_alloc(arena, sizeof(struct mrsh_word_command));
 	wc->word.node.type = MRSH_NODE_WORD;
 	wc->word.type = MRSH_WORD_COMMAND;
 	wc->program = prog;
@@ -324,19 +586,30 @@ struct mrsh_word_command *mrsh_word_command_create(struct mrsh_program *prog,
 	return wc;
 }
 
-struct mrsh_word_arithmetic *mrsh_word_arithmetic_create(
+struct mrsh_word_command *mrsh_word_command_create(struct mrsh_program *prog,
+		bool back_quoted) {
+	return word_command_create(NULL, prog, back_quoted);
+}
+
+struct mrsh_word_arithmetic *word_arithmetic_create(struct mrsh_arena *arena,
 		struct mrsh_word *body) {
 	struct mrsh_word_arithmetic *wa =
-		calloc(1, sizeof(struct mrsh_word_arithmetic));
+		ast_alloc(arena, sizeof(struct mrsh_word_arithmetic));
 	wa->word.node.type = MRSH_NODE_WORD;
 	wa->word.type = MRSH_WORD_ARITHMETIC;
 	wa->body = body;
 	return wa;
 }
 
-struct mrsh_word_list *mrsh_word_list_create(struct mrsh_array *children,
-		bool double_quoted) {
-	struct mrsh_word_list *wl = calloc(1, sizeof(struct mrsh_word_list));
+struct mrsh_word_arithmetic *mrsh_word_arithmetic_create(
+		struct mrsh_word *body) {
+	return word_arithmetic_create(NULL, body);
+}
+
+struct mrsh_word_list *word_list_create(struct mrsh_arena *arena,
+		struct mrsh_array *children, bool double_quoted) {
+	struct mrsh_word_list *wl =
+		ast_alloc(arena, sizeof(struct mrsh_word_list));
 	wl->word.node.type = MRSH_NODE_WORD;
 	wl->word.type = MRSH_WORD_LIST;
 	if (children != NULL) {
@@ -346,6 +619,11 @@ struct mrsh_word_list *mrsh_word_list_create(struct mrsh_array *children,
 	return wl;
 }
 
+struct mrsh_word_list *mrsh_word_list_create(struct mrsh_array *children,
+		bool double_quoted) {
+	return word_list_create(NULL, children, double_quoted);
+}
+
 struct mrsh_word_string *mrsh_word_get_string(const struct mrsh_word *word) {
 	assert(word->type == MRSH_WORD_STRING);
 	return (struct mrsh_word_string *)word;
@@ -373,11 +651,22 @@ struct mrsh_word_list *mrsh_word_get_list(const struct mrsh_word *word) {
 	return (struct mrsh_word_list *)word;
 }
 
-struct mrsh_simple_command *mrsh_simple_command_create(struct mrsh_word *name,
-		struct mrsh_array *arguments, struct mrsh_array *io_redirects,
-		struct mrsh_array *assignments) {
-	struct mrsh_simple_command *cmd =
-		calloc(1, sizeof(struct mrsh_simple_command));
+struct mrsh_simple_command_priv {
+	struct mrsh_simple_command pub;
+	struct mrsh_command_cache cache;
+};
+
+struct mrsh_command_cache *simple_command_get_cache(
+		struct mrsh_simple_command *sc) {
+	return &((struct mrsh_simple_command_priv *)sc)->cache;
+}
+
+struct mrsh_simple_command *simple_command_create(struct mrsh_arena *arena,
+		struct mrsh_word *name, struct mrsh_array *arguments,
+		struct mrsh_array *io_redirects, struct mrsh_array *assignments) {
+	struct mrsh_simple_command_priv *priv =
+		ast_alloc(arena, sizeof(struct mrsh_simple_command_priv));
+	struct mrsh_simple_command *cmd = &priv->pub;
 	cmd->command.node.type = MRSH_NODE_COMMAND;
 	cmd->command.type = MRSH_SIMPLE_COMMAND;
 	cmd->name = name;
@@ -387,25 +676,45 @@ struct mrsh_simple_command *mrsh_simple_command_create(struct mrsh_word *name,
 	return cmd;
 }
 
-struct mrsh_brace_group *mrsh_brace_group_create(struct mrsh_array *body) {
-	struct mrsh_brace_group *bg = calloc(1, sizeof(struct mrsh_brace_group));
+struct mrsh_simple_command *mrsh_simple_command_create(struct mrsh_word *name,
+		struct mrsh_array *arguments, struct mrsh_array *io_redirects,
+		struct mrsh_array *assignments) {
+	return simple_command_create(NULL, name, arguments, io_redirects,
+		assignments);
+}
+
+struct mrsh_brace_group *brace_group_create(struct mrsh_arena *arena,
+		struct mrsh_array *body) {
+	struct mrsh_brace_group *bg =
+		ast_alloc(arena, sizeof(struct mrsh_brace_group));
 	bg->command.node.type = MRSH_NODE_COMMAND;
 	bg->command.type = MRSH_BRACE_GROUP;
 	bg->body = *body;
 	return bg;
 }
 
-struct mrsh_subshell *mrsh_subshell_create(struct mrsh_array *body) {
-	struct mrsh_subshell *s = calloc(1, sizeof(struct mrsh_subshell));
+struct mrsh_brace_group *mrsh_brace_group_create(struct mrsh_array *body) {
+	return brace_group_create(NULL, body);
+}
+
+struct mrsh_subshell *subshell_create(struct mrsh_arena *arena,
+		struct mrsh_array *body) {
+	struct mrsh_subshell *s = ast_alloc(arena, sizeof(struct mrsh_subshell));
 	s->command.node.type = MRSH_NODE_COMMAND;
 	s->command.type = MRSH_SUBSHELL;
 	s->body = *body;
 	return s;
 }
 
-struct mrsh_if_clause *mrsh_if_clause_create(struct mrsh_array *condition,
-		struct mrsh_array *body, struct mrsh_command *else_part) {
-	struct mrsh_if_clause *ic = calloc(1, sizeof(struct mrsh_if_clause));
+struct mrsh_subshell *mrsh_subshell_create(struct mrsh_array *body) {
+	return subshell_create(NULL, body);
+}
+
+struct mrsh_if_clause *if_clause_create(struct mrsh_arena *arena,
+		struct mrsh_array *condition, struct mrsh_array *body,
+		struct mrsh_command *else_part) {
+	struct mrsh_if_clause *ic =
+		ast_alloc(arena, sizeof(struct mrsh_if_clause));
 	ic->command.node.type = MRSH_NODE_COMMAND;
 	ic->command.type = MRSH_IF_CLAUSE;
 	ic->condition = *condition;
@@ -414,9 +723,15 @@ struct mrsh_if_clause *mrsh_if_clause_create(struct mrsh_array *condition,
 	return ic;
 }
 
-struct mrsh_for_clause *mrsh_for_clause_create(char *name, bool in,
-		struct mrsh_array *word_list, struct mrsh_array *body) {
-	struct mrsh_for_clause *fc = calloc(1, sizeof(struct mrsh_for_clause));
+struct mrsh_if_clause *mrsh_if_clause_create(struct mrsh_array *condition,
+		struct mrsh_array *body, struct mrsh_command *else_part) {
+	return if_clause_create(NULL, condition, body, else_part);
+}
+
+struct mrsh_for_clause *for_clause_create(struct mrsh_arena *arena, char *name,
+		bool in, struct mrsh_array *word_list, struct mrsh_array *body) {
+	struct mrsh_for_clause *fc =
+		ast_alloc(arena, sizeof(struct mrsh_for_clause));
 	fc->command.node.type = MRSH_NODE_COMMAND;
 	fc->command.type = MRSH_FOR_CLAUSE;
 	fc->name = name;
@@ -426,9 +741,16 @@ struct mrsh_for_clause *mrsh_for_clause_create(char *name, bool in,
 	return fc;
 }
 
-struct mrsh_loop_clause *mrsh_loop_clause_create(enum mrsh_loop_type type,
-		struct mrsh_array *condition, struct mrsh_array *body) {
-	struct mrsh_loop_clause *lc = calloc(1, sizeof(struct mrsh_loop_clause));
+struct mrsh_for_clause *mrsh_for_clause_create(char *name, bool in,
+		struct mrsh_array *word_list, struct mrsh_array *body) {
+	return for_clause_create(NULL, name, in, word_list, body);
+}
+
+struct mrsh_loop_clause *loop_clause_create(struct mrsh_arena *arena,
+		enum mrsh_loop_type type, struct mrsh_array *condition,
+		struct mrsh_array *body) {
+	struct mrsh_loop_clause *lc =
+		ast_alloc(arena, sizeof(struct mrsh_loop_clause));
 	lc->command.node.type = MRSH_NODE_COMMAND;
 	lc->command.type = MRSH_LOOP_CLAUSE;
 	lc->type = type;
@@ -437,9 +759,15 @@ struct mrsh_loop_clause *mrsh_loop_clause_create(enum mrsh_loop_type type,
 	return lc;
 }
 
-struct mrsh_case_clause *mrsh_case_clause_create(struct mrsh_word *word,
-		struct mrsh_array *items) {
-	struct mrsh_case_clause *cc = calloc(1, sizeof(struct mrsh_case_clause));
+struct mrsh_loop_clause *mrsh_loop_clause_create(enum mrsh_loop_type type,
+		struct mrsh_array *condition, struct mrsh_array *body) {
+	return loop_clause_create(NULL, type, condition, body);
+}
+
+struct mrsh_case_clause *case_clause_create(struct mrsh_arena *arena,
+		struct mrsh_word *word, struct mrsh_array *items) {
+	struct mrsh_case_clause *cc =
+		ast_alloc(arena, sizeof(struct mrsh_case_clause));
 	cc->command.node.type = MRSH_NODE_COMMAND;
 	cc->command.type = MRSH_CASE_CLAUSE;
 	cc->word = word;
@@ -447,10 +775,16 @@ struct mrsh_case_clause *mrsh_case_clause_create(struct mrsh_word *word,
 	return cc;
 }
 
-struct mrsh_function_definition *mrsh_function_definition_create(char *name,
-		struct mrsh_command *body, struct mrsh_array *io_redirects) {
+struct mrsh_case_clause *mrsh_case_clause_create(struct mrsh_word *word,
+		struct mrsh_array *items) {
+	return case_clause_create(NULL, word, items);
+}
+
+struct mrsh_function_definition *function_definition_create(
+		struct mrsh_arena *arena, char *name, struct mrsh_command *body,
+		struct mrsh_array *io_redirects) {
 	struct mrsh_function_definition *fd =
-		calloc(1, sizeof(struct mrsh_function_definition));
+		ast_alloc(arena, sizeof(struct mrsh_function_definition));
 	fd->command.node.type = MRSH_NODE_COMMAND;
 	fd->command.type = MRSH_FUNCTION_DEFINITION;
 	fd->name = name;
@@ -459,6 +793,11 @@ struct mrsh_function_definition *mrsh_function_definition_create(char *name,
 	return fd;
 }
 
+struct mrsh_function_definition *mrsh_function_definition_create(char *name,
+		struct mrsh_command *body, struct mrsh_array *io_redirects) {
+	return function_definition_create(NULL, name, body, io_redirects);
+}
+
 struct mrsh_simple_command *mrsh_command_get_simple_command(
 		const struct mrsh_command *cmd) {
 	assert(cmd->type == MRSH_SIMPLE_COMMAND);
@@ -507,9 +846,9 @@ struct mrsh_function_definition *mrsh_command_get_function_definition(
 	return (struct mrsh_function_definition *)cmd;
 }
 
-struct mrsh_pipeline *mrsh_pipeline_create(struct mrsh_array *commands,
-		bool bang) {
-	struct mrsh_pipeline *pl = calloc(1, sizeof(struct mrsh_pipeline));
+struct mrsh_pipeline *pipeline_create(struct mrsh_arena *arena,
+		struct mrsh_array *commands, bool bang) {
+	struct mrsh_pipeline *pl = ast_alloc(arena, sizeof(struct mrsh_pipeline));
 	pl->and_or_list.node.type = MRSH_NODE_AND_OR_LIST;
 	pl->and_or_list.type = MRSH_AND_OR_LIST_PIPELINE;
 	pl->commands = *commands;
@@ -517,9 +856,15 @@ struct mrsh_pipeline *mrsh_pipeline_create(struct mrsh_array *commands,
 	return pl;
 }
 
-struct mrsh_binop *mrsh_binop_create(enum mrsh_binop_type type,
-		struct mrsh_and_or_list *left, struct mrsh_and_or_list *right) {
-	struct mrsh_binop *binop = calloc(1, sizeof(struct mrsh_binop));
+struct mrsh_pipeline *mrsh_pipeline_create(struct mrsh_array *commands,
+		bool bang) {
+	return pipeline_create(NULL, commands, bang);
+}
+
+struct mrsh_binop *binop_create(struct mrsh_arena *arena,
+		enum mrsh_binop_type type, struct mrsh_and_or_list *left,
+		struct mrsh_and_or_list *right) {
+	struct mrsh_binop *binop = ast_alloc(arena, sizeof(struct mrsh_binop));
 	binop->and_or_list.node.type = MRSH_NODE_AND_OR_LIST;
 	binop->and_or_list.type = MRSH_AND_OR_LIST_BINOP;
 	binop->type = type;
@@ -528,6 +873,11 @@ struct mrsh_binop *mrsh_binop_create(enum mrsh_binop_type type,
 	return binop;
 }
 
+struct mrsh_binop *mrsh_binop_create(enum mrsh_binop_type type,
+		struct mrsh_and_or_list *left, struct mrsh_and_or_list *right) {
+	return binop_create(NULL, type, left, right);
+}
+
 struct mrsh_pipeline *mrsh_and_or_list_get_pipeline(
 		const struct mrsh_and_or_list *and_or_list) {
 	assert(and_or_list->type == MRSH_AND_OR_LIST_PIPELINE);
@@ -622,7 +972,9 @@ void mrsh_node_for_each(struct mrsh_node *node,
 		case MRSH_FUNCTION_DEFINITION:;
 			struct mrsh_function_definition *fn =
 				mrsh_command_get_function_definition(cmd);
-			mrsh_node_for_each(&fn->body->node, iterator, user_data);
+			if (fn->body != NULL) {
+				mrsh_node_for_each(&fn->body->node, iterator, user_data);
+			}
 			return;
 		}
 		abort();
@@ -660,8 +1012,7 @@ void mrsh_node_for_each(struct mrsh_node *node,
 static void position_next(struct mrsh_position *dst,
 		const struct mrsh_position *src) {
 	*dst = *src;
-	++dst->offset;
-	++dst->column;
+	++dst->offset1;
 }
 
 void mrsh_word_range(struct mrsh_word *word, struct mrsh_position *begin,
@@ -698,8 +1049,11 @@ void mrsh_word_range(struct mrsh_word *word, struct mrsh_position *begin,
 		*begin = wc->range.begin;
 		*end = wc->range.end;
 		return;
-	case MRSH_WORD_ARITHMETIC:
-		abort(); // TODO
+	case MRSH_WORD_ARITHMETIC:;
+		// TODO: store the positions of `$((` and `))`
+		struct mrsh_word_arithmetic *wa = mrsh_word_get_arithmetic(word);
+		mrsh_word_range(wa->body, begin, end);
+		return;
 	case MRSH_WORD_LIST:;
 		struct mrsh_word_list *wl = mrsh_word_get_list(word);
 		if (wl->children.len == 0) {
@@ -746,21 +1100,21 @@ void mrsh_command_range(struct mrsh_command *cmd, struct mrsh_position *begin,
 		for (size_t i = 0; i < sc->arguments.len; ++i) {
 			struct mrsh_word *arg = sc->arguments.data[i];
 			mrsh_word_range(arg, NULL, &maybe_end);
-			if (maybe_end.offset > end->offset) {
+			if (maybe_end.offset1 > end->offset1) {
 				*end = maybe_end;
 			}
 		}
 		for (size_t i = 0; i < sc->io_redirects.len; ++i) {
 			struct mrsh_io_redirect *redir = sc->io_redirects.data[i];
 			mrsh_word_range(redir->name, NULL, &maybe_end);
-			if (maybe_end.offset > end->offset) {
+			if (maybe_end.offset1 > end->offset1) {
 				*end = maybe_end;
 			}
 		}
 		for (size_t i = 0; i < sc->assignments.len; ++i) {
 			struct mrsh_assignment *assign = sc->assignments.data[i];
 			mrsh_word_range(assign->value, NULL, &maybe_end);
-			if (maybe_end.offset > end->offset) {
+			if (maybe_end.offset1 > end->offset1) {
 				*end = maybe_end;
 			}
 		}
@@ -799,7 +1153,13 @@ void mrsh_command_range(struct mrsh_command *cmd, struct mrsh_position *begin,
 		struct mrsh_function_definition *fd =
 			mrsh_command_get_function_definition(cmd);
 		*begin = fd->name_range.begin;
-		mrsh_command_range(fd->body, NULL, end);
+		if (fd->body != NULL) {
+			mrsh_command_range(fd->body, NULL, end);
+		} else {
+			*end = fd->body_pos;
+			end->offset1 += strlen(fd->body_source);
+		}
+		return;
 	}
 	abort();
 }
@@ -808,32 +1168,65 @@ static void buffer_append_str(struct mrsh_buffer *buf, const char *str) {
 	mrsh_buffer_append(buf, str, strlen(str));
 }
 
-static void word_str(const struct mrsh_word *word, struct mrsh_buffer *buf) {
+static size_t word_str_len(const struct mrsh_word *word) {
 	switch (word->type) {
 	case MRSH_WORD_STRING:;
 		const struct mrsh_word_string *ws = mrsh_word_get_string(word);
-		buffer_append_str(buf, ws->str);
-		return;
+		return strlen(ws->str);
 	case MRSH_WORD_PARAMETER:
 	case MRSH_WORD_COMMAND:
 	case MRSH_WORD_ARITHMETIC:
 		abort();
 	case MRSH_WORD_LIST:;
 		const struct mrsh_word_list *wl = mrsh_word_get_list(word);
+		size_t len = 0;
 		for (size_t i = 0; i < wl->children.len; ++i) {
 			const struct mrsh_word *child = wl->children.data[i];
-			word_str(child, buf);
+			len += word_str_len(child);
 		}
-		return;
+		return len;
+	}
+	abort();
+}
+
+static char *word_str_write(const struct mrsh_word *word, char *dst) {
+	switch (word->type) {
+	case MRSH_WORD_STRING:;
+		const struct mrsh_word_string *ws = mrsh_word_get_string(word);
+		size_t len = strlen(ws->str);
+		memcpy(dst, ws->str, len);
+		return dst + len;
+	case MRSH_WORD_PARAMETER:
+	case MRSH_WORD_COMMAND:
+	case MRSH_WORD_ARITHMETIC:
+		abort();
+	case MRSH_WORD_LIST:;
+		const struct mrsh_word_list *wl = mrsh_word_get_list(word);
+		for (size_t i = 0; i < wl->children.len; ++i) {
+			const struct mrsh_word *child = wl->children.data[i];
+			dst = word_str_write(child, dst);
+		}
+		return dst;
 	}
 	abort();
 }
 
 char *mrsh_word_str(const struct mrsh_word *word) {
-	struct mrsh_buffer buf = {0};
-	word_str(word, &buf);
-	mrsh_buffer_append_char(&buf, '\0');
-	return mrsh_buffer_steal(&buf);
+	char *str = malloc(word_str_len(word) + 1);
+	if (str == NULL) {
+		return NULL;
+	}
+	*word_str_write(word, str) = '\0';
+	return str;
+}
+
+char *ast_word_str(struct mrsh_arena *arena, const struct mrsh_word *word) {
+	char *str = ast_alloc(arena, word_str_len(word) + 1);
+	if (str == NULL) {
+		return NULL;
+	}
+	*word_str_write(word, str) = '\0';
+	return str;
 }
 
 static const char *binop_type_str(enum mrsh_binop_type t) {
@@ -951,7 +1344,11 @@ static void node_format(struct mrsh_node *node, struct mrsh_buffer *buf) {
 				mrsh_command_get_function_definition(cmd);
 			buffer_append_str(buf, fn->name);
 			buffer_append_str(buf, "()");
-			node_format(&fn->body->node, buf);
+			if (fn->body != NULL) {
+				node_format(&fn->body->node, buf);
+			} else {
+				buffer_append_str(buf, fn->body_source);
+			}
 			// TODO: io-redirect
 			return;
 		}
@@ -1039,99 +1436,123 @@ struct mrsh_node *mrsh_node_copy(const struct mrsh_node *node) {
 	abort();
 }
 
-struct mrsh_word *mrsh_word_copy(const struct mrsh_word *word) {
+struct mrsh_word *word_copy(struct mrsh_arena *arena,
+		const struct mrsh_word *word) {
 	switch (word->type) {
 	case MRSH_WORD_STRING:;
 		struct mrsh_word_string *ws = mrsh_word_get_string(word);
 		struct mrsh_word_string *ws_copy =
-			mrsh_word_string_create(strdup(ws->str), ws->single_quoted);
+			word_string_create(arena, ast_strdup(arena, ws->str),
+				ws->single_quoted);
+		ws_copy->range = ws->range;
 		return &ws_copy->word;
 	case MRSH_WORD_PARAMETER:;
 		struct mrsh_word_parameter *wp = mrsh_word_get_parameter(word);
 
 		struct mrsh_word *arg = NULL;
 		if (wp->arg != NULL) {
-			arg = mrsh_word_copy(wp->arg);
+			arg = word_copy(arena, wp->arg);
 		}
 
-		struct mrsh_word_parameter *wp_copy = mrsh_word_parameter_create(
-			strdup(wp->name), wp->op, wp->colon, arg);
+		struct mrsh_word_parameter *wp_copy = word_parameter_create(arena,
+			atom_ref(wp->name), wp->op, wp->colon, arg);
+		wp_copy->dollar_pos = wp->dollar_pos;
+		wp_copy->name_range = wp->name_range;
+		wp_copy->op_range = wp->op_range;
+		wp_copy->lbrace_pos = wp->lbrace_pos;
+		wp_copy->rbrace_pos = wp->rbrace_pos;
 		return &wp_copy->word;
 	case MRSH_WORD_COMMAND:;
 		struct mrsh_word_command *wc = mrsh_word_get_command(word);
-		struct mrsh_word_command *wc_copy = mrsh_word_command_create(
-			mrsh_program_copy(wc->program), wc->back_quoted);
+		struct mrsh_word_command *wc_copy = word_command_create(arena,
+			program_copy(arena, wc->program), wc->back_quoted);
+		wc_copy->range = wc->range;
 		return &wc_copy->word;
 	case MRSH_WORD_ARITHMETIC:;
 		struct mrsh_word_arithmetic *wa = mrsh_word_get_arithmetic(word);
-		struct mrsh_word_arithmetic *wa_copy = mrsh_word_arithmetic_create(
-			mrsh_word_copy(wa->body));
+		struct mrsh_word_arithmetic *wa_copy = word_arithmetic_create(arena,
+			word_copy(arena, wa->body));
 		return &wa_copy->word;
 	case MRSH_WORD_LIST:;
 		struct mrsh_word_list *wl = mrsh_word_get_list(word);
 		struct mrsh_array children = {0};
-		mrsh_array_reserve(&children, wl->children.len);
+		ast_array_reserve(arena, &children, wl->children.len);
 		for (size_t i = 0; i < wl->children.len; ++i) {
 			struct mrsh_word *child = wl->children.data[i];
-			mrsh_array_add(&children, mrsh_word_copy(child));
+			mrsh_array_add(&children, word_copy(arena, child));
 		}
 		struct mrsh_word_list *wl_copy =
-			mrsh_word_list_create(&children, wl->double_quoted);
+			word_list_create(arena, &children, wl->double_quoted);
+		wl_copy->lquote_pos = wl->lquote_pos;
+		wl_copy->rquote_pos = wl->rquote_pos;
 		return &wl_copy->word;
 	}
 	abort();
 }
 
-struct mrsh_io_redirect *mrsh_io_redirect_copy(
+struct mrsh_io_redirect *io_redirect_copy(struct mrsh_arena *arena,
 		const struct mrsh_io_redirect *redir) {
 	struct mrsh_io_redirect *redir_copy =
-		calloc(1, sizeof(struct mrsh_io_redirect));
+		ast_alloc(arena, sizeof(struct mrsh_io_redirect));
 	redir_copy->io_number = redir->io_number;
 	redir_copy->op = redir->op;
-	redir_copy->name = mrsh_word_copy(redir->name);
+	redir_copy->name = word_copy(arena, redir->name);
+	redir_copy->io_number_pos = redir->io_number_pos;
+	redir_copy->op_range = redir->op_range;
 
-	mrsh_array_reserve(&redir_copy->here_document, redir->here_document.len);
+	ast_array_reserve(arena, &redir_copy->here_document,
+		redir->here_document.len);
 	for (size_t i = 0; i < redir->here_document.len; ++i) {
 		struct mrsh_word *line = redir->here_document.data[i];
-		mrsh_array_add(&redir_copy->here_document, mrsh_word_copy(line));
+		mrsh_array_add(&redir_copy->here_document, word_copy(arena, line));
 	}
 
 	return redir_copy;
 }
 
-struct mrsh_assignment *mrsh_assignment_copy(
+struct mrsh_assignment *assignment_copy(struct mrsh_arena *arena,
 		const struct mrsh_assignment *assign) {
 	struct mrsh_assignment *assign_copy =
-		calloc(1, sizeof(struct mrsh_assignment));
-	assign_copy->name = strdup(assign->name);
-	assign_copy->value = mrsh_word_copy(assign->value);
+		ast_alloc(arena, sizeof(struct mrsh_assignment));
+	ast_own_atom(arena, atom_ref(assign->name));
+	assign_copy->name = assign->name;
+	assign_copy->value = word_copy(arena, assign->value);
+	assign_copy->name_range = assign->name_range;
+	assign_copy->equal_pos = assign->equal_pos;
 	return assign_copy;
 }
 
-static void command_list_array_copy(struct mrsh_array *dst,
-		const struct mrsh_array *src) {
-	mrsh_array_reserve(dst, src->len);
+static void command_list_array_copy(struct mrsh_arena *arena,
+		struct mrsh_array *dst, const struct mrsh_array *src) {
+	ast_array_reserve(arena, dst, src->len);
 	for (size_t i = 0; i < src->len; ++i) {
 		struct mrsh_command_list *l = src->data[i];
-		mrsh_array_add(dst, mrsh_command_list_copy(l));
+		mrsh_array_add(dst, command_list_copy(arena, l));
 	}
 }
 
-static struct mrsh_case_item *case_item_copy(const struct mrsh_case_item *ci) {
-	struct mrsh_case_item *ci_copy = calloc(1, sizeof(struct mrsh_case_item));
+static struct mrsh_case_item *case_item_copy(struct mrsh_arena *arena,
+		const struct mrsh_case_item *ci) {
+	struct mrsh_case_item *ci_copy =
+		ast_alloc(arena, sizeof(struct mrsh_case_item));
 
-	mrsh_array_reserve(&ci_copy->patterns, ci->patterns.len);
+	ast_array_reserve(arena, &ci_copy->patterns, ci->patterns.len);
 	for (size_t i = 0; i < ci->patterns.len; ++i) {
 		struct mrsh_word *pattern = ci->patterns.data[i];
-		mrsh_array_add(&ci_copy->patterns, mrsh_word_copy(pattern));
+		mrsh_array_add(&ci_copy->patterns, word_copy(arena, pattern));
 	}
 
-	command_list_array_copy(&ci_copy->body, &ci->body);
+	command_list_array_copy(arena, &ci_copy->body, &ci->body);
 
+	ci_copy->lparen_pos = ci->lparen_pos;
+	ci_copy->rparen_pos = ci->rparen_pos;
+	ci_copy->dsemi_range = ci->dsemi_range;
 	return ci_copy;
 }
 
-struct mrsh_command *mrsh_command_copy(const struct mrsh_command *cmd) {
+struct mrsh_command *command_copy(struct mrsh_arena *arena,
+		const struct mrsh_command *cmd) {
+	++lib_stats.ast_copies;
 	struct mrsh_array io_redirects = {0};
 	switch (cmd->type) {
 	case MRSH_SIMPLE_COMMAND:;
@@ -1139,154 +1560,216 @@ struct mrsh_command *mrsh_command_copy(const struct mrsh_command *cmd) {
 
 		struct mrsh_word *name = NULL;
 		if (sc->name != NULL) {
-			name = mrsh_word_copy(sc->name);
+			name = word_copy(arena, sc->name);
 		}
 
 		struct mrsh_array arguments = {0};
-		mrsh_array_reserve(&arguments, sc->arguments.len);
+		ast_array_reserve(arena, &arguments, sc->arguments.len);
 		for (size_t i = 0; i < sc->arguments.len; ++i) {
 			struct mrsh_word *arg = sc->arguments.data[i];
-			mrsh_array_add(&arguments, mrsh_word_copy(arg));
+			mrsh_array_add(&arguments, word_copy(arena, arg));
 		}
 
-		mrsh_array_reserve(&io_redirects, sc->io_redirects.len);
+		ast_array_reserve(arena, &io_redirects, sc->io_redirects.len);
 		for (size_t i = 0; i < sc->io_redirects.len; ++i) {
 			struct mrsh_io_redirect *redir = sc->io_redirects.data[i];
-			mrsh_array_add(&io_redirects, mrsh_io_redirect_copy(redir));
+			mrsh_array_add(&io_redirects, io_redirect_copy(arena, redir));
 		}
 
 		struct mrsh_array assignments = {0};
-		mrsh_array_reserve(&assignments, sc->assignments.len);
+		ast_array_reserve(arena, &assignments, sc->assignments.len);
 		for (size_t i = 0; i < sc->assignments.len; ++i) {
 			struct mrsh_assignment *assign = sc->assignments.data[i];
-			mrsh_array_add(&assignments, mrsh_assignment_copy(assign));
+			mrsh_array_add(&assignments, assignment_copy(arena, assign));
 		}
 
-		struct mrsh_simple_command *sc_copy = mrsh_simple_command_create(
+		struct mrsh_simple_command *sc_copy = simple_command_create(arena,
 			name, &arguments, &io_redirects, &assignments);
+		*simple_command_get_cache(sc_copy) = *simple_command_get_cache(sc);
 		return &sc_copy->command;
 	case MRSH_BRACE_GROUP:;
 		struct mrsh_brace_group *bg = mrsh_command_get_brace_group(cmd);
 		struct mrsh_array bg_body = {0};
-		command_list_array_copy(&bg_body, &bg->body);
-		struct mrsh_brace_group *bg_copy = mrsh_brace_group_create(&bg_body);
+		command_list_array_copy(arena, &bg_body, &bg->body);
+		struct mrsh_brace_group *bg_copy = brace_group_create(arena, &bg_body);
+		bg_copy->lbrace_pos = bg->lbrace_pos;
+		bg_copy->rbrace_pos = bg->rbrace_pos;
 		return &bg_copy->command;
 	case MRSH_SUBSHELL:;
 		struct mrsh_subshell *ss = mrsh_command_get_subshell(cmd);
 		struct mrsh_array ss_body = {0};
-		command_list_array_copy(&ss_body, &ss->body);
-		struct mrsh_subshell *ss_copy = mrsh_subshell_create(&ss_body);
+		command_list_array_copy(arena, &ss_body, &ss->body);
+		struct mrsh_subshell *ss_copy = subshell_create(arena, &ss_body);
+		ss_copy->lparen_pos = ss->lparen_pos;
+		ss_copy->rparen_pos = ss->rparen_pos;
 		return &ss_copy->command;
 	case MRSH_IF_CLAUSE:;
 		struct mrsh_if_clause *ic = mrsh_command_get_if_clause(cmd);
 
 		struct mrsh_array ic_condition = {0};
-		command_list_array_copy(&ic_condition, &ic->condition);
+		command_list_array_copy(arena, &ic_condition, &ic->condition);
 
 		struct mrsh_array ic_body = {0};
-		command_list_array_copy(&ic_body, &ic->body);
+		command_list_array_copy(arena, &ic_body, &ic->body);
 
 		struct mrsh_command *else_part = NULL;
 		if (ic->else_part != NULL) {
-			else_part = mrsh_command_copy(ic->else_part);
+			else_part = command_copy(arena, ic->else_part);
 		}
 
 		struct mrsh_if_clause *ic_copy =
-			mrsh_if_clause_create(&ic_condition, &ic_body, else_part);
+			if_clause_create(arena, &ic_condition, &ic_body, else_part);
+		ic_copy->if_range = ic->if_range;
+		ic_copy->then_range = ic->then_range;
+		ic_copy->fi_range = ic->fi_range;
+		ic_copy->else_range = ic->else_range;
 		return &ic_copy->command;
 	case MRSH_FOR_CLAUSE:;
 		struct mrsh_for_clause *fc = mrsh_command_get_for_clause(cmd);
 
 		struct mrsh_array word_list = {0};
-		mrsh_array_reserve(&word_list, fc->word_list.len);
+		ast_array_reserve(arena, &word_list, fc->word_list.len);
 		for (size_t i = 0; i < fc->word_list.len; ++i) {
 			struct mrsh_word *word = fc->word_list.data[i];
-			mrsh_array_add(&word_list, mrsh_word_copy(word));
+			mrsh_array_add(&word_list, word_copy(arena, word));
 		}
 
 		struct mrsh_array fc_body = {0};
-		command_list_array_copy(&fc_body, &fc->body);
-
-		struct mrsh_for_clause *fc_copy = mrsh_for_clause_create(
-			strdup(fc->name), fc->in, &word_list, &fc_body);
+		command_list_array_copy(arena, &fc_body, &fc->body);
+
+		struct mrsh_for_clause *fc_copy = for_clause_create(arena,
+			ast_strdup(arena, fc->name), fc->in, &word_list, &fc_body);
+		fc_copy->for_range = fc->for_range;
+		fc_copy->name_range = fc->name_range;
+		fc_copy->do_range = fc->do_range;
+		fc_copy->done_range = fc->done_range;
+		fc_copy->in_range = fc->in_range;
 		return &fc_copy->command;
 	case MRSH_LOOP_CLAUSE:;
 		struct mrsh_loop_clause *lc = mrsh_command_get_loop_clause(cmd);
 
 		struct mrsh_array lc_condition = {0};
-		command_list_array_copy(&lc_condition, &lc->condition);
+		command_list_array_copy(arena, &lc_condition, &lc->condition);
 
 		struct mrsh_array lc_body = {0};
-		command_list_array_copy(&lc_body, &lc->body);
+		command_list_array_copy(arena, &lc_body, &lc->body);
 
 		struct mrsh_loop_clause *lc_copy =
-			mrsh_loop_clause_create(lc->type, &lc_condition, &lc_body);
+			loop_clause_create(arena, lc->type, &lc_condition, &lc_body);
+		lc_copy->while_until_range = lc->while_until_range;
+		lc_copy->do_range = lc->do_range;
+		lc_copy->done_range = lc->done_range;
 		return &lc_copy->command;
 	case MRSH_CASE_CLAUSE:;
 		struct mrsh_case_clause *cc = mrsh_command_get_case_clause(cmd);
 
 		struct mrsh_array items = {0};
-		mrsh_array_reserve(&items, cc->items.len);
+		ast_array_reserve(arena, &items, cc->items.len);
 		for (size_t i = 0; i < cc->items.len; ++i) {
 			struct mrsh_case_item *ci = cc->items.data[i];
-			mrsh_array_add(&items, case_item_copy(ci));
+			mrsh_array_add(&items, case_item_copy(arena, ci));
 		}
 
 		struct mrsh_case_clause *cc_copy =
-			mrsh_case_clause_create(mrsh_word_copy(cc->word), &items);
+			case_clause_create(arena, word_copy(arena, cc->word), &items);
+		cc_copy->case_range = cc->case_range;
+		cc_copy->in_range = cc->in_range;
+		cc_copy->esac_range = cc->esac_range;
 		return &cc_copy->command;
 	case MRSH_FUNCTION_DEFINITION:;
 		struct mrsh_function_definition *fd =
 			mrsh_command_get_function_definition(cmd);
 
-		mrsh_array_reserve(&io_redirects, fd->io_redirects.len);
+		ast_array_reserve(arena, &io_redirects, fd->io_redirects.len);
 		for (size_t i = 0; i < fd->io_redirects.len; ++i) {
 			struct mrsh_io_redirect *redir = fd->io_redirects.data[i];
-			mrsh_array_add(&io_redirects, mrsh_io_redirect_copy(redir));
+			mrsh_array_add(&io_redirects, io_redirect_copy(arena, redir));
 		}
 
 		struct mrsh_function_definition *fd_copy =
-			mrsh_function_definition_create(strdup(fd->name),
-				mrsh_command_copy(fd->body), &io_redirects);
+			function_definition_create(arena, ast_strdup(arena, fd->name),
+				fd->body != NULL ? command_copy(arena, fd->body) : NULL,
+				&io_redirects);
+		fd_copy->name_range = fd->name_range;
+		fd_copy->lparen_pos = fd->lparen_pos;
+		fd_copy->rparen_pos = fd->rparen_pos;
+		if (fd->body_source != NULL) {
+			fd_copy->body_source = ast_strdup(arena, fd->body_source);
+			fd_copy->body_pos = fd->body_pos;
+		}
 		return &fd_copy->command;
 	}
 	abort();
 }
 
-struct mrsh_and_or_list *mrsh_and_or_list_copy(
+struct mrsh_and_or_list *and_or_list_copy(struct mrsh_arena *arena,
 		const struct mrsh_and_or_list *and_or_list) {
 	switch (and_or_list->type) {
 	case MRSH_AND_OR_LIST_PIPELINE:;
 		struct mrsh_pipeline *pl = mrsh_and_or_list_get_pipeline(and_or_list);
 		struct mrsh_array commands = {0};
-		mrsh_array_reserve(&commands, pl->commands.len);
+		ast_array_reserve(arena, &commands, pl->commands.len);
 		for (size_t i = 0; i < pl->commands.len; ++i) {
 			struct mrsh_command *cmd = pl->commands.data[i];
-			mrsh_array_add(&commands, mrsh_command_copy(cmd));
+			mrsh_array_add(&commands, command_copy(arena, cmd));
 		}
 		struct mrsh_pipeline *p_copy =
-			mrsh_pipeline_create(&commands, pl->bang);
+			pipeline_create(arena, &commands, pl->bang);
 		return &p_copy->and_or_list;
 	case MRSH_AND_OR_LIST_BINOP:;
 		struct mrsh_binop *binop = mrsh_and_or_list_get_binop(and_or_list);
-		struct mrsh_binop *binop_copy = mrsh_binop_create(binop->type,
-			mrsh_and_or_list_copy(binop->left),
-			mrsh_and_or_list_copy(binop->right));
+		struct mrsh_binop *binop_copy = binop_create(arena, binop->type,
+			and_or_list_copy(arena, binop->left),
+			and_or_list_copy(arena, binop->right));
 		return &binop_copy->and_or_list;
 	}
 	abort();
 }
 
-struct mrsh_command_list *mrsh_command_list_copy(
+struct mrsh_command_list *command_list_copy(struct mrsh_arena *arena,
 		const struct mrsh_command_list *l) {
-	struct mrsh_command_list *l_copy = mrsh_command_list_create();
-	l_copy->and_or_list = mrsh_and_or_list_copy(l->and_or_list);
+	struct mrsh_command_list *l_copy = command_list_create(arena);
+	l_copy->and_or_list = and_or_list_copy(arena, l->and_or_list);
 	l_copy->ampersand = l->ampersand;
 	return l_copy;
 }
 
-struct mrsh_program *mrsh_program_copy(const struct mrsh_program *prog) {
-	struct mrsh_program *prog_copy = mrsh_program_create();
-	command_list_array_copy(&prog_copy->body, &prog->body);
+struct mrsh_program *program_copy(struct mrsh_arena *arena,
+		const struct mrsh_program *prog) {
+	struct mrsh_program *prog_copy = program_create(arena);
+	command_list_array_copy(arena, &prog_copy->body, &prog->body);
+	program_set_line_table(prog_copy, program_get_line_table(prog));
 	return prog_copy;
 }
+
+struct mrsh_word *mrsh_word_copy(const struct mrsh_word *word) {
+	return word_copy(NULL, word);
+}
+
+struct mrsh_io_redirect *mrsh_io_redirect_copy(
+		const struct mrsh_io_redirect *redir) {
+	return io_redirect_copy(NULL, redir);
+}
+
+struct mrsh_assignment *mrsh_assignment_copy(
+		const struct mrsh_assignment *assign) {
+	return assignment_copy(NULL, assign);
+}
+
+struct mrsh_command *mrsh_command_copy(const struct mrsh_command *cmd) {
+	return command_copy(NULL, cmd);
+}
+
+struct mrsh_and_or_list *mrsh_and_or_list_copy(
+		const struct mrsh_and_or_list *and_or_list) {
+	return and_or_list_copy(NULL, and_or_list);
+}
+
+struct mrsh_command_list *mrsh_command_list_copy(
+		const struct mrsh_command_list *l) {
+	return command_list_copy(NULL, l);
+}
+
+struct mrsh_program *mrsh_program_copy(const struct mrsh_program *prog) {
+	return program_copy(NULL, prog);
+}
@@ -22,9 +22,14 @@ static void print_prefix(const char *prefix, bool last) {
 	printf("%s%s", prefix, last ? L_LAST : L_VAL);
 }
 
+// The program being printed, used to get line and column numbers
+static const struct mrsh_program *root_program = NULL;
+
 static void print_range(const struct mrsh_range *range) {
-	printf("[%d:%d → %d:%d]", range->begin.line, range->begin.column,
-		range->end.line, range->end.column);
+	struct mrsh_location begin, end;
+	mrsh_program_location(root_program, &range->begin, &begin);
+	mrsh_program_location(root_program, &range->end, &end);
+	printf("[%d:%d → %d:%d]", begin.line, begin.column, end.line, end.column);
 }
 
 static const char *word_parameter_op_str(enum mrsh_word_parameter_op op) {
@@ -387,6 +392,13 @@ static void print_case_clause(struct mrsh_case_clause *cc, const char *prefix) {
 static void print_function_definition(struct mrsh_function_definition *fd,
 		const char *prefix) {
 	printf("function_definition %s ─ ", fd->name);
+	if (fd->body == NULL) {
+		struct mrsh_range body_range = { .begin = fd->body_pos };
+		mrsh_command_range(&fd->command, NULL, &body_range.end);
+		print_range(&body_range);
+		printf(" (not parsed yet)\n");
+		return;
+	}
 	print_command(fd->body, prefix);
 	// TODO: print io_redirects
 }
@@ -499,5 +511,7 @@ static void print_program(struct mrsh_program *prog, const char *prefix) {
 }
 
 void mrsh_program_print(struct mrsh_program *prog) {
+	root_program = prog;
 	print_program(prog, "");
+	root_program = NULL;
 }
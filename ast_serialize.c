@@ -0,0 +1,804 @@
+#include <assert.h>
+#include <mrsh/buffer.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "ast.h"
+#include "intern.h"
+#include "line_table.h"
+
+/**
+ * Nodes are written depth-first. Optional nodes and node types are prefixed
+ * with a tag byte, 0 meaning NULL. Integers are written in host byte order,
+ * strings and arrays are prefixed with their length.
+ */
+
+#define NODE_NULL 0
+#define MAX_DEPTH 1024
+
+static void write_u8(struct mrsh_buffer *buf, uint8_t v) {
+	mrsh_buffer_append_char(buf, (char)v);
+}
+
+static void write_u32(struct mrsh_buffer *buf, uint32_t v) {
+	mrsh_buffer_append(buf, (const char *)&v, sizeof(v));
+}
+
+static void write_str(struct mrsh_buffer *buf, const char *str) {
+	size_t len = strlen(str);
+	write_u32(buf, len);
+	mrsh_buffer_append(buf, str, len);
+}
+
+static void write_pos(struct mrsh_buffer *buf, const struct mrsh_position *pos) {
+	write_u32(buf, pos->offset1);
+}
+
+static void write_range(struct mrsh_buffer *buf,
+		const struct mrsh_range *range) {
+	write_pos(buf, &range->begin);
+	write_pos(buf, &range->end);
+}
+
+static void write_program(struct mrsh_buffer *buf,
+	const struct mrsh_program *prog);
+static void write_command(struct mrsh_buffer *buf,
+	const struct mrsh_command *cmd);
+
+static void write_word(struct mrsh_buffer *buf, const struct mrsh_word *word) {
+	if (word == NULL) {
+		write_u8(buf, NODE_NULL);
+		return;
+	}
+
+	write_u8(buf, word->type + 1);
+	switch (word->type) {
+	case MRSH_WORD_STRING:;
+		struct mrsh_word_string *ws = mrsh_word_get_string(word);
+		write_str(buf, ws->str);
+		write_u8(buf, ws->single_quoted);
+		write_u8(buf, ws->split_fields);
+		write_range(buf, &ws->range);
+		return;
+	case MRSH_WORD_PARAMETER:;
+		struct mrsh_word_parameter *wp = mrsh_word_get_parameter(word);
+		write_str(buf, wp->name);
+		write_u8(buf, wp->op);
+		write_u8(buf, wp->colon);
+		write_word(buf, wp->arg);
+		write_pos(buf, &wp->dollar_pos);
+		write_range(buf, &wp->name_range);
+		write_range(buf, &wp->op_range);
+		write_pos(buf, &wp->lbrace_pos);
+		write_pos(buf, &wp->rbrace_pos);
+		return;
+	case MRSH_WORD_COMMAND:;
+		struct mrsh_word_command *wc = mrsh_word_get_command(word);
+		write_u8(buf, wc->program != NULL);
+		if (wc->program != NULL) {
+			write_program(buf, wc->program);
+		}
+		write_u8(buf, wc->back_quoted);
+		write_range(buf, &wc->range);
+		return;
+	case MRSH_WORD_ARITHMETIC:;
+		struct mrsh_word_arithmetic *wa = mrsh_word_get_arithmetic(word);
+		write_word(buf, wa->body);
+		return;
+	case MRSH_WORD_LIST:;
+		struct mrsh_word_list *wl = mrsh_word_get_list(word);
+		write_u32(buf, wl->children.len);
+		for (size_t i = 0; i < wl->children.len; ++i) {
+			write_word(buf, wl->children.data[i]);
+		}
+		write_u8(buf, wl->double_quoted);
+		write_pos(buf, &wl->lquote_pos);
+		write_pos(buf, &wl->rquote_pos);
+		return;
+	}
+	abort();
+}
+
+static void write_word_array(struct mrsh_buffer *buf,
+		const struct mrsh_array *words) {
+	write_u32(buf, words->len);
+	for (size_t i = 0; i < words->len; ++i) {
+		write_word(buf, words->data[i]);
+	}
+}
+
+static void write_io_redirect_array(struct mrsh_buffer *buf,
+		const struct mrsh_array *redirs) {
+	write_u32(buf, redirs->len);
+	for (size_t i = 0; i < redirs->len; ++i) {
+		struct mrsh_io_redirect *redir = redirs->data[i];
+		write_u32(buf, (uint32_t)redir->io_number);
+		write_u8(buf, redir->op);
+		write_word(buf, redir->name);
+		write_word_array(buf, &redir->here_document);
+		write_pos(buf, &redir->io_number_pos);
+		write_range(buf, &redir->op_range);
+	}
+}
+
+static void write_and_or_list(struct mrsh_buffer *buf,
+		const struct mrsh_and_or_list *and_or_list) {
+	write_u8(buf, and_or_list->type);
+	switch (and_or_list->type) {
+	case MRSH_AND_OR_LIST_PIPELINE:;
+		struct mrsh_pipeline *pl = mrsh_and_or_list_get_pipeline(and_or_list);
+		write_u32(buf, pl->commands.len);
+		for (size_t i = 0; i < pl->commands.len; ++i) {
+			write_command(buf, pl->commands.data[i]);
+		}
+		write_u8(buf, pl->bang);
+		write_pos(buf, &pl->bang_pos);
+		return;
+	case MRSH_AND_OR_LIST_BINOP:;
+		struct mrsh_binop *binop = mrsh_and_or_list_get_binop(and_or_list);
+		write_u8(buf, binop->type);
+		write_and_or_list(buf, binop->left);
+		write_and_or_list(buf, binop->right);
+		write_range(buf, &binop->op_range);
+		return;
+	}
+	abort();
+}
+
+static void write_command_list_array(struct mrsh_buffer *buf,
+		const struct mrsh_array *cmds) {
+	write_u32(buf, cmds->len);
+	for (size_t i = 0; i < cmds->len; ++i) {
+		struct mrsh_command_list *l = cmds->data[i];
+		write_and_or_list(buf, l->and_or_list);
+		write_u8(buf, l->ampersand);
+		write_pos(buf, &l->separator_pos);
+	}
+}
+
+static void write_command(struct mrsh_buffer *buf,
+		const struct mrsh_command *cmd) {
+	if (cmd == NULL) {
+		write_u8(buf, NODE_NULL);
+		return;
+	}
+
+	write_u8(buf, cmd->type + 1);
+	switch (cmd->type) {
+	case MRSH_SIMPLE_COMMAND:;
+		struct mrsh_simple_command *sc = mrsh_command_get_simple_command(cmd);
+		write_word(buf, sc->name);
+		write_word_array(buf, &sc->arguments);
+		write_io_redirect_array(buf, &sc->io_redirects);
+		write_u32(buf, sc->assignments.len);
+		for (size_t i = 0; i < sc->assignments.len; ++i) {
+			struct mrsh_assignment *assign = sc->assignments.data[i];
+			write_str(buf, assign->name);
+			write_word(buf, assign->value);
+			write_range(buf, &assign->name_range);
+			write_pos(buf, &assign->equal_pos);
+		}
+		return;
+	case MRSH_BRACE_GROUP:;
+		struct mrsh_brace_group *bg = mrsh_command_get_brace_group(cmd);
+		write_command_list_array(buf, &bg->body);
+		write_pos(buf, &bg->lbrace_pos);
+		write_pos(buf, &bg->rbrace_pos);
+		return;
+	case MRSH_SUBSHELL:;
+		struct mrsh_subshell *s = mrsh_command_get_subshell(cmd);
+		write_command_list_array(buf, &s->body);
+		write_pos(buf, &s->lparen_pos);
+		write_pos(buf, &s->rparen_pos);
+		return;
+	case MRSH_IF_CLAUSE:;
+		struct mrsh_if_clause *ic = mrsh_command_get_if_clause(cmd);
+		write_command_list_array(buf, &ic->condition);
+		write_command_list_array(buf, &ic->body);
+		write_command(buf, ic->else_part);
+		write_range(buf, &ic->if_range);
+		write_range(buf, &ic->then_range);
+		write_range(buf, &ic->fi_range);
+		write_range(buf, &ic->else_range);
+		return;
+	case MRSH_FOR_CLAUSE:;
+		struct mrsh_for_clause *fc = mrsh_command_get_for_clause(cmd);
+		write_str(buf, fc->name);
+		write_u8(buf, fc->in);
+		write_word_array(buf, &fc->word_list);
+		write_command_list_array(buf, &fc->body);
+		write_range(buf, &fc->for_range);
+		write_range(buf, &fc->name_range);
+		write_range(buf, &fc->do_range);
+		write_range(buf, &fc->done_range);
+		write_range(buf, &fc->in_range);
+		return;
+	case MRSH_LOOP_CLAUSE:;
+		struct mrsh_loop_clause *lc = mrsh_command_get_loop_clause(cmd);
+		write_u8(buf, lc->type);
+		write_command_list_array(buf, &lc->condition);
+		write_command_list_array(buf, &lc->body);
+		write_range(buf, &lc->while_until_range);
+		write_range(buf, &lc->do_range);
+		write_range(buf, &lc->done_range);
+		return;
+	case MRSH_CASE_CLAUSE:;
+		struct mrsh_case_clause *cc = mrsh_command_get_case_clause(cmd);
+		write_word(buf, cc->word);
+		write_u32(buf, cc->items.len);
+		for (size_t i = 0; i < cc->items.len; ++i) {
+			struct mrsh_case_item *item = cc->items.data[i];
+			write_word_array(buf, &item->patterns);
+			write_command_list_array(buf, &item->body);
+			write_pos(buf, &item->lparen_pos);
+			write_pos(buf, &item->rparen_pos);
+			write_range(buf, &item->dsemi_range);
+		}
+		write_range(buf, &cc->case_range);
+		write_range(buf, &cc->in_range);
+		write_range(buf, &cc->esac_range);
+		return;
+	case MRSH_FUNCTION_DEFINITION:;
+		struct mrsh_function_definition *fd =
+			mrsh_command_get_function_definition(cmd);
+		write_str(buf, fd->name);
+		write_command(buf, fd->body);
+		write_io_redirect_array(buf, &fd->io_redirects);
+		write_u8(buf, fd->body_source != NULL);
+		if (fd->body_source != NULL) {
+			write_str(buf, fd->body_source);
+			write_pos(buf, &fd->body_pos);
+		}
+		write_range(buf, &fd->name_range);
+		write_pos(buf, &fd->lparen_pos);
+		write_pos(buf, &fd->rparen_pos);
+		return;
+	}
+	abort();
+}
+
+static void write_program(struct mrsh_buffer *buf,
+		const struct mrsh_program *prog) {
+	write_command_list_array(buf, &prog->body);
+}
+
+void program_serialize(const struct mrsh_program *prog,
+		struct mrsh_buffer *buf) {
+	const struct mrsh_line_table *lines = program_get_line_table(prog);
+	size_t nlines = lines != NULL ? lines->len : 0;
+	write_u32(buf, nlines);
+	for (size_t i = 0; i < nlines; ++i) {
+		write_u32(buf, lines->newlines[i]);
+	}
+
+	write_program(buf, prog);
+}
+
+struct reader {
+	const char *data;
+	size_t len;
+	int depth;
+	bool error;
+	struct mrsh_arena *arena; // nodes are allocated from it
+};
+
+static bool read_bytes(struct reader *r, void *dst, size_t size) {
+	if (r->error || r->len < size) {
+		r->error = true;
+		return false;
+	}
+	memcpy(dst, r->data, size);
+	r->data += size;
+	r->len -= size;
+	return true;
+}
+
+static uint8_t read_u8(struct reader *r) {
+	uint8_t v = 0;
+	read_bytes(r, &v, sizeof(v));
+	return v;
+}
+
+static uint32_t read_u32(struct reader *r) {
+	uint32_t v = 0;
+	read_bytes(r, &v, sizeof(v));
+	return v;
+}
+
+static bool read_bool(struct reader *r) {
+	return read_u8(r) != 0;
+}
+
+/**
+ * Reads an enum value, failing if it's greater than `max`.
+ */
+static int read_enum(struct reader *r, int max) {
+	uint8_t v = read_u8(r);
+	if (v > max) {
+		r->error = true;
+		return 0;
+	}
+	return v;
+}
+
+static char *read_str(struct reader *r) {
+	uint32_t len = read_u32(r);
+	if (r->error || r->len < len) {
+		r->error = true;
+		return NULL;
+	}
+	char *str = ast_strndup(r->arena, r->data, len);
+	r->data += len;
+	r->len -= len;
+	if (str == NULL) {
+		r->error = true;
+	}
+	return str;
+}
+
+static const char *read_atom(struct reader *r) {
+	uint32_t len = read_u32(r);
+	if (r->error || r->len < len) {
+		r->error = true;
+		return NULL;
+	}
+	const char *atom = intern_n(r->data, len);
+	r->data += len;
+	r->len -= len;
+	if (atom == NULL) {
+		r->error = true;
+	}
+	return atom;
+}
+
+static void read_pos(struct reader *r, struct mrsh_position *pos) {
+	pos->offset1 = read_u32(r);
+}
+
+static void read_range(struct reader *r, struct mrsh_range *range) {
+	read_pos(r, &range->begin);
+	read_pos(r, &range->end);
+}
+
+/**
+ * Reads an array length, and reserves the array. Each element takes at least
+ * one byte, which bounds the length by the remaining data.
+ */
+static uint32_t read_array_len(struct reader *r, struct mrsh_array *array) {
+	uint32_t len = read_u32(r);
+	if (r->error || len > r->len ||
+			!ast_array_reserve(r->arena, array, len)) {
+		r->error = true;
+		return 0;
+	}
+	return len;
+}
+
+static bool enter(struct reader *r) {
+	if (r->error || r->depth >= MAX_DEPTH) {
+		r->error = true;
+		return false;
+	}
+	++r->depth;
+	return true;
+}
+
+static void leave(struct reader *r) {
+	--r->depth;
+}
+
+static struct mrsh_program *read_program(struct reader *r);
+static struct mrsh_command *read_command(struct reader *r);
+
+static struct mrsh_word *_read_word(struct reader *r) {
+	int tag = read_enum(r, MRSH_WORD_LIST + 1);
+	if (r->error || tag == NODE_NULL) {
+		return NULL;
+	}
+
+	switch ((enum mrsh_word_type)(tag - 1)) {
+	case MRSH_WORD_STRING:;
+		char *str = read_str(r);
+		bool single_quoted = read_bool(r);
+		if (r->error) {
+			return NULL;
+		}
+		struct mrsh_word_string *ws =
+			word_string_create(r->arena, str, single_quoted);
+		ws->split_fields = read_bool(r);
+		read_range(r, &ws->range);
+		return &ws->word;
+	case MRSH_WORD_PARAMETER:;
+		const char *name = read_atom(r);
+		enum mrsh_word_parameter_op op = read_enum(r, MRSH_PARAM_DHASH);
+		bool colon = read_bool(r);
+		struct mrsh_word *arg = _read_word(r);
+		if (r->error) {
+			atom_unref(name);
+			return NULL;
+		}
+		struct mrsh_word_parameter *wp =
+			word_parameter_create(r->arena, name, op, colon, arg);
+		read_pos(r, &wp->dollar_pos);
+		read_range(r, &wp->name_range);
+		read_range(r, &wp->op_range);
+		read_pos(r, &wp->lbrace_pos);
+		read_pos(r, &wp->rbrace_pos);
+		return &wp->word;
+	case MRSH_WORD_COMMAND:;
+		struct mrsh_program *prog = NULL;
+		if (read_bool(r)) {
+			prog = read_program(r);
+		}
+		bool back_quoted = read_bool(r);
+		if (r->error) {
+			return NULL;
+		}
+		struct mrsh_word_command *wc =
+			word_command_create(r->arena, prog, back_quoted);
+		read_range(r, &wc->range);
+		return &wc->word;
+	case MRSH_WORD_ARITHMETIC:;
+		struct mrsh_word *body = _read_word(r);
+		if (r->error || body == NULL) {
+			r->error = true;
+			return NULL;
+		}
+		struct mrsh_word_arithmetic *wa =
+			word_arithmetic_create(r->arena, body);
+		return &wa->word;
+	case MRSH_WORD_LIST:;
+		struct mrsh_array children = {0};
+		uint32_t len = read_array_len(r, &children);
+		for (uint32_t i = 0; i < len; ++i) {
+			struct mrsh_word *child = _read_word(r);
+			if (child == NULL) {
+				r->error = true;
+				return NULL;
+			}
+			mrsh_array_add(&children, child);
+		}
+		bool double_quoted = read_bool(r);
+		if (r->error) {
+			return NULL;
+		}
+		struct mrsh_word_list *wl =
+			word_list_create(r->arena, &children, double_quoted);
+		read_pos(r, &wl->lquote_pos);
+		read_pos(r, &wl->rquote_pos);
+		return &wl->word;
+	}
+	abort();
+}
+
+static struct mrsh_word *read_word(struct reader *r) {
+	if (!enter(r)) {
+		return NULL;
+	}
+	struct mrsh_word *word = _read_word(r);
+	leave(r);
+	return word;
+}
+
+static void read_word_array(struct reader *r, struct mrsh_array *words) {
+	uint32_t len = read_array_len(r, words);
+	for (uint32_t i = 0; i < len; ++i) {
+		struct mrsh_word *word = read_word(r);
+		if (word == NULL) {
+			r->error = true;
+			return;
+		}
+		mrsh_array_add(words, word);
+	}
+}
+
+static void read_io_redirect_array(struct reader *r,
+		struct mrsh_array *redirs) {
+	uint32_t len = read_array_len(r, redirs);
+	for (uint32_t i = 0; i < len; ++i) {
+		struct mrsh_io_redirect *redir =
+			ast_alloc(r->arena, sizeof(struct mrsh_io_redirect));
+		if (redir == NULL) {
+			r->error = true;
+			return;
+		}
+		redir->io_number = (int32_t)read_u32(r);
+		redir->op = read_enum(r, MRSH_IO_DLESSDASH);
+		redir->name = read_word(r);
+		read_word_array(r, &redir->here_document);
+		read_pos(r, &redir->io_number_pos);
+		read_range(r, &redir->op_range);
+		if (r->error || redir->name == NULL) {
+			r->error = true;
+			return;
+		}
+		mrsh_array_add(redirs, redir);
+	}
+}
+
+static struct mrsh_and_or_list *_read_and_or_list(struct reader *r) {
+	switch ((enum mrsh_and_or_list_type)read_enum(r, MRSH_AND_OR_LIST_BINOP)) {
+	case MRSH_AND_OR_LIST_PIPELINE:;
+		struct mrsh_array commands = {0};
+		uint32_t len = read_array_len(r, &commands);
+		for (uint32_t i = 0; i < len; ++i) {
+			struct mrsh_command *cmd = read_command(r);
+			if (cmd == NULL) {
+				r->error = true;
+				return NULL;
+			}
+			mrsh_array_add(&commands, cmd);
+		}
+		bool bang = read_bool(r);
+		if (r->error || len == 0) {
+			r->error = true;
+			return NULL;
+		}
+		struct mrsh_pipeline *pl =
+			pipeline_create(r->arena, &commands, bang);
+		read_pos(r, &pl->bang_pos);
+		return &pl->and_or_list;
+	case MRSH_AND_OR_LIST_BINOP:;
+		enum mrsh_binop_type type = read_enum(r, MRSH_BINOP_OR);
+		if (!enter(r)) {
+			return NULL;
+		}
+		struct mrsh_and_or_list *left = _read_and_or_list(r);
+		struct mrsh_and_or_list *right = _read_and_or_list(r);
+		leave(r);
+		if (r->error) {
+			return NULL;
+		}
+		struct mrsh_binop *binop =
+			binop_create(r->arena, type, left, right);
+		read_range(r, &binop->op_range);
+		return &binop->and_or_list;
+	}
+	abort();
+}
+
+static void read_command_list_array(struct reader *r,
+		struct mrsh_array *cmds) {
+	uint32_t len = read_array_len(r, cmds);
+	for (uint32_t i = 0; i < len; ++i) {
+		struct mrsh_and_or_list *and_or_list = _read_and_or_list(r);
+		if (r->error) {
+			return;
+		}
+		struct mrsh_command_list *l = command_list_create(r->arena);
+		if (l == NULL) {
+			r->error = true;
+			return;
+		}
+		l->and_or_list = and_or_list;
+		l->ampersand = read_bool(r);
+		read_pos(r, &l->separator_pos);
+		mrsh_array_add(cmds, l);
+	}
+}
+
+static struct mrsh_command *_read_command(struct reader *r) {
+	int tag = read_enum(r, MRSH_FUNCTION_DEFINITION + 1);
+	if (r->error || tag == NODE_NULL) {
+		return NULL;
+	}
+
+	struct mrsh_array body = {0};
+	switch ((enum mrsh_command_type)(tag - 1)) {
+	case MRSH_SIMPLE_COMMAND:;
+		struct mrsh_word *name = read_word(r);
+		struct mrsh_array arguments = {0}, io_redirects = {0},
+			assignments = {0};
+		read_word_array(r, &arguments);
+		read_io_redirect_array(r, &io_redirects);
+		uint32_t len = read_array_len(r, &assignments);
+		for (uint32_t i = 0; i < len; ++i) {
+			struct mrsh_assignment *assign =
+				ast_alloc(r->arena, sizeof(struct mrsh_assignment));
+			if (assign == NULL) {
+				r->error = true;
+				return NULL;
+			}
+			assign->name = read_atom(r);
+			ast_own_atom(r->arena, assign->name);
+			assign->value = read_word(r);
+			read_range(r, &assign->name_range);
+			read_pos(r, &assign->equal_pos);
+			if (r->error || assign->value == NULL) {
+				r->error = true;
+				return NULL;
+			}
+			mrsh_array_add(&assignments, assign);
+		}
+		if (r->error) {
+			return NULL;
+		}
+		struct mrsh_simple_command *sc = simple_command_create(r->arena,
+			name, &arguments, &io_redirects, &assignments);
+		return &sc->command;
+	case MRSH_BRACE_GROUP:;
+		read_command_list_array(r, &body);
+		if (r->error) {
+			return NULL;
+		}
+		struct mrsh_brace_group *bg = brace_group_create(r->arena, &body);
+		read_pos(r, &bg->lbrace_pos);
+		read_pos(r, &bg->rbrace_pos);
+		return &bg->command;
+	case MRSH_SUBSHELL:;
+		read_command_list_array(r, &body);
+		if (r->error) {
+			return NULL;
+		}
+		struct mrsh_subshell *s = subshell_create(r->arena, &body);
+		read_pos(r, &s->lparen_pos);
+		read_pos(r, &s->rparen_pos);
+		return &s->command;
+	case MRSH_IF_CLAUSE:;
+		struct mrsh_array condition = {0};
+		read_command_list_array(r, &condition);
+		read_command_list_array(r, &body);
+		struct mrsh_command *else_part = read_command(r);
+		if (r->error) {
+			return NULL;
+		}
+		struct mrsh_if_clause *ic =
+			if_clause_create(r->arena, &condition, &body, else_part);
+		read_range(r, &ic->if_range);
+		read_range(r, &ic->then_range);
+		read_range(r, &ic->fi_range);
+		read_range(r, &ic->else_range);
+		return &ic->command;
+	case MRSH_FOR_CLAUSE:;
+		char *for_name = read_str(r);
+		bool in = read_bool(r);
+		struct mrsh_array word_list = {0};
+		read_word_array(r, &word_list);
+		read_command_list_array(r, &body);
+		if (r->error) {
+			return NULL;
+		}
+		struct mrsh_for_clause *fc =
+			for_clause_create(r->arena, for_name, in, &word_list, &body);
+		read_range(r, &fc->for_range);
+		read_range(r, &fc->name_range);
+		read_range(r, &fc->do_range);
+		read_range(r, &fc->done_range);
+		read_range(r, &fc->in_range);
+		return &fc->command;
+	case MRSH_LOOP_CLAUSE:;
+		enum mrsh_loop_type loop_type = read_enum(r, MRSH_LOOP_UNTIL);
+		struct mrsh_array loop_condition = {0};
+		read_command_list_array(r, &loop_condition);
+		read_command_list_array(r, &body);
+		if (r->error) {
+			return NULL;
+		}
+		struct mrsh_loop_clause *lc =
+			loop_clause_create(r->arena, loop_type, &loop_condition, &body);
+		read_range(r, &lc->while_until_range);
+		read_range(r, &lc->do_range);
+		read_range(r, &lc->done_range);
+		return &lc->command;
+	case MRSH_CASE_CLAUSE:;
+		struct mrsh_word *word = read_word(r);
+		struct mrsh_array items = {0};
+		uint32_t items_len = read_array_len(r, &items);
+		for (uint32_t i = 0; i < items_len; ++i) {
+			struct mrsh_case_item *item =
+				ast_alloc(r->arena, sizeof(struct mrsh_case_item));
+			if (item == NULL) {
+				r->error = true;
+				return NULL;
+			}
+			read_word_array(r, &item->patterns);
+			read_command_list_array(r, &item->body);
+			read_pos(r, &item->lparen_pos);
+			read_pos(r, &item->rparen_pos);
+			read_range(r, &item->dsemi_range);
+			if (r->error) {
+				return NULL;
+			}
+			mrsh_array_add(&items, item);
+		}
+		if (r->error || word == NULL) {
+			r->error = true;
+			return NULL;
+		}
+		struct mrsh_case_clause *cc =
+			case_clause_create(r->arena, word, &items);
+		read_range(r, &cc->case_range);
+		read_range(r, &cc->in_range);
+		read_range(r, &cc->esac_range);
+		return &cc->command;
+	case MRSH_FUNCTION_DEFINITION:;
+		char *fn_name = read_str(r);
+		struct mrsh_command *fn_body = read_command(r);
+		struct mrsh_array fn_io_redirects = {0};
+		read_io_redirect_array(r, &fn_io_redirects);
+		char *fn_body_source = NULL;
+		struct mrsh_position fn_body_pos = {0};
+		if (read_bool(r)) {
+			fn_body_source = read_str(r);
+			read_pos(r, &fn_body_pos);
+		}
+		if (r->error || (fn_body == NULL) == (fn_body_source == NULL)) {
+			r->error = true;
+			return NULL;
+		}
+		struct mrsh_function_definition *fd = function_definition_create(
+			r->arena, fn_name, fn_body, &fn_io_redirects);
+		fd->body_source = fn_body_source;
+		fd->body_pos = fn_body_pos;
+		read_range(r, &fd->name_range);
+		read_pos(r, &fd->lparen_pos);
+		read_pos(r, &fd->rparen_pos);
+		return &fd->command;
+	}
+	abort();
+}
+
+static struct mrsh_command *read_command(struct reader *r) {
+	if (!enter(r)) {
+		return NULL;
+	}
+	struct mrsh_command *cmd = _read_command(r);
+	leave(r);
+	return cmd;
+}
+
+static struct mrsh_program *read_program(struct reader *r) {
+	struct mrsh_program *prog = program_create(r->arena);
+	if (prog == NULL) {
+		r->error = true;
+		return NULL;
+	}
+	read_command_list_array(r, &prog->body);
+	return prog;
+}
+
+static struct mrsh_line_table *read_line_table(struct reader *r) {
+	uint32_t len = read_u32(r);
+	if (r->error || len > r->len / sizeof(uint32_t)) {
+		r->error = true;
+		return NULL;
+	}
+
+	struct mrsh_line_table *lines = line_table_create();
+	if (lines == NULL) {
+		r->error = true;
+		return NULL;
+	}
+	for (uint32_t i = 0; i < len; ++i) {
+		if (!line_table_add(lines, read_u32(r))) {
+			r->error = true;
+			break;
+		}
+	}
+	return lines;
+}
+
+struct mrsh_program *program_deserialize(const char *data, size_t len) {
+	struct mrsh_arena *arena = calloc(1, sizeof(struct mrsh_arena));
+	if (arena == NULL) {
+		return NULL;
+	}
+
+	struct reader r = { .data = data, .len = len, .arena = arena };
+	struct mrsh_line_table *lines = read_line_table(&r);
+	struct mrsh_program *prog = read_program(&r);
+
+	if (r.error || r.len != 0) {
+		line_table_unref(lines);
+		arena_finish(arena);
+		free(arena);
+		return NULL;
+	}
+
+	program_set_arena(prog, arena);
+	program_set_line_table(prog, lines);
+	line_table_unref(lines);
+	return prog;
+}
@@ -0,0 +1,107 @@
+/*
+ * Counts heap allocations made while parsing and executing simple commands.
+ * Each workload is repeated many times in a single program, and the number of
+ * allocations per command is reported for both, along with the parse cache
+ * hits of workloads using eval.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <mrsh/buffer.h>
+#include <mrsh/builtin.h>
+#include <mrsh/parser.h>
+#include <mrsh/shell.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc_count.h"
+
+#define ITERATIONS 1000
+
+struct workload {
+	const char *name;
+	const char *setup;
+	const char *command;
+};
+
+static const struct workload workloads[] = {
+	{ "literal", NULL, ": foo bar baz" },
+	{ "parameter", "a=1 b='x y' c=z", ": \"$a\" $b ${c}" },
+	{ "assignment", "a=1", "v=$a" },
+	{ "positional", "set -- a b c", ": \"$@\"" },
+	{ "function", "f() { :; }", "f a b" },
+	{ "arithmetic", "a=1", ": $((a + 1))" },
+	{ "eval", "a=1", "eval 'v=$a'" },
+};
+
+static struct mrsh_program *parse(const char *script) {
+	struct mrsh_parser *parser = mrsh_parser_with_data(script, strlen(script));
+	mrsh_parser_set_arena(parser, true);
+	struct mrsh_program *prog = mrsh_parse_program(parser);
+	const char *err_msg = mrsh_parser_error(parser, NULL);
+	if (err_msg != NULL) {
+		fprintf(stderr, "failed to parse '%s': %s\n", script, err_msg);
+		exit(1);
+	}
+	mrsh_parser_destroy(parser);
+	return prog;
+}
+
+static void run(struct mrsh_state *state, struct mrsh_program *prog) {
+	if (mrsh_run_program(state, prog) < 0) {
+		fprintf(stderr, "failed to run program\n");
+		exit(1);
+	}
+}
+
+int main(int argc, char *argv[]) {
+#ifndef __GLIBC__
+	fprintf(stderr, "allocation counting requires glibc\n");
+	return 77;
+#endif
+
+	size_t workloads_len = sizeof(workloads) / sizeof(workloads[0]);
+	for (size_t i = 0; i < workloads_len; ++i) {
+		const struct workload *wl = &workloads[i];
+
+		struct mrsh_state *state = mrsh_state_create();
+		struct mrsh_init_args init_args = {0};
+		if (mrsh_process_args(state, &init_args, 1, argv) != 0) {
+			return 1;
+		}
+		if (wl->setup != NULL) {
+			struct mrsh_program *prog = parse(wl->setup);
+			run(state, prog);
+			mrsh_program_destroy(prog);
+		}
+
+		struct mrsh_buffer buf = {0};
+		for (size_t j = 0; j < ITERATIONS; ++j) {
+			mrsh_buffer_append(&buf, wl->command, strlen(wl->command));
+			mrsh_buffer_append_char(&buf, '\n');
+		}
+		mrsh_buffer_append_char(&buf, '\0');
+		size_t before = alloc_count;
+		struct mrsh_program *prog = parse(buf.data);
+		size_t parse_allocs = alloc_count - before;
+		mrsh_buffer_finish(&buf);
+
+		before = alloc_count;
+		run(state, prog);
+		size_t allocs = alloc_count - before;
+
+		printf("%-12s %8.2f allocs/command %8.2f allocs/parsed command",
+			wl->name, (double)allocs / ITERATIONS,
+			(double)parse_allocs / ITERATIONS);
+		struct mrsh_parse_cache_stats stats;
+		mrsh_get_parse_cache_stats(state, &stats);
+		if (stats.hits + stats.misses > 0) {
+			printf(" (parse cache: %zu hits, %zu misses)",
+				stats.hits, stats.misses);
+		}
+		printf("\n");
+
+		mrsh_program_destroy(prog);
+		mrsh_state_destroy(state);
+	}
+
+	return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef BENCH_ALLOC_COUNT_H
+#define BENCH_ALLOC_COUNT_H
+
+#include <stddef.h>
+
+/**
+ * Number of heap allocations made by the program so far, including
+ * reallocations. Only counted with glibc, whose allocator can be wrapped:
+ * stays zero otherwise.
+ */
+extern size_t alloc_count;
+
+#endif
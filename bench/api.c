@@ -0,0 +1,344 @@
+/*
+ * Measures the library without running any process. A synthetic script is
+ * generated, then parsed, printed and destroyed repeatedly, and a set of words
+ * and arithmetic expressions are expanded repeatedly. The size of the script
+ * is the number of functions it defines, and its nesting the depth of the
+ * compound commands in each of them.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <mrsh/ast.h>
+#include <mrsh/builtin.h>
+#include <mrsh/parser.h>
+#include <mrsh/shell.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "alloc_count.h"
+
+#define DEFAULT_FUNCTIONS 200
+#define DEFAULT_DEPTH 4
+// The script is parsed until at least this many bytes have been processed
+#define PARSE_BYTES (16 * 1024 * 1024)
+#define PRINT_ITERATIONS 20
+#define EXPAND_ITERATIONS 200000
+
+static const char usage[] = "usage: %s [-n functions] [-d depth]\n";
+
+struct workload {
+	const char *name;
+	const char *source;
+};
+
+// Words are expanded without command substitutions, which would fork
+static const struct workload words[] = {
+	{ "literal", "literal" },
+	{ "parameter", "$name" },
+	{ "quoted", "\"$name in $path\"" },
+	{ "default", "${unset:-default}" },
+	{ "trim", "${path##*/}" },
+	{ "length", "${#path}" },
+	{ "arithmetic", "$((count * 2 + 1))" },
+	{ "tilde", "~/file" },
+};
+
+static const struct workload arithm_exprs[] = {
+	{ "constant", "1 + 2 * 3" },
+	{ "variable", "(count + 7) % 5 << 2" },
+	{ "bitwise", "(count & 7) | (count > 10) << 3" },
+};
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void indent(FILE *f, int level) {
+	for (int i = 0; i < level; ++i) {
+		fputc('\t', f);
+	}
+}
+
+/**
+ * Writes a compound command nested `depth` times, then simple commands using
+ * most kinds of words.
+ */
+static void generate_block(FILE *f, int fn, int level, int depth) {
+	if (level > depth) {
+		indent(f, level);
+		fprintf(f, "echo \"unit %d: ${name:-default}\" $((count * 2 + %d)) "
+			"'literal text' >/dev/null\n", fn, level);
+		indent(f, level);
+		fprintf(f, "value=${path##*/} other=\"$value-%d\"\n", fn);
+		indent(f, level);
+		fprintf(f, "printf '%%s\\n' \"$@\" | tr a-z A-Z && "
+			"result=$(basename \"$path\") || true\n");
+		return;
+	}
+
+	switch ((fn + level) % 5) {
+	case 0:
+		indent(f, level);
+		fprintf(f, "if [ \"$count\" -gt %d ]; then\n", level);
+		generate_block(f, fn, level + 1, depth);
+		indent(f, level);
+		fprintf(f, "else\n");
+		indent(f, level + 1);
+		fprintf(f, "count=$((count + 1))\n");
+		indent(f, level);
+		fprintf(f, "fi\n");
+		break;
+	case 1:
+		indent(f, level);
+		fprintf(f, "while [ \"$count\" -lt %d ]; do\n", level * 10);
+		generate_block(f, fn, level + 1, depth);
+		indent(f, level);
+		fprintf(f, "done\n");
+		break;
+	case 2:
+		indent(f, level);
+		fprintf(f, "for item in a b \"$name\" *.sh; do\n");
+		generate_block(f, fn, level + 1, depth);
+		indent(f, level);
+		fprintf(f, "done\n");
+		break;
+	case 3:
+		indent(f, level);
+		fprintf(f, "case \"$item\" in\n");
+		indent(f, level);
+		fprintf(f, "-%d|--option=*)\n", level);
+		generate_block(f, fn, level + 1, depth);
+		indent(f, level + 1);
+		fprintf(f, ";;\n");
+		indent(f, level);
+		fprintf(f, "*) ;;\n");
+		indent(f, level);
+		fprintf(f, "esac\n");
+		break;
+	default:
+		indent(f, level);
+		fprintf(f, "{\n");
+		generate_block(f, fn, level + 1, depth);
+		indent(f, level);
+		fprintf(f, "} 2>/dev/null\n");
+	}
+}
+
+static char *generate_script(int functions, int depth, size_t *len) {
+	char *script;
+	FILE *f = open_memstream(&script, len);
+	if (f == NULL) {
+		perror("open_memstream");
+		exit(1);
+	}
+	for (int i = 0; i < functions; ++i) {
+		fprintf(f, "# Function number %d\n", i);
+		fprintf(f, "func%d() {\n", i);
+		generate_block(f, i, 1, depth);
+		fprintf(f, "}\n\n");
+	}
+	fclose(f);
+	return script;
+}
+
+static struct mrsh_program *parse(const char *source, size_t len) {
+	struct mrsh_parser *parser = mrsh_parser_with_data(source, len);
+	// Programs are never modified, only destroyed as a whole
+	mrsh_parser_set_arena(parser, true);
+	struct mrsh_program *prog = mrsh_parse_program(parser);
+	struct mrsh_location err_loc;
+	const char *err_msg = mrsh_parser_error(parser, &err_loc);
+	if (err_msg != NULL) {
+		fprintf(stderr, "%d:%d: syntax error: %s\n",
+			err_loc.line, err_loc.column, err_msg);
+		exit(1);
+	}
+	mrsh_parser_destroy(parser);
+	return prog;
+}
+
+static void count_node(struct mrsh_node *node, void *data) {
+	size_t *nodes = data;
+	++*nodes;
+}
+
+static void bench_script(int functions, int depth) {
+	size_t len;
+	char *script = generate_script(functions, depth, &len);
+
+	struct mrsh_program *prog = parse(script, len);
+	size_t nodes = 0;
+	mrsh_node_for_each(&prog->node, count_node, &nodes);
+	mrsh_program_destroy(prog);
+	printf("script: %d functions, depth %d, %zu bytes, %zu nodes\n",
+		functions, depth, len, nodes);
+
+	size_t iterations = PARSE_BYTES / len + 1;
+	double parse_time = 0, destroy_time = 0;
+	size_t allocs = 0;
+	for (size_t i = 0; i < iterations; ++i) {
+		size_t before = alloc_count;
+		double start = now();
+		prog = parse(script, len);
+		double parsed = now();
+		allocs += alloc_count - before;
+		mrsh_program_destroy(prog);
+		parse_time += parsed - start;
+		destroy_time += now() - parsed;
+	}
+	double total_nodes = (double)iterations * nodes;
+	printf("%-24s %10.2f MB/s %10.2f Mnodes/s", "parse",
+		iterations * len / parse_time / 1e6, total_nodes / parse_time / 1e6);
+#ifdef __GLIBC__
+	printf(" %8.2f allocs/node", allocs / total_nodes);
+#endif
+	printf("\n");
+	printf("%-24s %10.2f ns/node\n", "destroy",
+		destroy_time / total_nodes * 1e9);
+
+	// mrsh_program_print writes to the standard output
+	prog = parse(script, len);
+	fflush(stdout);
+	int stdout_fd = dup(STDOUT_FILENO);
+	int null_fd = open("/dev/null", O_WRONLY);
+	if (stdout_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+		perror("failed to redirect the standard output");
+		exit(1);
+	}
+	close(null_fd);
+	double start = now();
+	for (size_t i = 0; i < PRINT_ITERATIONS; ++i) {
+		mrsh_program_print(prog);
+	}
+	fflush(stdout);
+	double print_time = now() - start;
+	dup2(stdout_fd, STDOUT_FILENO);
+	close(stdout_fd);
+	mrsh_program_destroy(prog);
+	printf("%-24s %10.2f ns/node\n", "print",
+		print_time / ((double)PRINT_ITERATIONS * nodes) * 1e9);
+
+	free(script);
+}
+
+static struct mrsh_word *parse_word(const char *source,
+		struct mrsh_program **prog) {
+	size_t len = strlen(source) + 2;
+	char *command = malloc(len + 1);
+	snprintf(command, len + 1, ": %s", source);
+	*prog = parse(command, len);
+	free(command);
+
+	struct mrsh_command_list *list = (*prog)->body.data[0];
+	struct mrsh_pipeline *pl =
+		mrsh_and_or_list_get_pipeline(list->and_or_list);
+	struct mrsh_simple_command *sc =
+		mrsh_command_get_simple_command(pl->commands.data[0]);
+	return sc->arguments.data[0];
+}
+
+static void bench_words(struct mrsh_state *state) {
+	size_t words_len = sizeof(words) / sizeof(words[0]);
+	for (size_t i = 0; i < words_len; ++i) {
+		struct mrsh_program *prog;
+		struct mrsh_word *word = parse_word(words[i].source, &prog);
+
+		// Expansion replaces the word, it's expanded from a copy each time
+		size_t before = alloc_count;
+		double start = now();
+		for (size_t j = 0; j < EXPAND_ITERATIONS; ++j) {
+			struct mrsh_word *copy = mrsh_word_copy(word);
+			if (mrsh_run_word(state, &copy) < 0) {
+				fprintf(stderr, "failed to expand %s\n", words[i].source);
+				exit(1);
+			}
+			mrsh_word_destroy(copy);
+		}
+		double elapsed = now() - start;
+		size_t allocs = alloc_count - before;
+
+		char name[64];
+		snprintf(name, sizeof(name), "expand %s", words[i].name);
+		printf("%-24s %10.2f ns/op", name, elapsed / EXPAND_ITERATIONS * 1e9);
+#ifdef __GLIBC__
+		printf(" %8.2f allocs/op", (double)allocs / EXPAND_ITERATIONS);
+#endif
+		printf("\n");
+		mrsh_program_destroy(prog);
+	}
+}
+
+static void bench_arithm(struct mrsh_state *state) {
+	size_t exprs_len = sizeof(arithm_exprs) / sizeof(arithm_exprs[0]);
+	for (size_t i = 0; i < exprs_len; ++i) {
+		const char *source = arithm_exprs[i].source;
+		struct mrsh_parser *parser =
+			mrsh_parser_with_data(source, strlen(source));
+		struct mrsh_arithm_expr *expr = mrsh_parse_arithm_expr(parser);
+		if (expr == NULL) {
+			fprintf(stderr, "failed to parse %s\n", source);
+			exit(1);
+		}
+		mrsh_parser_destroy(parser);
+
+		double start = now();
+		for (size_t j = 0; j < EXPAND_ITERATIONS; ++j) {
+			long result;
+			if (!mrsh_run_arithm_expr(state, expr, &result)) {
+				fprintf(stderr, "failed to evaluate %s\n", source);
+				exit(1);
+			}
+		}
+		double elapsed = now() - start;
+
+		char name[64];
+		snprintf(name, sizeof(name), "arithm %s", arithm_exprs[i].name);
+		printf("%-24s %10.2f ns/op\n", name,
+			elapsed / EXPAND_ITERATIONS * 1e9);
+		mrsh_arithm_expr_destroy(expr);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	int functions = DEFAULT_FUNCTIONS, depth = DEFAULT_DEPTH;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:d:")) != -1) {
+		switch (opt) {
+		case 'n':
+			functions = atoi(optarg);
+			break;
+		case 'd':
+			depth = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, usage, argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc || functions <= 0 || depth < 0) {
+		fprintf(stderr, usage, argv[0]);
+		return 1;
+	}
+
+	bench_script(functions, depth);
+
+	struct mrsh_state *state = mrsh_state_create();
+	struct mrsh_init_args init_args = {0};
+	if (mrsh_process_args(state, &init_args, 1, argv) != 0) {
+		return 1;
+	}
+	mrsh_env_set(state, "name", "value", MRSH_VAR_ATTRIB_NONE);
+	mrsh_env_set(state, "path", "/usr/local/share/doc/README",
+		MRSH_VAR_ATTRIB_NONE);
+	mrsh_env_set(state, "count", "42", MRSH_VAR_ATTRIB_NONE);
+	mrsh_env_set(state, "HOME", "/home/user", MRSH_VAR_ATTRIB_NONE);
+
+	bench_words(state);
+	bench_arithm(state);
+
+	mrsh_state_destroy(state);
+	return 0;
+}
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Walks argument lists with shift, as option parsing loops do
+args=""
+i=0
+while [ $i -lt 50 ]; do
+	args="$args -v file$i"
+	i=$((i + 1))
+done
+
+count_options() {
+	n=0
+	while [ $# -gt 0 ]; do
+		case "$1" in
+		-*) n=$((n + 1)) ;;
+		esac
+		shift
+	done
+	echo "$n"
+}
+
+i=0
+total=0
+while [ $i -lt 400 ]; do
+	n=$(count_options $args)
+	total=$((total + n))
+	i=$((i + 1))
+done
+echo "$total"
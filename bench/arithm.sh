@@ -0,0 +1,11 @@
+#!/bin/sh
+# Counts with arithmetic expansions
+i=0
+a=0
+b=1
+while [ $i -lt 50000 ]; do
+	a=$(( (a + b * 3) % 1000 ))
+	b=$(( b ^ (i & 7) ))
+	i=$((i + 1))
+done
+echo "$a $b"
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Dispatches on strings with case, as command line tools do
+dispatch() {
+	case "$1" in
+	start|run) echo 1 ;;
+	stop|halt) echo 2 ;;
+	*.tar.gz|*.tgz) echo 3 ;;
+	[0-9]*) echo 4 ;;
+	--*=*) echo 5 ;;
+	-[a-z]) echo 6 ;;
+	*) echo 0 ;;
+	esac
+}
+
+i=0
+sum=0
+while [ $i -lt 3000 ]; do
+	for word in start halt archive.tgz 42 --name=value -x other; do
+		case "$word" in
+		start|run) sum=$((sum + 1)) ;;
+		stop|halt) sum=$((sum + 2)) ;;
+		*.tar.gz|*.tgz) sum=$((sum + 3)) ;;
+		[0-9]*) sum=$((sum + 4)) ;;
+		--*=*) sum=$((sum + 5)) ;;
+		-[a-z]) sum=$((sum + 6)) ;;
+		*) sum=$((sum + 7)) ;;
+		esac
+	done
+	i=$((i + 1))
+done
+echo "$sum"
+dispatch "--name=value"
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Expands patterns in a large directory
+dir=$(mktemp -d)
+awk -v dir="$dir" 'BEGIN {
+	for (i = 0; i < 2000; i++) {
+		printf "" >(dir "/file" i ".txt")
+		close(dir "/file" i ".txt")
+	}
+}'
+touch "$dir/other.log"
+
+i=0
+n=0
+while [ $i -lt 50 ]; do
+	for f in "$dir"/*.txt "$dir"/file1*; do
+		n=$((n + 1))
+	done
+	i=$((i + 1))
+done
+echo "$n"
+rm -rf "$dir"
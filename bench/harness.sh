@@ -0,0 +1,54 @@
+#!/bin/sh
+# Runs a workload with mrsh and with a reference shell, and prints the CPU time
+# used by each of them and their children, in seconds, on a single line:
+#
+#     <workload> <mrsh time> <reference time> <ratio>
+#
+# Outputs are compared before reporting times, so that a shell running the
+# workload wrongly isn't reported as fast.
+workload="$1"
+name=$(basename "$workload" .sh)
+
+mrsh_out=$(mktemp)
+ref_out=$(mktemp)
+trap 'rm -f "$mrsh_out" "$ref_out"' EXIT
+
+# Runs the workload with a shell, and prints the user and system time of the
+# subshell's children as reported by times, e.g. "0m1.50s 0m0.25s"
+run() {
+	(
+		"$1" "$workload" >"$2"
+		times
+	) | tail -n 1
+}
+
+# Converts the output of times to seconds
+seconds() {
+	echo "$1" | awk '{
+		total = 0
+		for (i = 1; i <= NF; i++) {
+			split($i, t, "m")
+			sub("s", "", t[2])
+			total += t[1] * 60 + t[2]
+		}
+		printf "%.3f\n", total
+	}'
+}
+
+mrsh_time=$(seconds "$(run "$MRSH" "$mrsh_out")")
+ref_time=$(seconds "$(run "$REF_SH" "$ref_out")")
+
+if ! cmp -s "$mrsh_out" "$ref_out"; then
+	echo >&2 "$workload: mismatch"
+	echo >&2 ""
+	echo >&2 "mrsh:"
+	cat >&2 "$mrsh_out"
+	echo >&2 ""
+	echo >&2 "ref ($REF_SH):"
+	cat >&2 "$ref_out"
+	exit 1
+fi
+
+ratio=$(echo "$mrsh_time $ref_time" |
+	awk '{ printf "%.2f\n", ($2 > 0 ? $1 / $2 : 0) }')
+echo "$name $mrsh_time $ref_time $ratio"
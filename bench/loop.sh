@@ -0,0 +1,9 @@
+#!/bin/sh
+# Measures the cost of loop iterations whose condition is a test command. The
+# CPU time used by the shell and by its children is reported at the end.
+
+i=0
+while [ "$i" -lt 10000 ]; do
+	i=$((i + 1))
+done
+times
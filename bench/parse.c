@@ -0,0 +1,105 @@
+/*
+ * Measures parser throughput. Each script given on the command line is read
+ * into memory and parsed repeatedly, then the number of megabytes parsed per
+ * second is reported for each of them and for the whole corpus.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <mrsh/buffer.h>
+#include <mrsh/parser.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Each script is parsed until at least this many bytes have been processed
+#define BYTES_PER_SCRIPT (4 * 1024 * 1024)
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool read_file(const char *path, struct mrsh_buffer *buf) {
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "failed to open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	while (true) {
+		char *dst = mrsh_buffer_reserve(buf, 4096);
+		size_t n = fread(dst, 1, 4096, f);
+		buf->len += n;
+		if (n < 4096) {
+			break;
+		}
+	}
+
+	bool ok = !ferror(f);
+	if (!ok) {
+		fprintf(stderr, "failed to read %s\n", path);
+	}
+	fclose(f);
+	return ok;
+}
+
+static bool parse(const char *path, const char *data, size_t len) {
+	struct mrsh_parser *parser = mrsh_parser_with_data(data, len);
+	mrsh_parser_set_arena(parser, true);
+	struct mrsh_program *prog = mrsh_parse_program(parser);
+	struct mrsh_location err_loc;
+	const char *err_msg = mrsh_parser_error(parser, &err_loc);
+	if (err_msg != NULL) {
+		fprintf(stderr, "%s:%d:%d: syntax error: %s\n",
+			path, err_loc.line, err_loc.column, err_msg);
+	}
+	mrsh_program_destroy(prog);
+	mrsh_parser_destroy(parser);
+	return err_msg == NULL;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <script>...\n", argv[0]);
+		return 1;
+	}
+
+	size_t total_bytes = 0;
+	double total_time = 0;
+	for (int i = 1; i < argc; ++i) {
+		const char *path = argv[i];
+
+		struct mrsh_buffer buf = {0};
+		if (!read_file(path, &buf)) {
+			mrsh_buffer_finish(&buf);
+			return 1;
+		}
+		if (buf.len == 0 || !parse(path, buf.data, buf.len)) {
+			// Skip empty scripts and ones we can't parse
+			mrsh_buffer_finish(&buf);
+			continue;
+		}
+
+		size_t iterations = BYTES_PER_SCRIPT / buf.len + 1;
+		double start = now();
+		for (size_t j = 0; j < iterations; ++j) {
+			parse(path, buf.data, buf.len);
+		}
+		double elapsed = now() - start;
+
+		size_t bytes = iterations * buf.len;
+		printf("%-40s %8zu bytes %8.2f MB/s\n", path, buf.len,
+			bytes / elapsed / 1e6);
+		total_bytes += bytes;
+		total_time += elapsed;
+		mrsh_buffer_finish(&buf);
+	}
+
+	if (total_time > 0) {
+		printf("%-40s %14s %8.2f MB/s\n", "total", "",
+			total_bytes / total_time / 1e6);
+	}
+	return 0;
+}
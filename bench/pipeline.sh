@@ -0,0 +1,8 @@
+#!/bin/sh
+# Runs short pipelines of builtins and utilities
+i=0
+while [ $i -lt 300 ]; do
+	echo "$i" | cat | cat >/dev/null
+	i=$((i + 1))
+done
+echo "$i"
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Reads a large file line by line
+file=$(mktemp)
+awk 'BEGIN { for (i = 0; i < 20000; i++) print "line " i " of the file" }' \
+	>"$file"
+
+lines=0
+words=0
+cat "$file" | {
+	while read -r first second rest; do
+		lines=$((lines + 1))
+		words=$((words + 2))
+	done
+	echo "$lines $words"
+}
+rm -f "$file"
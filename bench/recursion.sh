@@ -0,0 +1,28 @@
+#!/bin/sh
+# Calls functions recursively
+depth() {
+	if [ "$1" -gt 0 ]; then
+		depth $(($1 - 1))
+	else
+		calls=$((calls + 1))
+	fi
+}
+
+fib() {
+	if [ "$1" -lt 2 ]; then
+		result=$((result + $1))
+	else
+		fib $(($1 - 1))
+		fib $(($1 - 2))
+	fi
+}
+
+calls=0
+i=0
+while [ $i -lt 20 ]; do
+	depth 500
+	i=$((i + 1))
+done
+result=0
+fib 16
+echo "$calls $result"
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Sources a large library of functions
+lib=$(mktemp)
+awk 'BEGIN {
+	for (i = 0; i < 500; i++) {
+		print "# Function number " i
+		print "lib_func" i "() {"
+		print "\tif [ \"$1\" = \"--help\" ]; then"
+		print "\t\techo \"usage: lib_func" i " [arg...]\""
+		print "\t\treturn 0"
+		print "\tfi"
+		print "\tfor arg in \"$@\"; do"
+		print "\t\tcase \"$arg\" in"
+		print "\t\t-*) echo \"option $arg\" ;;"
+		print "\t\t*) echo \"argument $arg\" ;;"
+		print "\t\tesac"
+		print "\tdone"
+		print "}"
+	}
+}' >"$lib"
+
+i=0
+while [ $i -lt 30 ]; do
+	. "$lib"
+	i=$((i + 1))
+done
+lib_func499 --help
+rm -f "$lib"
@@ -0,0 +1,15 @@
+#!/bin/sh
+# Runs a command substitution at each iteration of a loop
+f() {
+	echo "$1"
+}
+
+i=0
+sum=0
+while [ $i -lt 2000 ]; do
+	n=$(f $i)
+	m=$(echo "$n")
+	sum=$((sum + m))
+	i=$((i + 1))
+done
+echo "$sum"
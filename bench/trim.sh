@@ -0,0 +1,14 @@
+#!/bin/sh
+# Trims paths with pattern removal expansions, as basename and dirname do
+i=0
+len=0
+while [ $i -lt 10000 ]; do
+	path="/usr/local/share/doc/package-$i/README.tar.gz"
+	base=${path##*/}
+	dir=${path%/*}
+	name=${base%%.*}
+	ext=${base#*.}
+	len=$((len + ${#base} + ${#dir} + ${#name} + ${#ext}))
+	i=$((i + 1))
+done
+echo "$len"
@@ -6,6 +6,7 @@
 #include "builtin.h"
 #include "mrsh_getopt.h"
 #include "shell/shell.h"
+#include "shell/snapshot.h"
 
 static const char alias_usage[] = "usage: alias [alias-name[=string]...]\n";
 
@@ -40,7 +41,9 @@ int builtin_alias(struct mrsh_state *state, int argc, char *argv[]) {
 			*equal = '\0';
 
 			char *old_value = mrsh_hashtable_set(&priv->aliases, alias, value);
-			free(old_value);
+			if (!snapshot_keep(state, &priv->aliases, alias, old_value)) {
+				free(old_value);
+			}
 		} else {
 			const char *value = mrsh_hashtable_get(&priv->aliases, alias);
 			if (value == NULL) {
@@ -1,33 +1,33 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <mrsh/builtin.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
 #include "builtin.h"
 #include "shell/shell.h"
 
-struct builtin {
-	const char *name;
-	mrsh_builtin_func func;
-	bool special;
-};
-
 static const struct builtin builtins[] = {
 	// Keep alpha sorted
 	{ ".", builtin_dot, true },
-	{ ":", builtin_colon, true },
+	{ ":", builtin_colon, true, true },
+	{ "[", builtin_test, false, true },
 	{ "alias", builtin_alias, false },
 	{ "bg", builtin_bg, false },
 	{ "break", builtin_break, true },
 	{ "cd", builtin_cd, false },
 	{ "command", builtin_command, false },
 	{ "continue", builtin_break, true },
+	{ "echo", builtin_echo, false, true },
 	{ "eval", builtin_eval, true },
 	{ "exec", builtin_exec, true },
 	{ "exit", builtin_exit, true },
 	{ "export", builtin_export, true },
-	{ "false", builtin_false, false },
+	{ "false", builtin_false, false, true },
 //	{ "fc", builtin_fc, false },
 	{ "fg", builtin_fg, false },
 	{ "getopts", builtin_getopts, false },
@@ -35,15 +35,18 @@ static const struct builtin builtins[] = {
 	{ "jobs", builtin_jobs, false },
 //	{ "kill", builtin_kill, false },
 //	{ "newgrp", builtin_newgrp, false },
+	{ "printf", builtin_printf, false, true },
 	{ "pwd", builtin_pwd, false },
-	{ "read", builtin_read, false },
+	{ "read", builtin_read, false, true },
 	{ "readonly", builtin_export, true },
 	{ "return", builtin_return, true },
 	{ "set", builtin_set, true },
 	{ "shift", builtin_shift, true },
+	{ "stats", builtin_stats, false, true },
+	{ "test", builtin_test, false, true },
 	{ "times", builtin_times, true },
 	{ "trap", builtin_trap, true },
-	{ "true", builtin_true, false },
+	{ "true", builtin_true, false, true },
 	{ "type", builtin_type, false },
 	{ "ulimit", builtin_ulimit, false },
 	{ "umask", builtin_umask, false },
@@ -80,7 +83,7 @@ static int unspecified_compare(const void *_a, const void *_b) {
 	return strcmp(a, *b);
 }
 
-static const struct builtin *get_builtin(const char *name) {
+const struct builtin *get_builtin(const char *name) {
 	if (bsearch(name, unspecified_names,
 			sizeof(unspecified_names) / sizeof(unspecified_names[0]),
 			sizeof(unspecified_names[0]), unspecified_compare)) {
@@ -100,6 +103,82 @@ bool mrsh_has_special_builtin(const char *name) {
 	return builtin != NULL && builtin->special;
 }
 
+int builtin_fd(struct mrsh_state *state, int fd) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	if (fd >= 0 && fd < BUILTIN_FDS && priv->builtin_fds[fd].bound) {
+		return priv->builtin_fds[fd].fd;
+	}
+	return fd;
+}
+
+FILE *builtin_stream(struct mrsh_state *state, int fd) {
+	assert(fd == STDOUT_FILENO || fd == STDERR_FILENO);
+	FILE *std = fd == STDOUT_FILENO ? stdout : stderr;
+
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	struct builtin_fd *bfd = &priv->builtin_fds[fd];
+	if (!bfd->bound || bfd->fd == fd) {
+		return std;
+	}
+
+	if (bfd->stream == NULL) {
+		// The real file descriptor may be the shell's standard output
+		fflush(stdout);
+		// Closing the stream mustn't close the real file descriptor, which
+		// may be bound to other file descriptors or belong to the shell
+		int stream_fd = fcntl(bfd->fd, F_DUPFD_CLOEXEC, 0);
+		if (stream_fd < 0) {
+			return std;
+		}
+		bfd->stream = fdopen(stream_fd, "w");
+		if (bfd->stream == NULL) {
+			close(stream_fd);
+			// Better late than never
+			return std;
+		}
+	}
+	return bfd->stream;
+}
+
+void builtin_bind_fd(struct mrsh_state *state, int fd, int real_fd) {
+	assert(fd >= 0 && fd < BUILTIN_FDS);
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	struct builtin_fd *bfd = &priv->builtin_fds[fd];
+	bfd->bound = true;
+	bfd->fd = real_fd;
+}
+
+static bool close_stream(FILE *stream, FILE *err) {
+	bool ok = !ferror(stream);
+	if (fclose(stream) != 0) {
+		ok = false;
+	}
+	if (!ok) {
+		fprintf(err, "failed to write output: %s\n", strerror(errno));
+	}
+	return ok;
+}
+
+bool builtin_unbind_fds(struct mrsh_state *state) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	bool ok = true;
+	// Errors are reported to the builtin's standard error, which is closed
+	// last
+	for (size_t i = 0; i < BUILTIN_FDS; ++i) {
+		struct builtin_fd *bfd = &priv->builtin_fds[i];
+		if (i != STDERR_FILENO && bfd->stream != NULL) {
+			FILE *err = builtin_stream(state, STDERR_FILENO);
+			ok = close_stream(bfd->stream, err) && ok;
+		}
+	}
+	struct builtin_fd *err_bfd = &priv->builtin_fds[STDERR_FILENO];
+	if (err_bfd->stream != NULL) {
+		ok = close_stream(err_bfd->stream, stderr) && ok;
+	}
+	memset(priv->builtin_fds, 0, sizeof(priv->builtin_fds));
+	return ok;
+}
+
 int mrsh_run_builtin(struct mrsh_state *state, int argc, char *argv[]) {
 	assert(argc > 0);
 
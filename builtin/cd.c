@@ -9,6 +9,7 @@
 #include "builtin.h"
 #include "mrsh_getopt.h"
 #include "shell/path.h"
+#include "shell/shell.h"
 
 static const char cd_usage[] = "usage: cd [-L|-P] [-|directory]\n";
 
@@ -19,6 +20,7 @@ static int cd(struct mrsh_state *state, const char *path) {
 		fprintf(stderr, "cd: %s\n", strerror(errno));
 		return 1;
 	}
+	forget_relative_utilities(state);
 	char *cwd = current_working_dir();
 	if (cwd == NULL) {
 		perror("current_working_dir failed");
@@ -81,6 +83,7 @@ int builtin_cd(struct mrsh_state *state, int argc, char *argv[]) {
 			fprintf(stderr, "cd: %s\n", strerror(errno));
 			return 1;
 		}
+		forget_relative_utilities(state);
 		char *_pwd = strdup(pwd);
 		puts(oldpwd);
 		mrsh_env_set(state, "PWD", oldpwd, MRSH_VAR_ATTRIB_EXPORT);
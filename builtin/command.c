@@ -10,6 +10,7 @@
 #include "shell/path.h"
 #include "shell/process.h"
 #include "shell/shell.h"
+#include "shell/trace.h"
 
 static const char command_usage[] = "usage: command [-v|-V|-p] "
 	"command_name [argument...]\n";
@@ -39,12 +40,9 @@ static int verify_command(struct mrsh_state *state, const char *command_name,
 		return 0;
 	}
 
-	for (size_t i = 0; i < keywords_len; ++i) {
-		if (strlen(keywords[i]) == len_command_name &&
-				strcmp(command_name, keywords[i]) == 0) {
-			printf("%s\n", command_name);
-			return 0;
-		}
+	if (is_keyword(command_name, len_command_name)) {
+		printf("%s\n", command_name);
+		return 0;
 	}
 
 	char *expanded = expand_path(state, command_name, true, default_path);
@@ -70,11 +68,12 @@ static int run_command(struct mrsh_state *state, int argc, char *argv[],
 	}
 
 	// TODO: job control support
-	pid_t pid = fork();
+	pid_t pid = fork_process(state);
 	if (pid < 0) {
 		perror("fork");
 		return 126;
 	} else if (pid == 0) {
+		trace_exec(state, path, argv);
 		execv(path, argv);
 
 		// Something went wrong
@@ -84,6 +83,8 @@ static int run_command(struct mrsh_state *state, int argc, char *argv[],
 
 	free(path);
 
+	++state_get_priv(state)->stats.execs;
+	trace_fork(state, pid, NULL);
 	struct mrsh_process *proc = process_create(state, pid);
 	return job_wait_process(proc);
 }
@@ -3,6 +3,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <mrsh/builtin.h>
+#include <mrsh/entry.h>
 #include <mrsh/parser.h>
 #include <mrsh/shell.h>
 #include <stdlib.h>
@@ -10,9 +11,74 @@
 #include <unistd.h>
 #include "builtin.h"
 #include "shell/path.h"
+#include "shell/shell.h"
 
 static const char source_usage[] = "usage: . <path>\n";
 
+/**
+ * Parses and runs one line at a time, so that memory usage doesn't grow with
+ * the size of the file.
+ */
+static int run_stream(struct mrsh_state *state, int fd, const char *name) {
+	struct mrsh_parser *parser = mrsh_parser_with_fd(fd);
+	mrsh_parser_set_arena(parser, true);
+
+	int ret = 0;
+	while (state->exit == -1) {
+		mrsh_parser_set_lazy_function_bodies(parser,
+			(state->options & MRSH_OPT_LAZYFUNCS) != 0);
+		struct mrsh_program *program = mrsh_parse_line(parser);
+		if (program == NULL) {
+			struct mrsh_location err_loc;
+			const char *err_msg = mrsh_parser_error(parser, &err_loc);
+			if (err_msg != NULL) {
+				fprintf(stderr, "%s %d:%d: %s\n",
+					name, err_loc.line, err_loc.column, err_msg);
+				ret = 1;
+			}
+			break;
+		}
+
+		if (program->body.len > 0) {
+			ret = mrsh_run_program(state, program);
+		}
+		mrsh_program_destroy(program);
+		if (ret < 0) {
+			break;
+		}
+	}
+
+	mrsh_parser_destroy(parser);
+	return ret;
+}
+
+/**
+ * Loads a whole file from the cache of compiled scripts, or parses it. Returns
+ * NULL with the file rewound if it contains a syntax error, so that the
+ * commands before the error still run when streaming it.
+ */
+static struct mrsh_program *load_program(struct mrsh_state *state, int fd) {
+	struct mrsh_program *program = mrsh_script_cache_load(state, fd);
+	if (program != NULL) {
+		return program;
+	}
+
+	struct mrsh_parser *parser = mrsh_parser_with_fd(fd);
+	mrsh_parser_set_arena(parser, true);
+	mrsh_parser_set_lazy_function_bodies(parser,
+		(state->options & MRSH_OPT_LAZYFUNCS) != 0);
+	program = mrsh_parse_program(parser);
+	if (program != NULL && mrsh_parser_error(parser, NULL) == NULL) {
+		mrsh_script_cache_store(state, fd, program);
+	} else {
+		mrsh_program_destroy(program);
+		program = NULL;
+		lseek(fd, 0, SEEK_SET);
+	}
+	mrsh_parser_destroy(parser);
+	return program;
+}
+
 int builtin_dot(struct mrsh_state *state, int argc, char *argv[]) {
 	if (argc != 2) {
 		fprintf(stderr, source_usage);
@@ -36,24 +102,39 @@ int builtin_dot(struct mrsh_state *state, int argc, char *argv[]) {
 	}
 	free(path);
 
-	struct mrsh_parser *parser = mrsh_parser_with_fd(fd);
-	struct mrsh_program *program = mrsh_parse_program(parser);
+	// Small files are parsed at once, so that they can be cached. Larger ones
+	// are streamed.
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	bool lazy = (state->options & MRSH_OPT_LAZYFUNCS) != 0;
+	char *key = parse_cache_file_key(fd);
+	struct mrsh_parse_cache_entry *entry = NULL;
+	struct mrsh_program *program = NULL;
+	if (key != NULL) {
+		entry = parse_cache_get(&priv->parse_cache, key, lazy);
+		if (entry == NULL) {
+			program = load_program(state, fd);
+		}
+		if (program != NULL) {
+			entry = parse_cache_add(&priv->parse_cache, key, program,
+				lazy);
+			if (entry != NULL) {
+				program = NULL;
+			}
+		}
+		free(key);
+	}
 
 	int ret;
-	struct mrsh_position err_pos;
-	const char *err_msg = mrsh_parser_error(parser, &err_pos);
-	if (err_msg != NULL) {
-		fprintf(stderr, "%s %d:%d: %s\n",
-			argv[1], err_pos.line, err_pos.column, err_msg);
-		ret = 1;
+	if (entry != NULL) {
+		ret = mrsh_run_program(state, entry->program);
+		parse_cache_entry_unref(entry);
 	} else if (program != NULL) {
 		ret = mrsh_run_program(state, program);
+		mrsh_program_destroy(program);
 	} else {
-		ret = 0;
+		ret = run_stream(state, fd, argv[1]);
 	}
 
-	mrsh_program_destroy(program);
-	mrsh_parser_destroy(parser);
 	close(fd);
 	return ret;
 
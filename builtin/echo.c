@@ -0,0 +1,31 @@
+#include <mrsh/shell.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "builtin.h"
+
+int builtin_echo(struct mrsh_state *state, int argc, char *argv[]) {
+	FILE *out = builtin_stream(state, STDOUT_FILENO);
+
+	// XSI echo doesn't take options, but -n is widespread
+	int i = 1;
+	bool newline = true;
+	if (argc > 1 && strcmp(argv[1], "-n") == 0) {
+		newline = false;
+		++i;
+	}
+
+	for (; i < argc; ++i) {
+		if (!print_escape_sequences(out, argv[i])) {
+			return 0;
+		}
+		if (i + 1 < argc) {
+			fputc(' ', out);
+		}
+	}
+	if (newline) {
+		fputc('\n', out);
+	}
+
+	return 0;
+}
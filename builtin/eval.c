@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "builtin.h"
+#include "shell/shell.h"
 
 static const char eval_usage[] = "usage: eval [cmds...]\n";
 
@@ -27,19 +28,46 @@ int builtin_eval(struct mrsh_state *state, int argc, char *argv[]) {
 		}
 	}
 	mrsh_buffer_append_char(&buf, '\n');
+	mrsh_buffer_append_char(&buf, '\0');
 
-	struct mrsh_parser *parser = mrsh_parser_with_data(buf.data, buf.len);
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	bool lazy = (state->options & MRSH_OPT_LAZYFUNCS) != 0;
+	bool cacheable = buf.len - 1 <= PARSE_CACHE_MAX_SOURCE_SIZE;
+	struct mrsh_parse_cache_entry *entry = NULL;
+	if (cacheable) {
+		entry = parse_cache_get(&priv->parse_cache, buf.data, lazy);
+	}
+	if (entry != NULL) {
+		int ret = mrsh_run_program(state, entry->program);
+		parse_cache_entry_unref(entry);
+		mrsh_buffer_finish(&buf);
+		return ret;
+	}
+
+	struct mrsh_parser *parser = mrsh_parser_with_data(buf.data, buf.len - 1);
+	mrsh_parser_set_arena(parser, true);
+	mrsh_parser_set_lazy_function_bodies(parser, lazy);
 	struct mrsh_program *program = mrsh_parse_program(parser);
 
 	int ret;
-	struct mrsh_position err_pos;
-	const char *err_msg = mrsh_parser_error(parser, &err_pos);
+	struct mrsh_location err_loc;
+	const char *err_msg = mrsh_parser_error(parser, &err_loc);
 	if (err_msg != NULL) {
 		fprintf(stderr, "%s %d:%d: %s\n",
-			argv[1], err_pos.line, err_pos.column, err_msg);
+			argv[1], err_loc.line, err_loc.column, err_msg);
 		ret = 1;
 	} else if (program != NULL) {
-		ret = mrsh_run_program(state, program);
+		if (cacheable) {
+			entry = parse_cache_add(&priv->parse_cache, buf.data, program,
+				lazy);
+		}
+		if (entry != NULL) {
+			program = NULL;
+			ret = mrsh_run_program(state, entry->program);
+			parse_cache_entry_unref(entry);
+		} else {
+			ret = mrsh_run_program(state, program);
+		}
 	} else {
 		ret = 0;
 	}
@@ -3,6 +3,7 @@
 #include "builtin.h"
 #include "mrsh_getopt.h"
 #include "shell/path.h"
+#include "shell/trace.h"
 
 static const char exec_usage[] = "usage: exec [command [argument...]]\n";
 
@@ -27,6 +28,8 @@ int builtin_exec(struct mrsh_state *state, int argc, char *argv[]) {
 		return 126;
 	}
 
+	fflush(stdout);
+	trace_exec(state, path, &argv[_mrsh_optind]);
 	execv(path, &argv[_mrsh_optind]);
 	perror("exec");
 	return 1;
@@ -56,7 +56,7 @@ int builtin_export(struct mrsh_state *state, int argc, char *argv[]) {
 		struct mrsh_word_string *ws =
 			mrsh_word_string_create(strdup(val), false);
 		struct mrsh_word *word = &ws->word;
-		expand_tilde(state, &word, true);
+		expand_tilde(state, NULL, &word, true);
 		char *new_val = mrsh_word_str(word);
 		mrsh_word_destroy(word);
 		mrsh_env_set(state, key, new_val, attrib | prev_attribs);
@@ -8,6 +8,7 @@
 #include <string.h>
 #include "builtin.h"
 #include "mrsh_getopt.h"
+#include "shell/shell.h"
 
 static const char getopts_usage[] = "usage: getopts optstring name [arg...]\n";
 
@@ -23,14 +24,21 @@ int builtin_getopts(struct mrsh_state *state, int argc, char *argv[]) {
 		return 1;
 	}
 
+	bool frame_args = _mrsh_optind + 2 == argc;
 	int optc;
 	char **optv;
-	if (_mrsh_optind + 2 > argc) {
+	if (!frame_args) {
 		optc = argc - _mrsh_optind - 2;
 		optv = &argv[_mrsh_optind + 2];
 	} else {
-		optc = state->frame->argc;
-		optv = state->frame->argv;
+		optc = mrsh_call_frame_nargs(state->frame) + 1;
+		optv = calloc(optc + 1, sizeof(char *));
+		if (optv == NULL) {
+			return 1;
+		}
+		for (int i = 0; i < optc; ++i) {
+			optv[i] = (char *)mrsh_call_frame_get_arg(state->frame, i);
+		}
 	}
 	char *optstring = argv[_mrsh_optind];
 	char *name = argv[_mrsh_optind + 1];
@@ -38,18 +46,22 @@ int builtin_getopts(struct mrsh_state *state, int argc, char *argv[]) {
 	const char *optind_str = mrsh_env_get(state, "OPTIND", NULL);
 	if (optind_str == NULL) {
 		fprintf(stderr, "getopts: OPTIND is not defined\n");
-		return 1;
+		goto error;
 	}
 	char *endptr;
 	long optind_long = strtol(optind_str, &endptr, 10);
 	if (endptr[0] != '\0' || optind_long <= 0 || optind_long > INT_MAX) {
 		fprintf(stderr, "getopts: OPTIND is not a positive integer\n");
-		return 1;
+		goto error;
 	}
 	_mrsh_optind = (int)optind_long;
 
 	_mrsh_optopt = 0;
 	int opt = _mrsh_getopt(optc, optv, optstring);
+	if (frame_args) {
+		// Strings are owned by the call frame
+		free(optv);
+	}
 
 	char optind_fmt[16];
 	snprintf(optind_fmt, sizeof(optind_fmt), "%d", _mrsh_optind);
@@ -93,4 +105,10 @@ int builtin_getopts(struct mrsh_state *state, int argc, char *argv[]) {
 		return 1;
 	}
 	return 0;
+
+error:
+	if (frame_args) {
+		free(optv);
+	}
+	return 1;
 }
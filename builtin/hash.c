@@ -5,18 +5,25 @@
 #include <string.h>
 #include "builtin.h"
 #include "mrsh_getopt.h"
+#include "shell/shell.h"
 
 static const char hash_usage[] = "usage: hash -r|utility...\n";
 
+static void print_utility_iterator(const char *key, void *_value,
+		void *user_data) {
+	const char *value = _value;
+	printf("%s\n", value);
+}
+
 int builtin_hash(struct mrsh_state *state, int argc, char *argv[]) {
-	/* Hashing and remembering executable location isn't implemented. Thus most
-	 * of this builtin just does nothing. */
+	struct mrsh_state_priv *priv = state_get_priv(state);
+
 	_mrsh_optind = 0;
 	int opt;
 	while ((opt = _mrsh_getopt(argc, argv, ":r")) != -1) {
 		switch (opt) {
 		case 'r':
-			/* no-op: reset list of cached utilities */
+			forget_utilities(state);
 			return 0;
 		default:
 			fprintf(stderr, "hash: unknown option -- %c\n", _mrsh_optopt);
@@ -26,7 +33,8 @@ int builtin_hash(struct mrsh_state *state, int argc, char *argv[]) {
 	}
 
 	if (argc == 1) {
-		/* no-op: print list of cached utilities */
+		mrsh_hashtable_for_each(&priv->utilities, print_utility_iterator,
+			NULL);
 		return 0;
 	}
 
@@ -42,12 +50,16 @@ int builtin_hash(struct mrsh_state *state, int argc, char *argv[]) {
 			continue;
 		}
 
-		char *path = expand_path(state, utility, true, false);
-		if (path == NULL) {
+		// Search $PATH again, in case the utility has moved
+		char *old_path = mrsh_hashtable_del(&priv->utilities, utility);
+		if (old_path != NULL) {
+			free(old_path);
+			invalidate_commands(state);
+		}
+		if (find_utility(state, utility) == NULL) {
 			fprintf(stderr, "hash: command not found: %s\n", utility);
 			return 1;
 		}
-		free(path);
 	}
 
 	return 0;
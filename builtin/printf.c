@@ -0,0 +1,405 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <inttypes.h>
+#include <mrsh/shell.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "builtin.h"
+
+static const char printf_usage[] = "usage: printf format [argument...]\n";
+
+struct printf_args {
+	char **argv;
+	int argc, pos;
+	bool error;
+	bool stop; // \c was found in a %b argument
+	FILE *out, *err;
+};
+
+/**
+ * Prints a diagnostic after the output written so far, in case both go to the
+ * same file.
+ */
+static void print_error(struct printf_args *args, const char *fmt, ...) {
+	fflush(args->out);
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(args->err, fmt, ap);
+	va_end(ap);
+}
+
+static bool is_octal(char c) {
+	return c >= '0' && c <= '7';
+}
+
+/**
+ * Parses up to `max` octal digits.
+ */
+static const char *parse_octal(const char *str, int max, char *c) {
+	unsigned char value = 0;
+	for (int i = 0; i < max && is_octal(*str); ++i) {
+		value = value * 8 + (*str - '0');
+		++str;
+	}
+	*c = (char)value;
+	return str;
+}
+
+/**
+ * Parses the escape sequence after a backslash, common to formats and to %b.
+ * Returns NULL if it isn't one.
+ */
+static const char *parse_escape(const char *str, char *c) {
+	switch (*str) {
+	case '\\':
+		*c = '\\';
+		break;
+	case 'a':
+		*c = '\a';
+		break;
+	case 'b':
+		*c = '\b';
+		break;
+	case 'f':
+		*c = '\f';
+		break;
+	case 'n':
+		*c = '\n';
+		break;
+	case 'r':
+		*c = '\r';
+		break;
+	case 't':
+		*c = '\t';
+		break;
+	case 'v':
+		*c = '\v';
+		break;
+	default:
+		return NULL;
+	}
+	return str + 1;
+}
+
+bool print_escape_sequences(FILE *f, const char *str) {
+	while (*str != '\0') {
+		if (*str != '\\') {
+			size_t n = strcspn(str, "\\");
+			fwrite(str, 1, n, f);
+			str += n;
+			continue;
+		}
+
+		++str;
+		char c;
+		const char *end = parse_escape(str, &c);
+		if (end != NULL) {
+			str = end;
+		} else if (*str == 'c') {
+			return false;
+		} else if (*str == '0') {
+			str = parse_octal(str + 1, 3, &c);
+		} else if (is_octal(*str)) {
+			str = parse_octal(str, 3, &c);
+		} else {
+			c = '\\';
+		}
+		fputc(c, f);
+	}
+	return true;
+}
+
+static const char *next_arg(struct printf_args *args) {
+	if (args->pos >= args->argc) {
+		return NULL;
+	}
+	return args->argv[args->pos++];
+}
+
+static bool check_number(struct printf_args *args, const char *arg,
+		const char *end) {
+	if (errno != 0) {
+		print_error(args, "printf: %s: %s\n", arg, strerror(errno));
+	} else if (end == arg) {
+		print_error(args, "printf: %s: expected numeric value\n", arg);
+	} else if (*end != '\0') {
+		print_error(args, "printf: %s: not completely converted\n", arg);
+	} else {
+		return true;
+	}
+	args->error = true;
+	return false;
+}
+
+/**
+ * Numeric arguments starting with a quote are the value of the next character.
+ */
+static bool char_value(const char *arg, intmax_t *value) {
+	if (arg[0] != '\'' && arg[0] != '"') {
+		return false;
+	}
+	*value = (unsigned char)arg[1];
+	return true;
+}
+
+static intmax_t next_int(struct printf_args *args) {
+	const char *arg = next_arg(args);
+	intmax_t value = 0;
+	if (arg == NULL || char_value(arg, &value)) {
+		return value;
+	}
+	char *end;
+	errno = 0;
+	value = strtoimax(arg, &end, 0);
+	check_number(args, arg, end);
+	return value;
+}
+
+static uintmax_t next_uint(struct printf_args *args) {
+	const char *arg = next_arg(args);
+	intmax_t value = 0;
+	if (arg == NULL || char_value(arg, &value)) {
+		return value;
+	}
+	char *end;
+	errno = 0;
+	uintmax_t uvalue = strtoumax(arg, &end, 0);
+	check_number(args, arg, end);
+	return uvalue;
+}
+
+static double next_double(struct printf_args *args) {
+	const char *arg = next_arg(args);
+	intmax_t value = 0;
+	if (arg == NULL) {
+		return 0;
+	} else if (char_value(arg, &value)) {
+		return value;
+	}
+	char *end;
+	errno = 0;
+	double dvalue = strtod(arg, &end);
+	check_number(args, arg, end);
+	return dvalue;
+}
+
+static const char *skip_field(struct printf_args *args, const char *fmt,
+		int *field, size_t *fields_len) {
+	if (*fmt == '*') {
+		field[(*fields_len)++] = (int)next_int(args);
+		return fmt + 1;
+	}
+	return fmt + strspn(fmt, "0123456789");
+}
+
+/**
+ * Prints a conversion specification built at runtime. The specification is
+ * checked by the caller, so that it matches the arguments.
+ */
+static void print_spec(FILE *f, const char *spec, ...) {
+	va_list ap;
+	va_start(ap, spec);
+	vfprintf(f, spec, ap);
+	va_end(ap);
+}
+
+/**
+ * Prints a conversion specification, without its `%`. It's handed over to the
+ * C library, with a length modifier for integers. Returns NULL if output must
+ * stop.
+ */
+static const char *print_conversion(struct printf_args *args,
+		const char *fmt) {
+	int field[2]; // width and precision given as arguments
+	size_t fields_len = 0;
+
+	const char *begin = fmt;
+	fmt += strspn(fmt, "-+ #0");
+	fmt = skip_field(args, fmt, field, &fields_len);
+	if (*fmt == '.') {
+		fmt = skip_field(args, fmt + 1, field, &fields_len);
+	}
+
+	char spec[64] = "%";
+	size_t spec_len = fmt - begin;
+	if (spec_len + 4 > sizeof(spec)) {
+		print_error(args, "printf: conversion specification too long\n");
+		args->error = true;
+		return NULL;
+	}
+	memcpy(spec + 1, begin, spec_len);
+	++spec_len;
+
+	char conv = *fmt;
+	switch (conv) {
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		spec[spec_len++] = 'j';
+		break;
+	case 'a':
+	case 'A':
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'c':
+	case 's':
+	case 'b':
+		break;
+	case '\0':
+		print_error(args, "printf: missing conversion specifier\n");
+		args->error = true;
+		return NULL;
+	default:
+		print_error(args, "printf: %%%c: invalid conversion\n", conv);
+		args->error = true;
+		return NULL;
+	}
+	spec[spec_len++] = conv == 'b' ? 's' : conv;
+	spec[spec_len] = '\0';
+
+#define PRINT(value) \
+	do { \
+		switch (fields_len) { \
+		case 0: \
+			print_spec(args->out, spec, value); \
+			break; \
+		case 1: \
+			print_spec(args->out, spec, field[0], value); \
+			break; \
+		default: \
+			print_spec(args->out, spec, field[0], field[1], value); \
+		} \
+	} while (0)
+
+	switch (conv) {
+	case 'd':
+	case 'i':
+		PRINT(next_int(args));
+		break;
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		PRINT(next_uint(args));
+		break;
+	case 'c':;
+		const char *c = next_arg(args);
+		PRINT(c != NULL ? c[0] : '\0');
+		break;
+	case 's':;
+		const char *s = next_arg(args);
+		PRINT(s != NULL ? s : "");
+		break;
+	case 'b':;
+		const char *b = next_arg(args);
+		if (b == NULL) {
+			b = "";
+		}
+		if (spec_len == 2) {
+			args->stop = !print_escape_sequences(args->out, b);
+			break;
+		}
+		// Padding and precision apply to the expanded string
+		char *expanded;
+		size_t expanded_len;
+		FILE *f = open_memstream(&expanded, &expanded_len);
+		if (f == NULL) {
+			print_error(args, "printf: open_memstream: %s\n",
+				strerror(errno));
+			args->error = true;
+			return NULL;
+		}
+		args->stop = !print_escape_sequences(f, b);
+		fclose(f);
+		PRINT(expanded);
+		free(expanded);
+		break;
+	default:
+		PRINT(next_double(args));
+	}
+
+#undef PRINT
+
+	return args->stop ? NULL : fmt + 1;
+}
+
+/**
+ * Prints the format once. Returns false if output must stop.
+ */
+static bool print_format(struct printf_args *args, const char *fmt) {
+	while (*fmt != '\0') {
+		size_t n = strcspn(fmt, "\\%");
+		fwrite(fmt, 1, n, args->out);
+		fmt += n;
+
+		if (*fmt == '\\') {
+			++fmt;
+			char c;
+			const char *end = parse_escape(fmt, &c);
+			if (end != NULL) {
+				fmt = end;
+			} else if (is_octal(*fmt)) {
+				fmt = parse_octal(fmt, 3, &c);
+			} else {
+				c = '\\';
+			}
+			fputc(c, args->out);
+		} else if (*fmt == '%') {
+			++fmt;
+			if (*fmt == '%') {
+				fputc('%', args->out);
+				++fmt;
+				continue;
+			}
+			fmt = print_conversion(args, fmt);
+			if (fmt == NULL) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int builtin_printf(struct mrsh_state *state, int argc, char *argv[]) {
+	int first = 1;
+	if (argc > 1 && strcmp(argv[1], "--") == 0) {
+		++first;
+	}
+	FILE *err = builtin_stream(state, STDERR_FILENO);
+	if (argc <= first) {
+		fprintf(err, printf_usage);
+		return 1;
+	}
+
+	const char *fmt = argv[first];
+	struct printf_args args = {
+		.argv = &argv[first + 1],
+		.argc = argc - first - 1,
+		.out = builtin_stream(state, STDOUT_FILENO),
+		.err = err,
+	};
+
+	// The format is reused as long as it consumes arguments
+	while (true) {
+		int prev_pos = args.pos;
+		if (!print_format(&args, fmt)) {
+			break;
+		}
+		if (args.pos >= args.argc || args.pos == prev_pos) {
+			break;
+		}
+	}
+
+	return args.error ? 1 : 0;
+}
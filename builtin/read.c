@@ -6,12 +6,50 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "builtin.h"
 #include "mrsh_getopt.h"
 
 static const char read_usage[] = "usage: read [-r] var...\n";
 
+#define READ_BLOCK_SIZE 128
+
+/**
+ * Reads the input byte by byte, without consuming anything past the line: the
+ * rest of the input belongs to whoever runs next. Seekable files are read by
+ * blocks and the excess is given back when done.
+ */
+struct read_input {
+	int fd;
+	bool seekable;
+	char buf[READ_BLOCK_SIZE];
+	size_t pos, len;
+};
+
+static int read_input_getc(struct read_input *in) {
+	if (in->pos == in->len) {
+		size_t size = in->seekable ? sizeof(in->buf) : 1;
+		ssize_t n;
+		do {
+			n = read(in->fd, in->buf, size);
+		} while (n < 0 && errno == EINTR);
+		if (n <= 0) {
+			return EOF;
+		}
+		in->pos = 0;
+		in->len = (size_t)n;
+	}
+	return (unsigned char)in->buf[in->pos++];
+}
+
+static void read_input_finish(struct read_input *in) {
+	if (in->pos < in->len) {
+		lseek(in->fd, -(off_t)(in->len - in->pos), SEEK_CUR);
+	}
+}
+
 int builtin_read(struct mrsh_state *state, int argc, char *argv[]) {
+	FILE *err = builtin_stream(state, STDERR_FILENO);
 	bool raw = false;
 
 	_mrsh_optind = 0;
@@ -22,20 +60,26 @@ int builtin_read(struct mrsh_state *state, int argc, char *argv[]) {
 			raw = true;
 			break;
 		default:
-			fprintf(stderr, "read: unknown option -- %c\n", _mrsh_optopt);
-			fprintf(stderr, read_usage);
+			fprintf(err, "read: unknown option -- %c\n", _mrsh_optopt);
+			fprintf(err, read_usage);
 			return 1;
 		}
 	}
 	if (_mrsh_optind == argc) {
-		fprintf(stderr, read_usage);
+		fprintf(err, read_usage);
 		return 1;
 	}
 
+	// Whoever writes the input may be waiting for our output, e.g. a prompt
+	fflush(stdout);
+
+	struct read_input in = { .fd = builtin_fd(state, STDIN_FILENO) };
+	in.seekable = lseek(in.fd, 0, SEEK_CUR) >= 0;
+
 	struct mrsh_buffer buf = {0};
 	bool escaped = false;
 	int c;
-	while ((c = fgetc(stdin)) != EOF) {
+	while ((c = read_input_getc(&in)) != EOF) {
 		if (!raw && !escaped && c == '\\') {
 			escaped = true;
 			continue;
@@ -44,7 +88,7 @@ int builtin_read(struct mrsh_state *state, int argc, char *argv[]) {
 			if (escaped) {
 				escaped = false;
 				const char *ps2 = mrsh_env_get(state, "PS2", NULL);
-				fprintf(stderr, "%s", ps2 != NULL ? ps2 : "> ");
+				fprintf(err, "%s", ps2 != NULL ? ps2 : "> ");
 				continue;
 			}
 			break;
@@ -52,16 +96,17 @@ int builtin_read(struct mrsh_state *state, int argc, char *argv[]) {
 		escaped = false;
 		mrsh_buffer_append_char(&buf, (char)c);
 	}
+	read_input_finish(&in);
 	mrsh_buffer_append_char(&buf, '\0');
 
 	struct mrsh_array fields = {0};
 
 	struct mrsh_word_string *ws = mrsh_word_string_create(mrsh_buffer_steal(&buf), false);
-	split_fields(&fields, &ws->word, mrsh_env_get(state, "IFS", NULL));
+	split_fields(NULL, &fields, &ws->word, mrsh_env_get(state, "IFS", NULL));
 	mrsh_word_destroy(&ws->word);
 
 	struct mrsh_array strs = {0};
-	get_fields_str(&strs, &fields);
+	get_fields_str(NULL, &strs, &fields);
 	for (size_t i = 0; i < fields.len; ++i) {
 		mrsh_word_destroy(fields.data[i]);
 	}
@@ -38,6 +38,9 @@ static const struct option_map options[] = {
 	{ "nounset", 'u', MRSH_OPT_NOUNSET },
 	{ "verbose", 'v', MRSH_OPT_VERBOSE },
 	{ "xtrace", 'x', MRSH_OPT_XTRACE },
+	{ "lazyfuncs", 0, MRSH_OPT_LAZYFUNCS },
+	{ "profile", 0, MRSH_OPT_PROFILE },
+	{ "stats", 0, MRSH_OPT_STATS },
 };
 
 const char *state_get_options(struct mrsh_state *state) {
@@ -81,23 +84,18 @@ static const struct option_map *find_long_option(const char *opt) {
 	return NULL;
 }
 
-static char **argv_dup(char *argv_0, int argc, char *argv[]) {
+static void set_args(struct mrsh_state *state, int argc, char *argv[]) {
 	char **_argv = calloc(argc + 1, sizeof(char *));
-	_argv[0] = argv_0;
-	for (int i = 1; i < argc; ++i) {
-		_argv[i] = strdup(argv[i - 1]);
-	}
-	return _argv;
-}
-
-static void argv_free(int argc, char **argv) {
-	if (!argv) {
+	if (_argv == NULL) {
 		return;
 	}
 	for (int i = 0; i < argc; ++i) {
-		free(argv[i]);
+		_argv[i] = strdup(argv[i]);
 	}
-	free(argv);
+	struct mrsh_args *args = args_create(argc, _argv);
+	free(_argv);
+	call_frame_set_args(state->frame, args, 0);
+	args_unref(args);
 }
 
 static int set(struct mrsh_state *state, int argc, char *argv[],
@@ -189,25 +187,21 @@ static int set(struct mrsh_state *state, int argc, char *argv[],
 	}
 
 	if (i != argc || force_positional) {
-		char *argv_0;
 		if (init_args != NULL) {
-			argv_0 = strdup(argv[i++]);
-			init_args->command_file = argv_0;
-		} else if (state->frame->argv) {
-			argv_0 = strdup(state->frame->argv[0]);
-		} else {
+			free(state->frame->argv_0);
+			state->frame->argv_0 = strdup(argv[i++]);
+			init_args->command_file = state->frame->argv_0;
+		} else if (state->frame->argv_0 == NULL) {
 			fprintf(stderr, set_usage);
 			return 1;
 		}
-		argv_free(state->frame->argc, state->frame->argv);
-		state->frame->argc = argc - i + 1;
-		state->frame->argv = argv_dup(argv_0, state->frame->argc, &argv[i]);
+		set_args(state, argc - i, &argv[i]);
 	} else
 out:
 	  if (init_args != NULL) {
-		// No args given, but we need to initialize state->argv
-		state->frame->argc = 1;
-		state->frame->argv = argv_dup(strdup(argv[0]), 1, argv);
+		// No args given, but we need to initialize $0
+		free(state->frame->argv_0);
+		state->frame->argv_0 = strdup(argv[0]);
 	}
 
 	return 0;
@@ -3,6 +3,7 @@
 #include <mrsh/shell.h>
 #include <stdlib.h>
 #include "builtin.h"
+#include "shell/shell.h"
 
 static const char shift_usage[] = "usage: shift [n]\n";
 
@@ -33,20 +34,13 @@ int builtin_shift(struct mrsh_state *state, int argc, char *argv[]) {
 			state->exit = 1;
 		}
 		return 1;
-	} else if (n > state->frame->argc - 1) {
+	} else if (n > mrsh_call_frame_nargs(state->frame)) {
 		fprintf(stderr, "shift: [n] must be less than $#\n");
 		if (!state->interactive) {
 			state->exit = 1;
 		}
 		return 1;
 	}
-	for (int i = 1, j = n + 1; j < state->frame->argc; ++i, ++j) {
-		if (j <= state->frame->argc - n) {
-			state->frame->argv[i] = state->frame->argv[j];
-		} else {
-			free(state->frame->argv[i]);
-		}
-	}
-	state->frame->argc -= n;
+	call_frame_shift(state->frame, n);
 	return 0;
 }
@@ -0,0 +1,44 @@
+#include <mrsh/builtin.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "builtin.h"
+#include "shell/shell.h"
+#include "stats.h"
+
+static const char stats_usage[] = "usage: stats\n";
+
+void print_stats(struct mrsh_state *state, FILE *f) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	const struct shell_stats *stats = &priv->stats;
+
+	fprintf(f, "forks %lu\n", stats->forks);
+	fprintf(f, "execs %lu\n", stats->execs);
+	fprintf(f, "pipes %lu\n", stats->pipes);
+	fprintf(f, "substitutions %lu\n", stats->substitutions);
+	fprintf(f, "here_documents %lu\n", stats->here_documents);
+	fprintf(f, "globs %lu\n", stats->globs);
+	fprintf(f, "peak_jobs %zu\n", stats->peak_jobs);
+	fprintf(f, "parse_bytes %lu\n", lib_stats.parse_bytes);
+	fprintf(f, "parse_cache_hits %zu\n", priv->parse_cache.hits);
+	fprintf(f, "parse_cache_misses %zu\n", priv->parse_cache.misses);
+	fprintf(f, "hashtable_probes %lu\n", lib_stats.hashtable_probes);
+	fprintf(f, "ast_copies %lu\n", lib_stats.ast_copies);
+	fprintf(f, "allocations %lu\n", lib_stats.allocations);
+}
+
+/**
+ * Counters are per process: a subshell or a command of a pipeline starts with
+ * the counters of the shell which forked it, and what it does isn't added to
+ * them. For instance, after `echo $(date) | cat`, the shell has counted the
+ * pipe and two forks, but not the substitution, which ran in a child.
+ */
+int builtin_stats(struct mrsh_state *state, int argc, char *argv[]) {
+	FILE *err = builtin_stream(state, STDERR_FILENO);
+	if (argc > 1) {
+		fprintf(err, stats_usage);
+		return 1;
+	}
+
+	print_stats(state, builtin_stream(state, STDOUT_FILENO));
+	return 0;
+}
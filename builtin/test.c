@@ -0,0 +1,348 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <mrsh/shell.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "builtin.h"
+
+/**
+ * Arguments of a test expression. Evaluation stops at the first error, which
+ * is reported once.
+ */
+struct test_parser {
+	const char *name;
+	FILE *err;
+	char **args;
+	int len, pos;
+	bool error;
+};
+
+static void test_error(struct test_parser *p, const char *msg,
+		const char *arg) {
+	if (p->error) {
+		return;
+	}
+	if (arg != NULL) {
+		fprintf(p->err, "%s: %s: %s\n", p->name, arg, msg);
+	} else {
+		fprintf(p->err, "%s: %s\n", p->name, msg);
+	}
+	p->error = true;
+}
+
+static bool is_unary_op(const char *op) {
+	return op[0] == '-' && op[1] != '\0' && op[2] == '\0' &&
+		strchr("bcdefghLnprSstuwxz", op[1]) != NULL;
+}
+
+static bool is_binary_op(const char *op) {
+	const char *ops[] = {
+		"=", "!=", "<", ">",
+		"-eq", "-ne", "-gt", "-ge", "-lt", "-le",
+		"-ef", "-nt", "-ot",
+	};
+	for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+		if (strcmp(op, ops[i]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool test_file(char op, const char *path) {
+	struct stat st;
+	switch (op) {
+	case 'r':
+		return faccessat(AT_FDCWD, path, R_OK, AT_EACCESS) == 0;
+	case 'w':
+		return faccessat(AT_FDCWD, path, W_OK, AT_EACCESS) == 0;
+	case 'x':
+		return faccessat(AT_FDCWD, path, X_OK, AT_EACCESS) == 0;
+	case 'h':
+	case 'L':
+		return lstat(path, &st) == 0 && S_ISLNK(st.st_mode);
+	}
+
+	if (stat(path, &st) != 0) {
+		return false;
+	}
+	switch (op) {
+	case 'b':
+		return S_ISBLK(st.st_mode);
+	case 'c':
+		return S_ISCHR(st.st_mode);
+	case 'd':
+		return S_ISDIR(st.st_mode);
+	case 'e':
+		return true;
+	case 'f':
+		return S_ISREG(st.st_mode);
+	case 'g':
+		return st.st_mode & S_ISGID;
+	case 'p':
+		return S_ISFIFO(st.st_mode);
+	case 'S':
+		return S_ISSOCK(st.st_mode);
+	case 's':
+		return st.st_size > 0;
+	case 'u':
+		return st.st_mode & S_ISUID;
+	}
+	abort();
+}
+
+static bool parse_integer(struct test_parser *p, const char *str,
+		intmax_t *value) {
+	char *end;
+	errno = 0;
+	*value = strtoimax(str, &end, 10);
+	while (end[0] == ' ' || end[0] == '\t') {
+		++end;
+	}
+	if (end == str || end[0] != '\0' || errno != 0) {
+		test_error(p, "illegal number", str);
+		return false;
+	}
+	return true;
+}
+
+static bool test_unary(struct test_parser *p, const char *op,
+		const char *arg) {
+	switch (op[1]) {
+	case 'n':
+		return arg[0] != '\0';
+	case 'z':
+		return arg[0] == '\0';
+	case 't':;
+		intmax_t fd;
+		if (!parse_integer(p, arg, &fd)) {
+			return false;
+		}
+		return fd >= 0 && fd <= INT_MAX && isatty(fd);
+	default:
+		return test_file(op[1], arg);
+	}
+}
+
+static int compare_mtime(const struct stat *a, const struct stat *b) {
+	if (a->st_mtim.tv_sec != b->st_mtim.tv_sec) {
+		return a->st_mtim.tv_sec < b->st_mtim.tv_sec ? -1 : 1;
+	}
+	if (a->st_mtim.tv_nsec != b->st_mtim.tv_nsec) {
+		return a->st_mtim.tv_nsec < b->st_mtim.tv_nsec ? -1 : 1;
+	}
+	return 0;
+}
+
+static bool test_files(const char *a, const char *op, const char *b) {
+	struct stat st_a, st_b;
+	bool has_a = stat(a, &st_a) == 0;
+	bool has_b = stat(b, &st_b) == 0;
+	if (strcmp(op, "-ef") == 0) {
+		return has_a && has_b &&
+			st_a.st_dev == st_b.st_dev && st_a.st_ino == st_b.st_ino;
+	} else if (strcmp(op, "-nt") == 0) {
+		// A file is newer than one which doesn't exist
+		return has_a && (!has_b || compare_mtime(&st_a, &st_b) > 0);
+	} else { // -ot
+		return has_b && (!has_a || compare_mtime(&st_a, &st_b) < 0);
+	}
+}
+
+static bool test_binary(struct test_parser *p, const char *a, const char *op,
+		const char *b) {
+	if (strcmp(op, "=") == 0) {
+		return strcmp(a, b) == 0;
+	} else if (strcmp(op, "!=") == 0) {
+		return strcmp(a, b) != 0;
+	} else if (strcmp(op, "<") == 0) {
+		return strcoll(a, b) < 0;
+	} else if (strcmp(op, ">") == 0) {
+		return strcoll(a, b) > 0;
+	} else if (strcmp(op, "-ef") == 0 || strcmp(op, "-nt") == 0 ||
+			strcmp(op, "-ot") == 0) {
+		return test_files(a, op, b);
+	}
+
+	intmax_t x, y;
+	if (!parse_integer(p, a, &x) || !parse_integer(p, b, &y)) {
+		return false;
+	}
+	if (strcmp(op, "-eq") == 0) {
+		return x == y;
+	} else if (strcmp(op, "-ne") == 0) {
+		return x != y;
+	} else if (strcmp(op, "-gt") == 0) {
+		return x > y;
+	} else if (strcmp(op, "-ge") == 0) {
+		return x >= y;
+	} else if (strcmp(op, "-lt") == 0) {
+		return x < y;
+	} else { // -le
+		return x <= y;
+	}
+}
+
+static const char *peek_arg(struct test_parser *p, int offset) {
+	if (p->pos + offset >= p->len) {
+		return NULL;
+	}
+	return p->args[p->pos + offset];
+}
+
+static const char *read_arg(struct test_parser *p) {
+	const char *arg = peek_arg(p, 0);
+	if (arg == NULL) {
+		test_error(p, "argument expected", NULL);
+		return "";
+	}
+	++p->pos;
+	return arg;
+}
+
+static bool or_expr(struct test_parser *p);
+
+static bool primary(struct test_parser *p) {
+	const char *arg = read_arg(p);
+	const char *next = peek_arg(p, 0);
+	if (next != NULL && is_binary_op(next) && peek_arg(p, 1) != NULL) {
+		++p->pos;
+		return test_binary(p, arg, next, read_arg(p));
+	} else if (is_unary_op(arg) && next != NULL) {
+		return test_unary(p, arg, read_arg(p));
+	} else if (strcmp(arg, "(") == 0) {
+		bool result = or_expr(p);
+		const char *rparen = read_arg(p);
+		if (strcmp(rparen, ")") != 0) {
+			test_error(p, "closing paren expected", NULL);
+		}
+		return result;
+	}
+	return arg[0] != '\0';
+}
+
+static bool not_expr(struct test_parser *p) {
+	const char *arg = peek_arg(p, 0);
+	if (arg != NULL && strcmp(arg, "!") == 0 && peek_arg(p, 1) != NULL) {
+		++p->pos;
+		return !not_expr(p);
+	}
+	return primary(p);
+}
+
+static bool and_expr(struct test_parser *p) {
+	bool result = not_expr(p);
+	while (!p->error) {
+		const char *op = peek_arg(p, 0);
+		if (op == NULL || strcmp(op, "-a") != 0) {
+			break;
+		}
+		++p->pos;
+		// Both operands are parsed, even if the result is already known
+		bool right = not_expr(p);
+		result = result && right;
+	}
+	return result;
+}
+
+static bool or_expr(struct test_parser *p) {
+	bool result = and_expr(p);
+	while (!p->error) {
+		const char *op = peek_arg(p, 0);
+		if (op == NULL || strcmp(op, "-o") != 0) {
+			break;
+		}
+		++p->pos;
+		bool right = and_expr(p);
+		result = result || right;
+	}
+	return result;
+}
+
+/**
+ * Evaluates the next `n` arguments with the rules POSIX gives for up to four
+ * arguments, which resolve ambiguities like `! = x` by the number of
+ * arguments. Longer expressions are parsed with the usual precedence.
+ */
+static bool test_args(struct test_parser *p, int n) {
+	char **args = &p->args[p->pos];
+	switch (n) {
+	case 0:
+		return false;
+	case 1:
+		++p->pos;
+		return args[0][0] != '\0';
+	case 2:
+		if (strcmp(args[0], "!") == 0) {
+			++p->pos;
+			return !test_args(p, 1);
+		}
+		if (is_unary_op(args[0])) {
+			p->pos += 2;
+			return test_unary(p, args[0], args[1]);
+		}
+		break;
+	case 3:
+		if (is_binary_op(args[1])) {
+			p->pos += 3;
+			return test_binary(p, args[0], args[1], args[2]);
+		}
+		if (strcmp(args[0], "!") == 0) {
+			++p->pos;
+			return !test_args(p, 2);
+		}
+		if (strcmp(args[0], "(") == 0 && strcmp(args[2], ")") == 0) {
+			++p->pos;
+			bool result = test_args(p, 1);
+			++p->pos;
+			return result;
+		}
+		break;
+	case 4:
+		if (strcmp(args[0], "!") == 0) {
+			++p->pos;
+			return !test_args(p, 3);
+		}
+		if (strcmp(args[0], "(") == 0 && strcmp(args[3], ")") == 0) {
+			++p->pos;
+			bool result = test_args(p, 2);
+			++p->pos;
+			return result;
+		}
+		break;
+	}
+	return or_expr(p);
+}
+
+int builtin_test(struct mrsh_state *state, int argc, char *argv[]) {
+	struct test_parser p = {
+		.name = argv[0],
+		.err = builtin_stream(state, STDERR_FILENO),
+		.args = &argv[1],
+		.len = argc - 1,
+	};
+
+	if (strcmp(argv[0], "[") == 0) {
+		if (p.len == 0 || strcmp(argv[argc - 1], "]") != 0) {
+			fprintf(p.err, "[: missing ]\n");
+			return 2;
+		}
+		--p.len;
+	}
+
+	bool result = test_args(&p, p.len);
+	if (!p.error && p.pos < p.len) {
+		test_error(&p, "unexpected operator", p.args[p.pos]);
+	}
+	if (p.error) {
+		return 2;
+	}
+	return result ? 0 : 1;
+}
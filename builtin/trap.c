@@ -162,13 +162,14 @@ int builtin_trap(struct mrsh_state *state, int argc, char *argv[]) {
 
 		struct mrsh_parser *parser =
 			mrsh_parser_with_data(action_str, strlen(action_str));
+		mrsh_parser_set_arena(parser, true);
 		program = mrsh_parse_program(parser);
 
-		struct mrsh_position err_pos;
-		const char *err_msg = mrsh_parser_error(parser, &err_pos);
+		struct mrsh_location err_loc;
+		const char *err_msg = mrsh_parser_error(parser, &err_loc);
 		if (err_msg != NULL) {
 			fprintf(stderr, "trap: %d:%d: %s\n",
-				err_pos.line, err_pos.column, err_msg);
+				err_loc.line, err_loc.column, err_msg);
 			mrsh_parser_destroy(parser);
 			mrsh_program_destroy(program);
 			return 1;
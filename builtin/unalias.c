@@ -6,12 +6,22 @@
 #include "builtin.h"
 #include "mrsh_getopt.h"
 #include "shell/shell.h"
+#include "shell/snapshot.h"
 
 static const char unalias_usage[] = "usage: unalias -a|alias-name...\n";
 
+static void delete_alias(struct mrsh_state *state, const char *key) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	char *old_value = mrsh_hashtable_get(&priv->aliases, key);
+	if (!snapshot_keep(state, &priv->aliases, key, old_value)) {
+		free(old_value);
+	}
+	mrsh_hashtable_del(&priv->aliases, key);
+}
+
 static void delete_alias_iterator(const char *key, void *_value,
 		void *user_data) {
-	free(mrsh_hashtable_del((struct mrsh_hashtable*)user_data, key));
+	delete_alias(user_data, key);
 }
 
 int builtin_unalias(struct mrsh_state *state, int argc, char *argv[]) {
@@ -38,8 +48,7 @@ int builtin_unalias(struct mrsh_state *state, int argc, char *argv[]) {
 			fprintf(stderr, unalias_usage);
 			return 1;
 		}
-		mrsh_hashtable_for_each(&priv->aliases, delete_alias_iterator,
-			&priv->aliases);
+		mrsh_hashtable_for_each(&priv->aliases, delete_alias_iterator, state);
 		return 0;
 	}
 
@@ -49,7 +58,7 @@ int builtin_unalias(struct mrsh_state *state, int argc, char *argv[]) {
 	}
 
 	for (int i = _mrsh_optind; i < argc; ++i) {
-		free(mrsh_hashtable_del(&priv->aliases, argv[i]));
+		delete_alias(state, argv[i]);
 	}
 	return 0;
 }
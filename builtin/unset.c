@@ -6,6 +6,7 @@
 #include "builtin.h"
 #include "mrsh_getopt.h"
 #include "shell/shell.h"
+#include "shell/snapshot.h"
 
 static const char unset_usage[] = "usage: unset [-fv] name...\n";
 
@@ -48,7 +49,10 @@ int builtin_unset(struct mrsh_state *state, int argc, char *argv[]) {
 		} else {
 			struct mrsh_function *oldfn =
 				mrsh_hashtable_del(&priv->functions, argv[i]);
-			function_destroy(oldfn);
+			if (!snapshot_keep(state, &priv->functions, argv[i], oldfn)) {
+				function_unref(oldfn);
+			}
+			invalidate_commands(state);
 		}
 	}
 	return 0;
@@ -22,7 +22,7 @@ enum format {
 
 struct highlight_state {
 	const char *buf;
-	size_t offset;
+	uint32_t offset; // byte offset of the next char to print
 
 	enum format fmt_stack[FORMAT_STACK_SIZE];
 	size_t fmt_stack_len;
@@ -30,11 +30,12 @@ struct highlight_state {
 
 static void highlight(struct highlight_state *state, struct mrsh_position *pos,
 		enum format fmt) {
-	assert(pos->offset >= state->offset);
+	uint32_t offset = pos->offset1 - 1;
+	assert(offset >= state->offset);
 
 	fwrite(&state->buf[state->offset], sizeof(char),
-		pos->offset - state->offset, stdout);
-	state->offset = pos->offset;
+		offset - state->offset, stdout);
+	state->offset = offset;
 
 	if (fmt == FORMAT_RESET) {
 		assert(state->fmt_stack_len > 0);
@@ -62,7 +63,7 @@ static void highlight_str(struct highlight_state *state,
 
 static void highlight_char(struct highlight_state *state,
 		struct mrsh_position *pos, enum format fmt) {
-	struct mrsh_position next = { .offset = pos->offset + 1 };
+	struct mrsh_position next = { .offset1 = pos->offset1 + 1 };
 	highlight(state, pos, fmt);
 	highlight(state, &next, FORMAT_RESET);
 }
@@ -98,7 +99,7 @@ static void highlight_word(struct highlight_state *state,
 		struct mrsh_position end = {0};
 		if (mrsh_position_valid(&wp->rbrace_pos)) {
 			highlight_char(state, &wp->rbrace_pos, FORMAT_GREEN);
-			end.offset = wp->rbrace_pos.offset + 1;
+			end.offset1 = wp->rbrace_pos.offset1 + 1;
 		} else {
 			end = wp->name_range.end;
 		}
@@ -112,7 +113,7 @@ static void highlight_word(struct highlight_state *state,
 		// TODO: highlight inside
 		if (wc->back_quoted) {
 			struct mrsh_position rquote = {
-				.offset = wc->range.end.offset - 1,
+				.offset1 = wc->range.end.offset1 - 1,
 			};
 			highlight_char(state, &rquote, FORMAT_GREEN);
 		}
@@ -135,7 +136,7 @@ static void highlight_word(struct highlight_state *state,
 		}
 
 		if (wl->double_quoted) {
-			struct mrsh_position end = { .offset = wl->rquote_pos.offset + 1 };
+			struct mrsh_position end = { .offset1 = wl->rquote_pos.offset1 + 1 };
 			highlight(state, &end, FORMAT_RESET);
 		}
 		break;
@@ -245,7 +246,9 @@ static void highlight_command(struct highlight_state *state,
 		highlight_str(state, &fd->name_range, FORMAT_BLUE);
 		highlight_char(state, &fd->lparen_pos, FORMAT_GREEN);
 		highlight_char(state, &fd->rparen_pos, FORMAT_GREEN);
-		highlight_command(state, fd->body);
+		if (fd->body != NULL) {
+			highlight_command(state, fd->body);
+		}
 		break;
 	}
 }
@@ -323,12 +326,12 @@ int main(int argc, char *argv[]) {
 		.buf = buf.data,
 	};
 
-	struct mrsh_position begin = { .offset = 0 };
+	struct mrsh_position begin = { .offset1 = 1 };
 	highlight(&state, &begin, FORMAT_DEFAULT);
 
 	highlight_program(&state, prog);
 
-	struct mrsh_position end = { .offset = buf.len };
+	struct mrsh_position end = { .offset1 = buf.len + 1 };
 	highlight(&state, &end, FORMAT_RESET);
 	assert(state.fmt_stack_len == 0);
 
@@ -2,6 +2,8 @@
 #include <mrsh/hashtable.h>
 #include <stdlib.h>
 #include <string.h>
+#include "intern.h"
+#include "stats.h"
 
 static unsigned int djb2(const char *str) {
 	unsigned int hash = 5381;
@@ -12,9 +14,18 @@ static unsigned int djb2(const char *str) {
 	return hash;
 }
 
+unsigned int mrsh_hashtable_hash(const char *key) {
+	return djb2(key);
+}
+
 void *mrsh_hashtable_get(struct mrsh_hashtable *table, const char *key) {
-	unsigned int hash = djb2(key);
+	return mrsh_hashtable_get_hashed(table, key, djb2(key));
+}
+
+void *mrsh_hashtable_get_hashed(struct mrsh_hashtable *table, const char *key,
+		unsigned int hash) {
 	unsigned int bucket = hash % MRSH_HASHTABLE_BUCKETS;
+	++lib_stats.hashtable_probes;
 	struct mrsh_hashtable_entry *entry = table->buckets[bucket];
 
 	while (entry != NULL) {
@@ -31,6 +42,7 @@ void *mrsh_hashtable_set(struct mrsh_hashtable *table, const char *key,
 		void *value) {
 	unsigned int hash = djb2(key);
 	unsigned int bucket = hash % MRSH_HASHTABLE_BUCKETS;
+	++lib_stats.hashtable_probes;
 	struct mrsh_hashtable_entry *entry = table->buckets[bucket];
 
 	struct mrsh_hashtable_entry *previous = NULL;
@@ -62,13 +74,18 @@ static void hashtable_entry_destroy(struct mrsh_hashtable_entry *entry) {
 	if (entry == NULL) {
 		return;
 	}
-	free(entry->key);
+	if (entry->interned) {
+		atom_unref(entry->key);
+	} else {
+		free(entry->key);
+	}
 	free(entry);
 }
 
 void *mrsh_hashtable_del(struct mrsh_hashtable *table, const char *key) {
 	unsigned int hash = djb2(key);
 	unsigned int bucket = hash % MRSH_HASHTABLE_BUCKETS;
+	++lib_stats.hashtable_probes;
 	struct mrsh_hashtable_entry *entry = table->buckets[bucket];
 
 	struct mrsh_hashtable_entry *previous = NULL;
@@ -94,6 +111,63 @@ void *mrsh_hashtable_del(struct mrsh_hashtable *table, const char *key) {
 	return old_value;
 }
 
+void *hashtable_get_atom(struct mrsh_hashtable *table, const char *atom) {
+	unsigned int hash = atom_hash(atom);
+	unsigned int bucket = hash % MRSH_HASHTABLE_BUCKETS;
+	++lib_stats.hashtable_probes;
+	struct mrsh_hashtable_entry *entry = table->buckets[bucket];
+
+	while (entry != NULL) {
+		// Two different atoms are never equal
+		if (entry->key == atom || (!entry->interned && entry->hash == hash &&
+				strcmp(entry->key, atom) == 0)) {
+			return entry->value;
+		}
+		entry = entry->next;
+	}
+
+	return NULL;
+}
+
+void *hashtable_set_atom(struct mrsh_hashtable *table, const char *atom,
+		void *value) {
+	unsigned int hash = atom_hash(atom);
+	unsigned int bucket = hash % MRSH_HASHTABLE_BUCKETS;
+	++lib_stats.hashtable_probes;
+	struct mrsh_hashtable_entry *entry = table->buckets[bucket];
+
+	struct mrsh_hashtable_entry *previous = NULL;
+	while (entry != NULL) {
+		if (entry->key == atom || (!entry->interned && entry->hash == hash &&
+				strcmp(entry->key, atom) == 0)) {
+			break;
+		}
+		previous = entry;
+		entry = entry->next;
+	}
+
+	if (entry == NULL) {
+		entry = calloc(1, sizeof(struct mrsh_hashtable_entry));
+		entry->hash = hash;
+		if (previous != NULL) {
+			previous->next = entry;
+		} else {
+			table->buckets[bucket] = entry;
+		}
+	} else if (entry->key != atom) {
+		free(entry->key); // the same name, but not interned
+		entry->key = NULL;
+	}
+	if (entry->key == NULL) {
+		entry->interned = true;
+		entry->key = (char *)atom_ref(atom);
+	}
+
+	void *old_value = entry->value;
+	entry->value = value;
+	return old_value;
+}
+
 void mrsh_hashtable_finish(struct mrsh_hashtable *table) {
 	for (size_t i = 0; i < MRSH_HASHTABLE_BUCKETS; ++i) {
 		struct mrsh_hashtable_entry *entry = table->buckets[i];
@@ -0,0 +1,47 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <mrsh/array.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct mrsh_arena_chunk;
+
+/**
+ * A bump allocator. Allocations are never freed individually: everything
+ * allocated after a mark is released at once with `arena_release`, and
+ * everything is released with `arena_finish`.
+ *
+ * Chunks freed by `arena_release` are kept around, so that a hot loop
+ * releasing the arena after each iteration doesn't hit malloc again.
+ */
+struct mrsh_arena {
+	struct mrsh_arena_chunk *chunk; // most recent chunk
+	struct mrsh_arena_chunk *spare; // released chunk kept for reuse
+	struct mrsh_array atoms; // references to atoms released with the arena
+};
+
+/**
+ * A position in an arena, used to release everything allocated after it.
+ */
+struct mrsh_arena_mark {
+	struct mrsh_arena_chunk *chunk;
+	size_t used;
+	size_t atoms;
+};
+
+/**
+ * Allocates zero-initialized memory from the arena.
+ */
+void *arena_alloc(struct mrsh_arena *arena, size_t size);
+char *arena_strdup(struct mrsh_arena *arena, const char *str);
+char *arena_strndup(struct mrsh_arena *arena, const char *str, size_t len);
+/**
+ * Takes over a reference to an atom: it will be released with the arena.
+ */
+void arena_adopt_atom(struct mrsh_arena *arena, const char *atom);
+struct mrsh_arena_mark arena_mark(const struct mrsh_arena *arena);
+void arena_release(struct mrsh_arena *arena, struct mrsh_arena_mark mark);
+void arena_finish(struct mrsh_arena *arena);
+
+#endif
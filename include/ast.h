@@ -3,7 +3,169 @@
 
 #include <mrsh/ast.h>
 
-void command_list_array_finish(struct mrsh_array *cmds);
-void case_item_destroy(struct mrsh_case_item *item);
+struct mrsh_arena;
+struct mrsh_buffer;
+struct mrsh_line_table;
+
+/*
+ * Nodes can be allocated from an arena instead of the heap, by passing it to
+ * the functions below; NULL means the heap. Arena nodes aren't freed
+ * individually: destroying them is a no-op, their memory is reclaimed when the
+ * arena is released. Strings and arrays passed to create functions must be
+ * allocated from the same arena (or from the heap if NULL), e.g. with
+ * ast_strdup and ast_array_add.
+ */
+
+void command_list_array_finish(struct mrsh_arena *arena,
+	struct mrsh_array *cmds);
+void case_item_destroy(struct mrsh_arena *arena, struct mrsh_case_item *item);
+void ast_word_destroy(struct mrsh_arena *arena, struct mrsh_word *word);
+void ast_command_destroy(struct mrsh_arena *arena, struct mrsh_command *cmd);
+void ast_and_or_list_destroy(struct mrsh_arena *arena,
+	struct mrsh_and_or_list *and_or_list);
+void ast_program_destroy(struct mrsh_arena *arena, struct mrsh_program *prog);
+
+struct mrsh_word_string *word_string_create(struct mrsh_arena *arena,
+	char *str, bool single_quoted);
+/**
+ * Same as mrsh_word_parameter_create, but takes over a reference to an atom
+ * instead of a string.
+ */
+struct mrsh_word_parameter *word_parameter_create(struct mrsh_arena *arena,
+	const char *name, enum mrsh_word_parameter_op op, bool colon,
+	struct mrsh_word *arg);
+struct mrsh_word_command *word_command_create(struct mrsh_arena *arena,
+	struct mrsh_program *prog, bool back_quoted);
+struct mrsh_word_arithmetic *word_arithmetic_create(struct mrsh_arena *arena,
+	struct mrsh_word *body);
+struct mrsh_word_list *word_list_create(struct mrsh_arena *arena,
+	struct mrsh_array *children, bool double_quoted);
+struct mrsh_simple_command *simple_command_create(struct mrsh_arena *arena,
+	struct mrsh_word *name, struct mrsh_array *arguments,
+	struct mrsh_array *io_redirects, struct mrsh_array *assignments);
+struct mrsh_brace_group *brace_group_create(struct mrsh_arena *arena,
+	struct mrsh_array *body);
+struct mrsh_subshell *subshell_create(struct mrsh_arena *arena,
+	struct mrsh_array *body);
+struct mrsh_if_clause *if_clause_create(struct mrsh_arena *arena,
+	struct mrsh_array *condition, struct mrsh_array *body,
+	struct mrsh_command *else_part);
+struct mrsh_for_clause *for_clause_create(struct mrsh_arena *arena, char *name,
+	bool in, struct mrsh_array *word_list, struct mrsh_array *body);
+struct mrsh_loop_clause *loop_clause_create(struct mrsh_arena *arena,
+	enum mrsh_loop_type type, struct mrsh_array *condition,
+	struct mrsh_array *body);
+struct mrsh_case_clause *case_clause_create(struct mrsh_arena *arena,
+	struct mrsh_word *word, struct mrsh_array *items);
+struct mrsh_function_definition *function_definition_create(
+	struct mrsh_arena *arena, char *name, struct mrsh_command *body,
+	struct mrsh_array *io_redirects);
+struct mrsh_pipeline *pipeline_create(struct mrsh_arena *arena,
+	struct mrsh_array *commands, bool bang);
+struct mrsh_binop *binop_create(struct mrsh_arena *arena,
+	enum mrsh_binop_type type, struct mrsh_and_or_list *left,
+	struct mrsh_and_or_list *right);
+struct mrsh_command_list *command_list_create(struct mrsh_arena *arena);
+struct mrsh_program *program_create(struct mrsh_arena *arena);
+
+struct mrsh_word *word_copy(struct mrsh_arena *arena,
+	const struct mrsh_word *word);
+struct mrsh_io_redirect *io_redirect_copy(struct mrsh_arena *arena,
+	const struct mrsh_io_redirect *redir);
+struct mrsh_assignment *assignment_copy(struct mrsh_arena *arena,
+	const struct mrsh_assignment *assign);
+struct mrsh_command *command_copy(struct mrsh_arena *arena,
+	const struct mrsh_command *cmd);
+struct mrsh_and_or_list *and_or_list_copy(struct mrsh_arena *arena,
+	const struct mrsh_and_or_list *and_or_list);
+struct mrsh_command_list *command_list_copy(struct mrsh_arena *arena,
+	const struct mrsh_command_list *l);
+struct mrsh_program *program_copy(struct mrsh_arena *arena,
+	const struct mrsh_program *prog);
+
+/**
+ * Hands an arena over to a program allocated from it. Destroying the program
+ * then releases the whole arena, instead of destroying each node.
+ */
+void program_set_arena(struct mrsh_program *prog, struct mrsh_arena *arena);
+/**
+ * Sets the line table of a program's source. The program keeps a reference to
+ * it.
+ */
+void program_set_line_table(struct mrsh_program *prog,
+	struct mrsh_line_table *lines);
+/**
+ * Gets the line table of a program's source, NULL if unknown.
+ */
+struct mrsh_line_table *program_get_line_table(
+	const struct mrsh_program *prog);
+/**
+ * What the name of a simple command refers to, cached by the shell running it
+ * so that it isn't looked up each time. It's only valid as long as the
+ * generation matches the shell's.
+ */
+struct mrsh_command_cache {
+	unsigned long generation; // 0 if nothing is cached
+	int type;
+	const void *target;
+};
+
+/**
+ * Gets the command cache of a simple command. It's kept next to the node,
+ * outside of the public struct.
+ */
+struct mrsh_command_cache *simple_command_get_cache(
+	struct mrsh_simple_command *sc);
+/**
+ * Serializes a program into a binary format, which can be loaded back without
+ * parsing the source again. The format depends on the host, it's only meant to
+ * be cached on the machine which wrote it.
+ */
+void program_serialize(const struct mrsh_program *prog,
+	struct mrsh_buffer *buf);
+/**
+ * Loads a program written by program_serialize. All of its nodes are allocated
+ * from an arena owned by the program. Returns NULL if the data is invalid.
+ */
+struct mrsh_program *program_deserialize(const char *data, size_t len);
+/**
+ * Allocates zero-initialized memory from an arena, or from the heap if NULL.
+ */
+void *ast_alloc(struct mrsh_arena *arena, size_t size);
+char *ast_strdup(struct mrsh_arena *arena, const char *str);
+char *ast_strndup(struct mrsh_arena *arena, const char *str, size_t len);
+/**
+ * Same as mrsh_buffer_steal, but copies the data to the arena if any.
+ */
+char *ast_buffer_steal(struct mrsh_arena *arena, struct mrsh_buffer *buf);
+/**
+ * Hands over a reference to an atom to the node being created: it's released
+ * with the arena, or when the node is destroyed if NULL.
+ */
+void ast_own_atom(struct mrsh_arena *arena, const char *atom);
+/**
+ * Frees memory returned by the functions above. This is a no-op for memory
+ * allocated from an arena.
+ */
+void ast_free(struct mrsh_arena *arena, void *ptr);
+/**
+ * Same as mrsh_array_reserve, but allocates from an arena. Such an array must
+ * only grow with ast_array_add.
+ */
+bool ast_array_reserve(struct mrsh_arena *arena, struct mrsh_array *array,
+	size_t cap);
+/**
+ * Same as mrsh_array_add, but grows the array in an arena.
+ */
+ssize_t ast_array_add(struct mrsh_arena *arena, struct mrsh_array *array,
+	void *value);
+/**
+ * Same as mrsh_array_finish, but doesn't free memory allocated from an arena.
+ */
+void ast_array_finish(struct mrsh_arena *arena, struct mrsh_array *array);
+/**
+ * Same as mrsh_word_str, but allocates from an arena.
+ */
+char *ast_word_str(struct mrsh_arena *arena, const struct mrsh_word *word);
 
 #endif
@@ -2,13 +2,60 @@
 #define BUILTIN_H
 
 #include <mrsh/builtin.h>
+#include <stdio.h>
 
 struct mrsh_state;
 
 typedef int (*mrsh_builtin_func)(struct mrsh_state *state,
 	int argc, char *argv[]);
 
+struct builtin {
+	const char *name;
+	mrsh_builtin_func func;
+	bool special;
+	// Whether the builtin only accesses its standard file descriptors with
+	// builtin_fd and builtin_stream, and doesn't run other commands
+	bool virtual_fds;
+};
+
+/**
+ * Returns the builtin utility with the given name, or NULL if there's none.
+ */
+const struct builtin *get_builtin(const char *name);
+
+/**
+ * Redirections of builtins with virtual file descriptors only rebind entries
+ * of a table, instead of duplicating real file descriptors.
+ *
+ * builtin_fd returns the real file descriptor a builtin must use for `fd`.
+ * builtin_stream returns a stream writing to the standard output or error of
+ * a builtin. Output written to a redirected stream is buffered, and written
+ * whenever the buffer is full and when the builtin returns.
+ */
+int builtin_fd(struct mrsh_state *state, int fd);
+FILE *builtin_stream(struct mrsh_state *state, int fd);
+/**
+ * Redirects a file descriptor, which must be lower than BUILTIN_FDS, to a real
+ * one for the next builtin.
+ */
+void builtin_bind_fd(struct mrsh_state *state, int fd, int real_fd);
+/**
+ * Writes the rest of the output of the builtin to its redirections and undoes
+ * them. Returns false if some output couldn't be written.
+ */
+bool builtin_unbind_fds(struct mrsh_state *state);
+
 void print_escaped(const char *value);
+/**
+ * Prints a string, replacing the escape sequences understood by echo and by
+ * the %b conversion of printf. Returns false if output must stop because of
+ * `\c`.
+ */
+bool print_escape_sequences(FILE *f, const char *str);
+/**
+ * Prints the counters of the shell and of the library, one per line.
+ */
+void print_stats(struct mrsh_state *state, FILE *f);
 
 int builtin_alias(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_bg(struct mrsh_state *state, int argc, char *argv[]);
@@ -17,6 +64,7 @@ int builtin_cd(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_command(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_colon(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_dot(struct mrsh_state *state, int argc, char *argv[]);
+int builtin_echo(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_eval(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_exec(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_exit(struct mrsh_state *state, int argc, char *argv[]);
@@ -26,11 +74,14 @@ int builtin_fg(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_getopts(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_hash(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_jobs(struct mrsh_state *state, int argc, char *argv[]);
+int builtin_printf(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_pwd(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_read(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_return(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_set(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_shift(struct mrsh_state *state, int argc, char *argv[]);
+int builtin_stats(struct mrsh_state *state, int argc, char *argv[]);
+int builtin_test(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_times(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_trap(struct mrsh_state *state, int argc, char *argv[]);
 int builtin_true(struct mrsh_state *state, int argc, char *argv[]);
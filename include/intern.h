@@ -0,0 +1,38 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <mrsh/hashtable.h>
+#include <stddef.h>
+
+/**
+ * Interned strings, or atoms, are unique copies of strings: two atoms are equal
+ * if and only if they are the same pointer. Atoms are immutable and carry their
+ * hash as computed by mrsh_hashtable_hash.
+ *
+ * Atoms are reference-counted: intern returns a new reference, and an atom is
+ * removed from the pool once its last reference is released. The pool is
+ * shared by all shells, since the parser and the programs it returns don't
+ * belong to any of them, but it only holds the names still in use.
+ */
+const char *intern(const char *str);
+const char *intern_n(const char *str, size_t len);
+const char *atom_ref(const char *atom);
+/**
+ * Releases a reference to an atom. Does nothing if `atom` is NULL.
+ */
+void atom_unref(const char *atom);
+unsigned int atom_hash(const char *atom);
+
+/**
+ * Same as mrsh_hashtable_get, but looks up an atom. Entries set with
+ * hashtable_set_atom are found by comparing pointers only.
+ */
+void *hashtable_get_atom(struct mrsh_hashtable *table, const char *atom);
+/**
+ * Same as mrsh_hashtable_set, but the key is an atom, which is stored as-is
+ * instead of being copied. The entry takes a reference to it.
+ */
+void *hashtable_set_atom(struct mrsh_hashtable *table, const char *atom,
+	void *value);
+
+#endif
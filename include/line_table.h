@@ -0,0 +1,58 @@
+#ifndef LINE_TABLE_H
+#define LINE_TABLE_H
+
+#include <mrsh/ast.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A line table records the offsets of the newlines of a source, so that line
+ * and column numbers can be recovered from positions when needed instead of
+ * being stored in each node. Offsets are stored like in struct mrsh_position,
+ * plus one.
+ *
+ * Line tables are reference-counted: they are shared between a parser and the
+ * programs and functions parsed from it.
+ */
+struct mrsh_line_table {
+	int ref;
+	uint32_t *newlines; // offsets of newline characters, increasing
+	size_t len, cap;
+	// Newlines before the first recorded one, if older ones have been dropped
+	size_t base_line;
+	uint32_t base; // offset of the last dropped newline, 0 if none
+};
+
+struct mrsh_line_table *line_table_create(void);
+/**
+ * Increments the reference count. Does nothing if `lines` is NULL.
+ */
+struct mrsh_line_table *line_table_ref(struct mrsh_line_table *lines);
+void line_table_unref(struct mrsh_line_table *lines);
+/**
+ * Records a newline at the given offset. Newlines must be added in order.
+ */
+bool line_table_add(struct mrsh_line_table *lines, uint32_t offset);
+/**
+ * Records the newlines of `data`, which begins at source position `offset`.
+ * Data must be scanned in order.
+ */
+void line_table_scan(struct mrsh_line_table *lines, uint32_t offset,
+	const char *data, size_t len);
+/**
+ * Drops the newlines before `offset`, so that the table only covers the source
+ * from there. If the table is shared, a trimmed copy is returned instead and
+ * the caller's reference to `lines` is released, so that the other owners
+ * still see the whole table.
+ */
+struct mrsh_line_table *line_table_trim(struct mrsh_line_table *lines,
+	uint32_t offset);
+/**
+ * Gets the line and column of a position. Positions before the newlines
+ * dropped by line_table_trim have no location. If `lines` is NULL, every position
+ * is assumed to be on the first line.
+ */
+void line_table_lookup(const struct mrsh_line_table *lines,
+	const struct mrsh_position *pos, struct mrsh_location *loc);
+
+#endif
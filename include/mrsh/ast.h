@@ -3,13 +3,24 @@
 
 #include <mrsh/array.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
- * Position describes an arbitrary source position including line and column
- * location.
+ * Position describes an arbitrary source position as a byte offset. Line and
+ * column numbers aren't stored in the AST, they can be obtained with
+ * mrsh_program_location.
+ *
+ * The offset is stored plus one, so that zero-initialized positions are
+ * invalid: the first byte of the source is at offset1 == 1.
  */
 struct mrsh_position {
-	size_t offset; // starting at 0
+	uint32_t offset1; // byte offset plus one, 0 if invalid
+};
+
+/**
+ * Location describes a source position as line and column numbers.
+ */
+struct mrsh_location {
 	int line; // starting at 1
 	int column; // starting at 1
 };
@@ -83,13 +94,31 @@ enum mrsh_word_parameter_op {
 	MRSH_PARAM_DHASH, // `${parameter##[word]}`, Remove Largest Prefix Pattern
 };
 
+/**
+ * The kind of parameter a word parameter refers to, computed from its name.
+ */
+enum mrsh_word_parameter_kind {
+	MRSH_PARAM_KIND_NAME, // a variable
+	MRSH_PARAM_KIND_POSITIONAL, // `$1`, `${10}`, etc.
+	MRSH_PARAM_KIND_AT, // `$@`
+	MRSH_PARAM_KIND_STAR, // `$*`
+	MRSH_PARAM_KIND_HASH, // `$#`, number of positional parameters
+	MRSH_PARAM_KIND_QMARK, // `$?`, last exit status
+	MRSH_PARAM_KIND_MINUS, // `$-`, current options
+	MRSH_PARAM_KIND_DOLLAR, // `$$`, shell process ID
+	MRSH_PARAM_KIND_BANG, // `$!`, last background process ID
+	MRSH_PARAM_KIND_LINENO, // `$LINENO`, a variable defaulting to the line
+};
+
 /**
  * A word parameter is a type of word candidate for parameter expansion. The
  * format is either `$name` or `${expression}`.
  */
 struct mrsh_word_parameter {
 	struct mrsh_word word;
-	char *name;
+	const char *name; // interned, shared with other nodes
+	enum mrsh_word_parameter_kind kind;
+	int position; // only for positional parameters, -1 if out of range
 	enum mrsh_word_parameter_op op;
 	bool colon; // only for -, =, ?, +
 	struct mrsh_word *arg; // can be NULL
@@ -164,7 +193,7 @@ struct mrsh_io_redirect {
  * A variable assignment. The format is: `name=value`.
  */
 struct mrsh_assignment {
-	char *name;
+	const char *name; // interned, shared with other nodes
 	struct mrsh_word *value;
 
 	struct mrsh_range name_range;
@@ -334,11 +363,14 @@ struct mrsh_case_clause {
 struct mrsh_function_definition {
 	struct mrsh_command command;
 	char *name;
-	struct mrsh_command *body;
+	struct mrsh_command *body; // NULL if parsing the body has been deferred
 	struct mrsh_array io_redirects; // struct mrsh_io_redirect *
+	// Source of the body if parsing it has been deferred, NULL otherwise
+	char *body_source;
 
 	struct mrsh_range name_range;
 	struct mrsh_position lparen_pos, rparen_pos;
+	struct mrsh_position body_pos; // only valid if body_source is set
 };
 
 enum mrsh_and_or_list_type {
@@ -408,6 +440,13 @@ typedef void (*mrsh_node_iterator_func)(struct mrsh_node *node,
 	void *user_data);
 
 bool mrsh_position_valid(const struct mrsh_position *pos);
+/**
+ * Gets the line and column of a position in a program returned by the parser.
+ * Positions of programs nested in command substitutions must be looked up in
+ * the outermost program.
+ */
+void mrsh_program_location(const struct mrsh_program *prog,
+	const struct mrsh_position *pos, struct mrsh_location *loc);
 bool mrsh_range_valid(const struct mrsh_range *range);
 
 struct mrsh_word_string *mrsh_word_string_create(char *str,
@@ -38,6 +38,28 @@ void mrsh_source_profile(struct mrsh_state *state);
 /** Sources $ENV. It is recommended to source this in interactive shells. */
 void mrsh_source_env(struct mrsh_state *state);
 
+/**
+ * Loads the program of a script file from the cache of compiled scripts,
+ * skipping parsing. Returns NULL if the cache is disabled or doesn't contain
+ * an up-to-date program for the file. The cache is enabled by setting
+ * $MRSH_CACHE_DIR to a directory, and only holds regular files small enough to
+ * be parsed at once.
+ *
+ * Programs are parsed as a whole, so this is meant for sourced files: a script
+ * run by the shell is parsed line by line, so that aliases and options it sets
+ * apply to the lines after them.
+ *
+ * Entries are looked up by device and inode, and checked against the size,
+ * modification time and a hash of the contents of the file.
+ */
+struct mrsh_program *mrsh_script_cache_load(struct mrsh_state *state, int fd);
+/**
+ * Stores the program parsed from a script file in the cache of compiled
+ * scripts. Does nothing if the cache is disabled.
+ */
+void mrsh_script_cache_store(struct mrsh_state *state, int fd,
+	const struct mrsh_program *prog);
+
 /**
  * Run the trap registered on EXIT. It is recommended to call this function
  * right before exiting the shell.
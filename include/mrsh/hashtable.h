@@ -1,11 +1,14 @@
 #ifndef MRSH_HASHTABLE_H
 #define MRSH_HASHTABLE_H
 
+#include <stdbool.h>
+
 #define MRSH_HASHTABLE_BUCKETS 256
 
 struct mrsh_hashtable_entry {
 	struct mrsh_hashtable_entry *next;
 	unsigned int hash;
+	bool interned; // the key is an atom, not owned by the entry
 	char *key;
 	void *value;
 };
@@ -18,7 +21,14 @@ typedef void (*mrsh_hashtable_iterator_func)(const char *key, void *value,
 	void *user_data);
 
 void mrsh_hashtable_finish(struct mrsh_hashtable *table);
+/**
+ * Returns the hash of a key, which can be computed once and given to
+ * `mrsh_hashtable_get_hashed`.
+ */
+unsigned int mrsh_hashtable_hash(const char *key);
 void *mrsh_hashtable_get(struct mrsh_hashtable *table, const char *key);
+void *mrsh_hashtable_get_hashed(struct mrsh_hashtable *table, const char *key,
+	unsigned int hash);
 void *mrsh_hashtable_set(struct mrsh_hashtable *table, const char *key,
 	void *value);
 void *mrsh_hashtable_del(struct mrsh_hashtable *table, const char *key);
@@ -3,6 +3,7 @@
 
 #include <mrsh/ast.h>
 #include <stdio.h>
+#include <sys/types.h>
 
 struct mrsh_parser;
 struct mrsh_buffer;
@@ -13,6 +14,14 @@ struct mrsh_buffer;
  */
 typedef const char *(*mrsh_parser_alias_func)(const char *name,
 	void *user_data);
+/**
+ * A read callback, called each time the parser needs more input. It should
+ * append data to `buf`, typically a line, and return the number of bytes
+ * appended, 0 on end of file or -1 on error. `continuation` is true when the
+ * line being parsed isn't complete yet, e.g. to print a secondary prompt.
+ */
+typedef ssize_t (*mrsh_parser_read_func)(struct mrsh_buffer *buf,
+	bool continuation, void *user_data);
 
 /**
  * Create a parser from a file descriptor.
@@ -27,6 +36,14 @@ struct mrsh_parser *mrsh_parser_with_data(const char *buf, size_t len);
  * the parser needs input data.
  */
 struct mrsh_parser *mrsh_parser_with_buffer(struct mrsh_buffer *buf);
+/**
+ * Create a parser pulling its input from a callback. Since the parser asks for
+ * more input when a line ends in the middle of a command, the command is
+ * parsed once as it's read, instead of being parsed again from the start with
+ * each continuation line.
+ */
+struct mrsh_parser *mrsh_parser_with_read_func(mrsh_parser_read_func read,
+	void *user_data);
 void mrsh_parser_destroy(struct mrsh_parser *parser);
 /**
  * Parse a complete multi-line program.
@@ -50,12 +67,35 @@ bool mrsh_parser_eof(struct mrsh_parser *parser);
  */
 void mrsh_parser_set_alias_func(struct mrsh_parser *parser,
 	mrsh_parser_alias_func alias, void *user_data);
+/**
+ * Enable or disable lazy parsing of function bodies. When enabled, the body of
+ * a function definition is only skimmed to find where it ends, and is stored
+ * as source text in the definition. Bodies the skimmer isn't sure about are
+ * parsed as usual.
+ */
+void mrsh_parser_set_lazy_function_bodies(struct mrsh_parser *parser,
+	bool lazy);
+/**
+ * Enable or disable arena allocation of parsed programs. When enabled, each
+ * program returned by mrsh_parse_program and mrsh_parse_line owns an arena
+ * which all of its nodes, strings and arrays are allocated from, and which is
+ * released at once by mrsh_program_destroy.
+ *
+ * Such a program must be treated as immutable: its nodes must not be destroyed
+ * or replaced individually, since they don't own their memory. Use
+ * mrsh_program_destroy on the whole program, and copy nodes with the
+ * mrsh_*_copy functions to get heap trees which can be modified freely.
+ *
+ * Disabled by default: each node is then allocated on the heap and owned by
+ * its parent.
+ */
+void mrsh_parser_set_arena(struct mrsh_parser *parser, bool use_arena);
 /**
  * Check if the parser ended with a syntax error. The error message is returned.
- * The error position can optionally be obtained.
+ * The error location can optionally be obtained.
  */
 const char *mrsh_parser_error(struct mrsh_parser *parser,
-	struct mrsh_position *pos);
+	struct mrsh_location *loc);
 /**
  * Check if the input ends on a continuation line.
  */
@@ -55,6 +55,19 @@ enum mrsh_option {
 	// -x: The shell shall write to standard error a trace for each command
 	// after it expands the command and before it executes it.
 	MRSH_OPT_XTRACE = 1 << 13,
+	// -o lazyfuncs: Defer parsing the bodies of function definitions until
+	// they're called. Syntax errors in function bodies are only reported when
+	// the function is called, and aliases are expanded at that time.
+	MRSH_OPT_LAZYFUNCS = 1 << 14,
+	// -o profile: Record the time spent in each function and each command,
+	// and write a report when the shell exits. The report is written to the
+	// file named by $MRSH_PROFILE, or to the standard error. It includes what
+	// child processes of the shell run, e.g. functions in pipelines.
+	MRSH_OPT_PROFILE = 1 << 15,
+	// -o stats: Write the counters reported by the stats utility to the
+	// standard error when the shell exits. Counters are per process, they
+	// don't include what child processes of the shell do.
+	MRSH_OPT_STATS = 1 << 16,
 };
 
 enum mrsh_variable_attrib {
@@ -63,12 +76,30 @@ enum mrsh_variable_attrib {
 	MRSH_VAR_ATTRIB_READONLY = 1 << 1,
 };
 
+struct mrsh_args;
+
+/**
+ * A call frame holds the positional parameters. These are stored in a
+ * reference-counted array which can be shared between call frames, and should
+ * be read with mrsh_call_frame_nargs and mrsh_call_frame_get_arg.
+ */
 struct mrsh_call_frame {
-	char **argv;
-	int argc;
+	char *argv_0; // $0
+	struct mrsh_args *args; // can be NULL if there are no parameters
+	int args_offset;
 	struct mrsh_call_frame *prev;
 };
 
+/**
+ * Returns the number of positional parameters, ie. $#.
+ */
+int mrsh_call_frame_nargs(struct mrsh_call_frame *frame);
+/**
+ * Returns the positional parameter `i`, or NULL if it's unset. $0 is returned
+ * for `i == 0`.
+ */
+const char *mrsh_call_frame_get_arg(struct mrsh_call_frame *frame, int i);
+
 struct mrsh_state {
 	int exit;
 	uint32_t options; // enum mrsh_option
@@ -103,4 +134,15 @@ bool mrsh_set_job_control(struct mrsh_state *state, bool enabled);
  */
 void mrsh_destroy_terminated_jobs(struct mrsh_state *state);
 
+struct mrsh_parse_cache_stats {
+	size_t hits, misses;
+};
+
+/**
+ * Get the number of hits and misses of the cache of programs parsed by the
+ * eval and dot builtins.
+ */
+void mrsh_get_parse_cache_stats(struct mrsh_state *state,
+	struct mrsh_parse_cache_stats *stats);
+
 #endif
@@ -5,6 +5,9 @@
 #include <mrsh/buffer.h>
 #include <mrsh/parser.h>
 
+struct mrsh_arena;
+struct mrsh_line_table;
+
 enum symbol_name {
 	EOF_TOKEN,
 	TOKEN,
@@ -37,16 +40,44 @@ extern const struct symbol operators[];
 extern const size_t operators_len;
 extern const size_t operators_max_str_len;
 
-extern const char *keywords[];
-extern const size_t keywords_len;
+enum char_class {
+	CHAR_BLANK = 1 << 0,
+	CHAR_OPERATOR_START = 1 << 1,
+	// Ends a word without special meaning: blanks, operators and the end of
+	// the line or of a subshell
+	CHAR_WORD_END = 1 << 2,
+	// Starts a quoted part or an expansion
+	CHAR_WORD_SPECIAL = 1 << 3,
+};
+
+/**
+ * Classes of each character, a combination of enum char_class flags.
+ */
+extern const unsigned char char_classes[256];
+
+/**
+ * An alias being substituted. Replacement texts are read from the start of the
+ * parser's buffer, before the rest of the input: the innermost alias comes
+ * first.
+ */
+struct parser_alias {
+	char *name;
+	size_t len; // replacement text left to read
+	bool trailing_blank; // whether the replacement ends with a blank
+};
 
 struct mrsh_parser {
 	int fd; // can be -1
 	struct mrsh_buffer *in_buf; // can be NULL
+	mrsh_parser_read_func read; // can be NULL
+	void *read_user_data;
 	bool eof;
+	bool line_begun; // whether input has been read for the current line
 
-	struct mrsh_buffer buf; // internal read buffer
+	struct mrsh_buffer buf; // internal read buffer, starting at the lookahead
+	size_t buf_offset; // data consumed from the start of buf's allocation
 	struct mrsh_position pos;
+	struct mrsh_line_table *lines; // newlines of the input read so far
 
 	struct {
 		char *msg;
@@ -61,6 +92,14 @@ struct mrsh_parser {
 
 	mrsh_parser_alias_func alias;
 	void *alias_user_data;
+	struct mrsh_array aliases; // struct parser_alias *, innermost last
+	size_t alias_len; // replacement text at the start of buf
+	bool alias_blank; // whether an alias ending with a blank was just read
+
+	bool lazy_function_bodies;
+	bool use_arena; // whether parsed programs own an arena
+	// The arena nodes are allocated from while parsing, NULL for the heap
+	struct mrsh_arena *arena;
 
 	int arith_nested_parens;
 };
@@ -68,6 +107,23 @@ struct mrsh_parser {
 typedef struct mrsh_word *(*word_func)(struct mrsh_parser *parser, char end);
 
 size_t parser_peek(struct mrsh_parser *parser, char *buf, size_t size);
+/**
+ * Returns the length of the longest prefix of `data` which contains none of
+ * the characters of `delims`, nor NUL characters. At most 16 delimiters are
+ * supported.
+ */
+size_t scan_span(const char *data, size_t len, const char *delims);
+/**
+ * Consumes the input up to the next delimiter, see scan_span, and appends it
+ * to `buf` unless NULL. Returns the number of characters consumed.
+ */
+size_t parser_read_span(struct mrsh_parser *parser, const char *delims,
+	struct mrsh_buffer *buf);
+/**
+ * Moves the lookahead back to the start of the buffer's allocation. Must be
+ * called before growing the buffer.
+ */
+void parser_compact_buffer(struct mrsh_parser *parser);
 char parser_peek_char(struct mrsh_parser *parser);
 size_t parser_read(struct mrsh_parser *parser, char *buf, size_t size);
 char parser_read_char(struct mrsh_parser *parser);
@@ -77,10 +133,35 @@ bool expect_token(struct mrsh_parser *parser, const char *str,
 	struct mrsh_range *range);
 char *read_token(struct mrsh_parser *parser, size_t len,
 	struct mrsh_range *range);
+/**
+ * Same as read_token, but returns a new reference to an atom.
+ */
+const char *read_name(struct mrsh_parser *parser, size_t len,
+	struct mrsh_range *range);
 void read_continuation_line(struct mrsh_parser *parser);
+/**
+ * Substitutes an alias: its replacement text is read before the rest of the
+ * input. Takes ownership of `name`.
+ */
+void parser_push_alias(struct mrsh_parser *parser, char *name,
+	const char *repl);
+/**
+ * Checks whether an alias is being substituted, in which case it must not be
+ * substituted again.
+ */
+bool parser_alias_active(struct mrsh_parser *parser, const char *name);
+/**
+ * Checks whether the replacement of an alias ending with a blank has just been
+ * read, in which case the next word must be checked for aliases too.
+ */
+bool parser_alias_ends_with_blank(struct mrsh_parser *parser);
 void parser_set_error(struct mrsh_parser *parser, const char *msg);
 void parser_begin(struct mrsh_parser *parser);
 bool is_operator_start(char c);
+/**
+ * Checks whether a string is a reserved word.
+ */
+bool is_keyword(const char *str, size_t len);
 enum symbol_name get_symbol(struct mrsh_parser *parser);
 /**
  * Invalidates the current symbol. Should be used each time manual
@@ -101,4 +182,23 @@ struct mrsh_word *word(struct mrsh_parser *parser, char end);
 struct mrsh_word *arithmetic_word(struct mrsh_parser *parser, char end);
 struct mrsh_word *parameter_expansion_word(struct mrsh_parser *parser);
 
+/**
+ * Moves the parser to a position of another source, described by `lines`. Used
+ * to parse a piece of a source separately, e.g. a deferred function body.
+ */
+void parser_set_position(struct mrsh_parser *parser,
+	const struct mrsh_position *pos, struct mrsh_line_table *lines);
+/**
+ * Finds the end of the brace group or subshell at the start of the input,
+ * without parsing it. Nothing is consumed. Returns its length, or 0 if it
+ * can't be found reliably.
+ */
+size_t skim_compound_command(struct mrsh_parser *parser);
+/**
+ * Parses the body of a function definition whose parsing was deferred. Nodes
+ * are allocated from `arena`.
+ */
+struct mrsh_command *parse_function_body(struct mrsh_parser *parser,
+	struct mrsh_arena *arena);
+
 #endif
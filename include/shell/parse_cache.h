@@ -0,0 +1,66 @@
+#ifndef SHELL_PARSE_CACHE_H
+#define SHELL_PARSE_CACHE_H
+
+#include <mrsh/hashtable.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PARSE_CACHE_CAP 32
+// Larger files are executed as they're parsed, without being cached
+#define PARSE_CACHE_MAX_FILE_SIZE (1024 * 1024)
+// Longer sources given to eval are parsed each time, so that the cache holds a
+// bounded amount of memory
+#define PARSE_CACHE_MAX_SOURCE_SIZE 4096
+
+struct mrsh_program;
+
+struct mrsh_parse_cache_entry {
+	struct mrsh_parse_cache_entry *prev, *next; // most recently used first
+	char *key;
+	struct mrsh_program *program;
+	bool lazy_function_bodies; // whether function bodies were left unparsed
+	// Programs are only read while they run, but may be evicted meanwhile if
+	// they use the cache themselves, so entries are reference-counted
+	int ref;
+};
+
+/**
+ * A cache of parsed programs, bounded to PARSE_CACHE_CAP entries. The least
+ * recently used entry is evicted when the cache is full.
+ *
+ * Keys are either the source text itself, or a string identifying a file and
+ * its version (see parse_cache_file_key).
+ */
+struct mrsh_parse_cache {
+	struct mrsh_hashtable entries; // struct mrsh_parse_cache_entry *
+	struct mrsh_parse_cache_entry *head, *tail;
+	size_t len;
+	size_t hits, misses;
+};
+
+void parse_cache_finish(struct mrsh_parse_cache *cache);
+/**
+ * Looks up a program and marks it as most recently used. Returns a new
+ * reference to its entry, or NULL on a miss. Programs parsed with another
+ * function body parsing mode are misses.
+ */
+struct mrsh_parse_cache_entry *parse_cache_get(struct mrsh_parse_cache *cache,
+	const char *key, bool lazy_function_bodies);
+/**
+ * Adds a program to the cache, which takes ownership of it. Returns a new
+ * reference to its entry, or NULL on error in which case the caller keeps
+ * ownership of the program.
+ */
+struct mrsh_parse_cache_entry *parse_cache_add(struct mrsh_parse_cache *cache,
+	const char *key, struct mrsh_program *program, bool lazy_function_bodies);
+void parse_cache_entry_unref(struct mrsh_parse_cache_entry *entry);
+/**
+ * Returns a key identifying the contents of a regular file: its device, inode,
+ * size and modification and change times. Returns NULL if the file isn't a
+ * regular file or is larger than PARSE_CACHE_MAX_FILE_SIZE.
+ *
+ * Keys for files never end with a newline, unlike sources.
+ */
+char *parse_cache_file_key(int fd);
+
+#endif
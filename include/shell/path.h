@@ -12,6 +12,12 @@
  */
 char *expand_path(struct mrsh_state *state, const char *file, bool exec,
 	bool default_path);
+/* Searches $PATH for an executable utility like expand_path, and remembers its
+ * location for the next searches. Returns NULL if not found. The location is
+ * owned by the shell and is valid until the locations are forgotten, see
+ * forget_utilities. Names containing a slash are returned as-is.
+ */
+const char *find_utility(struct mrsh_state *state, const char *name);
 /* Like getcwd, but returns allocated memory */
 char *current_working_dir(void);
 
@@ -21,6 +21,11 @@ struct mrsh_process {
 	int signal; // only valid if stopped is true
 };
 
+/**
+ * Forks the shell. Output buffered by the shell is written beforehand,
+ * otherwise the child process would write it too.
+ */
+pid_t fork_process(struct mrsh_state *state);
 /**
  * Register a new process.
  */
@@ -0,0 +1,97 @@
+#ifndef SHELL_PROFILE_H
+#define SHELL_PROFILE_H
+
+#include <mrsh/ast.h>
+#include <mrsh/hashtable.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+struct mrsh_context;
+struct mrsh_state;
+
+/**
+ * Resources used by the shell and its waited-for children. Times are in
+ * nanoseconds.
+ */
+struct profile_sample {
+	uint64_t wall, cpu;
+	unsigned long forks, execs;
+};
+
+/**
+ * Statistics of a function, of a command at a given line, or of a stack of
+ * functions. Self statistics exclude nested commands and function calls, total
+ * ones include them.
+ */
+struct profile_entry {
+	char *name;
+	unsigned long calls;
+	int depth; // number of frames running, to count recursive calls once
+	struct profile_sample self, total;
+};
+
+/**
+ * A function or a command being run. Frames are allocated on the stack of the
+ * function they profile.
+ */
+struct profile_frame {
+	struct profile_frame *parent;
+	struct profile_frame *function; // innermost function frame
+	struct profile_entry *entry;
+	struct profile_entry *stack; // only for function frames
+	struct profile_sample begin, children;
+};
+
+/**
+ * A profile of the shell, from the first time the profile option is set until
+ * the shell exits. Commands run by child processes, e.g. in pipelines, are
+ * accounted to the command which waits for them.
+ *
+ * Child processes start with an empty copy of the profile. When they exit,
+ * they append their entries to the records file, which is merged into the
+ * profile before it's written. Their time overlaps with the time the shell
+ * spends waiting for them.
+ */
+struct mrsh_profile {
+	pid_t pid; // of the shell the profile belongs to
+	FILE *records; // entries of child processes, may be NULL
+	struct mrsh_hashtable functions; // struct profile_entry *
+	struct mrsh_hashtable commands; // struct profile_entry *
+	struct mrsh_hashtable stacks; // struct profile_entry *
+	struct profile_frame root; // the top-level function, "main"
+	struct profile_frame *current;
+	// Resources used by child processes, summed from their records
+	struct profile_sample children;
+};
+
+/**
+ * Starts profiling a command, a pipeline or a command substitution. Returns
+ * false if profiling is disabled, in which case profile_leave must not be
+ * called.
+ */
+bool profile_enter_command(struct mrsh_context *ctx,
+	struct profile_frame *frame, struct mrsh_command *cmd);
+bool profile_enter_pipeline(struct mrsh_context *ctx,
+	struct profile_frame *frame, struct mrsh_pipeline *pl);
+bool profile_enter_word_command(struct mrsh_context *ctx,
+	struct profile_frame *frame, struct mrsh_word_command *wc);
+/**
+ * Starts profiling a function call.
+ */
+bool profile_enter_function(struct mrsh_state *state,
+	struct profile_frame *frame, const char *name);
+void profile_leave(struct mrsh_state *state, struct profile_frame *frame);
+/**
+ * Writes the profile, if any, and releases it. The report is written to the
+ * file named by $MRSH_PROFILE, or to the standard error. If
+ * $MRSH_PROFILE_FORMAT is "collapsed", stacks of functions are written in the
+ * format expected by flame graph tools instead.
+ */
+void profile_finish(struct mrsh_state *state);
+/**
+ * Must be called in child processes right after they've been forked.
+ */
+void profile_init_child(struct mrsh_state *state);
+
+#endif
@@ -2,7 +2,9 @@
 #define SHELL_REDIR_H
 
 #include <mrsh/ast.h>
+#include <mrsh/shell.h>
 
-int process_redir(const struct mrsh_io_redirect *redir, int *redir_fd);
+int process_redir(struct mrsh_state *state,
+	const struct mrsh_io_redirect *redir, int *redir_fd);
 
 #endif
@@ -2,8 +2,12 @@
 #define SHELL_SHELL_H
 
 #include <mrsh/shell.h>
+#include <stdio.h>
 #include <termios.h>
+#include "arena.h"
 #include "job.h"
+#include "line_table.h"
+#include "shell/parse_cache.h"
 #include "process.h"
 #include "shell/trap.h"
 
@@ -12,8 +16,19 @@ struct mrsh_variable {
 	uint32_t attribs; // enum mrsh_variable_attrib
 };
 
+/**
+ * A function is reference-counted: while it runs, the call keeps a reference
+ * so that the body can redefine or unset it.
+ */
 struct mrsh_function {
-	struct mrsh_command *body;
+	int ref;
+	struct mrsh_command *body; // NULL until parsed if parsing was deferred
+	struct mrsh_line_table *lines; // of the source, can be NULL
+	// Source of the body if parsing it was deferred, NULL once parsed
+	char *body_source;
+	struct mrsh_position body_pos;
+	// Arena the body is allocated from once parsed, if parsing was deferred
+	struct mrsh_arena *arena;
 };
 
 enum mrsh_branch_control {
@@ -23,6 +38,16 @@ enum mrsh_branch_control {
 	MRSH_BRANCH_EXIT,
 };
 
+/**
+ * An array of positional parameters. It's reference-counted so that call
+ * frames can share it, and must not be modified while it's shared.
+ */
+struct mrsh_args {
+	char **argv;
+	int argc;
+	int ref;
+};
+
 struct mrsh_call_frame_priv {
 	struct mrsh_call_frame pub;
 
@@ -36,6 +61,33 @@ struct mrsh_trap {
 	struct mrsh_program *program;
 };
 
+#define BUILTIN_FDS 10
+
+/**
+ * A file descriptor as seen by a builtin which supports virtual redirections,
+ * see builtin_fd.
+ */
+struct builtin_fd {
+	bool bound;
+	int fd; // the real file descriptor, if bound
+	// Buffered output to the file descriptor, if bound
+	FILE *stream;
+};
+
+/**
+ * Counters of the work done by a shell process, reported by the stats builtin.
+ * Child processes start with the counters of their parent, and what they do
+ * isn't counted by it, e.g. substitutions run by a command of a pipeline.
+ */
+struct shell_stats {
+	unsigned long forks, execs;
+	unsigned long pipes;
+	unsigned long substitutions; // command substitutions
+	unsigned long here_documents;
+	unsigned long globs; // fields expanded as pathname patterns
+	size_t peak_jobs;
+};
+
 struct mrsh_state_priv {
 	struct mrsh_state pub;
 
@@ -44,6 +96,12 @@ struct mrsh_state_priv {
 	struct mrsh_hashtable aliases; // char *
 	struct mrsh_hashtable variables; // struct mrsh_variable *
 	struct mrsh_hashtable functions; // struct mrsh_function *
+	// Locations of utilities found in $PATH, see the hash utility
+	struct mrsh_hashtable utilities; // char *
+	bool relative_utilities; // whether some locations are relative paths
+	// Changes each time a command name may refer to something else, which
+	// invalidates the command caches of simple commands
+	unsigned long command_generation;
 
 	bool job_control;
 	pid_t pgid;
@@ -53,6 +111,24 @@ struct mrsh_state_priv {
 
 	struct mrsh_trap traps[MRSH_NSIG];
 
+	// Current snapshot, if a subshell is running without forking
+	struct mrsh_snapshot *snapshot;
+
+	// Expansion results, released when the current simple command completes
+	struct mrsh_arena arena;
+
+	// Programs parsed by eval and the dot builtin
+	struct mrsh_parse_cache parse_cache;
+
+	// Redirections of the builtin being run, if it supports virtual ones
+	struct builtin_fd builtin_fds[BUILTIN_FDS];
+
+	struct shell_stats stats;
+	// Created when the profile option is first set
+	struct mrsh_profile *profile;
+	// Set when $MRSH_TRACE names a file
+	struct mrsh_trace *trace;
+
 	// TODO: move this to context
 	bool child; // true if we're not the main shell process
 };
@@ -68,14 +144,57 @@ struct mrsh_context {
 	struct mrsh_job *job;
 	// When executing an asynchronous list, this is set to true
 	bool background;
+	// Line table of the source of the commands being executed, can be NULL
+	struct mrsh_line_table *lines;
+	// The arena words are expanded into, NULL for the heap
+	struct mrsh_arena *arena;
 };
 
-void function_destroy(struct mrsh_function *fn);
+void variable_destroy(struct mrsh_variable *var);
+struct mrsh_function *function_ref(struct mrsh_function *fn);
+void function_unref(struct mrsh_function *fn);
+
+/**
+ * Creates a new array of positional parameters. The array takes ownership of
+ * the strings in `argv`, but not of `argv` itself.
+ */
+struct mrsh_args *args_create(int argc, char *argv[]);
+struct mrsh_args *args_ref(struct mrsh_args *args);
+void args_unref(struct mrsh_args *args);
 
 struct mrsh_call_frame_priv *call_frame_get_priv(struct mrsh_call_frame *frame);
+/**
+ * Replaces the positional parameters. A reference to `args` is taken.
+ */
+void call_frame_set_args(struct mrsh_call_frame *frame,
+	struct mrsh_args *args, int offset);
+/**
+ * Removes the `n` first positional parameters. `n` must not be greater than
+ * the number of positional parameters.
+ */
+void call_frame_shift(struct mrsh_call_frame *frame, int n);
 
 struct mrsh_state_priv *state_get_priv(struct mrsh_state *state);
-void push_frame(struct mrsh_state *state, int argc, const char *argv[]);
+/**
+ * Pushes a new call frame, with $0 set to `argv_0` and positional parameters
+ * starting at `offset` in `args`. A reference to `args` is taken.
+ */
+void push_frame(struct mrsh_state *state, const char *argv_0,
+	struct mrsh_args *args, int offset);
 void pop_frame(struct mrsh_state *state);
+/**
+ * Invalidates the command caches of simple commands. Must be called when
+ * functions are defined or removed.
+ */
+void invalidate_commands(struct mrsh_state *state);
+/**
+ * Forgets the locations of utilities, e.g. when $PATH changes.
+ */
+void forget_utilities(struct mrsh_state *state);
+/**
+ * Must be called when the current working directory changes, since locations
+ * found in relative $PATH entries aren't valid anymore.
+ */
+void forget_relative_utilities(struct mrsh_state *state);
 
 #endif
@@ -0,0 +1,60 @@
+#ifndef SHELL_SNAPSHOT_H
+#define SHELL_SNAPSHOT_H
+
+#include <mrsh/hashtable.h>
+#include <mrsh/shell.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "shell/shell.h"
+
+/**
+ * A snapshot of the shell state, used to run subshells without forking.
+ *
+ * Variables, functions and aliases are copied on write: the first time an
+ * entry is modified while the snapshot is active, its previous value is moved
+ * into the snapshot instead of being destroyed. Restoring the snapshot puts
+ * these values back.
+ */
+struct mrsh_snapshot {
+	struct mrsh_snapshot *prev;
+
+	// Previous values, as struct mrsh_snapshot_entry *
+	struct mrsh_hashtable variables;
+	struct mrsh_hashtable functions;
+	struct mrsh_hashtable aliases;
+
+	uint32_t options;
+	mode_t umask;
+	int cwd_fd;
+	bool null_stdin;
+	int stdin_fd; // -1 if stdin was closed
+
+	struct mrsh_call_frame *frame;
+	enum mrsh_branch_control branch_control;
+	int nloops;
+	struct mrsh_args *args;
+	int args_offset;
+};
+
+/**
+ * Saves the shell state and makes the snapshot current. If `null_stdin` is
+ * set, stdin is replaced by /dev/null until the snapshot is restored. Returns
+ * false on error, in which case the snapshot isn't current.
+ */
+bool snapshot_save(struct mrsh_state *state, struct mrsh_snapshot *snapshot,
+	bool null_stdin);
+/**
+ * Restores the shell state saved in the current snapshot.
+ */
+void snapshot_restore(struct mrsh_state *state,
+	struct mrsh_snapshot *snapshot);
+/**
+ * Must be called with the previous value when an entry of `table` (one of the
+ * variables, functions or aliases tables) is overwritten or deleted. Returns
+ * true if the current snapshot took ownership of the value, false if the
+ * caller should destroy it.
+ */
+bool snapshot_keep(struct mrsh_state *state, struct mrsh_hashtable *table,
+	const char *key, void *value);
+
+#endif
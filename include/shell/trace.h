@@ -0,0 +1,70 @@
+#ifndef SHELL_TRACE_H
+#define SHELL_TRACE_H
+
+#include <mrsh/ast.h>
+#include <mrsh/buffer.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define TRACE_BUFFER_SIZE 65536
+
+struct mrsh_state;
+
+/**
+ * A trace of the shell and of its child processes, in the Chrome trace event
+ * format. Tracing is enabled by setting $MRSH_TRACE to the path of a file.
+ *
+ * Each process buffers its events and appends them to the file when the
+ * buffer is full, before forking or executing a utility and when it exits. The
+ * file is a JSON array which is never closed, as allowed by the format, so that
+ * processes can write to it in any order. It isn't truncated: "[" is only
+ * written if it's empty.
+ */
+struct mrsh_trace {
+	int fd;
+	pid_t pid; // of the process writing the buffer
+	struct mrsh_buffer buf;
+};
+
+/**
+ * Starts, stops or redirects tracing, when $MRSH_TRACE changes. `path` is its
+ * new value, or NULL if it's been unset.
+ */
+void trace_update(struct mrsh_state *state, const char *path);
+/**
+ * Writes buffered events to the trace file.
+ */
+void trace_flush(struct mrsh_state *state);
+void trace_finish(struct mrsh_state *state);
+/**
+ * Must be called in child processes right after they've been forked.
+ */
+void trace_init_child(struct mrsh_state *state);
+
+/**
+ * Returns the time at which an event begins, or 0 if tracing is disabled.
+ */
+uint64_t trace_begin(struct mrsh_state *state);
+/**
+ * Records that the shell forked a process to run `node`, which can be NULL.
+ */
+void trace_fork(struct mrsh_state *state, pid_t pid, struct mrsh_node *node);
+/**
+ * Records that the process is about to execute a utility. Buffered events are
+ * written, since they'd be lost otherwise.
+ */
+void trace_exec(struct mrsh_state *state, const char *path, char **argv);
+/**
+ * Records a wait for a process which began at `begin`, and its status as
+ * returned by waitpid.
+ */
+void trace_wait(struct mrsh_state *state, uint64_t begin, pid_t pid,
+	int stat);
+/**
+ * Records a builtin or a function call which began at `begin`. `category` is
+ * either "builtin" or "function".
+ */
+void trace_command(struct mrsh_state *state, uint64_t begin,
+	const char *category, int argc, char **argv);
+
+#endif
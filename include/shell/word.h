@@ -3,28 +3,45 @@
 
 #include <mrsh/shell.h>
 
+struct mrsh_arena;
+
+/*
+ * The functions below allocate the words and strings they create from `arena`,
+ * or from the heap if NULL. See ast.h.
+ */
+
 /**
  * Performs tilde expansion. It leaves the word as-is in case of error.
  */
-void expand_tilde(struct mrsh_state *state, struct mrsh_word **word_ptr,
-	bool assignment);
+void expand_tilde(struct mrsh_state *state, struct mrsh_arena *arena,
+	struct mrsh_word **word_ptr, bool assignment);
 /**
  * Performs field splitting on `word`, writing fields to `fields`. This should
  * be done after expansions/substitutions.
  */
-void split_fields(struct mrsh_array *fields, const struct mrsh_word *word,
-	const char *ifs);
-void get_fields_str(struct mrsh_array *strs, const struct mrsh_array *fields);
+void split_fields(struct mrsh_arena *arena, struct mrsh_array *fields,
+	const struct mrsh_word *word, const char *ifs);
+/**
+ * Converts each field to a string.
+ */
+void get_fields_str(struct mrsh_arena *arena, struct mrsh_array *strs,
+	const struct mrsh_array *fields);
 /**
  * Convert a word to a pattern. Returns NULL if word doesn't contain any
- * special pattern character (ie. requires an exact match).
+ * special pattern character (ie. requires an exact match). The pattern must be
+ * free'd with ast_free.
+ */
+char *word_to_pattern(struct mrsh_arena *arena, const struct mrsh_word *word);
+/**
+ * Checks whether `word` is exactly "$@", ie. expands to the positional
+ * parameters without any modification.
  */
-char *word_to_pattern(const struct mrsh_word *word);
+bool is_quoted_at_sign(const struct mrsh_word *word);
 /**
  * Performs pathname expansion on each item in `fields`.
  */
-bool expand_pathnames(struct mrsh_array *expanded,
-	const struct mrsh_array *fields);
+bool expand_pathnames(struct mrsh_state *state, struct mrsh_arena *arena,
+	struct mrsh_array *expanded, const struct mrsh_array *fields);
 
 
 #endif
@@ -0,0 +1,17 @@
+#ifndef STATS_H
+#define STATS_H
+
+/**
+ * Counters of the work done by the library in this process. They're shared by
+ * all shells, since the parser and the AST don't belong to any of them.
+ */
+struct lib_stats {
+	unsigned long parse_bytes; // read by parsers
+	unsigned long hashtable_probes; // lookups, insertions and deletions
+	unsigned long ast_copies; // commands copied
+	unsigned long allocations; // AST nodes, strings and expansion results
+};
+
+extern struct lib_stats lib_stats;
+
+#endif
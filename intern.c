@@ -0,0 +1,151 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+#define INITIAL_CAP 256
+
+struct atom {
+	unsigned int hash;
+	size_t ref;
+	size_t len;
+	char str[];
+};
+
+/**
+ * Open-addressing table of atoms, at most half full. It's freed once the last
+ * atom is released.
+ */
+static struct {
+	struct atom **slots;
+	size_t len, cap; // cap is a power of two
+} pool = {0};
+
+// Same as the hash used by mrsh_hashtable, but bounded by a length
+static unsigned int hash_n(const char *str, size_t len) {
+	unsigned int hash = 5381;
+	for (size_t i = 0; i < len; ++i) {
+		hash = ((hash << 5) + hash) + str[i];
+	}
+	return hash;
+}
+
+static struct atom **find_slot(struct atom **slots, size_t cap,
+		const char *str, size_t len, unsigned int hash) {
+	size_t i = hash & (cap - 1);
+	while (slots[i] != NULL) {
+		struct atom *atom = slots[i];
+		if (atom->hash == hash && atom->len == len &&
+				memcmp(atom->str, str, len) == 0) {
+			break;
+		}
+		i = (i + 1) & (cap - 1);
+	}
+	return &slots[i];
+}
+
+static bool pool_grow(void) {
+	size_t cap = pool.cap == 0 ? INITIAL_CAP : 2 * pool.cap;
+	struct atom **slots = calloc(cap, sizeof(struct atom *));
+	if (slots == NULL) {
+		return false;
+	}
+
+	for (size_t i = 0; i < pool.cap; ++i) {
+		struct atom *atom = pool.slots[i];
+		if (atom != NULL) {
+			*find_slot(slots, cap, atom->str, atom->len, atom->hash) = atom;
+		}
+	}
+
+	free(pool.slots);
+	pool.slots = slots;
+	pool.cap = cap;
+	return true;
+}
+
+const char *intern_n(const char *str, size_t len) {
+	if (2 * (pool.len + 1) > pool.cap && !pool_grow()) {
+		return NULL;
+	}
+
+	unsigned int hash = hash_n(str, len);
+	struct atom **slot = find_slot(pool.slots, pool.cap, str, len, hash);
+	if (*slot != NULL) {
+		++(*slot)->ref;
+		return (*slot)->str;
+	}
+
+	struct atom *atom = malloc(sizeof(struct atom) + len + 1);
+	if (atom == NULL) {
+		return NULL;
+	}
+	atom->hash = hash;
+	atom->ref = 1;
+	atom->len = len;
+	memcpy(atom->str, str, len);
+	atom->str[len] = '\0';
+
+	*slot = atom;
+	++pool.len;
+	return atom->str;
+}
+
+const char *intern(const char *str) {
+	return intern_n(str, strlen(str));
+}
+
+static struct atom *get_atom(const char *str) {
+	return (struct atom *)(str - offsetof(struct atom, str));
+}
+
+const char *atom_ref(const char *str) {
+	++get_atom(str)->ref;
+	return str;
+}
+
+/**
+ * Removes the atom in slot `i`, moving the atoms probed after it so that
+ * lookups don't stop at the hole.
+ */
+static void pool_remove(size_t i) {
+	size_t mask = pool.cap - 1;
+	pool.slots[i] = NULL;
+	for (size_t j = (i + 1) & mask; pool.slots[j] != NULL; j = (j + 1) & mask) {
+		// The atom can be moved to the hole if its home slot isn't between the
+		// hole and its current slot
+		size_t home = pool.slots[j]->hash & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			pool.slots[i] = pool.slots[j];
+			pool.slots[j] = NULL;
+			i = j;
+		}
+	}
+}
+
+void atom_unref(const char *str) {
+	if (str == NULL) {
+		return;
+	}
+	struct atom *atom = get_atom(str);
+	if (--atom->ref > 0) {
+		return;
+	}
+
+	struct atom **slot =
+		find_slot(pool.slots, pool.cap, atom->str, atom->len, atom->hash);
+	pool_remove(slot - pool.slots);
+	free(atom);
+
+	--pool.len;
+	if (pool.len == 0) {
+		free(pool.slots);
+		pool.slots = NULL;
+		pool.cap = 0;
+	}
+}
+
+unsigned int atom_hash(const char *str) {
+	return get_atom(str)->hash;
+}
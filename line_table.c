@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <string.h>
+#include "line_table.h"
+
+#define INITIAL_CAP 64
+
+struct mrsh_line_table *line_table_create(void) {
+	struct mrsh_line_table *lines = calloc(1, sizeof(struct mrsh_line_table));
+	if (lines == NULL) {
+		return NULL;
+	}
+	lines->ref = 1;
+	return lines;
+}
+
+struct mrsh_line_table *line_table_ref(struct mrsh_line_table *lines) {
+	if (lines != NULL) {
+		++lines->ref;
+	}
+	return lines;
+}
+
+void line_table_unref(struct mrsh_line_table *lines) {
+	if (lines == NULL) {
+		return;
+	}
+	--lines->ref;
+	if (lines->ref > 0) {
+		return;
+	}
+	free(lines->newlines);
+	free(lines);
+}
+
+bool line_table_add(struct mrsh_line_table *lines, uint32_t offset) {
+	uint32_t last = lines->len > 0 ? lines->newlines[lines->len - 1] : lines->base;
+	if (last >= offset) {
+		// The parser input has been rewritten, e.g. by an alias
+		return true;
+	}
+
+	if (lines->len == lines->cap) {
+		size_t new_cap = 2 * lines->cap;
+		if (new_cap < INITIAL_CAP) {
+			new_cap = INITIAL_CAP;
+		}
+		uint32_t *new_newlines =
+			realloc(lines->newlines, new_cap * sizeof(uint32_t));
+		if (new_newlines == NULL) {
+			return false;
+		}
+		lines->newlines = new_newlines;
+		lines->cap = new_cap;
+	}
+
+	lines->newlines[lines->len++] = offset;
+	return true;
+}
+
+void line_table_scan(struct mrsh_line_table *lines, uint32_t offset,
+		const char *data, size_t len) {
+	if (lines == NULL) {
+		return;
+	}
+
+	if (offset == 0) {
+		return; // positions aren't tracked anymore
+	}
+
+	const char *end = data + len;
+	const char *p = data;
+	while ((p = memchr(p, '\n', end - p)) != NULL) {
+		if ((size_t)(p - data) > UINT32_MAX - offset) {
+			return; // past the last position which can be represented
+		}
+		if (!line_table_add(lines, offset + (uint32_t)(p - data))) {
+			return;
+		}
+		++p;
+	}
+}
+
+struct mrsh_line_table *line_table_trim(struct mrsh_line_table *lines,
+		uint32_t offset) {
+	size_t n = 0;
+	while (n < lines->len && lines->newlines[n] < offset) {
+		++n;
+	}
+	if (n == 0) {
+		return lines;
+	}
+
+	size_t base_line = lines->base_line + n;
+	uint32_t base = lines->newlines[n - 1];
+
+	struct mrsh_line_table *trimmed = lines;
+	if (lines->ref > 1) {
+		trimmed = line_table_create();
+		if (trimmed == NULL) {
+			return lines;
+		}
+		size_t len = lines->len - n;
+		if (len > 0) {
+			trimmed->newlines = malloc(len * sizeof(uint32_t));
+			if (trimmed->newlines == NULL) {
+				line_table_unref(trimmed);
+				return lines;
+			}
+			memcpy(trimmed->newlines, &lines->newlines[n],
+				len * sizeof(uint32_t));
+		}
+		trimmed->len = trimmed->cap = len;
+		line_table_unref(lines);
+	} else {
+		memmove(lines->newlines, &lines->newlines[n],
+			(lines->len - n) * sizeof(uint32_t));
+		lines->len -= n;
+	}
+
+	trimmed->base_line = base_line;
+	trimmed->base = base;
+	return trimmed;
+}
+
+void line_table_lookup(const struct mrsh_line_table *lines,
+		const struct mrsh_position *pos, struct mrsh_location *loc) {
+	if (!mrsh_position_valid(pos)) {
+		*loc = (struct mrsh_location){0};
+		return;
+	}
+
+	if (lines != NULL && pos->offset1 <= lines->base) {
+		*loc = (struct mrsh_location){0};
+		return;
+	}
+
+	// Find the number of newlines before the position
+	size_t lo = 0, hi = lines != NULL ? lines->len : 0;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (lines->newlines[mid] < pos->offset1) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	uint32_t line_begin = 0;
+	size_t base_line = 0;
+	if (lines != NULL) {
+		line_begin = lo > 0 ? lines->newlines[lo - 1] : lines->base;
+		base_line = lines->base_line;
+	}
+	loc->line = base_line + lo + 1;
+	loc->column = pos->offset1 - line_begin;
+}
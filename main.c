@@ -16,6 +16,33 @@
 
 extern char **environ;
 
+/**
+ * Reads a line from the terminal, prompting with PS1 at the start of a command
+ * and with PS2 on continuation lines.
+ */
+static ssize_t read_interactive_line(struct mrsh_buffer *buf,
+		bool continuation, void *user_data) {
+	struct mrsh_state *state = user_data;
+
+	char *prompt;
+	if (continuation) {
+		prompt = mrsh_get_ps2(state);
+	} else {
+		// TODO: next_history_id
+		prompt = mrsh_get_ps1(state, 0);
+	}
+	fflush(stdout);
+	char *line = NULL;
+	size_t n = interactive_next(state, &line, prompt);
+	free(prompt);
+	if (!line) {
+		return 0;
+	}
+	mrsh_buffer_append(buf, line, n);
+	free(line);
+	return n;
+}
+
 int main(int argc, char *argv[]) {
 	struct mrsh_state *state = mrsh_state_create();
 
@@ -29,12 +56,11 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
-	struct mrsh_buffer parser_buffer = {0};
 	struct mrsh_parser *parser;
 	int fd = -1;
 	if (state->interactive) {
 		interactive_init(state);
-		parser = mrsh_parser_with_buffer(&parser_buffer);
+		parser = mrsh_parser_with_read_func(read_interactive_line, state);
 	} else {
 		if (init_args.command_str) {
 			parser = mrsh_parser_with_data(init_args.command_str,
@@ -54,6 +80,8 @@ int main(int argc, char *argv[]) {
 			parser = mrsh_parser_with_fd(fd);
 		}
 	}
+	// The shell never modifies the programs it runs
+	mrsh_parser_set_arena(parser, true);
 	mrsh_state_set_parser_alias_func(state, parser);
 
 	if (state->options & MRSH_OPT_MONITOR) {
@@ -64,7 +92,7 @@ int main(int argc, char *argv[]) {
 
 	if (!(state->options & MRSH_OPT_NOEXEC)) {
 		// If argv[0] begins with `-`, it's a login shell
-		if (state->frame->argv[0][0] == '-') {
+		if (state->frame->argv_0[0] == '-') {
 			mrsh_source_profile(state);
 		}
 		if (state->interactive) {
@@ -72,45 +100,20 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-	struct mrsh_buffer read_buffer = {0};
 	while (state->exit == -1) {
-		if (state->interactive) {
-			char *prompt;
-			if (read_buffer.len > 0) {
-				prompt = mrsh_get_ps2(state);
-			} else {
-				// TODO: next_history_id
-				prompt = mrsh_get_ps1(state, 0);
-			}
-			char *line = NULL;
-			size_t n = interactive_next(state, &line, prompt);
-			free(prompt);
-			if (!line) {
-				state->exit = state->last_status;
-				continue;
-			}
-			mrsh_buffer_append(&read_buffer, line, n);
-			free(line);
-
-			parser_buffer.len = 0;
-			mrsh_buffer_append(&parser_buffer,
-				read_buffer.data, read_buffer.len);
-
-			mrsh_parser_reset(parser);
-		}
-
+		mrsh_parser_set_lazy_function_bodies(parser,
+			(state->options & MRSH_OPT_LAZYFUNCS) != 0);
 		struct mrsh_program *prog = mrsh_parse_line(parser);
-		if (state->interactive && mrsh_parser_continuation_line(parser)) {
-			// Nothing to see here
-		} else if (prog == NULL) {
-			struct mrsh_position err_pos;
-			const char *err_msg = mrsh_parser_error(parser, &err_pos);
+		if (prog == NULL) {
+			struct mrsh_location err_loc;
+			const char *err_msg = mrsh_parser_error(parser, &err_loc);
 			if (err_msg != NULL) {
-				mrsh_buffer_finish(&read_buffer);
 				fprintf(stderr, "%s:%d:%d: syntax error: %s\n",
-					state->frame->argv[0], err_pos.line, err_pos.column,
+					state->frame->argv_0, err_loc.line, err_loc.column,
 					err_msg);
 				if (state->interactive) {
+					// Discard the rest of the line
+					mrsh_parser_reset(parser);
 					continue;
 				} else {
 					state->exit = 1;
@@ -131,7 +134,6 @@ int main(int argc, char *argv[]) {
 				mrsh_run_program(state, prog);
 				mrsh_destroy_terminated_jobs(state);
 			}
-			mrsh_buffer_finish(&read_buffer);
 		}
 		mrsh_program_destroy(prog);
 	}
@@ -144,9 +146,7 @@ int main(int argc, char *argv[]) {
 
 	mrsh_run_exit_trap(state);
 
-	mrsh_buffer_finish(&read_buffer);
 	mrsh_parser_destroy(parser);
-	mrsh_buffer_finish(&parser_buffer);
 	mrsh_state_destroy(state);
 	if (fd >= 0) {
 		close(fd);
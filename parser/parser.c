@@ -8,10 +8,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "ast.h"
+#include "line_table.h"
 #include "parser.h"
+#include "stats.h"
 
 #define READ_SIZE 4096
+#define SCAN_MAX_DELIMS 16
 
 // Keep sorted from the longest to the shortest
 const struct symbol operators[] = {
@@ -30,33 +36,68 @@ const struct symbol operators[] = {
 const size_t operators_len = sizeof(operators) / sizeof(operators[0]);
 const size_t operators_max_str_len = 3;
 
-const char *keywords[] = {
-	"if",
-	"then",
-	"else",
-	"elif",
-	"fi",
-	"do",
-	"done",
-
-	"case",
-	"esac",
-	"while",
-	"until",
-	"for",
-
-	"{",
-	"}",
-	"!",
-	"in",
+const unsigned char char_classes[256] = {
+	['\0'] = CHAR_WORD_END,
+	['\n'] = CHAR_WORD_END,
+	[')'] = CHAR_WORD_END,
+	[' '] = CHAR_BLANK | CHAR_WORD_END,
+	['\t'] = CHAR_BLANK | CHAR_WORD_END,
+	['&'] = CHAR_OPERATOR_START | CHAR_WORD_END,
+	['|'] = CHAR_OPERATOR_START | CHAR_WORD_END,
+	[';'] = CHAR_OPERATOR_START | CHAR_WORD_END,
+	['<'] = CHAR_OPERATOR_START | CHAR_WORD_END,
+	['>'] = CHAR_OPERATOR_START | CHAR_WORD_END,
+	['$'] = CHAR_WORD_SPECIAL,
+	['`'] = CHAR_WORD_SPECIAL,
+	['\''] = CHAR_WORD_SPECIAL,
+	['"'] = CHAR_WORD_SPECIAL,
+	['\\'] = CHAR_WORD_SPECIAL,
 };
 
-const size_t keywords_len = sizeof(keywords) / sizeof(keywords[0]);
+#define KEYWORD_HASH_SIZE 32
+
+/**
+ * Reserved words, indexed by keyword_hash. The hash function has been chosen
+ * so that there are no collisions.
+ */
+static const char *const keyword_table[KEYWORD_HASH_SIZE] = {
+	[0] = "if",
+	[1] = "fi",
+	[2] = "{",
+	[3] = "else",
+	[5] = "esac",
+	[6] = "then",
+	[8] = "}",
+	[9] = "for",
+	[12] = "while",
+	[13] = "until",
+	[18] = "elif",
+	[19] = "do",
+	[20] = "!",
+	[24] = "in",
+	[27] = "case",
+	[31] = "done",
+};
+
+static size_t keyword_hash(const char *str, size_t len) {
+	unsigned char first = str[0], last = str[len - 1];
+	return (4 * first + 15 * last + len) % KEYWORD_HASH_SIZE;
+}
+
+bool is_keyword(const char *str, size_t len) {
+	if (len == 0) {
+		return false;
+	}
+	const char *keyword = keyword_table[keyword_hash(str, len)];
+	return keyword != NULL && strlen(keyword) == len &&
+		memcmp(keyword, str, len) == 0;
+}
 
 static struct mrsh_parser *parser_create(void) {
 	struct mrsh_parser *parser = calloc(1, sizeof(struct mrsh_parser));
 	parser->fd = -1;
-	parser->pos.line = parser->pos.column = 1;
+	parser->pos.offset1 = 1;
+	parser->lines = line_table_create();
 	return parser;
 }
 
@@ -70,6 +111,8 @@ struct mrsh_parser *mrsh_parser_with_data(const char *buf, size_t len) {
 	struct mrsh_parser *parser = parser_create();
 	mrsh_buffer_append(&parser->buf, buf, len);
 	mrsh_buffer_append_char(&parser->buf, '\0');
+	line_table_scan(parser->lines, parser->pos.offset1, buf, len);
+	lib_stats.parse_bytes += len;
 	return parser;
 }
 
@@ -79,12 +122,38 @@ struct mrsh_parser *mrsh_parser_with_buffer(struct mrsh_buffer *buf) {
 	return parser;
 }
 
+struct mrsh_parser *mrsh_parser_with_read_func(mrsh_parser_read_func read,
+		void *user_data) {
+	struct mrsh_parser *parser = parser_create();
+	parser->read = read;
+	parser->read_user_data = user_data;
+	return parser;
+}
+
+static void alias_destroy(struct parser_alias *alias) {
+	free(alias->name);
+	free(alias);
+}
+
+static void clear_aliases(struct mrsh_parser *parser) {
+	for (size_t i = 0; i < parser->aliases.len; ++i) {
+		alias_destroy(parser->aliases.data[i]);
+	}
+	parser->aliases.len = 0;
+	parser->alias_len = 0;
+	parser->alias_blank = false;
+}
+
 void mrsh_parser_destroy(struct mrsh_parser *parser) {
 	if (parser == NULL) {
 		return;
 	}
+	parser_compact_buffer(parser);
 	mrsh_buffer_finish(&parser->buf);
 	mrsh_array_finish(&parser->here_documents);
+	clear_aliases(parser);
+	mrsh_array_finish(&parser->aliases);
+	line_table_unref(parser->lines);
 	free(parser->error.msg);
 	free(parser);
 }
@@ -134,8 +203,41 @@ static ssize_t parser_peek_buffer(struct mrsh_parser *parser, size_t size) {
 	return n_read;
 }
 
+static ssize_t parser_peek_func(struct mrsh_parser *parser, size_t size) {
+	assert(parser->read != NULL);
+
+	size_t n_read = 0;
+	while (n_read < size) {
+		ssize_t n = parser->read(&parser->buf, parser->line_begun,
+			parser->read_user_data);
+		if (n < 0) {
+			return -1;
+		} else if (n == 0) {
+			break;
+		}
+
+		parser->line_begun = true;
+		n_read += n;
+	}
+
+	return n_read;
+}
+
+void parser_compact_buffer(struct mrsh_parser *parser) {
+	if (parser->buf_offset == 0) {
+		return;
+	}
+	char *base = parser->buf.data - parser->buf_offset;
+	memmove(base, parser->buf.data, parser->buf.len);
+	parser->buf.data = base;
+	parser->buf.cap += parser->buf_offset;
+	parser->buf_offset = 0;
+}
+
 size_t parser_peek(struct mrsh_parser *parser, char *buf, size_t size) {
 	if (size > parser->buf.len) {
+		parser_compact_buffer(parser);
+
 		size_t n_more = size - parser->buf.len;
 
 		ssize_t n_read;
@@ -143,6 +245,8 @@ size_t parser_peek(struct mrsh_parser *parser, char *buf, size_t size) {
 			n_read = parser_peek_fd(parser, n_more);
 		} else if (parser->in_buf != NULL) {
 			n_read = parser_peek_buffer(parser, n_more);
+		} else if (parser->read != NULL) {
+			n_read = parser_peek_func(parser, n_more);
 		} else {
 			n_read = 0;
 		}
@@ -152,6 +256,16 @@ size_t parser_peek(struct mrsh_parser *parser, char *buf, size_t size) {
 			return 0; // TODO: better error handling
 		}
 
+		lib_stats.parse_bytes += n_read;
+
+		// Find newlines in bulk, instead of when each char is consumed
+		size_t prev_len = parser->buf.len - n_read;
+		size_t scan_offset = parser->pos.offset1 + prev_len - parser->alias_len;
+		if (parser->pos.offset1 != 0 && scan_offset <= UINT32_MAX) {
+			line_table_scan(parser->lines, scan_offset,
+				&parser->buf.data[prev_len], n_read);
+		}
+
 		if ((size_t)n_read < n_more) {
 			if (!parser->eof) {
 				mrsh_buffer_append_char(&parser->buf, '\0');
@@ -168,38 +282,133 @@ size_t parser_peek(struct mrsh_parser *parser, char *buf, size_t size) {
 }
 
 char parser_peek_char(struct mrsh_parser *parser) {
+	if (parser->buf.len > 0) {
+		return parser->buf.data[0];
+	}
 	char c = '\0';
 	parser_peek(parser, &c, sizeof(char));
 	return c;
 }
 
-size_t parser_read(struct mrsh_parser *parser, char *buf, size_t size) {
-	size_t n = parser_peek(parser, buf, size);
-	if (n > 0) {
-		for (size_t i = 0; i < n; ++i) {
-			assert(parser->buf.data[i] != '\0');
-			++parser->pos.offset;
-			if (parser->buf.data[i] == '\n') {
-				++parser->pos.line;
-				parser->pos.column = 1;
-			} else {
-				++parser->pos.column;
+/**
+ * Consumes `n` characters from the replacement texts at the start of the
+ * buffer, and returns how many characters of the input are left to consume.
+ * Aliases are popped once characters after their replacement are consumed.
+ */
+static size_t consume_aliases(struct mrsh_parser *parser, size_t n) {
+	while (n > 0 && parser->aliases.len > 0) {
+		struct parser_alias *alias =
+			parser->aliases.data[parser->aliases.len - 1];
+		if (alias->len == 0) {
+			if (alias->trailing_blank) {
+				parser->alias_blank = true;
 			}
+			alias_destroy(alias);
+			--parser->aliases.len;
+			continue;
 		}
-		memmove(parser->buf.data, parser->buf.data + n, parser->buf.len - n);
-		parser->buf.len -= n;
 
-		parser->continuation_line = false;
+		size_t alias_n = n < alias->len ? n : alias->len;
+		alias->len -= alias_n;
+		parser->alias_len -= alias_n;
+		n -= alias_n;
+	}
+	return n;
+}
+
+static void consume_buffer(struct mrsh_parser *parser, size_t n) {
+	assert(memchr(parser->buf.data, '\0', n) == NULL);
+	// Replacement texts aren't part of the input, positions don't move
+	size_t input_n = n;
+	if (parser->aliases.len > 0) {
+		input_n = consume_aliases(parser, n);
+	}
+	// Positions stop being tracked once they can't be represented anymore
+	if (parser->pos.offset1 != 0 && input_n > UINT32_MAX - parser->pos.offset1) {
+		parser->pos.offset1 = 0;
+	} else if (parser->pos.offset1 != 0) {
+		parser->pos.offset1 += input_n;
+	}
+	// Moving the remaining data is deferred until the buffer needs to grow,
+	// so that reading doesn't depend on how much data is buffered
+	parser->buf.data += n;
+	parser->buf.len -= n;
+	parser->buf.cap -= n;
+	parser->buf_offset += n;
+
+	parser->continuation_line = false;
+}
+
+size_t parser_read(struct mrsh_parser *parser, char *buf, size_t size) {
+	size_t n = parser_peek(parser, buf, size);
+	if (n > 0) {
+		consume_buffer(parser, n);
 	}
 	return n;
 }
 
 char parser_read_char(struct mrsh_parser *parser) {
-	char c = '\0';
-	parser_read(parser, &c, sizeof(char));
+	char c = parser_peek_char(parser);
+	if (c != '\0') {
+		consume_buffer(parser, 1);
+	}
 	return c;
 }
 
+void parser_push_alias(struct mrsh_parser *parser, char *name,
+		const char *repl) {
+	size_t len = strlen(repl);
+	if (len <= parser->buf_offset) {
+		// Reuse the space of the data already consumed
+		parser->buf.data -= len;
+		parser->buf.cap += len;
+		parser->buf_offset -= len;
+	} else {
+		parser_compact_buffer(parser);
+		mrsh_buffer_reserve(&parser->buf, len);
+		memmove(&parser->buf.data[len], parser->buf.data, parser->buf.len);
+	}
+	memcpy(parser->buf.data, repl, len);
+	parser->buf.len += len;
+
+	struct parser_alias *alias = calloc(1, sizeof(struct parser_alias));
+	alias->name = name;
+	alias->len = len;
+	alias->trailing_blank = len > 0 &&
+		(char_classes[(unsigned char)repl[len - 1]] & CHAR_BLANK);
+	mrsh_array_add(&parser->aliases, alias);
+	parser->alias_len += len;
+}
+
+bool parser_alias_active(struct mrsh_parser *parser, const char *name) {
+	for (size_t i = 0; i < parser->aliases.len; ++i) {
+		struct parser_alias *alias = parser->aliases.data[i];
+		// An alias ending with a blank is done once its replacement is read,
+		// so that the next word can be substituted with it
+		if ((alias->len > 0 || !alias->trailing_blank) &&
+				strcmp(alias->name, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool parser_alias_ends_with_blank(struct mrsh_parser *parser) {
+	if (parser->alias_blank) {
+		return true;
+	}
+	for (size_t i = parser->aliases.len; i > 0; --i) {
+		struct parser_alias *alias = parser->aliases.data[i - 1];
+		if (alias->len > 0) {
+			break;
+		}
+		if (alias->trailing_blank) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void read_continuation_line(struct mrsh_parser *parser) {
 	char c = parser_read_char(parser);
 	assert(c == '\n');
@@ -207,16 +416,7 @@ void read_continuation_line(struct mrsh_parser *parser) {
 }
 
 bool is_operator_start(char c) {
-	switch (c) {
-	case '&':
-	case '|':
-	case ';':
-	case '<':
-	case '>':
-		return true;
-	default:
-		return false;
-	}
+	return char_classes[(unsigned char)c] & CHAR_OPERATOR_START;
 }
 
 void parser_set_error(struct mrsh_parser *parser, const char *msg) {
@@ -237,9 +437,9 @@ void parser_set_error(struct mrsh_parser *parser, const char *msg) {
 }
 
 const char *mrsh_parser_error(struct mrsh_parser *parser,
-		struct mrsh_position *pos) {
-	if (pos != NULL) {
-		*pos = parser->error.pos;
+		struct mrsh_location *loc) {
+	if (loc != NULL) {
+		line_table_lookup(parser->lines, &parser->error.pos, loc);
 	}
 	return parser->error.msg;
 }
@@ -249,60 +449,143 @@ void parser_begin(struct mrsh_parser *parser) {
 	parser->continuation_line = false;
 }
 
-// See section 2.3 Token Recognition
-static void next_symbol(struct mrsh_parser *parser) {
-	parser->has_sym = true;
-
-	char c = parser_peek_char(parser);
+size_t scan_span(const char *data, size_t len, const char *delims) {
+	size_t delims_len = strlen(delims);
+	assert(delims_len <= SCAN_MAX_DELIMS);
 
-	if (c == '\0') {
-		parser->sym = EOF_TOKEN;
-		return;
+	size_t i = 0;
+#ifdef __SSE2__
+	// Compare 16 characters at a time against each delimiter
+	__m128i delim_vecs[SCAN_MAX_DELIMS];
+	for (size_t j = 0; j < delims_len; ++j) {
+		delim_vecs[j] = _mm_set1_epi8(delims[j]);
 	}
-	if (c == '\n') {
-		parser->sym = NEWLINE;
-		return;
+	for (; i + 16 <= len; i += 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i *)&data[i]);
+		__m128i match = _mm_cmpeq_epi8(chunk, _mm_setzero_si128());
+		for (size_t j = 0; j < delims_len; ++j) {
+			match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, delim_vecs[j]));
+		}
+		unsigned int mask = _mm_movemask_epi8(match);
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
 	}
+#endif
 
-	if (is_operator_start(c)) {
-		for (size_t i = 0; i < operators_len; ++i) {
-			const char *str = operators[i].str;
+	for (; i < len; ++i) {
+		if (data[i] == '\0' || memchr(delims, data[i], delims_len) != NULL) {
+			break;
+		}
+	}
+	return i;
+}
 
-			size_t j;
-			for (j = 0; str[j] != '\0'; ++j) {
-				size_t n = j + 1;
-				size_t n_read = parser_peek(parser, NULL, n);
-				if (n != n_read || parser->buf.data[j] != str[j]) {
-					break;
-				}
+size_t parser_read_span(struct mrsh_parser *parser, const char *delims,
+		struct mrsh_buffer *buf) {
+	size_t total = 0;
+	while (parser_peek(parser, NULL, 1) > 0) {
+		size_t n = scan_span(parser->buf.data, parser->buf.len, delims);
+		if (n > 0) {
+			if (buf != NULL) {
+				mrsh_buffer_append(buf, parser->buf.data, n);
 			}
+			parser_read(parser, NULL, n);
+			total += n;
+		}
+		if (parser->buf.len > 0) {
+			break;
+		}
+	}
+	return total;
+}
 
-			if (str[j] == '\0') {
-				parser->sym = operators[i].name;
-				return;
-			}
+static void skip_blanks(struct mrsh_parser *parser) {
+	while (parser_peek(parser, NULL, 1) > 0) {
+		size_t n = 0;
+		while (n < parser->buf.len &&
+				(char_classes[(unsigned char)parser->buf.data[n]] & CHAR_BLANK)) {
+			++n;
+		}
+		parser_read(parser, NULL, n);
+		if (parser->buf.len > 0) {
+			break;
 		}
 	}
+}
 
-	if (isblank(c)) {
-		parser_read_char(parser);
-		next_symbol(parser);
-		return;
+/**
+ * Recognizes the operator at the start of the input, which begins with `c`.
+ * This is a DFA whose states are the prefixes of the operators. Returns TOKEN
+ * if the input doesn't start with an operator of more than one character.
+ *
+ * Only as many characters as needed are peeked, so that an interactive shell
+ * doesn't wait for more input.
+ */
+static enum symbol_name operator_symbol(struct mrsh_parser *parser, char c) {
+	char next = '\0';
+	if (parser_peek(parser, NULL, 2) == 2) {
+		next = parser->buf.data[1];
 	}
 
-	if (c == '#') {
-		while (true) {
-			char c = parser_peek_char(parser);
-			if (c == '\0' || c == '\n') {
-				break;
+	switch (c) {
+	case '&':
+		return next == '&' ? AND_IF : TOKEN;
+	case '|':
+		return next == '|' ? OR_IF : TOKEN;
+	case ';':
+		return next == ';' ? DSEMI : TOKEN;
+	case '<':
+		switch (next) {
+		case '<':
+			if (parser_peek(parser, NULL, 3) == 3 &&
+					parser->buf.data[2] == '-') {
+				return DLESSDASH;
 			}
-			parser_read_char(parser);
+			return DLESS;
+		case '&':
+			return LESSAND;
+		case '>':
+			return LESSGREAT;
 		}
-		next_symbol(parser);
-		return;
+		return TOKEN;
+	case '>':
+		switch (next) {
+		case '>':
+			return DGREAT;
+		case '&':
+			return GREATAND;
+		case '|':
+			return CLOBBER;
+		}
+		return TOKEN;
 	}
+	return TOKEN;
+}
 
-	parser->sym = TOKEN;
+// See section 2.3 Token Recognition
+static void next_symbol(struct mrsh_parser *parser) {
+	parser->has_sym = true;
+
+	char c;
+	while (true) {
+		skip_blanks(parser);
+		c = parser_peek_char(parser);
+		if (c != '#') {
+			break;
+		}
+		parser_read_span(parser, "\n", NULL);
+	}
+
+	if (c == '\0') {
+		parser->sym = EOF_TOKEN;
+	} else if (c == '\n') {
+		parser->sym = NEWLINE;
+	} else if (is_operator_start(c)) {
+		parser->sym = operator_symbol(parser, c);
+	} else {
+		parser->sym = TOKEN;
+	}
 }
 
 enum symbol_name get_symbol(struct mrsh_parser *parser) {
@@ -359,12 +642,34 @@ void mrsh_parser_set_alias_func(struct mrsh_parser *parser,
 	parser->alias_user_data = user_data;
 }
 
+void mrsh_parser_set_lazy_function_bodies(struct mrsh_parser *parser,
+		bool lazy) {
+	parser->lazy_function_bodies = lazy;
+}
+
+void mrsh_parser_set_arena(struct mrsh_parser *parser, bool use_arena) {
+	parser->use_arena = use_arena;
+}
+
+void parser_set_position(struct mrsh_parser *parser,
+		const struct mrsh_position *pos, struct mrsh_line_table *lines) {
+	parser->pos = *pos;
+	line_table_unref(parser->lines);
+	parser->lines = line_table_ref(lines);
+}
+
 bool mrsh_parser_continuation_line(struct mrsh_parser *parser) {
 	return parser->continuation_line;
 }
 
 void mrsh_parser_reset(struct mrsh_parser *parser) {
 	parser->buf.len = 0;
+	parser_compact_buffer(parser);
 	parser->has_sym = false;
-	parser->pos = (struct mrsh_position){0};
+	parser->pos = (struct mrsh_position){ .offset1 = 1 };
+	clear_aliases(parser);
+
+	// Programs parsed so far keep their own reference
+	line_table_unref(parser->lines);
+	parser->lines = line_table_create();
 }
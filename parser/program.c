@@ -8,7 +8,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "ast.h"
+#include "line_table.h"
 #include "parser.h"
 
 static const char *operator_str(enum symbol_name sym) {
@@ -81,7 +83,7 @@ static void apply_aliases(struct mrsh_parser *parser) {
 		return;
 	}
 
-	const char *last_repl = NULL;
+	parser->alias_blank = false;
 	while (true) {
 		if (!symbol(parser, TOKEN)) {
 			return;
@@ -93,27 +95,20 @@ static void apply_aliases(struct mrsh_parser *parser) {
 		}
 
 		char *name = strndup(parser->buf.data, alias_len);
-		const char *repl = parser->alias(name, parser->alias_user_data);
-		free(name);
-		if (repl == NULL || last_repl == repl) {
-			break;
+		const char *repl = NULL;
+		if (!parser_alias_active(parser, name)) {
+			repl = parser->alias(name, parser->alias_user_data);
 		}
-
-		size_t trailing_len = parser->buf.len - alias_len;
-		size_t repl_len = strlen(repl);
-		if (repl_len > alias_len) {
-			mrsh_buffer_reserve(&parser->buf, repl_len - alias_len);
+		if (repl == NULL) {
+			free(name);
+			return;
 		}
-		memmove(&parser->buf.data[repl_len], &parser->buf.data[alias_len],
-			parser->buf.len - alias_len);
-		memcpy(parser->buf.data, repl, repl_len);
-		parser->buf.len = repl_len + trailing_len;
-
-		// TODO: fixup parser->pos
-		// TODO: if repl's last char is blank, replace next alias too
 
+		// The replacement is read before the rest of the input, and checked
+		// for aliases in turn
+		parser_read(parser, NULL, alias_len);
 		consume_symbol(parser);
-		last_repl = repl;
+		parser_push_alias(parser, name, repl);
 	}
 }
 
@@ -213,14 +208,14 @@ static struct mrsh_io_redirect *io_redirect(struct mrsh_parser *parser) {
 	redir.op_range.begin = parser->pos;
 	if (io_file(parser, &redir)) {
 		struct mrsh_io_redirect *redir_ptr =
-			calloc(1, sizeof(struct mrsh_io_redirect));
+			ast_alloc(parser->arena, sizeof(struct mrsh_io_redirect));
 		memcpy(redir_ptr, &redir, sizeof(struct mrsh_io_redirect));
 		redir.op_range.end = parser->pos;
 		return redir_ptr;
 	}
 	if (io_here(parser, &redir)) {
 		struct mrsh_io_redirect *redir_ptr =
-			calloc(1, sizeof(struct mrsh_io_redirect));
+			ast_alloc(parser->arena, sizeof(struct mrsh_io_redirect));
 		memcpy(redir_ptr, &redir, sizeof(struct mrsh_io_redirect));
 		redir.op_range.end = parser->pos;
 		mrsh_array_add(&parser->here_documents, redir_ptr);
@@ -249,17 +244,20 @@ static struct mrsh_assignment *assignment_word(struct mrsh_parser *parser) {
 	}
 
 	struct mrsh_range name_range;
-	char *name = read_token(parser, name_len, &name_range);
+	const char *name = read_name(parser, name_len, &name_range);
 
 	struct mrsh_position equal_pos = parser->pos;
 	parser_read(parser, NULL, 1);
 
 	struct mrsh_word *value = word(parser, 0);
 	if (value == NULL) {
-		value = &mrsh_word_string_create(strdup(""), false)->word;
+		char *empty = ast_strdup(parser->arena, "");
+		value = &word_string_create(parser->arena, empty, false)->word;
 	}
 
-	struct mrsh_assignment *assign = calloc(1, sizeof(struct mrsh_assignment));
+	struct mrsh_assignment *assign =
+		ast_alloc(parser->arena, sizeof(struct mrsh_assignment));
+	ast_own_atom(parser->arena, name);
 	assign->name = name;
 	assign->value = value;
 	assign->name_range = name_range;
@@ -271,13 +269,13 @@ static bool cmd_prefix(struct mrsh_parser *parser,
 		struct mrsh_simple_command *cmd) {
 	struct mrsh_io_redirect *redir = io_redirect(parser);
 	if (redir != NULL) {
-		mrsh_array_add(&cmd->io_redirects, redir);
+		ast_array_add(parser->arena, &cmd->io_redirects, redir);
 		return true;
 	}
 
 	struct mrsh_assignment *assign = assignment_word(parser);
 	if (assign != NULL) {
-		mrsh_array_add(&cmd->assignments, assign);
+		ast_array_add(parser->arena, &cmd->assignments, assign);
 		return true;
 	}
 
@@ -292,18 +290,14 @@ static struct mrsh_word *cmd_name(struct mrsh_parser *parser) {
 		return word(parser, 0);
 	}
 
-	// TODO: optimize this
-	for (size_t i = 0; i < keywords_len; ++i) {
-		if (strlen(keywords[i]) == word_len &&
-				strncmp(parser->buf.data, keywords[i], word_len) == 0) {
-			return NULL;
-		}
+	if (is_keyword(parser->buf.data, word_len)) {
+		return NULL;
 	}
 
 	struct mrsh_range range;
 	char *str = read_token(parser, word_len, &range);
 
-	struct mrsh_word_string *ws = mrsh_word_string_create(str, false);
+	struct mrsh_word_string *ws = word_string_create(parser->arena, str, false);
 	ws->range = range;
 	return &ws->word;
 }
@@ -312,13 +306,17 @@ static bool cmd_suffix(struct mrsh_parser *parser,
 		struct mrsh_simple_command *cmd) {
 	struct mrsh_io_redirect *redir = io_redirect(parser);
 	if (redir != NULL) {
-		mrsh_array_add(&cmd->io_redirects, redir);
+		ast_array_add(parser->arena, &cmd->io_redirects, redir);
 		return true;
 	}
 
+	if (parser_alias_ends_with_blank(parser)) {
+		apply_aliases(parser);
+	}
+
 	struct mrsh_word *arg = word(parser, 0);
 	if (arg != NULL) {
-		mrsh_array_add(&cmd->arguments, arg);
+		ast_array_add(parser->arena, &cmd->arguments, arg);
 		return true;
 	}
 
@@ -342,7 +340,7 @@ static struct mrsh_simple_command *simple_command(struct mrsh_parser *parser) {
 		}
 	}
 
-	return mrsh_simple_command_create(cmd.name, &cmd.arguments,
+	return simple_command_create(parser->arena, cmd.name, &cmd.arguments,
 		&cmd.io_redirects, &cmd.assignments);
 }
 
@@ -371,7 +369,7 @@ static struct mrsh_command_list *term(struct mrsh_parser *parser) {
 		return NULL;
 	}
 
-	struct mrsh_command_list *cmd = mrsh_command_list_create();
+	struct mrsh_command_list *cmd = command_list_create(parser->arena);
 	cmd->and_or_list = and_or_list;
 
 	struct mrsh_position separator_pos = parser->pos;
@@ -408,14 +406,14 @@ static bool compound_list(struct mrsh_parser *parser, struct mrsh_array *cmds) {
 	if (l == NULL) {
 		return false;
 	}
-	mrsh_array_add(cmds, l);
+	ast_array_add(parser->arena, cmds, l);
 
 	while (true) {
 		l = term(parser);
 		if (l == NULL) {
 			break;
 		}
-		mrsh_array_add(cmds, l);
+		ast_array_add(parser->arena, cmds, l);
 	}
 
 	return true;
@@ -444,11 +442,11 @@ static struct mrsh_brace_group *brace_group(struct mrsh_parser *parser) {
 
 	struct mrsh_position rbrace_pos = parser->pos;
 	if (!expect_token(parser, "}", NULL)) {
-		command_list_array_finish(&body);
+		command_list_array_finish(parser->arena, &body);
 		return NULL;
 	}
 
-	struct mrsh_brace_group *bg = mrsh_brace_group_create(&body);
+	struct mrsh_brace_group *bg = brace_group_create(parser->arena, &body);
 	bg->lbrace_pos = lbrace_pos;
 	bg->rbrace_pos = rbrace_pos;
 	return bg;
@@ -467,11 +465,11 @@ static struct mrsh_subshell *subshell(struct mrsh_parser *parser) {
 
 	struct mrsh_position rparen_pos = parser->pos;
 	if (!expect_token(parser, ")", NULL)) {
-		command_list_array_finish(&body);
+		command_list_array_finish(parser->arena, &body);
 		return NULL;
 	}
 
-	struct mrsh_subshell *s = mrsh_subshell_create(&body);
+	struct mrsh_subshell *s = subshell_create(parser->arena, &body);
 	s->lparen_pos = lparen_pos;
 	s->rparen_pos = rparen_pos;
 	return s;
@@ -487,19 +485,20 @@ static struct mrsh_command *else_part(struct mrsh_parser *parser) {
 
 		struct mrsh_range then_range;
 		if (!expect_token(parser, "then", &then_range)) {
-			command_list_array_finish(&cond);
+			command_list_array_finish(parser->arena, &cond);
 			return NULL;
 		}
 
 		struct mrsh_array body = {0};
 		if (!expect_compound_list(parser, &body)) {
-			command_list_array_finish(&cond);
+			command_list_array_finish(parser->arena, &cond);
 			return NULL;
 		}
 
 		struct mrsh_command *ep = else_part(parser);
 
-		struct mrsh_if_clause *ic = mrsh_if_clause_create(&cond, &body, ep);
+		struct mrsh_if_clause *ic =
+			if_clause_create(parser->arena, &cond, &body, ep);
 		ic->if_range = if_range;
 		ic->then_range = then_range;
 		return &ic->command;
@@ -512,7 +511,7 @@ static struct mrsh_command *else_part(struct mrsh_parser *parser) {
 		}
 
 		// TODO: position information is missing
-		struct mrsh_brace_group *bg = mrsh_brace_group_create(&body);
+		struct mrsh_brace_group *bg = brace_group_create(parser->arena, &body);
 		return &bg->command;
 	}
 
@@ -547,18 +546,19 @@ static struct mrsh_if_clause *if_clause(struct mrsh_parser *parser) {
 		goto error_else_part;
 	}
 
-	struct mrsh_if_clause *ic = mrsh_if_clause_create(&cond, &body, ep);
+	struct mrsh_if_clause *ic =
+		if_clause_create(parser->arena, &cond, &body, ep);
 	ic->if_range = if_range;
 	ic->then_range = then_range;
 	ic->fi_range = fi_range;
 	return ic;
 
 error_else_part:
-	mrsh_command_destroy(ep);
+	ast_command_destroy(parser->arena, ep);
 error_body:
-	command_list_array_finish(&body);
+	command_list_array_finish(parser->arena, &body);
 error_cond:
-	command_list_array_finish(&cond);
+	command_list_array_finish(parser->arena, &cond);
 	return NULL;
 }
 
@@ -577,7 +577,7 @@ static void wordlist(struct mrsh_parser *parser,
 		if (w == NULL) {
 			break;
 		}
-		mrsh_array_add(words, w);
+		ast_array_add(parser->arena, words, w);
 	}
 }
 
@@ -595,7 +595,7 @@ static bool expect_do_group(struct mrsh_parser *parser,
 
 	if (!token(parser, "done", done_range)) {
 		parser_set_error(parser, "expected 'done'");
-		command_list_array_finish(body);
+		command_list_array_finish(parser->arena, body);
 		return false;
 	}
 
@@ -642,7 +642,7 @@ static struct mrsh_for_clause *for_clause(struct mrsh_parser *parser) {
 	}
 
 	struct mrsh_for_clause *fc =
-		mrsh_for_clause_create(name, in, &words, &body);
+		for_clause_create(parser->arena, name, in, &words, &body);
 	fc->for_range = for_range;
 	fc->name_range = name_range;
 	fc->in_range = in_range;
@@ -653,10 +653,10 @@ static struct mrsh_for_clause *for_clause(struct mrsh_parser *parser) {
 error_words:
 	for (size_t i = 0; i < words.len; ++i) {
 		struct mrsh_word *word = words.data[i];
-		mrsh_word_destroy(word);
+		ast_word_destroy(parser->arena, word);
 	}
-	mrsh_array_finish(&words);
-	free(name);
+	ast_array_finish(parser->arena, &words);
+	ast_free(parser->arena, name);
 	return NULL;
 }
 
@@ -679,12 +679,12 @@ static struct mrsh_loop_clause *loop_clause(struct mrsh_parser *parser) {
 	struct mrsh_array body = {0};
 	struct mrsh_range do_range, done_range;
 	if (!expect_do_group(parser, &body, &do_range, &done_range)) {
-		command_list_array_finish(&condition);
+		command_list_array_finish(parser->arena, &condition);
 		return NULL;
 	}
 
 	struct mrsh_loop_clause *fc =
-		mrsh_loop_clause_create(type, &condition, &body);
+		loop_clause_create(parser->arena, type, &condition, &body);
 	fc->while_until_range = while_until_range;
 	fc->do_range = do_range;
 	fc->done_range = done_range;
@@ -705,7 +705,7 @@ static struct mrsh_case_item *expect_case_item(struct mrsh_parser *parser,
 	}
 
 	struct mrsh_array patterns = {0};
-	mrsh_array_add(&patterns, w);
+	ast_array_add(parser->arena, &patterns, w);
 
 	while (token(parser, "|", NULL)) {
 		struct mrsh_word *w = word(parser, 0);
@@ -713,7 +713,7 @@ static struct mrsh_case_item *expect_case_item(struct mrsh_parser *parser,
 			parser_set_error(parser, "expected a word");
 			return NULL;
 		}
-		mrsh_array_add(&patterns, w);
+		ast_array_add(parser->arena, &patterns, w);
 	}
 
 	struct mrsh_position rparen_pos = parser->pos;
@@ -734,7 +734,8 @@ static struct mrsh_case_item *expect_case_item(struct mrsh_parser *parser,
 		linebreak(parser);
 	}
 
-	struct mrsh_case_item *item = calloc(1, sizeof(struct mrsh_case_item));
+	struct mrsh_case_item *item =
+		ast_alloc(parser->arena, sizeof(struct mrsh_case_item));
 	if (item == NULL) {
 		goto error_body;
 	}
@@ -746,13 +747,13 @@ static struct mrsh_case_item *expect_case_item(struct mrsh_parser *parser,
 	return item;
 
 error_body:
-	command_list_array_finish(&body);
+	command_list_array_finish(parser->arena, &body);
 error_patterns:
 	for (size_t i = 0; i < patterns.len; ++i) {
 		struct mrsh_word *w = patterns.data[i];
-		mrsh_word_destroy(w);
+		ast_word_destroy(parser->arena, w);
 	}
-	mrsh_array_finish(&patterns);
+	ast_array_finish(parser->arena, &patterns);
 	return NULL;
 }
 
@@ -785,7 +786,7 @@ static struct mrsh_case_clause *case_clause(struct mrsh_parser *parser) {
 		if (item == NULL) {
 			goto error_items;
 		}
-		mrsh_array_add(&items, item);
+		ast_array_add(parser->arena, &items, item);
 
 		if (!dsemi) {
 			// Only the last case can omit `;;`
@@ -796,7 +797,7 @@ static struct mrsh_case_clause *case_clause(struct mrsh_parser *parser) {
 		}
 	}
 
-	struct mrsh_case_clause *cc = mrsh_case_clause_create(w, &items);
+	struct mrsh_case_clause *cc = case_clause_create(parser->arena, w, &items);
 	cc->case_range = case_range;
 	cc->in_range = in_range;
 	cc->esac_range = esac_range;
@@ -805,11 +806,11 @@ static struct mrsh_case_clause *case_clause(struct mrsh_parser *parser) {
 error_items:
 	for (size_t i = 0; i < items.len; ++i) {
 		struct mrsh_case_item *item = items.data[i];
-		case_item_destroy(item);
+		case_item_destroy(parser->arena, item);
 	}
-	mrsh_array_finish(&items);
+	ast_array_finish(parser->arena, &items);
 error_word:
-	mrsh_word_destroy(w);
+	ast_word_destroy(parser->arena, w);
 	return NULL;
 }
 
@@ -851,10 +852,24 @@ static struct mrsh_function_definition *function_definition(
 
 	linebreak(parser);
 
-	struct mrsh_command *cmd = compound_command(parser);
-	if (cmd == NULL) {
-		parser_set_error(parser, "expected a compound command");
-		return NULL;
+	struct mrsh_position body_pos = parser->pos;
+	size_t body_len = 0;
+	if (parser->lazy_function_bodies) {
+		body_len = skim_compound_command(parser);
+	}
+
+	struct mrsh_command *cmd = NULL;
+	char *body_source = NULL;
+	if (body_len > 0) {
+		body_source = ast_strndup(parser->arena, parser->buf.data, body_len);
+		parser_read(parser, NULL, body_len);
+		consume_symbol(parser);
+	} else {
+		cmd = compound_command(parser);
+		if (cmd == NULL) {
+			parser_set_error(parser, "expected a compound command");
+			return NULL;
+		}
 	}
 
 	struct mrsh_array io_redirects = {0};
@@ -863,14 +878,18 @@ static struct mrsh_function_definition *function_definition(
 		if (redir == NULL) {
 			break;
 		}
-		mrsh_array_add(&io_redirects, redir);
+		ast_array_add(parser->arena, &io_redirects, redir);
 	}
 
 	struct mrsh_function_definition *fd =
-		mrsh_function_definition_create(name, cmd, &io_redirects);
+		function_definition_create(parser->arena, name, cmd, &io_redirects);
 	fd->name_range = name_range;
 	fd->lparen_pos = lparen_pos;
 	fd->rparen_pos = rparen_pos;
+	if (body_source != NULL) {
+		fd->body_source = body_source;
+		fd->body_pos = body_pos;
+	}
 	return fd;
 }
 
@@ -1000,7 +1019,7 @@ static struct mrsh_pipeline *pipeline(struct mrsh_parser *parser) {
 	}
 
 	struct mrsh_array commands = {0};
-	mrsh_array_add(&commands, cmd);
+	ast_array_add(parser->arena, &commands, cmd);
 
 	while (token(parser, "|", NULL)) {
 		linebreak(parser);
@@ -1009,18 +1028,18 @@ static struct mrsh_pipeline *pipeline(struct mrsh_parser *parser) {
 			parser_set_error(parser, "expected a command");
 			goto error_commands;
 		}
-		mrsh_array_add(&commands, cmd);
+		ast_array_add(parser->arena, &commands, cmd);
 	}
 
-	struct mrsh_pipeline *p = mrsh_pipeline_create(&commands, bang);
+	struct mrsh_pipeline *p = pipeline_create(parser->arena, &commands, bang);
 	p->bang_pos = bang_pos;
 	return p;
 
 error_commands:
 	for (size_t i = 0; i < commands.len; ++i) {
-		mrsh_command_destroy((struct mrsh_command *)commands.data[i]);
+		ast_command_destroy(parser->arena, commands.data[i]);
 	}
-	mrsh_array_finish(&commands);
+	ast_array_finish(parser->arena, &commands);
 	return NULL;
 }
 
@@ -1043,12 +1062,13 @@ static struct mrsh_and_or_list *and_or(struct mrsh_parser *parser) {
 	linebreak(parser);
 	struct mrsh_and_or_list *and_or_list = and_or(parser);
 	if (and_or_list == NULL) {
-		mrsh_and_or_list_destroy(&pl->and_or_list);
+		ast_and_or_list_destroy(parser->arena, &pl->and_or_list);
 		parser_set_error(parser, "expected an AND-OR list");
 		return NULL;
 	}
 
-	struct mrsh_binop *binop = mrsh_binop_create(binop_type, &pl->and_or_list, and_or_list);
+	struct mrsh_binop *binop = binop_create(parser->arena, binop_type,
+		&pl->and_or_list, and_or_list);
 	binop->op_range = op_range;
 	return &binop->and_or_list;
 }
@@ -1059,7 +1079,7 @@ static struct mrsh_command_list *list(struct mrsh_parser *parser) {
 		return NULL;
 	}
 
-	struct mrsh_command_list *cmd = mrsh_command_list_create();
+	struct mrsh_command_list *cmd = command_list_create(parser->arena);
 	cmd->and_or_list = and_or_list;
 
 	struct mrsh_position separator_pos = parser->pos;
@@ -1078,17 +1098,17 @@ static struct mrsh_command_list *list(struct mrsh_parser *parser) {
  * Append a new string word to `children` with the contents of `buf`, and reset
  * `buf`.
  */
-static void push_buffer_word_string(struct mrsh_array *children,
-		struct mrsh_buffer *buf) {
+static void push_buffer_word_string(struct mrsh_parser *parser,
+		struct mrsh_array *children, struct mrsh_buffer *buf) {
 	if (buf->len == 0) {
 		return;
 	}
 
-	mrsh_buffer_append_char(buf, '\0');
-
-	char *data = mrsh_buffer_steal(buf);
-	struct mrsh_word_string *ws = mrsh_word_string_create(data, false);
-	mrsh_array_add(children, &ws->word);
+	char *data = ast_strndup(parser->arena, buf->data, buf->len);
+	buf->len = 0;
+	struct mrsh_word_string *ws =
+		word_string_create(parser->arena, data, false);
+	ast_array_add(parser->arena, children, &ws->word);
 }
 
 static struct mrsh_word *here_document_line(struct mrsh_parser *parser) {
@@ -1096,25 +1116,29 @@ static struct mrsh_word *here_document_line(struct mrsh_parser *parser) {
 	struct mrsh_buffer buf = {0};
 
 	while (true) {
+		if (parser_read_span(parser, "$`\\", &buf) > 0) {
+			continue;
+		}
+
 		char c = parser_peek_char(parser);
 		if (c == '\0') {
 			break;
 		}
 
 		if (c == '$') {
-			push_buffer_word_string(&children, &buf);
+			push_buffer_word_string(parser, &children, &buf);
 			struct mrsh_word *t = expect_dollar(parser);
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
 		if (c == '`') {
-			push_buffer_word_string(&children, &buf);
+			push_buffer_word_string(parser, &children, &buf);
 			struct mrsh_word *t = back_quotes(parser);
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -1137,15 +1161,17 @@ static struct mrsh_word *here_document_line(struct mrsh_parser *parser) {
 		mrsh_buffer_append_char(&buf, c);
 	}
 
-	push_buffer_word_string(&children, &buf);
+	push_buffer_word_string(parser, &children, &buf);
 	mrsh_buffer_finish(&buf);
 
 	if (children.len == 1) {
 		struct mrsh_word *word = children.data[0];
-		mrsh_array_finish(&children); // TODO: don't allocate this array
+		// TODO: don't allocate this array
+		ast_array_finish(parser->arena, &children);
 		return word;
 	} else {
-		struct mrsh_word_list *wl = mrsh_word_list_create(&children, false);
+		struct mrsh_word_list *wl =
+			word_list_create(parser->arena, &children, false);
 		return &wl->word;
 	}
 }
@@ -1182,14 +1208,7 @@ static bool expect_here_document(struct mrsh_parser *parser,
 	struct mrsh_buffer buf = {0};
 	while (true) {
 		buf.len = 0;
-		while (true) {
-			char c = parser_peek_char(parser);
-			if (c == '\0' || c == '\n') {
-				break;
-			}
-
-			mrsh_buffer_append_char(&buf, parser_read_char(parser));
-		}
+		parser_read_span(parser, "\n", &buf);
 		mrsh_buffer_append_char(&buf, '\0');
 
 		const char *line = buf.data;
@@ -1215,15 +1234,17 @@ static bool expect_here_document(struct mrsh_parser *parser,
 		if (expand_lines) {
 			struct mrsh_parser *subparser =
 				mrsh_parser_with_data(line, strlen(line));
+			subparser->arena = parser->arena;
 			word = here_document_line(subparser);
 			mrsh_parser_destroy(subparser);
 		} else {
 			struct mrsh_word_string *ws =
-				mrsh_word_string_create(strdup(line), true);
+				word_string_create(parser->arena,
+					ast_strdup(parser->arena, line), true);
 			word = &ws->word;
 		}
 
-		mrsh_array_add(&redir->here_document, word);
+		ast_array_add(parser->arena, &redir->here_document, word);
 	}
 	mrsh_buffer_finish(&buf);
 
@@ -1231,20 +1252,27 @@ static bool expect_here_document(struct mrsh_parser *parser,
 	return true;
 }
 
+/**
+ * Parses a complete command and the here-documents it refers to. Reading the
+ * here-documents consumes the newline ending the command, in which case
+ * `newline_read` is set.
+ */
 static bool complete_command(struct mrsh_parser *parser,
-		struct mrsh_array *cmds) {
+		struct mrsh_array *cmds, bool *newline_read) {
+	*newline_read = false;
+
 	struct mrsh_command_list *l = list(parser);
 	if (l == NULL) {
 		return false;
 	}
-	mrsh_array_add(cmds, l);
+	ast_array_add(parser->arena, cmds, l);
 
 	while (true) {
 		l = list(parser);
 		if (l == NULL) {
 			break;
 		}
-		mrsh_array_add(cmds, l);
+		ast_array_add(parser->arena, cmds, l);
 	}
 
 	if (parser->here_documents.len > 0) {
@@ -1266,14 +1294,15 @@ static bool complete_command(struct mrsh_parser *parser,
 		}
 
 		parser->here_documents.len = 0;
+		*newline_read = true;
 	}
 
 	return true;
 }
 
 static bool expect_complete_command(struct mrsh_parser *parser,
-		struct mrsh_array *cmds) {
-	if (!complete_command(parser, cmds)) {
+		struct mrsh_array *cmds, bool *newline_read) {
+	if (!complete_command(parser, cmds, newline_read)) {
 		parser_set_error(parser, "expected a complete command");
 		return false;
 	}
@@ -1282,7 +1311,7 @@ static bool expect_complete_command(struct mrsh_parser *parser,
 }
 
 static struct mrsh_program *program(struct mrsh_parser *parser) {
-	struct mrsh_program *prog = mrsh_program_create();
+	struct mrsh_program *prog = program_create(parser->arena);
 	if (prog == NULL) {
 		return NULL;
 	}
@@ -1292,17 +1321,18 @@ static struct mrsh_program *program(struct mrsh_parser *parser) {
 		return prog;
 	}
 
-	if (!expect_complete_command(parser, &prog->body)) {
-		mrsh_program_destroy(prog);
+	bool newline_read;
+	if (!expect_complete_command(parser, &prog->body, &newline_read)) {
+		ast_program_destroy(parser->arena, prog);
 		return NULL;
 	}
 
-	while (newline_list(parser)) {
+	while (newline_list(parser) || newline_read) {
 		if (eof(parser)) {
 			return prog;
 		}
 
-		if (!complete_command(parser, &prog->body)) {
+		if (!complete_command(parser, &prog->body, &newline_read)) {
 			break;
 		}
 	}
@@ -1311,14 +1341,70 @@ static struct mrsh_program *program(struct mrsh_parser *parser) {
 	return prog;
 }
 
-struct mrsh_program *mrsh_parse_line(struct mrsh_parser *parser) {
+struct mrsh_command *parse_function_body(struct mrsh_parser *parser,
+		struct mrsh_arena *arena) {
 	parser_begin(parser);
+	parser->arena = arena;
+
+	struct mrsh_command *cmd = compound_command(parser);
+	if (cmd == NULL) {
+		parser_set_error(parser, "expected a compound command");
+	} else if (!eof(parser)) {
+		parser_set_error(parser, "expected the end of the function body");
+		cmd = NULL;
+	}
+
+	parser->arena = NULL;
+	return cmd;
+}
+
+typedef struct mrsh_program *(*program_func)(struct mrsh_parser *parser);
+
+/**
+ * Parses a program with `f`. If enabled, its nodes, strings and arrays are
+ * allocated from an arena owned by the program. Programs nested in another
+ * one, e.g. in command substitutions, are allocated from the arena of the
+ * outermost program.
+ */
+static struct mrsh_program *parse_in_arena(struct mrsh_parser *parser,
+		program_func f) {
+	if (parser->arena != NULL) {
+		return f(parser);
+	}
+	if (!parser->use_arena) {
+		struct mrsh_program *prog = f(parser);
+		if (prog != NULL) {
+			program_set_line_table(prog, parser->lines);
+		}
+		return prog;
+	}
+
+	struct mrsh_arena *arena = calloc(1, sizeof(struct mrsh_arena));
+	if (arena == NULL) {
+		return NULL;
+	}
+
+	parser->arena = arena;
+	struct mrsh_program *prog = f(parser);
+	parser->arena = NULL;
+
+	if (prog == NULL) {
+		arena_finish(arena);
+		free(arena);
+		return NULL;
+	}
+	program_set_arena(prog, arena);
+	program_set_line_table(prog, parser->lines);
+	return prog;
+}
+
+static struct mrsh_program *line(struct mrsh_parser *parser) {
 
 	if (eof(parser)) {
 		return NULL;
 	}
 
-	struct mrsh_program *prog = mrsh_program_create();
+	struct mrsh_program *prog = program_create(parser->arena);
 	if (prog == NULL) {
 		return NULL;
 	}
@@ -1327,10 +1413,11 @@ struct mrsh_program *mrsh_parse_line(struct mrsh_parser *parser) {
 		return prog;
 	}
 
-	if (!expect_complete_command(parser, &prog->body)) {
+	bool newline_read;
+	if (!expect_complete_command(parser, &prog->body, &newline_read)) {
 		goto error;
 	}
-	if (!eof(parser) && !newline(parser)) {
+	if (!newline_read && !eof(parser) && !newline(parser)) {
 		parser_set_error(parser, "expected a newline");
 		goto error;
 	}
@@ -1338,7 +1425,7 @@ struct mrsh_program *mrsh_parse_line(struct mrsh_parser *parser) {
 	return prog;
 
 error:
-	mrsh_program_destroy(prog);
+	ast_program_destroy(parser->arena, prog);
 
 	// Consume the whole line
 	while (true) {
@@ -1358,7 +1445,18 @@ error:
 	return NULL;
 }
 
+struct mrsh_program *mrsh_parse_line(struct mrsh_parser *parser) {
+	parser_begin(parser);
+	// Only the newlines of the lines still to be parsed are needed, so that
+	// memory doesn't grow with the size of the input
+	if (parser->lines != NULL && parser->pos.offset1 != 0) {
+		parser->lines = line_table_trim(parser->lines, parser->pos.offset1);
+	}
+	parser->line_begun = parser->buf.len > 0;
+	return parse_in_arena(parser, line);
+}
+
 struct mrsh_program *mrsh_parse_program(struct mrsh_parser *parser) {
 	parser_begin(parser);
-	return program(parser);
+	return parse_in_arena(parser, program);
 }
@@ -0,0 +1,605 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include "parser.h"
+
+#define SKIM_MAX_DEPTH 64
+
+/**
+ * A skimmer finds where a compound command ends by only looking at what
+ * delimits it: quotes, nested commands, the reserved words of brace groups and
+ * case clauses, and here-documents. It works on the parser's lookahead buffer.
+ *
+ * Whenever it isn't sure about something, the skimmer gives up and the command
+ * is parsed as usual. Aliases aren't expanded.
+ */
+struct skimmer {
+	struct mrsh_parser *parser;
+	size_t i; // offset in the parser buffer
+	int depth;
+	struct mrsh_array here_documents; // struct skim_here_document *
+};
+
+struct skim_here_document {
+	char *delim;
+	bool dash;
+};
+
+enum skim_end {
+	SKIM_BRACE, // }
+	SKIM_PAREN, // )
+	SKIM_CASE_ITEM, // ;; or esac
+};
+
+static char peek_at(struct skimmer *s, size_t k) {
+	size_t n = s->i + k + 1;
+	if (parser_peek(s->parser, NULL, n) < n) {
+		return '\0';
+	}
+	return s->parser->buf.data[s->i + k];
+}
+
+static char cur(struct skimmer *s) {
+	return peek_at(s, 0);
+}
+
+static bool is_word_end(char c) {
+	switch (c) {
+	case '\0':
+	case ' ':
+	case '\t':
+	case '\n':
+	case ';':
+	case '&':
+	case '|':
+	case '<':
+	case '>':
+	case '(':
+	case ')':
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool skim_list(struct skimmer *s, enum skim_end end, bool *esac);
+static bool skim_dollar(struct skimmer *s);
+
+static bool skim_backquotes(struct skimmer *s) {
+	++s->i;
+	while (true) {
+		switch (cur(s)) {
+		case '\0':
+			return false;
+		case '`':
+			++s->i;
+			return true;
+		case '\\':
+			if (peek_at(s, 1) == '\0') {
+				return false;
+			}
+			s->i += 2;
+			break;
+		default:
+			++s->i;
+		}
+	}
+}
+
+static bool skim_double_quotes(struct skimmer *s) {
+	++s->i;
+	while (true) {
+		switch (cur(s)) {
+		case '\0':
+			return false;
+		case '"':
+			++s->i;
+			return true;
+		case '\\':
+			if (peek_at(s, 1) == '\0') {
+				return false;
+			}
+			s->i += 2;
+			break;
+		case '$':
+			if (!skim_dollar(s)) {
+				return false;
+			}
+			break;
+		case '`':
+			if (!skim_backquotes(s)) {
+				return false;
+			}
+			break;
+		default:
+			++s->i;
+		}
+	}
+}
+
+static bool skim_single_quotes(struct skimmer *s) {
+	++s->i;
+	while (true) {
+		char c = cur(s);
+		++s->i;
+		if (c == '\0') {
+			return false;
+		} else if (c == '\'') {
+			return true;
+		}
+	}
+}
+
+static bool skim_arithmetic(struct skimmer *s) {
+	s->i += 3; // $((
+	int parens = 2;
+	while (parens > 0) {
+		switch (cur(s)) {
+		case '\0':
+		case '\'':
+		case '"':
+		case '`':
+			return false;
+		case '(':
+			++parens;
+			break;
+		case ')':
+			--parens;
+			break;
+		}
+		++s->i;
+	}
+	return true;
+}
+
+static bool skim_parameter(struct skimmer *s) {
+	s->i += 2; // ${
+	while (true) {
+		switch (cur(s)) {
+		case '\0':
+			return false;
+		case '}':
+			++s->i;
+			return true;
+		case '\\':
+			if (peek_at(s, 1) == '\0') {
+				return false;
+			}
+			s->i += 2;
+			break;
+		case '\'':
+			// Single quotes are only special outside of double quotes
+			return false;
+		case '"':
+			if (!skim_double_quotes(s)) {
+				return false;
+			}
+			break;
+		case '$':
+			if (!skim_dollar(s)) {
+				return false;
+			}
+			break;
+		case '`':
+			if (!skim_backquotes(s)) {
+				return false;
+			}
+			break;
+		default:
+			++s->i;
+		}
+	}
+}
+
+static bool skim_dollar(struct skimmer *s) {
+	char next = peek_at(s, 1);
+	if (next == '(' && peek_at(s, 2) == '(') {
+		return skim_arithmetic(s);
+	} else if (next == '(') {
+		s->i += 2;
+		return skim_list(s, SKIM_PAREN, NULL);
+	} else if (next == '{') {
+		return skim_parameter(s);
+	}
+	++s->i;
+	return true;
+}
+
+/**
+ * Skims a word, leaving `s->i` right after it. Returns false if the word is
+ * empty or malformed.
+ */
+static bool skim_word(struct skimmer *s) {
+	size_t begin = s->i;
+	while (true) {
+		char c = cur(s);
+		if (is_word_end(c)) {
+			return c != '\0' && s->i > begin;
+		}
+
+		bool ok = true;
+		switch (c) {
+		case '\\':
+			if (peek_at(s, 1) == '\0') {
+				return false;
+			}
+			s->i += 2;
+			break;
+		case '\'':
+			ok = skim_single_quotes(s);
+			break;
+		case '"':
+			ok = skim_double_quotes(s);
+			break;
+		case '`':
+			ok = skim_backquotes(s);
+			break;
+		case '$':
+			ok = skim_dollar(s);
+			break;
+		default:
+			++s->i;
+		}
+		if (!ok) {
+			return false;
+		}
+	}
+}
+
+static bool word_equals(struct skimmer *s, size_t begin, const char *str) {
+	size_t len = strlen(str);
+	return s->i - begin == len &&
+		memcmp(&s->parser->buf.data[begin], str, len) == 0;
+}
+
+static void skip_blanks(struct skimmer *s) {
+	while (true) {
+		char c = cur(s);
+		if (c == ' ' || c == '\t') {
+			++s->i;
+		} else if (c == '\\' && peek_at(s, 1) == '\n') {
+			s->i += 2;
+		} else {
+			break;
+		}
+	}
+}
+
+static void skip_comment(struct skimmer *s) {
+	while (true) {
+		char c = cur(s);
+		if (c == '\0' || c == '\n') {
+			break;
+		}
+		++s->i;
+	}
+}
+
+/**
+ * Skims the here-document delimiter after a << or <<- operator, and records it
+ * so that the here-document can be skipped at the end of the line.
+ */
+static bool skim_here_document_delim(struct skimmer *s, bool dash) {
+	skip_blanks(s);
+	size_t begin = s->i;
+	if (!skim_word(s)) {
+		return false;
+	}
+
+	const char *data = &s->parser->buf.data[begin];
+	size_t len = s->i - begin;
+	char *delim = malloc(len + 1);
+	struct skim_here_document *hd = malloc(sizeof(*hd));
+	if (delim == NULL || hd == NULL) {
+		free(delim);
+		free(hd);
+		return false;
+	}
+
+	// Quote removal
+	size_t delim_len = 0;
+	for (size_t j = 0; j < len; ++j) {
+		if (data[j] == '\'' || data[j] == '"') {
+			continue;
+		}
+		if (data[j] == '\\' && j + 1 < len) {
+			++j;
+		}
+		delim[delim_len++] = data[j];
+	}
+	delim[delim_len] = '\0';
+
+	hd->delim = delim;
+	hd->dash = dash;
+	mrsh_array_add(&s->here_documents, hd);
+	return true;
+}
+
+/**
+ * Skips the bodies of the pending here-documents, at the start of a line.
+ */
+static bool skim_here_documents(struct skimmer *s) {
+	for (size_t j = 0; j < s->here_documents.len; ++j) {
+		struct skim_here_document *hd = s->here_documents.data[j];
+		while (true) {
+			if (hd->dash) {
+				while (cur(s) == '\t') {
+					++s->i;
+				}
+			}
+			size_t begin = s->i;
+			skip_comment(s); // skips to the end of the line
+			if (cur(s) == '\0') {
+				return false;
+			}
+			bool end = word_equals(s, begin, hd->delim);
+			++s->i;
+			if (end) {
+				break;
+			}
+		}
+		free(hd->delim);
+		free(hd);
+	}
+	s->here_documents.len = 0;
+	return true;
+}
+
+static bool skim_redirect(struct skimmer *s) {
+	char c = cur(s);
+	++s->i;
+	char next = cur(s);
+	if (c == '<' && next == '<') {
+		++s->i;
+		bool dash = cur(s) == '-';
+		if (dash) {
+			++s->i;
+		}
+		return skim_here_document_delim(s, dash);
+	}
+	if (next == '&' || next == '>' || (c == '>' && next == '|')) {
+		++s->i;
+	}
+	skip_blanks(s);
+	return skim_word(s);
+}
+
+static bool skim_case_clause(struct skimmer *s) {
+	skip_blanks(s);
+	if (!skim_word(s)) {
+		return false;
+	}
+	while (true) {
+		skip_blanks(s);
+		if (cur(s) != '\n') {
+			break;
+		}
+		++s->i;
+		if (!skim_here_documents(s)) {
+			return false;
+		}
+	}
+	size_t begin = s->i;
+	if (!skim_word(s) || !word_equals(s, begin, "in")) {
+		return false;
+	}
+
+	while (true) {
+		skip_blanks(s);
+		char c = cur(s);
+		if (c == '\n') {
+			++s->i;
+			if (!skim_here_documents(s)) {
+				return false;
+			}
+			continue;
+		} else if (c == '#') {
+			skip_comment(s);
+			continue;
+		} else if (c == '(') {
+			++s->i;
+			skip_blanks(s);
+		}
+
+		begin = s->i;
+		if (!skim_word(s)) {
+			return false;
+		}
+		if (c != '(' && word_equals(s, begin, "esac")) {
+			return true;
+		}
+
+		// Patterns
+		while (true) {
+			skip_blanks(s);
+			c = cur(s);
+			if (c == ')') {
+				++s->i;
+				break;
+			} else if (c != '|') {
+				return false;
+			}
+			++s->i;
+			skip_blanks(s);
+			if (!skim_word(s)) {
+				return false;
+			}
+		}
+
+		bool esac = false;
+		if (!skim_list(s, SKIM_CASE_ITEM, &esac)) {
+			return false;
+		}
+		if (esac) {
+			return true;
+		}
+	}
+}
+
+/**
+ * Skims a list of commands up to the terminator `end`, which is consumed. For
+ * case items, `esac` is set if the list is ended by the esac reserved word
+ * instead of ;;.
+ */
+static bool skim_list(struct skimmer *s, enum skim_end end, bool *esac) {
+	if (s->depth >= SKIM_MAX_DEPTH) {
+		return false;
+	}
+	++s->depth;
+
+	bool ok = false;
+	bool cmd_start = true; // true if reserved words are recognized
+	bool prefix = false; // true after an assignment starting a command
+	while (true) {
+		char c = cur(s);
+		switch (c) {
+		case '\0':
+			goto out;
+		case ' ':
+		case '\t':
+			++s->i;
+			continue;
+		case '\\':
+			if (peek_at(s, 1) == '\n') {
+				s->i += 2;
+				continue;
+			}
+			break;
+		case '#':
+			skip_comment(s);
+			continue;
+		case '\n':
+			++s->i;
+			if (!skim_here_documents(s)) {
+				goto out;
+			}
+			cmd_start = true;
+			prefix = false;
+			continue;
+		case ';':
+			++s->i;
+			if (cur(s) == ';') {
+				++s->i;
+				ok = end == SKIM_CASE_ITEM;
+				goto out;
+			}
+			cmd_start = true;
+			prefix = false;
+			continue;
+		case '&':
+		case '|':
+			++s->i;
+			if (cur(s) == c) {
+				++s->i;
+			}
+			cmd_start = true;
+			prefix = false;
+			continue;
+		case '(':
+			++s->i;
+			if (cmd_start && !prefix) {
+				if (!skim_list(s, SKIM_PAREN, NULL)) {
+					goto out;
+				}
+				cmd_start = false;
+			} else {
+				// Function definition
+				skip_blanks(s);
+				if (cur(s) != ')') {
+					goto out;
+				}
+				++s->i;
+				cmd_start = true;
+			}
+			continue;
+		case ')':
+			++s->i;
+			ok = end == SKIM_PAREN;
+			goto out;
+		case '<':
+		case '>':
+			if (!skim_redirect(s)) {
+				goto out;
+			}
+			cmd_start = false;
+			continue;
+		}
+
+		size_t begin = s->i;
+		if (!skim_word(s)) {
+			goto out;
+		}
+		if (!cmd_start) {
+			continue;
+		}
+
+		if (word_equals(s, begin, "{") || word_equals(s, begin, "}")) {
+			// Reserved words aren't recognized after an assignment
+			if (prefix) {
+				goto out;
+			}
+			if (s->parser->buf.data[begin] == '}') {
+				ok = end == SKIM_BRACE;
+				goto out;
+			}
+			if (!skim_list(s, SKIM_BRACE, NULL)) {
+				goto out;
+			}
+			cmd_start = false;
+		} else if (word_equals(s, begin, "esac") && !prefix) {
+			if (end == SKIM_CASE_ITEM) {
+				*esac = true;
+				ok = true;
+			}
+			goto out;
+		} else if (word_equals(s, begin, "case") && !prefix) {
+			if (!skim_case_clause(s)) {
+				goto out;
+			}
+			cmd_start = false;
+		} else if (!prefix && (word_equals(s, begin, "if") ||
+				word_equals(s, begin, "then") ||
+				word_equals(s, begin, "else") ||
+				word_equals(s, begin, "elif") ||
+				word_equals(s, begin, "while") ||
+				word_equals(s, begin, "until") ||
+				word_equals(s, begin, "do") ||
+				word_equals(s, begin, "!"))) {
+			// The next word starts a command
+		} else if (memchr(&s->parser->buf.data[begin], '=',
+				s->i - begin) != NULL) {
+			prefix = true;
+		} else {
+			cmd_start = false;
+		}
+	}
+
+out:
+	--s->depth;
+	return ok;
+}
+
+size_t skim_compound_command(struct mrsh_parser *parser) {
+	struct skimmer s = { .parser = parser };
+
+	bool ok;
+	if (cur(&s) == '(') {
+		++s.i;
+		ok = skim_list(&s, SKIM_PAREN, NULL);
+	} else {
+		ok = skim_word(&s) && word_equals(&s, 0, "{") &&
+			skim_list(&s, SKIM_BRACE, NULL);
+	}
+
+	// Here-documents whose body follows the compound command aren't supported
+	ok = ok && s.here_documents.len == 0;
+
+	for (size_t j = 0; j < s.here_documents.len; ++j) {
+		struct skim_here_document *hd = s.here_documents.data[j];
+		free(hd->delim);
+		free(hd);
+	}
+	mrsh_array_finish(&s.here_documents);
+
+	return ok ? s.i : 0;
+}
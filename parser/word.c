@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include "ast.h"
+#include "intern.h"
 #include "parser.h"
 
 static struct mrsh_word *single_quotes(struct mrsh_parser *parser) {
@@ -20,9 +21,12 @@ static struct mrsh_word *single_quotes(struct mrsh_parser *parser) {
 	struct mrsh_buffer buf = {0};
 
 	while (true) {
+		parser_read_span(parser, "'\n", &buf);
+
 		char c = parser_peek_char(parser);
 		if (c == '\0') {
 			parser_set_error(parser, "single quotes not terminated");
+			mrsh_buffer_finish(&buf);
 			return NULL;
 		}
 		if (c == '\'') {
@@ -30,18 +34,13 @@ static struct mrsh_word *single_quotes(struct mrsh_parser *parser) {
 			break;
 		}
 
-		if (c == '\n') {
-			read_continuation_line(parser);
-		} else {
-			parser_read_char(parser);
-		}
-
+		read_continuation_line(parser);
 		mrsh_buffer_append_char(&buf, c);
 	}
 
-	mrsh_buffer_append_char(&buf, '\0');
-	char *data = mrsh_buffer_steal(&buf);
-	struct mrsh_word_string *ws = mrsh_word_string_create(data, true);
+	char *data = ast_strndup(parser->arena, buf.data, buf.len);
+	mrsh_buffer_finish(&buf);
+	struct mrsh_word_string *ws = word_string_create(parser->arena, data, true);
 	ws->range.begin = begin;
 	ws->range.end = parser->pos;
 	return &ws->word;
@@ -58,7 +57,9 @@ size_t peek_name(struct mrsh_parser *parser, bool in_braces) {
 
 	size_t i = 0;
 	while (true) {
-		parser_peek(parser, NULL, i + 1);
+		if (i == parser->buf.len && parser_peek(parser, NULL, i + 1) <= i) {
+			break;
+		}
 
 		char c = parser->buf.data[i];
 		if (c != '_' && !isalnum(c)) {
@@ -80,24 +81,16 @@ size_t peek_word(struct mrsh_parser *parser, char end) {
 
 	size_t i = 0;
 	while (true) {
-		parser_peek(parser, NULL, i + 1);
-
-		char c = parser->buf.data[i];
-
-		switch (c) {
-		case '\0':
-		case '\n':
-		case ')':
+		if (i == parser->buf.len && parser_peek(parser, NULL, i + 1) <= i) {
 			return i;
-		case '$':
-		case '`':
-		case '\'':
-		case '"':
-		case '\\': // TODO: allow backslash in words
-			return 0;
 		}
 
-		if (is_operator_start(c) || isblank(c) || c == end) {
+		char c = parser->buf.data[i];
+		unsigned char class = char_classes[(unsigned char)c];
+		if (class & CHAR_WORD_SPECIAL) {
+			return 0; // TODO: allow backslash in words
+		}
+		if ((class & CHAR_WORD_END) || c == end) {
 			return i;
 		}
 
@@ -116,10 +109,12 @@ bool token(struct mrsh_parser *parser, const char *str,
 	size_t len = strlen(str);
 	assert(len > 0);
 
+	// Most attempts are rejected by the first character
+	if (parser_peek_char(parser) != str[0]) {
+		return false;
+	}
+
 	if (len == 1 && !isalpha(str[0])) {
-		if (parser_peek_char(parser) != str[0]) {
-			return false;
-		}
 		parser_read_char(parser);
 	} else {
 		size_t word_len = peek_word(parser, 0);
@@ -159,9 +154,8 @@ char *read_token(struct mrsh_parser *parser, size_t len,
 
 	struct mrsh_position begin = parser->pos;
 
-	char *tok = malloc(len + 1);
+	char *tok = ast_alloc(parser->arena, len + 1);
 	parser_read(parser, tok, len);
-	tok[len] = '\0';
 
 	if (range != NULL) {
 		range->begin = begin;
@@ -172,6 +166,27 @@ char *read_token(struct mrsh_parser *parser, size_t len,
 	return tok;
 }
 
+const char *read_name(struct mrsh_parser *parser, size_t len,
+		struct mrsh_range *range) {
+	if (!symbol(parser, TOKEN)) {
+		return NULL;
+	}
+
+	struct mrsh_position begin = parser->pos;
+
+	parser_peek(parser, NULL, len);
+	const char *name = intern_n(parser->buf.data, len);
+	parser_read(parser, NULL, len);
+
+	if (range != NULL) {
+		range->begin = begin;
+		range->end = parser->pos;
+	}
+
+	consume_symbol(parser);
+	return name;
+}
+
 static struct mrsh_word *word_list(struct mrsh_parser *parser, char end,
 		word_func f) {
 	struct mrsh_array children = {0};
@@ -185,7 +200,7 @@ static struct mrsh_word *word_list(struct mrsh_parser *parser, char end,
 		if (child == NULL) {
 			break;
 		}
-		mrsh_array_add(&children, child);
+		ast_array_add(parser->arena, &children, child);
 
 		struct mrsh_position begin = parser->pos;
 		struct mrsh_buffer buf = {0};
@@ -199,12 +214,11 @@ static struct mrsh_word *word_list(struct mrsh_parser *parser, char end,
 		if (buf.len == 0) {
 			break; // word() ended on a non-blank char, stop here
 		}
-		mrsh_buffer_append_char(&buf, '\0');
-		struct mrsh_word_string *ws =
-			mrsh_word_string_create(mrsh_buffer_steal(&buf), false);
+		struct mrsh_word_string *ws = word_string_create(parser->arena, 
+			ast_strndup(parser->arena, buf.data, buf.len), false);
 		ws->range.begin = begin;
 		ws->range.end = parser->pos;
-		mrsh_array_add(&children, &ws->word);
+		ast_array_add(parser->arena, &children, &ws->word);
 		mrsh_buffer_finish(&buf);
 	}
 
@@ -212,10 +226,11 @@ static struct mrsh_word *word_list(struct mrsh_parser *parser, char end,
 		return NULL;
 	} else if (children.len == 1) {
 		struct mrsh_word *child = children.data[0];
-		mrsh_array_finish(&children);
+		ast_array_finish(parser->arena, &children);
 		return child;
 	} else {
-		struct mrsh_word_list *wl = mrsh_word_list_create(&children, false);
+		struct mrsh_word_list *wl =
+			word_list_create(parser->arena, &children, false);
 		return &wl->word;
 	}
 }
@@ -299,7 +314,7 @@ static struct mrsh_word_parameter *expect_parameter_expression(
 	}
 
 	struct mrsh_range name_range;
-	char *name = read_token(parser, name_len, &name_range);
+	const char *name = read_name(parser, name_len, &name_range);
 	if (name == NULL) {
 		return NULL;
 	}
@@ -309,6 +324,7 @@ static struct mrsh_word_parameter *expect_parameter_expression(
 	if (op == MRSH_PARAM_NONE && parser_peek_char(parser) != '}') {
 		op_range.begin = parser->pos;
 		if (!expect_parameter_op(parser, &op, &colon)) {
+			atom_unref(name);
 			return NULL;
 		}
 		op_range.end = parser->pos;
@@ -318,11 +334,13 @@ static struct mrsh_word_parameter *expect_parameter_expression(
 	struct mrsh_position rbrace_pos = parser->pos;
 	if (parser_read_char(parser) != '}') {
 		parser_set_error(parser, "expected end of parameter");
+		atom_unref(name);
+		ast_word_destroy(parser->arena, arg);
 		return NULL;
 	}
 
 	struct mrsh_word_parameter *wp =
-		mrsh_word_parameter_create(name, op, colon, arg);
+		word_parameter_create(parser->arena, name, op, colon, arg);
 	wp->name_range = name_range;
 	wp->op_range = op_range;
 	wp->lbrace_pos = lbrace_pos;
@@ -345,7 +363,7 @@ static struct mrsh_word_command *expect_word_command(
 	struct mrsh_program *prog = mrsh_parse_program(parser);
 	parser->alias = alias;
 	if (mrsh_parser_error(parser, NULL) != NULL) {
-		mrsh_program_destroy(prog);
+		ast_program_destroy(parser->arena, prog);
 		return NULL;
 	} else if (prog == NULL) {
 		parser_set_error(parser, "expected a program");
@@ -353,11 +371,11 @@ static struct mrsh_word_command *expect_word_command(
 	}
 
 	if (!expect_token(parser, ")", NULL)) {
-		mrsh_program_destroy(prog);
+		ast_program_destroy(parser->arena, prog);
 		return NULL;
 	}
 
-	return mrsh_word_command_create(prog, false);
+	return word_command_create(parser->arena, prog, false);
 }
 
 static struct mrsh_word_arithmetic *expect_word_arithmetic(
@@ -377,15 +395,15 @@ static struct mrsh_word_arithmetic *expect_word_arithmetic(
 	}
 
 	if (!expect_token(parser, ")", NULL)) {
-		mrsh_word_destroy(body);
+		ast_word_destroy(parser->arena, body);
 		return NULL;
 	}
 	if (!expect_token(parser, ")", NULL)) {
-		mrsh_word_destroy(body);
+		ast_word_destroy(parser->arena, body);
 		return NULL;
 	}
 
-	return mrsh_word_arithmetic_create(body);
+	return word_arithmetic_create(parser->arena, body);
 }
 
 // Expect parameter expansion or command substitution
@@ -421,7 +439,8 @@ struct mrsh_word *expect_dollar(struct mrsh_parser *parser) {
 			if (wc == NULL) {
 				return NULL;
 			}
-			// TODO: store dollar_pos in wc
+			wc->range.begin = dollar_pos;
+			wc->range.end = parser->pos;
 			return &wc->word;
 		}
 	default:; // Parameter expansion in the form `$parameter`
@@ -452,12 +471,13 @@ struct mrsh_word *expect_dollar(struct mrsh_parser *parser) {
 		}
 
 		struct mrsh_range name_range;
-		char *name = read_token(parser, name_len, &name_range);
+		const char *name = read_name(parser, name_len, &name_range);
 		if (name == NULL) {
 			return NULL;
 		}
 
-		wp = mrsh_word_parameter_create(name, MRSH_PARAM_NONE, false, NULL);
+		wp = word_parameter_create(parser->arena, name, MRSH_PARAM_NONE,
+			false, NULL);
 		wp->dollar_pos = dollar_pos;
 		wp->name_range = name_range;
 		return &wp->word;
@@ -509,19 +529,22 @@ struct mrsh_word *back_quotes(struct mrsh_parser *parser) {
 	if (subparser == NULL) {
 		goto error;
 	}
+	// The program is nested in the one being parsed
+	subparser->arena = parser->arena;
 	struct mrsh_program *prog = mrsh_parse_program(subparser);
 	const char *err_msg = mrsh_parser_error(subparser, NULL);
 	if (err_msg != NULL) {
 		// TODO: how should we handle subparser error position?
 		parser_set_error(parser, err_msg);
-		mrsh_program_destroy(prog);
+		ast_program_destroy(parser->arena, prog);
 		goto error;
 	}
 	mrsh_parser_destroy(subparser);
 
 	mrsh_buffer_finish(&buf);
 
-	struct mrsh_word_command *wc = mrsh_word_command_create(prog, true);
+	struct mrsh_word_command *wc =
+		word_command_create(parser->arena, prog, true);
 	wc->range.begin = begin;
 	wc->range.end = parser->pos;
 	return &wc->word;
@@ -544,13 +567,13 @@ static void push_buffer_word_string(struct mrsh_parser *parser,
 		return;
 	}
 
-	mrsh_buffer_append_char(buf, '\0');
-
-	char *data = mrsh_buffer_steal(buf);
-	struct mrsh_word_string *ws = mrsh_word_string_create(data, false);
+	char *data = ast_strndup(parser->arena, buf->data, buf->len);
+	buf->len = 0;
+	struct mrsh_word_string *ws =
+		word_string_create(parser->arena, data, false);
 	ws->range.begin = *child_begin;
 	ws->range.end = parser->pos;
-	mrsh_array_add(children, &ws->word);
+	ast_array_add(parser->arena, children, &ws->word);
 
 	*child_begin = (struct mrsh_position){0};
 }
@@ -573,6 +596,7 @@ static struct mrsh_word *double_quotes(struct mrsh_parser *parser) {
 		char c = parser_peek_char(parser);
 		if (c == '\0') {
 			parser_set_error(parser, "double quotes not terminated");
+			mrsh_buffer_finish(&buf);
 			return NULL;
 		}
 		if (c == '"') {
@@ -588,7 +612,7 @@ static struct mrsh_word *double_quotes(struct mrsh_parser *parser) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -598,7 +622,7 @@ static struct mrsh_word *double_quotes(struct mrsh_parser *parser) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -621,15 +645,19 @@ static struct mrsh_word *double_quotes(struct mrsh_parser *parser) {
 				read_continuation_line(parser);
 				continue;
 			}
+
+			parser_read_char(parser);
+			mrsh_buffer_append_char(&buf, c);
+			continue;
 		}
 
-		parser_read_char(parser);
-		mrsh_buffer_append_char(&buf, c);
+		parser_read_span(parser, "\"$`\\", &buf);
 	}
 
 	mrsh_buffer_finish(&buf);
 
-	struct mrsh_word_list *wl = mrsh_word_list_create(&children, true);
+	struct mrsh_word_list *wl =
+		word_list_create(parser->arena, &children, true);
 	wl->lquote_pos = lquote_pos;
 	wl->rquote_pos = rquote_pos;
 	return &wl->word;
@@ -650,6 +678,10 @@ struct mrsh_word *word(struct mrsh_parser *parser, char end) {
 	struct mrsh_buffer buf = {0};
 	struct mrsh_position child_begin = {0};
 
+	// Characters which end a run of characters without special meaning
+	const char delims[] = { ' ', '\t', '\n', ')', '&', '|', ';', '<', '>',
+		'$', '`', '\'', '"', '\\', end, '\0' };
+
 	while (true) {
 		if (!mrsh_position_valid(&child_begin)) {
 			child_begin = parser->pos;
@@ -660,13 +692,17 @@ struct mrsh_word *word(struct mrsh_parser *parser, char end) {
 			break;
 		}
 
+		if (parser_read_span(parser, delims, &buf) > 0) {
+			continue;
+		}
+
 		if (c == '$') {
 			push_buffer_word_string(parser, &children, &buf, &child_begin);
 			struct mrsh_word *t = expect_dollar(parser);
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -676,7 +712,7 @@ struct mrsh_word *word(struct mrsh_parser *parser, char end) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -687,7 +723,7 @@ struct mrsh_word *word(struct mrsh_parser *parser, char end) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 		if (c == '"') {
@@ -696,7 +732,7 @@ struct mrsh_word *word(struct mrsh_parser *parser, char end) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -724,10 +760,12 @@ struct mrsh_word *word(struct mrsh_parser *parser, char end) {
 
 	if (children.len == 1) {
 		struct mrsh_word *word = children.data[0];
-		mrsh_array_finish(&children); // TODO: don't allocate this array
+		// TODO: don't allocate this array
+		ast_array_finish(parser->arena, &children);
 		return word;
 	} else {
-		struct mrsh_word_list *wl = mrsh_word_list_create(&children, false);
+		struct mrsh_word_list *wl =
+			word_list_create(parser->arena, &children, false);
 		return &wl->word;
 	}
 }
@@ -769,7 +807,7 @@ struct mrsh_word *arithmetic_word(struct mrsh_parser *parser, char end) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -779,7 +817,7 @@ struct mrsh_word *arithmetic_word(struct mrsh_parser *parser, char end) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -790,7 +828,7 @@ struct mrsh_word *arithmetic_word(struct mrsh_parser *parser, char end) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 		if (c == '"') {
@@ -799,7 +837,7 @@ struct mrsh_word *arithmetic_word(struct mrsh_parser *parser, char end) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -840,10 +878,12 @@ struct mrsh_word *arithmetic_word(struct mrsh_parser *parser, char end) {
 
 	if (children.len == 1) {
 		struct mrsh_word *word = children.data[0];
-		mrsh_array_finish(&children); // TODO: don't allocate this array
+		// TODO: don't allocate this array
+		ast_array_finish(parser->arena, &children);
 		return word;
 	} else {
-		struct mrsh_word_list *wl = mrsh_word_list_create(&children, false);
+		struct mrsh_word_list *wl =
+			word_list_create(parser->arena, &children, false);
 		return &wl->word;
 	}
 }
@@ -872,7 +912,7 @@ struct mrsh_word *parameter_expansion_word(struct mrsh_parser *parser) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -882,7 +922,7 @@ struct mrsh_word *parameter_expansion_word(struct mrsh_parser *parser) {
 			if (t == NULL) {
 				return NULL;
 			}
-			mrsh_array_add(&children, t);
+			ast_array_add(parser->arena, &children, t);
 			continue;
 		}
 
@@ -908,10 +948,12 @@ struct mrsh_word *parameter_expansion_word(struct mrsh_parser *parser) {
 
 	if (children.len == 1) {
 		struct mrsh_word *word = children.data[0];
-		mrsh_array_finish(&children); // TODO: don't allocate this array
+		// TODO: don't allocate this array
+		ast_array_finish(parser->arena, &children);
 		return word;
 	} else {
-		struct mrsh_word_list *wl = mrsh_word_list_create(&children, false);
+		struct mrsh_word_list *wl =
+			word_list_create(parser->arena, &children, false);
 		return &wl->word;
 	}
 }
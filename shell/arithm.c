@@ -8,7 +8,7 @@ static bool run_variable(struct mrsh_state *state, const char *name, long *val,
 	if (str == NULL) {
 		if ((state->options & MRSH_OPT_NOUNSET)) {
 			fprintf(stderr, "%s: %s: unbound variable\n",
-					state->frame->argv[0], name);
+					state->frame->argv_0, name);
 			return false;
 		}
 		*val = 0; // POSIX is not clear what to do in this case
@@ -17,7 +17,7 @@ static bool run_variable(struct mrsh_state *state, const char *name, long *val,
 		*val = strtod(str, &end);
 		if (end == str || end[0] != '\0') {
 			fprintf(stderr, "%s: %s: not a number: %s\n",
-					state->frame->argv[0], name, str);
+					state->frame->argv_0, name, str);
 			return false;
 		}
 	}
@@ -40,7 +40,7 @@ static bool run_arithm_binop(struct mrsh_state *state,
 	case MRSH_ARITHM_BINOP_SLASH:
 		if (right == 0) {
 			fprintf(stderr, "%s: division by zero: %ld/%ld\n",
-				state->frame->argv[0], left, right);
+				state->frame->argv_0, left, right);
 			return false;
 		}
 		*result = left / right;
@@ -48,7 +48,7 @@ static bool run_arithm_binop(struct mrsh_state *state,
 	case MRSH_ARITHM_BINOP_PERCENT:
 		if (right == 0) {
 			fprintf(stderr, "%s: division by zero: %ld%%%ld\n",
-				state->frame->argv[0], left, right);
+				state->frame->argv_0, left, right);
 			return false;
 		}
 		*result = left % right;
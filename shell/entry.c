@@ -19,11 +19,11 @@ static char *expand_str(struct mrsh_state *state, const char *src) {
 	}
 	struct mrsh_word *word = parameter_expansion_word(parser);
 	if (word == NULL) {
-		struct mrsh_position err_pos;
-		const char *err_msg = mrsh_parser_error(parser, &err_pos);
+		struct mrsh_location err_loc;
+		const char *err_msg = mrsh_parser_error(parser, &err_loc);
 		if (err_msg != NULL) {
 			fprintf(stderr, "%d:%d: syntax error: %s\n",
-				err_pos.line, err_pos.column, err_msg);
+				err_loc.line, err_loc.column, err_msg);
 		} else {
 			fprintf(stderr, "expand_str: unknown error\n");
 		}
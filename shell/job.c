@@ -12,6 +12,7 @@
 #include "shell/process.h"
 #include "shell/shell.h"
 #include "shell/task.h"
+#include "shell/trace.h"
 
 bool mrsh_set_job_control(struct mrsh_state *state, bool enabled) {
 	struct mrsh_state_priv *priv = state_get_priv(state);
@@ -88,6 +89,9 @@ struct mrsh_job *job_create(struct mrsh_state *state,
 	job->job_id = id;
 	job->last_status = TASK_STATUS_WAIT;
 	mrsh_array_add(&priv->jobs, job);
+	if (priv->jobs.len > priv->stats.peak_jobs) {
+		priv->stats.peak_jobs = priv->jobs.len;
+	}
 	return job;
 }
 
@@ -233,6 +237,7 @@ static bool _job_wait(struct mrsh_state *state, pid_t pid, int options) {
 		// Here it's important to wait for a specific process: we don't want to
 		// steal one of our grandchildren's status for one of our children.
 		int stat;
+		uint64_t begin = trace_begin(state);
 		pid_t ret = waitpid(pid, &stat, options);
 		if (ret == 0) { // no status available
 			assert(options & WNOHANG);
@@ -246,6 +251,7 @@ static bool _job_wait(struct mrsh_state *state, pid_t pid, int options) {
 		}
 		assert(ret == pid);
 
+		trace_wait(state, begin, ret, stat);
 		update_job(state, ret, stat);
 		return true;
 	}
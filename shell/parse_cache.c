@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <mrsh/ast.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "shell/parse_cache.h"
+
+static void entry_unlink(struct mrsh_parse_cache *cache,
+		struct mrsh_parse_cache_entry *entry) {
+	if (entry->prev != NULL) {
+		entry->prev->next = entry->next;
+	} else {
+		cache->head = entry->next;
+	}
+	if (entry->next != NULL) {
+		entry->next->prev = entry->prev;
+	} else {
+		cache->tail = entry->prev;
+	}
+	entry->prev = entry->next = NULL;
+}
+
+static void entry_push_front(struct mrsh_parse_cache *cache,
+		struct mrsh_parse_cache_entry *entry) {
+	entry->next = cache->head;
+	if (cache->head != NULL) {
+		cache->head->prev = entry;
+	} else {
+		cache->tail = entry;
+	}
+	cache->head = entry;
+}
+
+static void entry_remove(struct mrsh_parse_cache *cache,
+		struct mrsh_parse_cache_entry *entry) {
+	entry_unlink(cache, entry);
+	mrsh_hashtable_del(&cache->entries, entry->key);
+	--cache->len;
+	parse_cache_entry_unref(entry);
+}
+
+void parse_cache_finish(struct mrsh_parse_cache *cache) {
+	while (cache->head != NULL) {
+		entry_remove(cache, cache->head);
+	}
+	mrsh_hashtable_finish(&cache->entries);
+}
+
+struct mrsh_parse_cache_entry *parse_cache_get(struct mrsh_parse_cache *cache,
+		const char *key, bool lazy_function_bodies) {
+	struct mrsh_parse_cache_entry *entry =
+		mrsh_hashtable_get(&cache->entries, key);
+	if (entry == NULL || entry->lazy_function_bodies != lazy_function_bodies) {
+		++cache->misses;
+		return NULL;
+	}
+
+	++cache->hits;
+	entry_unlink(cache, entry);
+	entry_push_front(cache, entry);
+	++entry->ref;
+	return entry;
+}
+
+struct mrsh_parse_cache_entry *parse_cache_add(struct mrsh_parse_cache *cache,
+		const char *key, struct mrsh_program *program,
+		bool lazy_function_bodies) {
+	struct mrsh_parse_cache_entry *old =
+		mrsh_hashtable_get(&cache->entries, key);
+	if (old != NULL) {
+		entry_remove(cache, old);
+	}
+	while (cache->len >= PARSE_CACHE_CAP) {
+		entry_remove(cache, cache->tail);
+	}
+
+	struct mrsh_parse_cache_entry *entry =
+		calloc(1, sizeof(struct mrsh_parse_cache_entry));
+	if (entry == NULL) {
+		return NULL;
+	}
+	entry->key = strdup(key);
+	if (entry->key == NULL) {
+		free(entry);
+		return NULL;
+	}
+	entry->program = program;
+	entry->lazy_function_bodies = lazy_function_bodies;
+	entry->ref = 2; // one for the cache, one for the caller
+
+	mrsh_hashtable_set(&cache->entries, key, entry);
+	entry_push_front(cache, entry);
+	++cache->len;
+	return entry;
+}
+
+void parse_cache_entry_unref(struct mrsh_parse_cache_entry *entry) {
+	if (entry == NULL) {
+		return;
+	}
+	assert(entry->ref > 0);
+	--entry->ref;
+	if (entry->ref > 0) {
+		return;
+	}
+	mrsh_program_destroy(entry->program);
+	free(entry->key);
+	free(entry);
+}
+
+char *parse_cache_file_key(int fd) {
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+			st.st_size > PARSE_CACHE_MAX_FILE_SIZE) {
+		return NULL;
+	}
+
+	char key[128];
+	int n = snprintf(key, sizeof(key), "%ju:%ju:%jd:%jd.%09ld:%jd.%09ld",
+		(uintmax_t)st.st_dev, (uintmax_t)st.st_ino, (intmax_t)st.st_size,
+		(intmax_t)st.st_mtim.tv_sec, st.st_mtim.tv_nsec,
+		(intmax_t)st.st_ctim.tv_sec, st.st_ctim.tv_nsec);
+	if (n < 0 || (size_t)n >= sizeof(key)) {
+		return NULL;
+	}
+	return strdup(key);
+}
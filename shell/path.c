@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include "shell/path.h"
+#include "shell/shell.h"
 
 char *expand_path(struct mrsh_state *state, const char *file, bool exec,
 		bool default_path) {
@@ -66,6 +67,28 @@ next:
 	return NULL;
 }
 
+const char *find_utility(struct mrsh_state *state, const char *name) {
+	if (strchr(name, '/')) {
+		return name;
+	}
+
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	const char *path = mrsh_hashtable_get(&priv->utilities, name);
+	if (path != NULL) {
+		return path;
+	}
+
+	char *found = expand_path(state, name, true, false);
+	if (found == NULL) {
+		return NULL;
+	}
+	if (found[0] != '/') {
+		priv->relative_utilities = true;
+	}
+	mrsh_hashtable_set(&priv->utilities, name, found);
+	return found;
+}
+
 char *current_working_dir(void) {
 	// POSIX doesn't provide a way to query the CWD size
 	struct mrsh_buffer buf = {0};
@@ -3,11 +3,29 @@
 #include <mrsh/array.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
+#include <unistd.h>
 #include "shell/process.h"
+#include "shell/profile.h"
 #include "shell/task.h"
+#include "shell/trace.h"
+
+pid_t fork_process(struct mrsh_state *state) {
+	fflush(stdout);
+	fflush(stderr);
+	trace_flush(state);
+	pid_t pid = fork();
+	if (pid > 0) {
+		++state_get_priv(state)->stats.forks;
+	} else if (pid == 0) {
+		trace_init_child(state);
+		profile_init_child(state);
+	}
+	return pid;
+}
 
 struct mrsh_process *process_create(struct mrsh_state *state, pid_t pid) {
 	struct mrsh_state_priv *priv = state_get_priv(state);
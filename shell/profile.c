@@ -0,0 +1,585 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <mrsh/array.h>
+#include <mrsh/ast.h>
+#include <mrsh/buffer.h>
+#include <mrsh/shell.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include "line_table.h"
+#include "shell/profile.h"
+#include "shell/shell.h"
+
+// Child processes mostly exit without destroying the shell, their entries are
+// written when they do
+static struct mrsh_profile *exit_profile = NULL;
+
+enum profile_table {
+	PROFILE_FUNCTIONS,
+	PROFILE_COMMANDS,
+	PROFILE_STACKS,
+};
+
+/**
+ * An entry written by a child process to the records file, followed by its
+ * name.
+ */
+struct profile_record {
+	uint32_t table; // enum profile_table
+	uint32_t name_len;
+	unsigned long calls;
+	struct profile_sample self, total;
+};
+
+static uint64_t timespec_ns(const struct timespec *ts) {
+	return (uint64_t)ts->tv_sec * 1000000000 + (uint64_t)ts->tv_nsec;
+}
+
+static uint64_t timeval_ns(const struct timeval *tv) {
+	return (uint64_t)tv->tv_sec * 1000000000 + (uint64_t)tv->tv_usec * 1000;
+}
+
+static void sample(struct mrsh_state *state, struct profile_sample *s) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	s->wall = timespec_ns(&ts);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	s->cpu = timespec_ns(&ts);
+	// Children are accounted for once they've been waited for
+	struct rusage ru;
+	getrusage(RUSAGE_CHILDREN, &ru);
+	s->cpu += timeval_ns(&ru.ru_utime) + timeval_ns(&ru.ru_stime);
+
+	s->forks = priv->stats.forks;
+	s->execs = priv->stats.execs;
+}
+
+static void sample_add(struct profile_sample *dst,
+		const struct profile_sample *s) {
+	dst->wall += s->wall;
+	dst->cpu += s->cpu;
+	dst->forks += s->forks;
+	dst->execs += s->execs;
+}
+
+static void sample_sub(struct profile_sample *dst,
+		const struct profile_sample *s) {
+	dst->wall -= s->wall;
+	dst->cpu -= s->cpu;
+	dst->forks -= s->forks;
+	dst->execs -= s->execs;
+}
+
+static struct profile_entry *get_entry(struct mrsh_hashtable *table,
+		const char *name) {
+	struct profile_entry *entry = mrsh_hashtable_get(table, name);
+	if (entry == NULL) {
+		entry = calloc(1, sizeof(struct profile_entry));
+		entry->name = strdup(name);
+		mrsh_hashtable_set(table, name, entry);
+	}
+	return entry;
+}
+
+static void entry_destroy_iterator(const char *key, void *value,
+		void *user_data) {
+	struct profile_entry *entry = value;
+	free(entry->name);
+	free(entry);
+}
+
+/**
+ * Returns the profile if the profile option is set, creating it if needed.
+ */
+static struct mrsh_profile *get_profile(struct mrsh_state *state) {
+	if (!(state->options & MRSH_OPT_PROFILE)) {
+		return NULL;
+	}
+
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	if (priv->profile != NULL) {
+		return priv->profile;
+	}
+
+	struct mrsh_profile *profile = calloc(1, sizeof(struct mrsh_profile));
+	if (profile == NULL) {
+		return NULL;
+	}
+	profile->pid = getpid();
+	profile->records = tmpfile();
+	if (profile->records != NULL) {
+		// Append mode, so that each write of a child lands after the ones of
+		// the others
+		int fd = fileno(profile->records);
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_APPEND);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+	}
+	struct profile_frame *root = &profile->root;
+	root->function = root;
+	root->entry = get_entry(&profile->functions, "main");
+	root->stack = get_entry(&profile->stacks, "main");
+	root->entry->calls = 1;
+	root->entry->depth = 1;
+	sample(state, &root->begin);
+	profile->current = root;
+	priv->profile = profile;
+	return profile;
+}
+
+static void enter(struct mrsh_state *state, struct mrsh_profile *profile,
+		struct profile_frame *frame, struct profile_entry *entry) {
+	frame->parent = profile->current;
+	frame->function = profile->current->function;
+	frame->entry = entry;
+	frame->stack = NULL;
+	frame->children = (struct profile_sample){0};
+	++entry->calls;
+	++entry->depth;
+	profile->current = frame;
+	// Last, so that the profiler's own work isn't accounted to the frame
+	sample(state, &frame->begin);
+}
+
+static bool enter_command(struct mrsh_context *ctx,
+		struct profile_frame *frame, const struct mrsh_position *pos,
+		const char *name) {
+	struct mrsh_profile *profile = get_profile(ctx->state);
+	if (profile == NULL) {
+		return false;
+	}
+
+	// Commands are identified by their function, their line and their name
+	struct mrsh_location loc;
+	line_table_lookup(ctx->lines, pos, &loc);
+	const char *fn_name = profile->current->function->entry->name;
+	int len = snprintf(NULL, 0, "%s:%d %s", fn_name, loc.line, name);
+	char key[len + 1];
+	snprintf(key, sizeof(key), "%s:%d %s", fn_name, loc.line, name);
+
+	enter(ctx->state, profile, frame, get_entry(&profile->commands, key));
+	return true;
+}
+
+bool profile_enter_command(struct mrsh_context *ctx,
+		struct profile_frame *frame, struct mrsh_command *cmd) {
+	if (!(ctx->state->options & MRSH_OPT_PROFILE)) {
+		return false;
+	}
+
+	const char *name;
+	switch (cmd->type) {
+	case MRSH_SIMPLE_COMMAND:;
+		struct mrsh_simple_command *sc = mrsh_command_get_simple_command(cmd);
+		struct mrsh_position begin = {0};
+		if (sc->name == NULL && sc->assignments.len > 0) {
+			struct mrsh_assignment *assign = sc->assignments.data[0];
+			begin = assign->name_range.begin;
+			return enter_command(ctx, frame, &begin, "assignment");
+		} else if (sc->name == NULL) {
+			if (sc->io_redirects.len > 0) {
+				struct mrsh_io_redirect *redir = sc->io_redirects.data[0];
+				begin = redir->op_range.begin;
+			}
+			return enter_command(ctx, frame, &begin, "redirection");
+		}
+		mrsh_word_range(sc->name, &begin, NULL);
+		char *str = mrsh_node_format(&sc->name->node);
+		bool ok = enter_command(ctx, frame, &begin, str);
+		free(str);
+		return ok;
+	case MRSH_BRACE_GROUP:
+		name = "{";
+		break;
+	case MRSH_SUBSHELL:
+		name = "(";
+		break;
+	case MRSH_IF_CLAUSE:
+		name = "if";
+		break;
+	case MRSH_LOOP_CLAUSE:;
+		struct mrsh_loop_clause *lc = mrsh_command_get_loop_clause(cmd);
+		name = lc->type == MRSH_LOOP_WHILE ? "while" : "until";
+		break;
+	case MRSH_FOR_CLAUSE:
+		name = "for";
+		break;
+	case MRSH_CASE_CLAUSE:
+		name = "case";
+		break;
+	case MRSH_FUNCTION_DEFINITION:
+		return false;
+	default:
+		abort();
+	}
+
+	struct mrsh_position begin;
+	mrsh_command_range(cmd, &begin, NULL);
+	return enter_command(ctx, frame, &begin, name);
+}
+
+bool profile_enter_pipeline(struct mrsh_context *ctx,
+		struct profile_frame *frame, struct mrsh_pipeline *pl) {
+	if (!(ctx->state->options & MRSH_OPT_PROFILE)) {
+		return false;
+	}
+	struct mrsh_position begin;
+	mrsh_command_range(pl->commands.data[0], &begin, NULL);
+	return enter_command(ctx, frame, &begin, "|");
+}
+
+bool profile_enter_word_command(struct mrsh_context *ctx,
+		struct profile_frame *frame, struct mrsh_word_command *wc) {
+	if (!(ctx->state->options & MRSH_OPT_PROFILE)) {
+		return false;
+	}
+	return enter_command(ctx, frame, &wc->range.begin,
+		wc->back_quoted ? "`...`" : "$(...)");
+}
+
+bool profile_enter_function(struct mrsh_state *state,
+		struct profile_frame *frame, const char *name) {
+	struct mrsh_profile *profile = get_profile(state);
+	if (profile == NULL) {
+		return false;
+	}
+
+	const char *parent_stack = profile->current->function->stack->name;
+	int len = snprintf(NULL, 0, "%s;%s", parent_stack, name);
+	char stack[len + 1];
+	snprintf(stack, sizeof(stack), "%s;%s", parent_stack, name);
+
+	struct profile_entry *stack_entry = get_entry(&profile->stacks, stack);
+	enter(state, profile, frame, get_entry(&profile->functions, name));
+	frame->function = frame;
+	frame->stack = stack_entry;
+	return true;
+}
+
+void profile_leave(struct mrsh_state *state, struct profile_frame *frame) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	struct mrsh_profile *profile = priv->profile;
+
+	struct profile_sample total;
+	sample(state, &total);
+	sample_sub(&total, &frame->begin);
+	struct profile_sample self = total;
+	sample_sub(&self, &frame->children);
+
+	struct profile_entry *entry = frame->entry;
+	if (--entry->depth == 0) {
+		sample_add(&entry->total, &total);
+	}
+	// Time spent in commands is also time spent in their function
+	struct profile_frame *fn = frame->function;
+	if (fn != frame) {
+		sample_add(&entry->self, &self);
+	}
+	sample_add(&fn->entry->self, &self);
+	sample_add(&fn->stack->self, &self);
+
+	if (frame->parent != NULL) {
+		sample_add(&frame->parent->children, &total);
+	}
+	profile->current = frame->parent;
+}
+
+static struct mrsh_hashtable *get_table(struct mrsh_profile *profile,
+		uint32_t table) {
+	switch (table) {
+	case PROFILE_FUNCTIONS:
+		return &profile->functions;
+	case PROFILE_COMMANDS:
+		return &profile->commands;
+	case PROFILE_STACKS:
+		return &profile->stacks;
+	}
+	return NULL;
+}
+
+static void write_all(int fd, const char *data, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n < 0) {
+			return;
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+struct write_records_data {
+	struct mrsh_buffer *buf;
+	uint32_t table;
+};
+
+static void write_record_iterator(const char *key, void *value,
+		void *user_data) {
+	struct profile_entry *entry = value;
+	struct write_records_data *data = user_data;
+	// Entries of frames which only ran in the parent
+	if (entry->calls == 0 && entry->self.wall == 0) {
+		return;
+	}
+
+	struct profile_record record = {
+		.table = data->table,
+		.name_len = strlen(entry->name),
+		.calls = entry->calls,
+		.self = entry->self,
+		.total = entry->total,
+	};
+	mrsh_buffer_append(data->buf, (const char *)&record, sizeof(record));
+	mrsh_buffer_append(data->buf, entry->name, record.name_len);
+}
+
+/**
+ * Appends the entries of a child process to the records file.
+ */
+static void write_records(struct mrsh_profile *profile) {
+	if (profile->records == NULL) {
+		return;
+	}
+
+	struct mrsh_buffer buf = {0};
+	for (uint32_t table = PROFILE_FUNCTIONS; table <= PROFILE_STACKS;
+			++table) {
+		struct write_records_data data = { .buf = &buf, .table = table };
+		mrsh_hashtable_for_each(get_table(profile, table),
+			write_record_iterator, &data);
+	}
+	// A single write, so that records of processes aren't interleaved
+	write_all(fileno(profile->records), buf.data, buf.len);
+	mrsh_buffer_finish(&buf);
+}
+
+/**
+ * Adds the entries of child processes to the profile.
+ */
+static void merge_records(struct mrsh_profile *profile) {
+	if (profile->records == NULL) {
+		return;
+	}
+
+	rewind(profile->records);
+	struct profile_record record;
+	while (fread(&record, sizeof(record), 1, profile->records) == 1) {
+		struct mrsh_hashtable *table = get_table(profile, record.table);
+		char *name = malloc(record.name_len + 1);
+		if (table == NULL || name == NULL || fread(name, 1, record.name_len,
+				profile->records) != record.name_len) {
+			free(name);
+			break;
+		}
+		name[record.name_len] = '\0';
+
+		struct profile_entry *entry = get_entry(table, name);
+		entry->calls += record.calls;
+		sample_add(&entry->self, &record.self);
+		sample_add(&entry->total, &record.total);
+		if (record.table == PROFILE_FUNCTIONS) {
+			// Each frame's self resources go to exactly one function
+			sample_add(&profile->children, &record.self);
+		}
+		free(name);
+	}
+}
+
+static void write_at_exit(void) {
+	if (exit_profile != NULL) {
+		write_records(exit_profile);
+		exit_profile = NULL;
+	}
+}
+
+static void reset_entry_iterator(const char *key, void *value,
+		void *user_data) {
+	struct profile_entry *entry = value;
+	// The depth is kept, frames of the parent are still running
+	entry->calls = 0;
+	entry->self = entry->total = (struct profile_sample){0};
+}
+
+void profile_init_child(struct mrsh_state *state) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	struct mrsh_profile *profile = priv->profile;
+	if (profile == NULL) {
+		return;
+	}
+
+	// What the parent did is already accounted for by the parent
+	for (uint32_t table = PROFILE_FUNCTIONS; table <= PROFILE_STACKS;
+			++table) {
+		mrsh_hashtable_for_each(get_table(profile, table),
+			reset_entry_iterator, NULL);
+	}
+
+	static bool registered = false;
+	if (!registered) {
+		registered = atexit(write_at_exit) == 0;
+	}
+	exit_profile = profile;
+}
+
+static void collect_iterator(const char *key, void *value, void *user_data) {
+	struct mrsh_array *entries = user_data;
+	mrsh_array_add(entries, value);
+}
+
+static void collect_entries(struct mrsh_array *entries,
+		struct mrsh_hashtable *table,
+		int (*compare)(const void *, const void *)) {
+	mrsh_hashtable_for_each(table, collect_iterator, entries);
+	qsort(entries->data, entries->len, sizeof(void *), compare);
+}
+
+static int compare_wall(uint64_t a, uint64_t b) {
+	return a < b ? 1 : a > b ? -1 : 0;
+}
+
+static int compare_total(const void *_a, const void *_b) {
+	const struct profile_entry *a = *(struct profile_entry **)_a;
+	const struct profile_entry *b = *(struct profile_entry **)_b;
+	int cmp = compare_wall(a->total.wall, b->total.wall);
+	return cmp != 0 ? cmp : strcmp(a->name, b->name);
+}
+
+static int compare_self(const void *_a, const void *_b) {
+	const struct profile_entry *a = *(struct profile_entry **)_a;
+	const struct profile_entry *b = *(struct profile_entry **)_b;
+	int cmp = compare_wall(a->self.wall, b->self.wall);
+	return cmp != 0 ? cmp : strcmp(a->name, b->name);
+}
+
+static int compare_name(const void *_a, const void *_b) {
+	const struct profile_entry *a = *(struct profile_entry **)_a;
+	const struct profile_entry *b = *(struct profile_entry **)_b;
+	return strcmp(a->name, b->name);
+}
+
+static double ms(uint64_t ns) {
+	return (double)ns / 1000000;
+}
+
+static void write_report(struct mrsh_profile *profile, FILE *f) {
+	// Child processes run while the shell waits for them, and their CPU time
+	// is counted once they are waited for: only their forks and execs are
+	// missing from the total of the shell
+	const struct profile_sample *all = &profile->root.entry->total;
+	fprintf(f, "profile: %.3f ms wall, %.3f ms cpu, %lu forks, %lu execs\n",
+		ms(all->wall), ms(all->cpu), all->forks + profile->children.forks,
+		all->execs + profile->children.execs);
+
+	struct mrsh_array entries = {0};
+	collect_entries(&entries, &profile->functions, compare_total);
+	fprintf(f, "\nfunctions, by total time:\n");
+	fprintf(f, "%10s %12s %12s %12s %8s %8s  %s\n",
+		"calls", "total ms", "self ms", "cpu ms", "forks", "execs", "name");
+	for (size_t i = 0; i < entries.len; ++i) {
+		struct profile_entry *entry = entries.data[i];
+		fprintf(f, "%10lu %12.3f %12.3f %12.3f %8lu %8lu  %s\n",
+			entry->calls, ms(entry->total.wall), ms(entry->self.wall),
+			ms(entry->total.cpu), entry->total.forks, entry->total.execs,
+			entry->name);
+	}
+	mrsh_array_finish(&entries);
+
+	entries = (struct mrsh_array){0};
+	collect_entries(&entries, &profile->commands, compare_self);
+	fprintf(f, "\ncommands, by self time:\n");
+	fprintf(f, "%10s %12s %12s %8s %8s  %s\n",
+		"calls", "self ms", "cpu ms", "forks", "execs", "command");
+	for (size_t i = 0; i < entries.len; ++i) {
+		struct profile_entry *entry = entries.data[i];
+		fprintf(f, "%10lu %12.3f %12.3f %8lu %8lu  %s\n",
+			entry->calls, ms(entry->self.wall), ms(entry->self.cpu),
+			entry->self.forks, entry->self.execs, entry->name);
+	}
+	mrsh_array_finish(&entries);
+}
+
+static void write_collapsed(struct mrsh_profile *profile, FILE *f) {
+	struct mrsh_array entries = {0};
+	collect_entries(&entries, &profile->stacks, compare_name);
+	for (size_t i = 0; i < entries.len; ++i) {
+		struct profile_entry *entry = entries.data[i];
+		uint64_t us = entry->self.wall / 1000;
+		if (us > 0) {
+			fprintf(f, "%s %" PRIu64 "\n", entry->name, us);
+		}
+	}
+	mrsh_array_finish(&entries);
+}
+
+static void write_profile(struct mrsh_state *state,
+		struct mrsh_profile *profile) {
+	const char *path = mrsh_env_get(state, "MRSH_PROFILE", NULL);
+	FILE *f = stderr;
+	if (path != NULL && path[0] != '\0') {
+		f = fopen(path, "w");
+		if (f == NULL) {
+			fprintf(stderr, "failed to open %s for writing: %s\n",
+				path, strerror(errno));
+			return;
+		}
+	}
+
+	// The report comes after the output of the script
+	fflush(stdout);
+
+	const char *format = mrsh_env_get(state, "MRSH_PROFILE_FORMAT", NULL);
+	if (format != NULL && strcmp(format, "collapsed") == 0) {
+		write_collapsed(profile, f);
+	} else {
+		write_report(profile, f);
+	}
+
+	if (f != stderr) {
+		fclose(f);
+	}
+}
+
+void profile_finish(struct mrsh_state *state) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	struct mrsh_profile *profile = priv->profile;
+	if (profile == NULL) {
+		return;
+	}
+
+	// Child processes which inherited the profile only write their records
+	if (profile->pid == getpid()) {
+		while (profile->current != NULL) {
+			profile_leave(state, profile->current);
+		}
+		merge_records(profile);
+		write_profile(state, profile);
+	} else {
+		write_records(profile);
+	}
+	if (exit_profile == profile) {
+		exit_profile = NULL;
+	}
+	if (profile->records != NULL) {
+		fclose(profile->records);
+	}
+
+	mrsh_hashtable_for_each(&profile->functions,
+		entry_destroy_iterator, NULL);
+	mrsh_hashtable_finish(&profile->functions);
+	mrsh_hashtable_for_each(&profile->commands,
+		entry_destroy_iterator, NULL);
+	mrsh_hashtable_finish(&profile->commands);
+	mrsh_hashtable_for_each(&profile->stacks, entry_destroy_iterator, NULL);
+	mrsh_hashtable_finish(&profile->stacks);
+	free(profile);
+	priv->profile = NULL;
+}
@@ -6,7 +6,9 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/param.h>
+#include "shell/process.h"
 #include "shell/redir.h"
+#include "shell/shell.h"
 
 static ssize_t write_here_document_line(int fd, struct mrsh_word *line,
 		ssize_t max_size) {
@@ -37,12 +39,16 @@ err_write:
 	return -1;
 }
 
-static int create_here_document_fd(const struct mrsh_array *lines) {
+static int create_here_document_fd(struct mrsh_state *state,
+		const struct mrsh_array *lines) {
 	int fds[2];
 	if (pipe(fds) != 0) {
 		perror("pipe");
 		return -1;
 	}
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	++priv->stats.here_documents;
+	++priv->stats.pipes;
 
 	// We can write at most PIPE_BUF bytes without blocking. If we want to write
 	// more, we need to fork and continue writing in another process.
@@ -68,7 +74,7 @@ static int create_here_document_fd(const struct mrsh_array *lines) {
 		return fds[0];
 	}
 
-	pid_t pid = fork();
+	pid_t pid = fork_process(state);
 	if (pid < 0) {
 		perror("fork");
 		close(fds[0]);
@@ -108,7 +114,8 @@ static int parse_fd(const char *str) {
 	return fd;
 }
 
-int process_redir(const struct mrsh_io_redirect *redir, int *redir_fd) {
+int process_redir(struct mrsh_state *state,
+		const struct mrsh_io_redirect *redir, int *redir_fd) {
 	// TODO: filename expansions
 	char *filename = mrsh_word_str(redir->name);
 
@@ -146,13 +153,14 @@ int process_redir(const struct mrsh_io_redirect *redir, int *redir_fd) {
 		break;
 	case MRSH_IO_DLESS: // <<
 	case MRSH_IO_DLESSDASH: // <<-
-		fd = create_here_document_fd(&redir->here_document);
+		fd = create_here_document_fd(state, &redir->here_document);
 		default_redir_fd = STDIN_FILENO;
 		break;
 	}
 	if (fd < 0) {
 		fprintf(stderr, "cannot open %s: %s\n", filename,
 			strerror(errno));
+		free(filename);
 		return -1;
 	}
 
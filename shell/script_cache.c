@@ -0,0 +1,271 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <mrsh/buffer.h>
+#include <mrsh/entry.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ast.h"
+#include "shell/parse_cache.h"
+
+#define CACHE_MAGIC "mrshast"
+#define CACHE_VERSION 2
+#define BYTE_ORDER_MARK 0x01020304
+
+#define CACHE_LAZY_FUNCTION_BODIES (1 << 0)
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/**
+ * Header of a cache entry, followed by the serialized program. The size,
+ * modification time and hash are those of the script when it was parsed. The
+ * flags record how it was parsed.
+ */
+struct cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t size;
+	int64_t mtime_sec, mtime_nsec;
+	uint64_t hash;
+	uint64_t flags;
+};
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < len; ++i) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static const char *cache_dir(struct mrsh_state *state) {
+	const char *dir = mrsh_env_get(state, "MRSH_CACHE_DIR", NULL);
+	if (dir == NULL || dir[0] == '\0') {
+		return NULL;
+	}
+	return dir;
+}
+
+static bool stat_script(int fd, struct stat *st) {
+	return fstat(fd, st) == 0 && S_ISREG(st->st_mode) &&
+		st->st_size <= PARSE_CACHE_MAX_FILE_SIZE;
+}
+
+/**
+ * Checks that a cache directory or entry can only have been written by us.
+ * Entries are run as code, so one planted by another user mustn't be loaded.
+ */
+static bool is_trusted(const struct stat *st) {
+	return st->st_uid == geteuid() && (st->st_mode & 022) == 0;
+}
+
+/**
+ * Opens the cache directory, if it can be trusted.
+ */
+static int open_cache_dir(const char *dir) {
+	int dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir_fd < 0) {
+		return -1;
+	}
+	struct stat st;
+	if (fstat(dir_fd, &st) != 0 || !is_trusted(&st)) {
+		close(dir_fd);
+		return -1;
+	}
+	return dir_fd;
+}
+
+#define ENTRY_NAME_SIZE 17
+
+/**
+ * Gets the name of the cache entry for a file. Entries are named after the
+ * device and inode of the file, so that renaming it keeps its entry.
+ */
+static void entry_name(const struct stat *st, char name[ENTRY_NAME_SIZE]) {
+	uint64_t key = FNV_OFFSET_BASIS;
+	key = hash_bytes(key, &st->st_dev, sizeof(st->st_dev));
+	key = hash_bytes(key, &st->st_ino, sizeof(st->st_ino));
+	snprintf(name, ENTRY_NAME_SIZE, "%016llx", (unsigned long long)key);
+}
+
+/**
+ * Hashes the contents of a regular file, without moving its offset.
+ */
+static bool hash_file(int fd, const struct stat *st, uint64_t *hash) {
+	*hash = FNV_OFFSET_BASIS;
+	if (st->st_size == 0) {
+		return true;
+	}
+
+	void *data = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	*hash = hash_bytes(*hash, data, st->st_size);
+	munmap(data, st->st_size);
+	return true;
+}
+
+static void init_header(struct cache_header *header, struct mrsh_state *state,
+		const struct stat *st) {
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header->version = CACHE_VERSION;
+	header->byte_order = BYTE_ORDER_MARK;
+	header->size = st->st_size;
+	header->mtime_sec = st->st_mtim.tv_sec;
+	header->mtime_nsec = st->st_mtim.tv_nsec;
+	if (state->options & MRSH_OPT_LAZYFUNCS) {
+		header->flags |= CACHE_LAZY_FUNCTION_BODIES;
+	}
+}
+
+struct mrsh_program *mrsh_script_cache_load(struct mrsh_state *state,
+		int fd) {
+	const char *dir = cache_dir(state);
+	if (dir == NULL) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (!stat_script(fd, &st)) {
+		return NULL;
+	}
+
+	int dir_fd = open_cache_dir(dir);
+	if (dir_fd < 0) {
+		return NULL;
+	}
+	char name[ENTRY_NAME_SIZE];
+	entry_name(&st, name);
+	int entry_fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+	close(dir_fd);
+	if (entry_fd < 0) {
+		return NULL;
+	}
+
+	struct mrsh_program *prog = NULL;
+	struct stat entry_st;
+	if (fstat(entry_fd, &entry_st) != 0 || !S_ISREG(entry_st.st_mode) ||
+			!is_trusted(&entry_st) ||
+			(size_t)entry_st.st_size < sizeof(struct cache_header)) {
+		goto out_fd;
+	}
+
+	size_t entry_size = entry_st.st_size;
+	const char *entry = mmap(NULL, entry_size, PROT_READ, MAP_PRIVATE,
+		entry_fd, 0);
+	if (entry == MAP_FAILED) {
+		goto out_fd;
+	}
+
+	struct cache_header expected, header;
+	init_header(&expected, state, &st);
+	memcpy(&header, entry, sizeof(header));
+	expected.hash = header.hash;
+	if (memcmp(&header, &expected, sizeof(header)) != 0) {
+		goto out_map;
+	}
+
+	// The modification time has a coarse granularity on some file systems,
+	// only the contents can tell whether the entry is up-to-date
+	uint64_t hash;
+	if (!hash_file(fd, &st, &hash) || hash != header.hash) {
+		goto out_map;
+	}
+
+	prog = program_deserialize(entry + sizeof(header),
+		entry_size - sizeof(header));
+
+out_map:
+	munmap((void *)entry, entry_size);
+out_fd:
+	close(entry_fd);
+	return prog;
+}
+
+static bool write_all(int fd, const char *data, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n < 0) {
+			return false;
+		}
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+void mrsh_script_cache_store(struct mrsh_state *state, int fd,
+		const struct mrsh_program *prog) {
+	const char *dir = cache_dir(state);
+	if (dir == NULL) {
+		return;
+	}
+
+	struct stat st;
+	if (!stat_script(fd, &st)) {
+		return;
+	}
+
+	struct cache_header header;
+	init_header(&header, state, &st);
+	if (!hash_file(fd, &st, &header.hash)) {
+		return;
+	}
+
+	struct mrsh_buffer buf = {0};
+	mrsh_buffer_append(&buf, (const char *)&header, sizeof(header));
+	program_serialize(prog, &buf);
+
+	if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+		goto out_buf;
+	}
+	// Entries written to a directory others can write to can't be loaded
+	int dir_fd = open_cache_dir(dir);
+	if (dir_fd < 0) {
+		goto out_buf;
+	}
+
+	char name[ENTRY_NAME_SIZE];
+	entry_name(&st, name);
+
+	// Write to a temporary file first, so that other shells never load a
+	// partially written entry
+	size_t tmp_size = strlen(dir) + strlen("/") + ENTRY_NAME_SIZE +
+		strlen(".XXXXXX");
+	char *tmp_path = malloc(tmp_size);
+	if (tmp_path == NULL) {
+		goto out_dir_fd;
+	}
+	snprintf(tmp_path, tmp_size, "%s/%s.XXXXXX", dir, name);
+
+	int tmp_fd = mkstemp(tmp_path);
+	if (tmp_fd < 0) {
+		goto out_tmp_path;
+	}
+	bool ok = write_all(tmp_fd, buf.data, buf.len);
+	if (close(tmp_fd) != 0) {
+		ok = false;
+	}
+	if (!ok || renameat(AT_FDCWD, tmp_path, dir_fd, name) != 0) {
+		unlink(tmp_path);
+	}
+
+out_tmp_path:
+	free(tmp_path);
+out_dir_fd:
+	close(dir_fd);
+out_buf:
+	mrsh_buffer_finish(&buf);
+}
@@ -6,15 +6,32 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "builtin.h"
+#include "intern.h"
 #include "shell/job.h"
 #include "shell/shell.h"
+#include "shell/snapshot.h"
 #include "shell/process.h"
+#include "shell/profile.h"
+#include "shell/trace.h"
 
-void function_destroy(struct mrsh_function *fn) {
-	if (!fn) {
+struct mrsh_function *function_ref(struct mrsh_function *fn) {
+	++fn->ref;
+	return fn;
+}
+
+void function_unref(struct mrsh_function *fn) {
+	if (fn == NULL || --fn->ref > 0) {
 		return;
 	}
-	mrsh_command_destroy(fn->body);
+	if (fn->arena != NULL) {
+		arena_finish(fn->arena);
+		free(fn->arena);
+	} else {
+		mrsh_command_destroy(fn->body);
+	}
+	line_table_unref(fn->lines);
+	free(fn->body_source);
 	free(fn);
 }
 
@@ -28,6 +45,7 @@ struct mrsh_state *mrsh_state_create(void) {
 
 	struct mrsh_state *state = &priv->pub;
 	state->exit = -1;
+	invalidate_commands(state);
 
 	struct mrsh_call_frame_priv *frame_priv =
 		calloc(1, sizeof(struct mrsh_call_frame_priv));
@@ -56,7 +74,7 @@ static void state_string_finish_iterator(const char *key, void *value,
 	free(value);
 }
 
-static void variable_destroy(struct mrsh_variable *var) {
+void variable_destroy(struct mrsh_variable *var) {
 	if (!var) {
 		return;
 	}
@@ -70,19 +88,23 @@ static void state_var_finish_iterator(const char *key, void *value,
 }
 
 static void state_fn_finish_iterator(const char *key, void *value, void *_) {
-	function_destroy((struct mrsh_function *)value);
+	function_unref((struct mrsh_function *)value);
 }
 
 static void call_frame_destroy(struct mrsh_call_frame *frame) {
-	for (int i = 0; i < frame->argc; ++i) {
-		free(frame->argv[i]);
-	}
-	free(frame->argv);
+	free(frame->argv_0);
+	args_unref(frame->args);
 	free(frame);
 }
 
 void mrsh_state_destroy(struct mrsh_state *state) {
 	struct mrsh_state_priv *priv = state_get_priv(state);
+	profile_finish(state);
+	trace_finish(state);
+	if (state->options & MRSH_OPT_STATS) {
+		fflush(stdout);
+		print_stats(state, stderr);
+	}
 	if (priv->job_control) {
 		broadcast_sighup_to_jobs(state);
 	}
@@ -93,6 +115,9 @@ void mrsh_state_destroy(struct mrsh_state *state) {
 	mrsh_hashtable_for_each(&priv->aliases,
 		state_string_finish_iterator, NULL);
 	mrsh_hashtable_finish(&priv->aliases);
+	mrsh_hashtable_for_each(&priv->utilities,
+		state_string_finish_iterator, NULL);
+	mrsh_hashtable_finish(&priv->utilities);
 	while (priv->jobs.len > 0) {
 		job_destroy(priv->jobs.data[priv->jobs.len - 1]);
 	}
@@ -110,6 +135,8 @@ void mrsh_state_destroy(struct mrsh_state *state) {
 	for (size_t i = 0; i < MRSH_NSIG; i++) {
 		mrsh_program_destroy(priv->traps[i].program);
 	}
+	parse_cache_finish(&priv->parse_cache);
+	arena_finish(&priv->arena);
 	free(state);
 }
 
@@ -117,24 +144,91 @@ struct mrsh_state_priv *state_get_priv(struct mrsh_state *state) {
 	return (struct mrsh_state_priv *)state;
 }
 
+void mrsh_get_parse_cache_stats(struct mrsh_state *state,
+		struct mrsh_parse_cache_stats *stats) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	stats->hits = priv->parse_cache.hits;
+	stats->misses = priv->parse_cache.misses;
+}
+
+void invalidate_commands(struct mrsh_state *state) {
+	// Generations are unique among all shells, since a command can be run by
+	// more than one
+	static unsigned long last_generation = 0;
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	priv->command_generation = ++last_generation;
+}
+
+static void forget_utility_iterator(const char *key, void *value,
+		void *user_data) {
+	struct mrsh_hashtable *utilities = user_data;
+	free(mrsh_hashtable_del(utilities, key));
+}
+
+void forget_utilities(struct mrsh_state *state) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	mrsh_hashtable_for_each(&priv->utilities, forget_utility_iterator,
+		&priv->utilities);
+	priv->relative_utilities = false;
+	invalidate_commands(state);
+}
+
+void forget_relative_utilities(struct mrsh_state *state) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	if (priv->relative_utilities) {
+		forget_utilities(state);
+	}
+}
+
 void mrsh_env_set(struct mrsh_state *state,
 		const char *key, const char *value, uint32_t attribs) {
 	struct mrsh_state_priv *priv = state_get_priv(state);
 
+	if (strcmp(key, "PATH") == 0) {
+		forget_utilities(state);
+	}
+
 	struct mrsh_variable *var = calloc(1, sizeof(struct mrsh_variable));
 	if (!var) {
 		return;
 	}
 	var->value = strdup(value);
 	var->attribs = attribs;
-	struct mrsh_variable *old = mrsh_hashtable_set(&priv->variables, key, var);
-	variable_destroy(old);
+	// Names are interned, so that looking up the names of parameters and
+	// assignments only compares pointers
+	const char *atom = intern(key);
+	struct mrsh_variable *old;
+	if (atom != NULL) {
+		old = hashtable_set_atom(&priv->variables, atom, var);
+	} else {
+		old = mrsh_hashtable_set(&priv->variables, key, var);
+	}
+	if (!snapshot_keep(state, &priv->variables, key, old)) {
+		variable_destroy(old);
+	}
+	// The variable keeps its own reference
+	atom_unref(atom);
+
+	if (strcmp(key, "MRSH_TRACE") == 0) {
+		trace_update(state, var->value);
+	}
 }
 
 void mrsh_env_unset(struct mrsh_state *state, const char *key) {
 	struct mrsh_state_priv *priv = state_get_priv(state);
 
-	variable_destroy(mrsh_hashtable_del(&priv->variables, key));
+	if (strcmp(key, "PATH") == 0) {
+		forget_utilities(state);
+	}
+
+	struct mrsh_variable *old = mrsh_hashtable_del(&priv->variables, key);
+	if (!snapshot_keep(state, &priv->variables, key, old)) {
+		variable_destroy(old);
+	}
+
+	if (strcmp(key, "MRSH_TRACE") == 0) {
+		trace_update(state, NULL);
+	}
 }
 
 const char *mrsh_env_get(struct mrsh_state *state,
@@ -148,17 +242,96 @@ const char *mrsh_env_get(struct mrsh_state *state,
 	return var ? var->value : NULL;
 }
 
+struct mrsh_args *args_create(int argc, char *argv[]) {
+	struct mrsh_args *args = calloc(1, sizeof(struct mrsh_args));
+	if (args == NULL) {
+		return NULL;
+	}
+	args->argv = malloc((argc + 1) * sizeof(char *));
+	if (args->argv == NULL) {
+		free(args);
+		return NULL;
+	}
+	memcpy(args->argv, argv, argc * sizeof(char *));
+	args->argv[argc] = NULL;
+	args->argc = argc;
+	args->ref = 1;
+	return args;
+}
+
+struct mrsh_args *args_ref(struct mrsh_args *args) {
+	if (args != NULL) {
+		++args->ref;
+	}
+	return args;
+}
+
+void args_unref(struct mrsh_args *args) {
+	if (args == NULL) {
+		return;
+	}
+	assert(args->ref > 0);
+	if (--args->ref > 0) {
+		return;
+	}
+	for (int i = 0; i < args->argc; ++i) {
+		free(args->argv[i]);
+	}
+	free(args->argv);
+	free(args);
+}
+
 struct mrsh_call_frame_priv *call_frame_get_priv(struct mrsh_call_frame *frame) {
 	return (struct mrsh_call_frame_priv *)frame;
 }
 
-void push_frame(struct mrsh_state *state, int argc, const char *argv[]) {
-	struct mrsh_call_frame_priv *next = calloc(1, sizeof(*next));
-	next->pub.argc = argc;
-	next->pub.argv = calloc(argc + 1, sizeof(char *));
-	for (int i = 0; i < argc; ++i) {
-		next->pub.argv[i] = strdup(argv[i]);
+int mrsh_call_frame_nargs(struct mrsh_call_frame *frame) {
+	if (frame->args == NULL) {
+		return 0;
 	}
+	return frame->args->argc - frame->args_offset;
+}
+
+const char *mrsh_call_frame_get_arg(struct mrsh_call_frame *frame, int i) {
+	if (i == 0) {
+		return frame->argv_0;
+	}
+	if (i < 0 || i > mrsh_call_frame_nargs(frame)) {
+		return NULL;
+	}
+	return frame->args->argv[frame->args_offset + i - 1];
+}
+
+void call_frame_set_args(struct mrsh_call_frame *frame,
+		struct mrsh_args *args, int offset) {
+	args_ref(args);
+	args_unref(frame->args);
+	frame->args = args;
+	frame->args_offset = offset;
+}
+
+void call_frame_shift(struct mrsh_call_frame *frame, int n) {
+	assert(n >= 0 && n <= mrsh_call_frame_nargs(frame));
+	if (n == 0) {
+		return;
+	}
+
+	struct mrsh_args *args = frame->args;
+	if (args->ref == 1) {
+		// Nobody else can see the parameters we're dropping
+		for (int i = frame->args_offset; i < frame->args_offset + n; ++i) {
+			free(args->argv[i]);
+			args->argv[i] = NULL;
+		}
+	}
+	frame->args_offset += n;
+}
+
+void push_frame(struct mrsh_state *state, const char *argv_0,
+		struct mrsh_args *args, int offset) {
+	struct mrsh_call_frame_priv *next = calloc(1, sizeof(*next));
+	next->pub.argv_0 = strdup(argv_0);
+	call_frame_set_args(&next->pub, args, offset);
 	next->pub.prev = state->frame;
 	state->frame = &next->pub;
 }
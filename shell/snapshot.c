@@ -0,0 +1,215 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "shell/job.h"
+#include "shell/shell.h"
+#include "shell/snapshot.h"
+#include "shell/trace.h"
+
+struct mrsh_snapshot_entry {
+	void *value; // NULL if the entry didn't exist
+};
+
+static bool replace_stdin(struct mrsh_snapshot *snapshot) {
+	// Keep the saved fd out of the way of redirections
+	snapshot->stdin_fd = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+	if (snapshot->stdin_fd < 0 && errno != EBADF) {
+		fprintf(stderr, "failed to duplicate stdin: %s\n", strerror(errno));
+		return false;
+	}
+
+	int fd = open("/dev/null", O_CLOEXEC | O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "failed to open /dev/null: %s\n", strerror(errno));
+		if (snapshot->stdin_fd >= 0) {
+			close(snapshot->stdin_fd);
+		}
+		return false;
+	}
+	if (fd != STDIN_FILENO) {
+		dup2(fd, STDIN_FILENO);
+		close(fd);
+	}
+	return true;
+}
+
+static void restore_stdin(struct mrsh_snapshot *snapshot) {
+	if (snapshot->stdin_fd >= 0) {
+		dup2(snapshot->stdin_fd, STDIN_FILENO);
+		close(snapshot->stdin_fd);
+	} else {
+		close(STDIN_FILENO);
+	}
+}
+
+bool snapshot_save(struct mrsh_state *state, struct mrsh_snapshot *snapshot,
+		bool null_stdin) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->stdin_fd = -1;
+
+	snapshot->cwd_fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (snapshot->cwd_fd < 0) {
+		return false;
+	}
+
+	snapshot->null_stdin = null_stdin;
+	if (null_stdin && !replace_stdin(snapshot)) {
+		close(snapshot->cwd_fd);
+		return false;
+	}
+
+	snapshot->umask = umask(0);
+	umask(snapshot->umask);
+	snapshot->options = state->options;
+
+	struct mrsh_call_frame_priv *frame_priv =
+		call_frame_get_priv(state->frame);
+	snapshot->frame = state->frame;
+	snapshot->branch_control = frame_priv->branch_control;
+	snapshot->nloops = frame_priv->nloops;
+	// Shift doesn't modify shared positional parameters
+	snapshot->args = args_ref(state->frame->args);
+	snapshot->args_offset = state->frame->args_offset;
+
+	snapshot->prev = priv->snapshot;
+	priv->snapshot = snapshot;
+	return true;
+}
+
+struct restore_iterator_data {
+	struct mrsh_hashtable *table;
+	void (*destroy)(void *value);
+};
+
+static void restore_iterator(const char *key, void *_entry, void *_data) {
+	struct mrsh_snapshot_entry *entry = _entry;
+	struct restore_iterator_data *data = _data;
+
+	void *cur;
+	if (entry->value != NULL) {
+		cur = mrsh_hashtable_set(data->table, key, entry->value);
+	} else {
+		cur = mrsh_hashtable_del(data->table, key);
+	}
+	if (cur != NULL) {
+		data->destroy(cur);
+	}
+	free(entry);
+}
+
+static void restore_table(struct mrsh_hashtable *saved,
+		struct mrsh_hashtable *table, void (*destroy)(void *value)) {
+	struct restore_iterator_data data = {
+		.table = table,
+		.destroy = destroy,
+	};
+	mrsh_hashtable_for_each(saved, restore_iterator, &data);
+	mrsh_hashtable_finish(saved);
+}
+
+static bool table_empty(const struct mrsh_hashtable *table) {
+	for (size_t i = 0; i < MRSH_HASHTABLE_BUCKETS; ++i) {
+		if (table->buckets[i] != NULL) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void destroy_variable(void *value) {
+	variable_destroy(value);
+}
+
+static void destroy_function(void *value) {
+	function_unref(value);
+}
+
+void snapshot_restore(struct mrsh_state *state,
+		struct mrsh_snapshot *snapshot) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	assert(priv->snapshot == snapshot);
+	priv->snapshot = snapshot->prev;
+
+	if (mrsh_hashtable_get(&snapshot->variables, "PATH") != NULL) {
+		forget_utilities(state);
+	}
+	if (!table_empty(&snapshot->functions)) {
+		invalidate_commands(state);
+	}
+	bool update_trace =
+		mrsh_hashtable_get(&snapshot->variables, "MRSH_TRACE") != NULL;
+
+	restore_table(&snapshot->variables, &priv->variables, destroy_variable);
+	if (update_trace) {
+		trace_update(state, mrsh_env_get(state, "MRSH_TRACE", NULL));
+	}
+	restore_table(&snapshot->functions, &priv->functions, destroy_function);
+	restore_table(&snapshot->aliases, &priv->aliases, free);
+
+	struct mrsh_call_frame *frame = snapshot->frame;
+	call_frame_set_args(frame, snapshot->args, snapshot->args_offset);
+	args_unref(snapshot->args);
+	struct mrsh_call_frame_priv *frame_priv = call_frame_get_priv(frame);
+	frame_priv->branch_control = snapshot->branch_control;
+	frame_priv->nloops = snapshot->nloops;
+
+	if ((state->options & MRSH_OPT_MONITOR) !=
+			(snapshot->options & MRSH_OPT_MONITOR)) {
+		mrsh_set_job_control(state, snapshot->options & MRSH_OPT_MONITOR);
+	}
+	state->options = snapshot->options;
+	umask(snapshot->umask);
+
+	if (fchdir(snapshot->cwd_fd) != 0) {
+		fprintf(stderr, "failed to restore working directory: %s\n",
+			strerror(errno));
+	}
+	close(snapshot->cwd_fd);
+	forget_relative_utilities(state);
+
+	if (snapshot->null_stdin) {
+		restore_stdin(snapshot);
+	}
+}
+
+static struct mrsh_hashtable *snapshot_table(struct mrsh_state_priv *priv,
+		struct mrsh_hashtable *table) {
+	if (table == &priv->variables) {
+		return &priv->snapshot->variables;
+	} else if (table == &priv->functions) {
+		return &priv->snapshot->functions;
+	} else if (table == &priv->aliases) {
+		return &priv->snapshot->aliases;
+	}
+	abort();
+}
+
+bool snapshot_keep(struct mrsh_state *state, struct mrsh_hashtable *table,
+		const char *key, void *value) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	if (priv->snapshot == NULL) {
+		return false;
+	}
+
+	struct mrsh_hashtable *saved = snapshot_table(priv, table);
+	if (mrsh_hashtable_get(saved, key) != NULL) {
+		// The value saved in the snapshot is older than this one
+		return false;
+	}
+
+	struct mrsh_snapshot_entry *entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		return false;
+	}
+	entry->value = value;
+	mrsh_hashtable_set(saved, key, entry);
+	return true;
+}
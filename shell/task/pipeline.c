@@ -3,7 +3,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "shell/profile.h"
 #include "shell/task.h"
+#include "shell/trace.h"
 
 /**
  * Put the process into its job's process group. This has to be done both in the
@@ -11,7 +13,7 @@
  */
 static struct mrsh_process *init_child(struct mrsh_context *ctx, pid_t pid) {
 	struct mrsh_process *proc = process_create(ctx->state, pid);
-	if (ctx->state->options & MRSH_OPT_MONITOR) {
+	if ((ctx->state->options & MRSH_OPT_MONITOR) && ctx->job != NULL) {
 		job_add_process(ctx->job, proc);
 
 		if (ctx->state->interactive && !ctx->background) {
@@ -21,24 +23,14 @@ static struct mrsh_process *init_child(struct mrsh_context *ctx, pid_t pid) {
 	return proc;
 }
 
-int run_pipeline(struct mrsh_context *ctx, struct mrsh_pipeline *pl) {
+/**
+ * Runs each command of a pipeline in its own process. `ctx` is the context of
+ * the pipeline's job.
+ */
+static int run_pipeline_processes(struct mrsh_context *ctx,
+		struct mrsh_pipeline *pl) {
 	struct mrsh_state_priv *priv = state_get_priv(ctx->state);
 
-	// Create a new sub-context, because we want one job per pipeline.
-	struct mrsh_context child_ctx = *ctx;
-	if (child_ctx.job == NULL) {
-		child_ctx.job = job_create(ctx->state, &pl->and_or_list.node);
-	}
-
-	assert(pl->commands.len > 0);
-	if (pl->commands.len == 1) {
-		int ret = run_command(&child_ctx, pl->commands.data[0]);
-		if (pl->bang && ret >= 0) {
-			ret = !ret;
-		}
-		return ret;
-	}
-
 	struct mrsh_array procs = {0};
 	mrsh_array_reserve(&procs, pl->commands.len);
 	int next_stdin = -1, cur_stdin = -1, cur_stdout = -1;
@@ -51,6 +43,7 @@ int run_pipeline(struct mrsh_context *ctx, struct mrsh_pipeline *pl) {
 				perror("pipe");
 				return TASK_STATUS_ERROR;
 			}
+			++priv->stats.pipes;
 
 			// We'll use the write end of the pipe as stdout, the read end will
 			// be used as stdin by the next command
@@ -59,13 +52,13 @@ int run_pipeline(struct mrsh_context *ctx, struct mrsh_pipeline *pl) {
 			cur_stdout = fds[1];
 		}
 
-		pid_t pid = fork();
+		pid_t pid = fork_process(ctx->state);
 		if (pid < 0) {
 			return TASK_STATUS_ERROR;
 		} else if (pid == 0) {
 			priv->child = true;
 
-			init_child(&child_ctx, getpid());
+			init_child(ctx, getpid());
 			if (ctx->state->options & MRSH_OPT_MONITOR) {
 				init_job_child_process(ctx->state);
 			}
@@ -92,7 +85,7 @@ int run_pipeline(struct mrsh_context *ctx, struct mrsh_pipeline *pl) {
 				close(cur_stdout);
 			}
 
-			int ret = run_command(&child_ctx, cmd);
+			int ret = run_command(ctx, cmd);
 			if (ret < 0) {
 				exit(127);
 			}
@@ -100,7 +93,8 @@ int run_pipeline(struct mrsh_context *ctx, struct mrsh_pipeline *pl) {
 			exit(ret);
 		}
 
-		struct mrsh_process *proc = init_child(&child_ctx, pid);
+		trace_fork(ctx->state, pid, &cmd->node);
+		struct mrsh_process *proc = init_child(ctx, pid);
 		mrsh_array_add(&procs, proc);
 
 		if (cur_stdin >= 0) {
@@ -132,3 +126,29 @@ int run_pipeline(struct mrsh_context *ctx, struct mrsh_pipeline *pl) {
 	}
 	return ret;
 }
+
+int run_pipeline(struct mrsh_context *ctx, struct mrsh_pipeline *pl) {
+	// Create a new sub-context, because we want one job per pipeline. Jobs
+	// are only tracked when job control is enabled.
+	struct mrsh_context child_ctx = *ctx;
+	if (child_ctx.job == NULL && (ctx->state->options & MRSH_OPT_MONITOR)) {
+		child_ctx.job = job_create(ctx->state, &pl->and_or_list.node);
+	}
+
+	assert(pl->commands.len > 0);
+	if (pl->commands.len == 1) {
+		int ret = run_command(&child_ctx, pl->commands.data[0]);
+		if (pl->bang && ret >= 0) {
+			ret = !ret;
+		}
+		return ret;
+	}
+
+	struct profile_frame frame;
+	if (!profile_enter_pipeline(ctx, &frame, pl)) {
+		return run_pipeline_processes(&child_ctx, pl);
+	}
+	int ret = run_pipeline_processes(&child_ctx, pl);
+	profile_leave(ctx->state, &frame);
+	return ret;
+}
@@ -8,10 +8,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include "ast.h"
+#include "builtin.h"
+#include "parser.h"
 #include "shell/shell.h"
 #include "shell/path.h"
+#include "shell/profile.h"
 #include "shell/redir.h"
+#include "shell/trace.h"
 #include "shell/word.h"
 #include "shell/task.h"
 
@@ -28,7 +34,7 @@ static void populate_env_iterator(const char *key, void *_var, void *_) {
  */
 static struct mrsh_process *init_child(struct mrsh_context *ctx, pid_t pid) {
 	struct mrsh_process *proc = process_create(ctx->state, pid);
-	if (ctx->state->options & MRSH_OPT_MONITOR) {
+	if ((ctx->state->options & MRSH_OPT_MONITOR) && ctx->job != NULL) {
 		job_add_process(ctx->job, proc);
 
 		if (ctx->state->interactive && !ctx->background) {
@@ -39,20 +45,11 @@ static struct mrsh_process *init_child(struct mrsh_context *ctx, pid_t pid) {
 }
 
 static int run_process(struct mrsh_context *ctx, struct mrsh_simple_command *sc,
-		char **argv) {
+		const char *path, char **argv) {
 	struct mrsh_state *state = ctx->state;
 	struct mrsh_state_priv *priv = state_get_priv(state);
 
-	// The pipeline is responsible for creating the job
-	assert(ctx->job != NULL);
-
-	char *path = expand_path(ctx->state, argv[0], true, false);
-	if (!path) {
-		fprintf(stderr, "%s: not found\n", argv[0]);
-		return 127;
-	}
-
-	pid_t pid = fork();
+	pid_t pid = fork_process(state);
 	if (pid < 0) {
 		perror("fork");
 		return TASK_STATUS_ERROR;
@@ -83,7 +80,7 @@ static int run_process(struct mrsh_context *ctx, struct mrsh_simple_command *sc,
 			struct mrsh_io_redirect *redir = sc->io_redirects.data[i];
 
 			int redir_fd;
-			int fd = process_redir(redir, &redir_fd);
+			int fd = process_redir(state, redir, &redir_fd);
 			if (fd < 0) {
 				exit(1);
 			}
@@ -100,6 +97,7 @@ static int run_process(struct mrsh_context *ctx, struct mrsh_simple_command *sc,
 			}
 		}
 
+		trace_exec(state, path, argv);
 		execv(path, argv);
 
 		// Something went wrong
@@ -107,8 +105,8 @@ static int run_process(struct mrsh_context *ctx, struct mrsh_simple_command *sc,
 		exit(127);
 	}
 
-	free(path);
-
+	++priv->stats.execs;
+	trace_fork(state, pid, &sc->command.node);
 	struct mrsh_process *process = init_child(ctx, pid);
 	return job_wait_process(process);
 }
@@ -116,6 +114,7 @@ static int run_process(struct mrsh_context *ctx, struct mrsh_simple_command *sc,
 struct saved_fd {
 	int dup_fd;
 	int redir_fd;
+	bool closed; // redir_fd wasn't open before the redirection
 };
 
 static bool dup_and_save_fd(int fd, int redir_fd, struct saved_fd *saved) {
@@ -127,7 +126,9 @@ static bool dup_and_save_fd(int fd, int redir_fd, struct saved_fd *saved) {
 	}
 
 	saved->dup_fd = dup(redir_fd);
-	if (saved->dup_fd < 0) {
+	if (saved->dup_fd < 0 && errno == EBADF) {
+		saved->closed = true;
+	} else if (saved->dup_fd < 0) {
 		fprintf(stderr, "failed to duplicate file descriptor: %s\n",
 			strerror(errno));
 		return false;
@@ -142,13 +143,127 @@ static bool dup_and_save_fd(int fd, int redir_fd, struct saved_fd *saved) {
 	return true;
 }
 
-static int run_builtin(struct mrsh_context *ctx, struct mrsh_simple_command *sc,
+/**
+ * Builtins write to the stdio buffer of stdout, which is only flushed when
+ * needed. When the standard error is the same file, e.g. with `2>&1`, the
+ * output must be written before the diagnostics of the next commands.
+ */
+static void flush_shared_output(void) {
+	struct stat out, err;
+	if (fstat(STDOUT_FILENO, &out) == 0 && fstat(STDERR_FILENO, &err) == 0 &&
+			out.st_dev == err.st_dev && out.st_ino == err.st_ino) {
+		fflush(stdout);
+	}
+}
+
+/**
+ * A redirection error aborts special builtins, like a syntax error would, but
+ * only fails regular ones.
+ */
+static int redirect_error_status(const struct builtin *builtin) {
+	return builtin->special ? TASK_STATUS_ERROR : 1;
+}
+
+/**
+ * Puts back the file descriptors saved before redirecting a builtin.
+ */
+static bool restore_fds(struct saved_fd *fds, size_t len) {
+	bool ok = true;
+	for (size_t i = 0; i < len; ++i) {
+		if (fds[i].closed) {
+			close(fds[i].redir_fd);
+		}
+		if (fds[i].dup_fd < 0) {
+			continue;
+		}
+
+		if (dup2(fds[i].dup_fd, fds[i].redir_fd) < 0) {
+			fprintf(stderr, "failed to duplicate file descriptor: %s\n",
+				strerror(errno));
+			ok = false;
+		}
+		close(fds[i].dup_fd);
+	}
+	return ok;
+}
+
+static bool can_bind_fds(struct mrsh_simple_command *sc) {
+	for (size_t i = 0; i < sc->io_redirects.len; ++i) {
+		struct mrsh_io_redirect *redir = sc->io_redirects.data[i];
+		if (redir->io_number >= BUILTIN_FDS) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Runs a builtin with virtual redirections: they only rebind file descriptors
+ * in the table of the builtin, real ones are left untouched.
+ */
+static int run_builtin_with_fds(struct mrsh_context *ctx,
+		struct mrsh_simple_command *sc, const struct builtin *builtin,
 		int argc, char **argv) {
+	// Files opened for the redirections, closed when the builtin returns.
+	// Zero-length VLAs are undefined behaviour
+	int opened[sc->io_redirects.len + 1];
+	size_t opened_len = 0;
+
+	int ret = redirect_error_status(builtin);
+	for (size_t i = 0; i < sc->io_redirects.len; ++i) {
+		struct mrsh_io_redirect *redir = sc->io_redirects.data[i];
+
+		int redir_fd;
+		int fd = process_redir(ctx->state, redir, &redir_fd);
+		if (fd < 0) {
+			goto out;
+		}
+
+		if (redir->op == MRSH_IO_LESSAND || redir->op == MRSH_IO_GREATAND) {
+			fd = builtin_fd(ctx->state, fd);
+			if (fcntl(fd, F_GETFD) < 0) {
+				fprintf(stderr, "cannot duplicate file descriptor: %s\n",
+					strerror(errno));
+				goto out;
+			}
+		} else {
+			opened[opened_len++] = fd;
+		}
+		builtin_bind_fd(ctx->state, redir_fd, fd);
+	}
+
+	ret = builtin->func(ctx->state, argc, argv);
+	flush_shared_output();
+
+out:
+	if (!builtin_unbind_fds(ctx->state) && ret == 0) {
+		ret = 1;
+	}
+	for (size_t i = 0; i < opened_len; ++i) {
+		close(opened[i]);
+	}
+	return ret;
+}
+
+static int run_builtin(struct mrsh_context *ctx, struct mrsh_simple_command *sc,
+		const struct builtin *builtin, int argc, char **argv) {
+	if (builtin->virtual_fds && can_bind_fds(sc)) {
+		return run_builtin_with_fds(ctx, sc, builtin, argc, argv);
+	}
+
 	// Duplicate old FDs to be able to restore them later
 	// Zero-length VLAs are undefined behaviour
 	struct saved_fd fds[sc->io_redirects.len + 1];
 	for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
 		fds[i].dup_fd = fds[i].redir_fd = -1;
+		fds[i].closed = false;
+	}
+
+	// Output is buffered until it's needed: here, the buffered output belongs
+	// to the file descriptors about to be redirected
+	bool redirected = sc->io_redirects.len > 0;
+	if (redirected) {
+		fflush(stdout);
 	}
 
 	for (size_t i = 0; i < sc->io_redirects.len; ++i) {
@@ -156,37 +271,44 @@ static int run_builtin(struct mrsh_context *ctx, struct mrsh_simple_command *sc,
 		struct saved_fd *saved = &fds[i];
 
 		int redir_fd;
-		int fd = process_redir(redir, &redir_fd);
+		int fd = process_redir(ctx->state, redir, &redir_fd);
 		if (fd < 0) {
-			return TASK_STATUS_ERROR;
+			restore_fds(fds, i);
+			return redirect_error_status(builtin);
 		}
 
-		if (!dup_and_save_fd(fd, redir_fd, saved)) {
-			return TASK_STATUS_ERROR;
+		bool saved_ok = dup_and_save_fd(fd, redir_fd, saved);
+
+		// Files opened for the builtin must not stay open after it returns,
+		// e.g. an executable written by printf would be busy
+		bool opened = redir->op != MRSH_IO_LESSAND &&
+			redir->op != MRSH_IO_GREATAND;
+		if (opened && fd != redir_fd) {
+			close(fd);
+		} else if (opened) {
+			// The file has been opened as the lowest free file descriptor
+			saved->closed = true;
+		}
+
+		if (!saved_ok) {
+			restore_fds(fds, i + 1);
+			return redirect_error_status(builtin);
 		}
 	}
 
 	// TODO: environment from assignements
 
-	int ret = mrsh_run_builtin(ctx->state, argc, argv);
-
-	// In case stdout/stderr are pipes, we need to flush to ensure output lines
-	// aren't out-of-order
-	fflush(stdout);
-	fflush(stderr);
+	int ret = builtin->func(ctx->state, argc, argv);
 
-	// Restore old FDs
-	for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
-		if (fds[i].dup_fd < 0) {
-			continue;
-		}
+	if (redirected) {
+		fflush(stdout);
+		fflush(stderr);
+	} else {
+		flush_shared_output();
+	}
 
-		if (dup2(fds[i].dup_fd, fds[i].redir_fd) < 0) {
-			fprintf(stderr, "failed to duplicate file descriptor: %s\n",
-				strerror(errno));
-			return TASK_STATUS_ERROR;
-		}
-		close(fds[i].dup_fd);
+	if (!restore_fds(fds, sc->io_redirects.len)) {
+		return TASK_STATUS_ERROR;
 	}
 
 	return ret;
@@ -195,7 +317,7 @@ static int run_builtin(struct mrsh_context *ctx, struct mrsh_simple_command *sc,
 static int run_assignments(struct mrsh_context *ctx, struct mrsh_array *assignments) {
 	for (size_t i = 0; i < assignments->len; ++i) {
 		struct mrsh_assignment *assign = assignments->data[i];
-		char *new_value = mrsh_word_str(assign->value);
+		char *new_value = ast_word_str(ctx->arena, assign->value);
 		uint32_t attribs = MRSH_VAR_ATTRIB_NONE;
 		if ((ctx->state->options & MRSH_OPT_ALLEXPORT)) {
 			attribs = MRSH_VAR_ATTRIB_EXPORT;
@@ -203,13 +325,13 @@ static int run_assignments(struct mrsh_context *ctx, struct mrsh_array *assignme
 		uint32_t prev_attribs = 0;
 		if (mrsh_env_get(ctx->state, assign->name, &prev_attribs) != NULL
 				&& (prev_attribs & MRSH_VAR_ATTRIB_READONLY)) {
-			free(new_value);
+			ast_free(ctx->arena, new_value);
 			fprintf(stderr, "cannot modify readonly variable %s\n",
 				assign->name);
 			return TASK_STATUS_ERROR;
 		}
 		mrsh_env_set(ctx->state, assign->name, new_value, attribs);
-		free(new_value);
+		ast_free(ctx->arena, new_value);
 	}
 
 	return 0;
@@ -219,7 +341,7 @@ static int expand_assignments(struct mrsh_context *ctx,
 		struct mrsh_array *assignments) {
 	for (size_t i = 0; i < assignments->len; ++i) {
 		struct mrsh_assignment *assign = assignments->data[i];
-		expand_tilde(ctx->state, &assign->value, true);
+		expand_tilde(ctx->state, ctx->arena, &assign->value, true);
 		int ret = run_word(ctx, &assign->value);
 		if (ret < 0) {
 			return ret;
@@ -229,62 +351,55 @@ static int expand_assignments(struct mrsh_context *ctx,
 }
 
 static struct mrsh_simple_command *copy_simple_command(
-		const struct mrsh_simple_command *sc) {
-	struct mrsh_command *cmd = mrsh_command_copy(&sc->command);
+		struct mrsh_arena *arena, const struct mrsh_simple_command *sc) {
+	struct mrsh_command *cmd = command_copy(arena, &sc->command);
 	return mrsh_command_get_simple_command(cmd);
 }
 
-int run_simple_command(struct mrsh_context *ctx, struct mrsh_simple_command *sc) {
-	struct mrsh_state *state = ctx->state;
-	struct mrsh_state_priv *priv = state_get_priv(state);
-
-	if (sc->name == NULL) {
-		// Copy each assignment from the AST, because during expansion and
-		// substitution we'll mutate the tree
-		struct mrsh_array assignments = {0};
-		mrsh_array_reserve(&assignments, sc->assignments.len);
-		for (size_t i = 0; i < sc->assignments.len; ++i) {
-			struct mrsh_assignment *assign = sc->assignments.data[i];
-			mrsh_array_add(&assignments, mrsh_assignment_copy(assign));
-		}
-
-		int ret = expand_assignments(ctx, &assignments);
-		if (ret < 0) {
-			return ret;
-		}
-
-		ret = run_assignments(ctx, &assignments);
-		if (ret < 0) {
-			return ret;
-		}
-
-		for (size_t i = 0; i < assignments.len; ++i) {
-			struct mrsh_assignment *assign = assignments.data[i];
-			mrsh_assignment_destroy(assign);
-		}
-		mrsh_array_finish(&assignments);
+static int run_assignment_command(struct mrsh_context *ctx,
+		struct mrsh_simple_command *sc) {
+	// Copy each assignment from the AST, because during expansion and
+	// substitution we'll mutate the tree
+	struct mrsh_array assignments = {0};
+	ast_array_reserve(ctx->arena, &assignments, sc->assignments.len);
+	for (size_t i = 0; i < sc->assignments.len; ++i) {
+		struct mrsh_assignment *assign = sc->assignments.data[i];
+		mrsh_array_add(&assignments, assignment_copy(ctx->arena, assign));
+	}
 
-		return 0;
+	int ret = expand_assignments(ctx, &assignments);
+	if (ret < 0) {
+		return ret;
 	}
 
-	// Copy the command from the AST, because during expansion and substitution
-	// we'll mutate the tree
-	sc = copy_simple_command(sc);
+	return run_assignments(ctx, &assignments);
+}
 
-	struct mrsh_array args = {0};
-	int ret = expand_word(ctx, sc->name, &args);
+static int expand_simple_command(struct mrsh_context *ctx,
+		struct mrsh_simple_command *sc, struct mrsh_array *args,
+		bool *forward_args) {
+	struct mrsh_state *state = ctx->state;
+	struct mrsh_state_priv *priv = state_get_priv(state);
+
+	int ret = expand_word(ctx, sc->name, args);
 	if (ret < 0) {
 		return ret;
 	}
-	for (size_t i = 0; i < sc->arguments.len; ++i) {
+
+	// When a function is called with "$@", the positional parameters are
+	// shared with the new call frame instead of being copied
+	*forward_args = args->len == 1 && sc->arguments.len == 1 &&
+		is_quoted_at_sign(sc->arguments.data[0]) &&
+		mrsh_hashtable_get(&priv->functions, args->data[0]) != NULL;
+	for (size_t i = 0; i < sc->arguments.len && !*forward_args; ++i) {
 		struct mrsh_word *arg = sc->arguments.data[i];
-		ret = expand_word(ctx, arg, &args);
+		ret = expand_word(ctx, arg, args);
 		if (ret < 0) {
 			return ret;
 		}
 	}
-	assert(args.len > 0);
-	mrsh_array_add(&args, NULL);
+	assert(args->len > 0);
+	ast_array_add(ctx->arena, args, NULL);
 
 	ret = expand_assignments(ctx, &sc->assignments);
 	if (ret < 0) {
@@ -293,7 +408,7 @@ int run_simple_command(struct mrsh_context *ctx, struct mrsh_simple_command *sc)
 
 	for (size_t i = 0; i < sc->io_redirects.len; ++i) {
 		struct mrsh_io_redirect *redir = sc->io_redirects.data[i];
-		expand_tilde(state, &redir->name, false);
+		expand_tilde(state, ctx->arena, &redir->name, false);
 		ret = run_word(ctx, &redir->name);
 		if (ret < 0) {
 			return ret;
@@ -301,7 +416,7 @@ int run_simple_command(struct mrsh_context *ctx, struct mrsh_simple_command *sc)
 		for (size_t j = 0; j < redir->here_document.len; ++j) {
 			struct mrsh_word **line_word_ptr =
 				(struct mrsh_word **)&redir->here_document.data[j];
-			expand_tilde(state, line_word_ptr, false);
+			expand_tilde(state, ctx->arena, line_word_ptr, false);
 			ret = run_word(ctx, line_word_ptr);
 			if (ret < 0) {
 				return ret;
@@ -309,8 +424,99 @@ int run_simple_command(struct mrsh_context *ctx, struct mrsh_simple_command *sc)
 		}
 	}
 
-	char **argv = (char **)args.data;
-	int argc = args.len - 1; // argv is NULL-terminated
+	return 0;
+}
+
+/**
+ * Parses the body of a function if parsing it was deferred when the function
+ * was defined.
+ */
+static bool load_function_body(struct mrsh_state *state,
+		struct mrsh_function *fn) {
+	if (fn->body != NULL) {
+		return true;
+	}
+
+	struct mrsh_arena *arena = calloc(1, sizeof(struct mrsh_arena));
+	if (arena == NULL) {
+		return false;
+	}
+
+	struct mrsh_parser *parser = mrsh_parser_with_data(fn->body_source,
+		strlen(fn->body_source));
+	parser_set_position(parser, &fn->body_pos, fn->lines);
+	mrsh_state_set_parser_alias_func(state, parser);
+	struct mrsh_command *body = parse_function_body(parser, arena);
+
+	struct mrsh_location err_loc;
+	const char *err_msg = mrsh_parser_error(parser, &err_loc);
+	if (err_msg != NULL) {
+		fprintf(stderr, "%s:%d:%d: syntax error: %s\n", state->frame->argv_0,
+			err_loc.line, err_loc.column, err_msg);
+		mrsh_parser_destroy(parser);
+		arena_finish(arena);
+		free(arena);
+		return false;
+	}
+	mrsh_parser_destroy(parser);
+
+	fn->body = body;
+	fn->arena = arena;
+	free(fn->body_source);
+	fn->body_source = NULL;
+	return true;
+}
+
+enum command_type {
+	COMMAND_FUNCTION,
+	COMMAND_BUILTIN,
+	COMMAND_UTILITY,
+};
+
+/**
+ * Looks up what a command name refers to, in order: a function, a builtin or
+ * a utility. Returns false if there's none.
+ */
+static bool resolve_command(struct mrsh_state *state, const char *name,
+		struct mrsh_command_cache *resolved) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	resolved->generation = priv->command_generation;
+
+	const void *target;
+	if ((target = mrsh_hashtable_get(&priv->functions, name)) != NULL) {
+		resolved->type = COMMAND_FUNCTION;
+	} else if ((target = get_builtin(name)) != NULL) {
+		resolved->type = COMMAND_BUILTIN;
+	} else if ((target = find_utility(state, name)) != NULL) {
+		resolved->type = COMMAND_UTILITY;
+	} else {
+		return false;
+	}
+	resolved->target = target;
+	return true;
+}
+
+/**
+ * Checks whether a command name always expands to itself, in which case what
+ * it refers to can be cached. Names containing a slash don't need to be looked
+ * up.
+ */
+static bool is_literal_name(const struct mrsh_word *word) {
+	if (word->type != MRSH_WORD_STRING) {
+		return false;
+	}
+	const struct mrsh_word_string *ws = mrsh_word_get_string(word);
+	if (strchr(ws->str, '/') != NULL) {
+		return false;
+	}
+	return ws->single_quoted || strpbrk(ws->str, "~*?[") == NULL;
+}
+
+static int run_expanded_command(struct mrsh_context *ctx,
+		struct mrsh_simple_command *sc, struct mrsh_command_cache *cache,
+		int argc, char **argv, bool forward_args) {
+	struct mrsh_state *state = ctx->state;
+	struct mrsh_state_priv *priv = state_get_priv(state);
 	const char *argv_0 = argv[0];
 
 	if ((state->options & MRSH_OPT_XTRACE)) {
@@ -319,31 +525,118 @@ int run_simple_command(struct mrsh_context *ctx, struct mrsh_simple_command *sc)
 		for (int i = 0; i < argc; ++i) {
 			fprintf(stderr, "%s%s", i > 0 ? " " : "", argv[i]);
 		}
+		if (forward_args) {
+			int nargs = mrsh_call_frame_nargs(state->frame);
+			for (int i = 1; i <= nargs; ++i) {
+				fprintf(stderr, " %s", mrsh_call_frame_get_arg(state->frame, i));
+			}
+		}
 		fprintf(stderr, "\n");
 		free(ps4);
 	}
 
-	ret = -1;
-	const struct mrsh_function *fn_def =
-		mrsh_hashtable_get(&priv->functions, argv_0);
-	if (fn_def != NULL) {
-		push_frame(state, argc, (const char **)argv);
-		// fn_def may be free'd during run_command when overwritten with another
-		// function, so we need to copy it.
-		struct mrsh_command *body = mrsh_command_copy(fn_def->body);
-		ret = run_command(ctx, body);
-		mrsh_command_destroy(body);
-		pop_frame(state);
-	} else if (mrsh_has_builtin(argv_0)) {
-		ret = run_builtin(ctx, sc, argc, argv);
+	struct mrsh_command_cache resolved;
+	if (cache != NULL && cache->generation == priv->command_generation) {
+		resolved = *cache;
+	} else if (resolve_command(state, argv_0, &resolved)) {
+		if (cache != NULL) {
+			*cache = resolved;
+		}
 	} else {
-		ret = run_process(ctx, sc, argv);
+		fprintf(stderr, "%s: not found\n", argv_0);
+		return 127;
 	}
 
-	mrsh_command_destroy(&sc->command);
-	for (size_t i = 0; i < args.len; ++i) {
-		free(args.data[i]);
+	assert(resolved.type == COMMAND_FUNCTION || !forward_args);
+	switch ((enum command_type)resolved.type) {
+	case COMMAND_FUNCTION:
+		break;
+	case COMMAND_BUILTIN:;
+		uint64_t begin = trace_begin(state);
+		int ret = run_builtin(ctx, sc, resolved.target, argc, argv);
+		trace_command(state, begin, "builtin", argc, argv);
+		return ret;
+	case COMMAND_UTILITY:
+		return run_process(ctx, sc, resolved.target, argv);
 	}
-	mrsh_array_finish(&args);
+
+	// Cast away const: the function is owned by the shell
+	struct mrsh_function *fn_def = (struct mrsh_function *)resolved.target;
+	if (!load_function_body(state, fn_def)) {
+		return 1;
+	}
+
+	struct mrsh_args *fn_args;
+	if (forward_args) {
+		fn_args = args_ref(state->frame->args);
+		push_frame(state, argv_0, fn_args, state->frame->args_offset);
+	} else {
+		// The call frame outlives the arena, it needs its own copy of the
+		// arguments
+		for (int i = 1; i < argc; ++i) {
+			argv[i] = strdup(argv[i]);
+		}
+		fn_args = args_create(argc - 1, &argv[1]);
+		push_frame(state, argv_0, fn_args, 0);
+	}
+	args_unref(fn_args);
+	// The function may be redefined or unset while it runs. Run its body
+	// in place rather than from a copy, so that the command caches of its
+	// simple commands are kept from one call to the next.
+	function_ref(fn_def);
+	struct mrsh_context fn_ctx = *ctx;
+	fn_ctx.lines = fn_def->lines;
+	struct profile_frame frame;
+	bool profiled = profile_enter_function(state, &frame, argv_0);
+	uint64_t begin = trace_begin(state);
+	int ret = run_command(&fn_ctx, fn_def->body);
+	// Arguments have been handed over to the call frame, only the name is
+	// still valid
+	trace_command(state, begin, "function", 1, argv);
+	if (profiled) {
+		profile_leave(state, &frame);
+	}
+	function_unref(fn_def);
+	pop_frame(state);
+	return ret;
+}
+
+int run_simple_command(struct mrsh_context *ctx, struct mrsh_simple_command *sc) {
+	struct mrsh_state_priv *priv = state_get_priv(ctx->state);
+
+	// Everything allocated while expanding the command is only needed until
+	// it completes, so it's allocated from the arena and released at once
+	struct mrsh_arena_mark mark = arena_mark(&priv->arena);
+	struct mrsh_context expand_ctx = *ctx;
+	expand_ctx.arena = &priv->arena;
+
+	if (sc->name == NULL) {
+		int ret = run_assignment_command(&expand_ctx, sc);
+		arena_release(&priv->arena, mark);
+		return ret;
+	}
+
+	// The cache stays in the AST, so that the next runs can use it
+	struct mrsh_command_cache *cache = NULL;
+	if (is_literal_name(sc->name)) {
+		cache = simple_command_get_cache(sc);
+	}
+
+	// Copy the command from the AST, because during expansion and substitution
+	// we'll mutate the tree
+	sc = copy_simple_command(&priv->arena, sc);
+
+	struct mrsh_array args = {0};
+	bool forward_args = false;
+	int ret = expand_simple_command(&expand_ctx, sc, &args, &forward_args);
+	if (ret >= 0) {
+		char **argv = (char **)args.data;
+		int argc = args.len - 1; // argv is NULL-terminated
+		ret = run_expanded_command(ctx, sc, cache, argc, argv,
+			forward_args);
+	}
+
+	// This also releases the arguments
+	arena_release(&priv->arena, mark);
 	return ret;
 }
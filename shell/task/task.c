@@ -8,14 +8,220 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "arena.h"
+#include "ast.h"
+#include "shell/profile.h"
 #include "shell/shell.h"
+#include "shell/snapshot.h"
 #include "shell/task.h"
+#include "shell/trace.h"
 #include "shell/trap.h"
 
-static int run_subshell(struct mrsh_context *ctx, struct mrsh_array *array) {
+/**
+ * Builtins which can't run in a subshell without forking: they either replace
+ * the shell process, deal with child processes and traps, or run arbitrary
+ * code we can't inspect beforehand.
+ */
+static const char *forking_builtins[] = {
+	".",
+	"bg",
+	"command",
+	"eval",
+	"exec",
+	"fg",
+	"jobs",
+	"read",
+	"trap",
+	"ulimit",
+	"wait",
+};
+
+// Limits recursion through function calls
+#define FORKLESS_MAX_DEPTH 16
+
+static bool command_is_forkless(struct mrsh_state *state,
+	struct mrsh_command *cmd, int depth);
+
+static bool command_list_array_is_forkless(struct mrsh_state *state,
+		struct mrsh_array *array, int depth);
+
+static bool and_or_list_is_forkless(struct mrsh_state *state,
+		struct mrsh_and_or_list *and_or_list, int depth) {
+	switch (and_or_list->type) {
+	case MRSH_AND_OR_LIST_PIPELINE:;
+		struct mrsh_pipeline *pl = mrsh_and_or_list_get_pipeline(and_or_list);
+		for (size_t i = 0; i < pl->commands.len; ++i) {
+			if (!command_is_forkless(state, pl->commands.data[i], depth)) {
+				return false;
+			}
+		}
+		return true;
+	case MRSH_AND_OR_LIST_BINOP:;
+		struct mrsh_binop *binop = mrsh_and_or_list_get_binop(and_or_list);
+		return and_or_list_is_forkless(state, binop->left, depth) &&
+			and_or_list_is_forkless(state, binop->right, depth);
+	}
+	abort();
+}
+
+static bool command_list_array_is_forkless(struct mrsh_state *state,
+		struct mrsh_array *array, int depth) {
+	for (size_t i = 0; i < array->len; ++i) {
+		struct mrsh_command_list *list = array->data[i];
+		if (list->ampersand ||
+				!and_or_list_is_forkless(state, list->and_or_list, depth)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool simple_command_is_forkless(struct mrsh_state *state,
+		struct mrsh_simple_command *sc, int depth) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+
+	if (sc->name == NULL) {
+		return true;
+	}
+	if (sc->name->type != MRSH_WORD_STRING) {
+		// We can't know which command will be executed
+		return false;
+	}
+	const char *name = mrsh_word_get_string(sc->name)->str;
+
+	size_t forking_builtins_len =
+		sizeof(forking_builtins) / sizeof(forking_builtins[0]);
+	for (size_t i = 0; i < forking_builtins_len; ++i) {
+		if (strcmp(name, forking_builtins[i]) == 0) {
+			return false;
+		}
+	}
+
+	struct mrsh_function *fn = mrsh_hashtable_get(&priv->functions, name);
+	if (fn != NULL) {
+		return fn->body != NULL &&
+			command_is_forkless(state, fn->body, depth + 1);
+	}
+	return true;
+}
+
+static bool command_is_forkless(struct mrsh_state *state,
+		struct mrsh_command *cmd, int depth) {
+	if (depth > FORKLESS_MAX_DEPTH) {
+		return false;
+	}
+
+	switch (cmd->type) {
+	case MRSH_SIMPLE_COMMAND:;
+		struct mrsh_simple_command *sc = mrsh_command_get_simple_command(cmd);
+		return simple_command_is_forkless(state, sc, depth);
+	case MRSH_BRACE_GROUP:;
+		struct mrsh_brace_group *bg = mrsh_command_get_brace_group(cmd);
+		return command_list_array_is_forkless(state, &bg->body, depth);
+	case MRSH_SUBSHELL:;
+		struct mrsh_subshell *s = mrsh_command_get_subshell(cmd);
+		return command_list_array_is_forkless(state, &s->body, depth);
+	case MRSH_IF_CLAUSE:;
+		struct mrsh_if_clause *ic = mrsh_command_get_if_clause(cmd);
+		return command_list_array_is_forkless(state, &ic->condition, depth) &&
+			command_list_array_is_forkless(state, &ic->body, depth) &&
+			(ic->else_part == NULL ||
+			command_is_forkless(state, ic->else_part, depth));
+	case MRSH_FOR_CLAUSE:;
+		struct mrsh_for_clause *fc = mrsh_command_get_for_clause(cmd);
+		return command_list_array_is_forkless(state, &fc->body, depth);
+	case MRSH_LOOP_CLAUSE:;
+		struct mrsh_loop_clause *lc = mrsh_command_get_loop_clause(cmd);
+		return command_list_array_is_forkless(state, &lc->condition, depth) &&
+			command_list_array_is_forkless(state, &lc->body, depth);
+	case MRSH_CASE_CLAUSE:;
+		struct mrsh_case_clause *cc = mrsh_command_get_case_clause(cmd);
+		for (size_t i = 0; i < cc->items.len; ++i) {
+			struct mrsh_case_item *ci = cc->items.data[i];
+			if (!command_list_array_is_forkless(state, &ci->body, depth)) {
+				return false;
+			}
+		}
+		return true;
+	case MRSH_FUNCTION_DEFINITION:;
+		// The function may be called later on in the subshell
+		struct mrsh_function_definition *fnd =
+			mrsh_command_get_function_definition(cmd);
+		return fnd->body != NULL &&
+			command_is_forkless(state, fnd->body, depth + 1);
+	}
+	abort();
+}
+
+/**
+ * Checks whether a subshell can run in the shell process, with its state
+ * saved and restored around it.
+ */
+static bool subshell_is_forkless(struct mrsh_state *state,
+		struct mrsh_array *array) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+
+	// With job control enabled, the subshell must be a process of its own so
+	// that it can be stopped
+	if (priv->job_control) {
+		return false;
+	}
+	// Caught traps are reset in subshells
+	for (size_t i = 0; i < MRSH_NSIG; ++i) {
+		if (priv->traps[i].set) {
+			return false;
+		}
+	}
+
+	return command_list_array_is_forkless(state, array, 0);
+}
+
+static int subshell_status(struct mrsh_context *ctx, int ret) {
+	if (ctx->state->exit >= 0) {
+		return ctx->state->exit;
+	}
+	if (ret == TASK_STATUS_INTERRUPTED) {
+		struct mrsh_call_frame_priv *frame_priv =
+			call_frame_get_priv(ctx->state->frame);
+		if (frame_priv->branch_control == MRSH_BRANCH_RETURN) {
+			return ctx->state->last_status;
+		}
+	}
+	if (ret < 0) {
+		return 127;
+	}
+	return ret;
+}
+
+static int run_subshell_forkless(struct mrsh_context *ctx,
+		struct mrsh_array *array) {
+	struct mrsh_snapshot snapshot;
+	// If job control is disabled, stdin is /dev/null
+	bool null_stdin = !(ctx->state->options & MRSH_OPT_MONITOR);
+	if (!snapshot_save(ctx->state, &snapshot, null_stdin)) {
+		return TASK_STATUS_ERROR;
+	}
+
+	int ret = run_command_list_array(ctx, array);
+	ret = subshell_status(ctx, ret);
+
+	ctx->state->exit = -1;
+	snapshot_restore(ctx->state, &snapshot);
+	return ret;
+}
+
+static int run_subshell(struct mrsh_context *ctx, struct mrsh_subshell *s) {
 	struct mrsh_state_priv *priv = state_get_priv(ctx->state);
+	struct mrsh_array *array = &s->body;
 
-	pid_t pid = fork();
+	if (subshell_is_forkless(ctx->state, array)) {
+		int ret = run_subshell_forkless(ctx, array);
+		if (ret != TASK_STATUS_ERROR) {
+			return ret;
+		}
+	}
+
+	pid_t pid = fork_process(ctx->state);
 	if (pid < 0) {
 		perror("fork");
 		return TASK_STATUS_ERROR;
@@ -39,16 +245,10 @@ static int run_subshell(struct mrsh_context *ctx, struct mrsh_array *array) {
 		}
 
 		int ret = run_command_list_array(ctx, array);
-		if (ret < 0) {
-			exit(127);
-		}
-
-		if (ctx->state->exit >= 0) {
-			exit(ctx->state->exit);
-		}
-		exit(ret);
+		exit(subshell_status(ctx, ret));
 	}
 
+	trace_fork(ctx->state, pid, &s->command.node);
 	struct mrsh_process *proc = process_create(ctx->state, pid);
 	return job_wait_process(proc);
 }
@@ -185,61 +385,78 @@ interrupt:
 	}
 
 	for (size_t i = 0; i < fields.len; i++) {
-		free(fields.data[i]);
+		ast_free(ctx->arena, fields.data[i]);
 	}
-	mrsh_array_finish(&fields);
+	ast_array_finish(ctx->arena, &fields);
 
 	--frame_priv->nloops;
 	return loop_ret;
 }
 
-static int run_case_clause(struct mrsh_context *ctx, struct mrsh_case_clause *cc) {
-	struct mrsh_word *word = mrsh_word_copy(cc->word);
-	expand_tilde(ctx->state, &word, false);
-	int ret = run_word(ctx, &word);
+/**
+ * Expands a copy of a word of a case clause: the AST is shared with the other
+ * runs of the clause, which need to expand the original word again.
+ */
+static int expand_case_word(struct mrsh_context *ctx,
+		const struct mrsh_word *word, struct mrsh_word **expanded) {
+	*expanded = word_copy(ctx->arena, word);
+	expand_tilde(ctx->state, ctx->arena, expanded, false);
+	return run_word(ctx, expanded);
+}
+
+static int select_case_item(struct mrsh_context *ctx,
+		struct mrsh_case_clause *cc, struct mrsh_case_item **selected) {
+	struct mrsh_word *word;
+	int ret = expand_case_word(ctx, cc->word, &word);
 	if (ret < 0) {
-		mrsh_word_destroy(word);
 		return ret;
 	}
-	char *word_str = mrsh_word_str(word);
-	mrsh_word_destroy(word);
+	char *word_str = ast_word_str(ctx->arena, word);
 
-	int case_ret = 0;
 	for (size_t i = 0; i < cc->items.len; ++i) {
 		struct mrsh_case_item *ci = cc->items.data[i];
-
-		bool selected = false;
 		for (size_t j = 0; j < ci->patterns.len; ++j) {
-			// TODO: this mutates the AST
-			struct mrsh_word **word_ptr =
-				(struct mrsh_word **)&ci->patterns.data[j];
-			expand_tilde(ctx->state, word_ptr, false);
-			int ret = run_word(ctx, word_ptr);
+			struct mrsh_word *pattern_word;
+			ret = expand_case_word(ctx, ci->patterns.data[j], &pattern_word);
 			if (ret < 0) {
 				return ret;
 			}
-			char *pattern = word_to_pattern(*word_ptr);
+			bool match;
+			char *pattern = word_to_pattern(ctx->arena, pattern_word);
 			if (pattern != NULL) {
-				selected = fnmatch(pattern, word_str, 0) == 0;
-				free(pattern);
+				match = fnmatch(pattern, word_str, 0) == 0;
 			} else {
-				char *str = mrsh_word_str(*word_ptr);
-				selected = strcmp(str, word_str) == 0;
-				free(str);
+				char *str = ast_word_str(ctx->arena, pattern_word);
+				match = strcmp(str, word_str) == 0;
 			}
-			if (selected) {
-				break;
+			if (match) {
+				*selected = ci;
+				return 0;
 			}
 		}
+	}
 
-		if (selected) {
-			case_ret = run_command_list_array(ctx, &ci->body);
-			break;
-		}
+	return 0;
+}
+
+static int run_case_clause(struct mrsh_context *ctx, struct mrsh_case_clause *cc) {
+	struct mrsh_state_priv *priv = state_get_priv(ctx->state);
+
+	// The word and the patterns are only needed until an item is selected
+	struct mrsh_arena_mark mark = arena_mark(&priv->arena);
+	struct mrsh_context expand_ctx = *ctx;
+	expand_ctx.arena = &priv->arena;
+	struct mrsh_case_item *selected = NULL;
+	int ret = select_case_item(&expand_ctx, cc, &selected);
+	arena_release(&priv->arena, mark);
+	if (ret < 0) {
+		return ret;
 	}
 
-	free(word_str);
-	return case_ret;
+	if (selected == NULL) {
+		return 0;
+	}
+	return run_command_list_array(ctx, &selected->body);
 }
 
 static int run_function_definition(struct mrsh_context *ctx,
@@ -247,14 +464,25 @@ static int run_function_definition(struct mrsh_context *ctx,
 	struct mrsh_state_priv *priv = state_get_priv(ctx->state);
 
 	struct mrsh_function *fn = calloc(1, sizeof(struct mrsh_function));
-	fn->body = mrsh_command_copy(fnd->body);
+	fn->ref = 1;
+	if (fnd->body != NULL) {
+		fn->body = mrsh_command_copy(fnd->body);
+	} else {
+		fn->body_source = strdup(fnd->body_source);
+		fn->body_pos = fnd->body_pos;
+	}
+	fn->lines = line_table_ref(ctx->lines);
 	struct mrsh_function *old_fn =
 		mrsh_hashtable_set(&priv->functions, fnd->name, fn);
-	function_destroy(old_fn);
+	if (!snapshot_keep(ctx->state, &priv->functions, fnd->name, old_fn)) {
+		function_unref(old_fn);
+	}
+	invalidate_commands(ctx->state);
 	return 0;
 }
 
-int run_command(struct mrsh_context *ctx, struct mrsh_command *cmd) {
+static int dispatch_command(struct mrsh_context *ctx,
+		struct mrsh_command *cmd) {
 	switch (cmd->type) {
 	case MRSH_SIMPLE_COMMAND:;
 		struct mrsh_simple_command *sc = mrsh_command_get_simple_command(cmd);
@@ -264,7 +492,7 @@ int run_command(struct mrsh_context *ctx, struct mrsh_command *cmd) {
 		return run_command_list_array(ctx, &bg->body);
 	case MRSH_SUBSHELL:;
 		struct mrsh_subshell *s = mrsh_command_get_subshell(cmd);
-		return run_subshell(ctx, &s->body);
+		return run_subshell(ctx, s);
 	case MRSH_IF_CLAUSE:;
 		struct mrsh_if_clause *ic = mrsh_command_get_if_clause(cmd);
 		return run_if_clause(ctx, ic);
@@ -286,6 +514,16 @@ int run_command(struct mrsh_context *ctx, struct mrsh_command *cmd) {
 	abort();
 }
 
+int run_command(struct mrsh_context *ctx, struct mrsh_command *cmd) {
+	struct profile_frame frame;
+	if (!profile_enter_command(ctx, &frame, cmd)) {
+		return dispatch_command(ctx, cmd);
+	}
+	int ret = dispatch_command(ctx, cmd);
+	profile_leave(ctx->state, &frame);
+	return ret;
+}
+
 int run_and_or_list(struct mrsh_context *ctx, struct mrsh_and_or_list *and_or_list) {
 	switch (and_or_list->type) {
 	case MRSH_AND_OR_LIST_PIPELINE:;
@@ -339,7 +577,7 @@ int run_command_list_array(struct mrsh_context *ctx, struct mrsh_array *array) {
 				child_ctx.job = job_create(state, &list->node);
 			}
 
-			pid_t pid = fork();
+			pid_t pid = fork_process(state);
 			if (pid < 0) {
 				perror("fork");
 				return TASK_STATUS_ERROR;
@@ -374,6 +612,7 @@ int run_command_list_array(struct mrsh_context *ctx, struct mrsh_array *array) {
 			}
 
 			ret = 0;
+			trace_fork(state, pid, &list->node);
 			init_async_child(&child_ctx, pid);
 		} else {
 			ret = run_and_or_list(ctx, list->and_or_list);
@@ -432,14 +671,17 @@ void mrsh_destroy_terminated_jobs(struct mrsh_state *state) {
 }
 
 int mrsh_run_program(struct mrsh_state *state, struct mrsh_program *prog) {
-	struct mrsh_context ctx = { .state = state };
+	struct mrsh_context ctx = {
+		.state = state,
+		.lines = program_get_line_table(prog),
+	};
 	int ret = run_command_list_array(&ctx, &prog->body);
 	run_pending_traps(state);
 	return ret;
 }
 
 int mrsh_run_word(struct mrsh_state *state, struct mrsh_word **word) {
-	expand_tilde(state, word, false);
+	expand_tilde(state, NULL, word, false);
 
 	struct mrsh_context ctx = { .state = state };
 	int last_status = state->last_status;
@@ -2,16 +2,20 @@
 #include <assert.h>
 #include <errno.h>
 #include <fnmatch.h>
+#include <limits.h>
 #include <mrsh/buffer.h>
 #include <mrsh/parser.h>
 #include <stdio.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "ast.h"
 #include "builtin.h"
+#include "intern.h"
 #include "shell/process.h"
+#include "shell/profile.h"
 #include "shell/task.h"
+#include "shell/trace.h"
 #include "shell/word.h"
 
 #define READ_SIZE 1024
@@ -80,12 +84,14 @@ static bool is_print_traps(struct mrsh_program *program) {
 	}
 }
 
-static void swap_words(struct mrsh_word **word_ptr, struct mrsh_word *new_word) {
-	mrsh_word_destroy(*word_ptr);
+static void swap_words(struct mrsh_context *ctx, struct mrsh_word **word_ptr,
+		struct mrsh_word *new_word) {
+	ast_word_destroy(ctx->arena, *word_ptr);
 	*word_ptr = new_word;
 }
 
-static int run_word_command(struct mrsh_context *ctx, struct mrsh_word **word_ptr) {
+static int run_word_command_process(struct mrsh_context *ctx,
+		struct mrsh_word **word_ptr) {
 	struct mrsh_word_command *wc = mrsh_word_get_command(*word_ptr);
 
 	int fds[2];
@@ -93,8 +99,9 @@ static int run_word_command(struct mrsh_context *ctx, struct mrsh_word **word_pt
 		perror("pipe");
 		return TASK_STATUS_ERROR;
 	}
+	++state_get_priv(ctx->state)->stats.pipes;
 
-	pid_t pid = fork();
+	pid_t pid = fork_process(ctx->state);
 	if (pid < 0) {
 		perror("fork");
 		close(fds[0]);
@@ -119,12 +126,19 @@ static int run_word_command(struct mrsh_context *ctx, struct mrsh_word **word_pt
 		}
 
 		if (wc->program != NULL) {
-			mrsh_run_program(ctx->state, wc->program);
+			// The nested program shares the line table of the outermost one
+			struct mrsh_context child_ctx = {
+				.state = ctx->state,
+				.lines = ctx->lines,
+			};
+			run_command_list_array(&child_ctx, &wc->program->body);
+			run_pending_traps(ctx->state);
 		}
 
 		exit(ctx->state->exit >= 0 ? ctx->state->exit : 0);
 	}
 
+	trace_fork(ctx->state, pid, &wc->word.node);
 	struct mrsh_process *process = process_create(ctx->state, pid);
 
 	close(fds[1]);
@@ -146,37 +160,48 @@ static int run_word_command(struct mrsh_context *ctx, struct mrsh_word **word_pt
 		--i;
 	}
 
-	struct mrsh_word_string *ws =
-		mrsh_word_string_create(mrsh_buffer_steal(&buf), false);
+	struct mrsh_word_string *ws = word_string_create(ctx->arena,
+		ast_buffer_steal(ctx->arena, &buf), false);
 	ws->split_fields = true;
-	swap_words(word_ptr, &ws->word);
+	swap_words(ctx, word_ptr, &ws->word);
 	return job_wait_process(process);
 }
 
+static int run_word_command(struct mrsh_context *ctx, struct mrsh_word **word_ptr) {
+	struct mrsh_word_command *wc = mrsh_word_get_command(*word_ptr);
+	++state_get_priv(ctx->state)->stats.substitutions;
+	struct profile_frame frame;
+	if (!profile_enter_word_command(ctx, &frame, wc)) {
+		return run_word_command_process(ctx, word_ptr);
+	}
+	int ret = run_word_command_process(ctx, word_ptr);
+	profile_leave(ctx->state, &frame);
+	return ret;
+}
+
 static const char *parameter_get_value(struct mrsh_state *state,
-		const char *name) {
+		const struct mrsh_word_parameter *wp) {
 	struct mrsh_state_priv *priv = state_get_priv(state);
 
 	static char value[16];
-	char *end;
-	long lvalue = strtol(name, &end, 10);
-	// Special cases
-	if (strcmp(name, "@") == 0 || strcmp(name, "*") == 0) {
+	switch (wp->kind) {
+	case MRSH_PARAM_KIND_AT:
+	case MRSH_PARAM_KIND_STAR:
 		// These are handled separately, because they evaluate to a word, not
 		// a raw string.
 		return NULL;
-	} else if (strcmp(name, "#") == 0) {
-		sprintf(value, "%d", state->frame->argc - 1);
+	case MRSH_PARAM_KIND_HASH:
+		sprintf(value, "%d", mrsh_call_frame_nargs(state->frame));
 		return value;
-	} else if (strcmp(name, "?") == 0) {
+	case MRSH_PARAM_KIND_QMARK:
 		sprintf(value, "%d", state->last_status);
 		return value;
-	} else if (strcmp(name, "-") == 0) {
+	case MRSH_PARAM_KIND_MINUS:
 		return state_get_options(state);
-	} else if (strcmp(name, "$") == 0) {
+	case MRSH_PARAM_KIND_DOLLAR:
 		sprintf(value, "%d", (int)getpid());
 		return value;
-	} else if (strcmp(name, "!") == 0) {
+	case MRSH_PARAM_KIND_BANG:
 		for (ssize_t i = priv->jobs.len - 1; i >= 0; i--) {
 			struct mrsh_job *job = priv->jobs.data[i];
 			if (job->processes.len == 0) {
@@ -189,18 +214,23 @@ static const char *parameter_get_value(struct mrsh_state *state,
 		}
 		/* Standard is unclear on what to do in this case, mimic dash */
 		return "";
-	} else if (end[0] == '\0' && end != name) {
-		if (lvalue >= state->frame->argc) {
+	case MRSH_PARAM_KIND_POSITIONAL:
+		if (wp->position < 0) {
 			return NULL;
 		}
-		return state->frame->argv[lvalue];
+		return mrsh_call_frame_get_arg(state->frame, wp->position);
+	case MRSH_PARAM_KIND_NAME:
+	case MRSH_PARAM_KIND_LINENO:
+		break;
 	}
 	// User-set cases
-	return mrsh_env_get(state, name, NULL);
+	struct mrsh_variable *var =
+		hashtable_get_atom(&priv->variables, wp->name);
+	return var ? var->value : NULL;
 }
 
 static struct mrsh_word *expand_positional_params(struct mrsh_state *state,
-		bool quote_args) {
+		struct mrsh_arena *arena, bool quote_args) {
 	const char *ifs = mrsh_env_get(state, "IFS", NULL);
 	char sep[2] = {0};
 	if (ifs == NULL) {
@@ -210,21 +240,23 @@ static struct mrsh_word *expand_positional_params(struct mrsh_state *state,
 	}
 
 	struct mrsh_array words = {0};
-	for (int i = 1; i < state->frame->argc; i++) {
-		const char *arg = state->frame->argv[i];
+	int nargs = mrsh_call_frame_nargs(state->frame);
+	ast_array_reserve(arena, &words, 2 * nargs);
+	for (int i = 1; i <= nargs; i++) {
+		const char *arg = mrsh_call_frame_get_arg(state->frame, i);
 		if (i > 1 && sep[0] != '\0') {
 			struct mrsh_word_string *ws =
-				mrsh_word_string_create(strdup(sep), false);
+				word_string_create(arena, ast_strdup(arena, sep), false);
 			ws->split_fields = true;
 			mrsh_array_add(&words, &ws->word);
 		}
 		struct mrsh_word_string *ws =
-			mrsh_word_string_create(strdup(arg), quote_args);
+			word_string_create(arena, ast_strdup(arena, arg), quote_args);
 		ws->split_fields = true;
 		mrsh_array_add(&words, &ws->word);
 	}
 
-	struct mrsh_word_list *wl = mrsh_word_list_create(&words, false);
+	struct mrsh_word_list *wl = word_list_create(arena, &words, false);
 	return &wl->word;
 }
 
@@ -245,16 +277,19 @@ static void mark_word_split_fields(struct mrsh_word *word) {
 	}
 }
 
-static struct mrsh_word *create_word_string(const char *str) {
-	struct mrsh_word_string *ws = mrsh_word_string_create(strdup(str), false);
+static struct mrsh_word *create_word_string(struct mrsh_arena *arena,
+		const char *str) {
+	struct mrsh_word_string *ws =
+		word_string_create(arena, ast_strdup(arena, str), false);
 	return &ws->word;
 }
 
-static struct mrsh_word *copy_word_or_null(struct mrsh_word *word) {
+static struct mrsh_word *copy_word_or_null(struct mrsh_arena *arena,
+		struct mrsh_word *word) {
 	if (word != NULL) {
-		return mrsh_word_copy(word);
+		return word_copy(arena, word);
 	} else {
-		return create_word_string("");
+		return create_word_string(arena, "");
 	}
 }
 
@@ -286,16 +321,16 @@ static int apply_parameter_cond_op(struct mrsh_context *ctx,
 		return 0;
 	case MRSH_PARAM_MINUS: // Use Default Values
 		if (value == NULL || (wp->colon && is_null_word(value))) {
-			mrsh_word_destroy(value);
-			*result = copy_word_or_null(wp->arg);
+			ast_word_destroy(ctx->arena, value);
+			*result = copy_word_or_null(ctx->arena, wp->arg);
 		} else {
 			*result = value;
 		}
 		return 0;
 	case MRSH_PARAM_EQUAL: // Assign Default Values
 		if (value == NULL || (wp->colon && is_null_word(value))) {
-			mrsh_word_destroy(value);
-			*result = copy_word_or_null(wp->arg);
+			ast_word_destroy(ctx->arena, value);
+			*result = copy_word_or_null(ctx->arena, wp->arg);
 			int ret = run_word(ctx, result);
 			if (ret < 0) {
 				return ret;
@@ -309,20 +344,21 @@ static int apply_parameter_cond_op(struct mrsh_context *ctx,
 		return 0;
 	case MRSH_PARAM_QMARK: // Indicate Error if Null or Unset
 		if (value == NULL || (wp->colon && is_null_word(value))) {
-			mrsh_word_destroy(value);
+			ast_word_destroy(ctx->arena, value);
 			char *err_msg;
 			if (wp->arg != NULL) {
-				struct mrsh_word *err_msg_word = mrsh_word_copy(wp->arg);
+				struct mrsh_word *err_msg_word =
+					word_copy(ctx->arena, wp->arg);
 				int ret = run_word(ctx, &err_msg_word);
 				if (ret < 0) {
 					return ret;
 				}
 				err_msg = mrsh_word_str(err_msg_word);
-				mrsh_word_destroy(err_msg_word);
+				ast_word_destroy(ctx->arena, err_msg_word);
 			} else {
 				err_msg = strdup("parameter not set or null");
 			}
-			fprintf(stderr, "%s: %s: %s\n", ctx->state->frame->argv[0],
+			fprintf(stderr, "%s: %s: %s\n", ctx->state->frame->argv_0,
 				wp->name, err_msg);
 			free(err_msg);
 			// TODO: make the shell exit if non-interactive
@@ -333,33 +369,34 @@ static int apply_parameter_cond_op(struct mrsh_context *ctx,
 		return 0;
 	case MRSH_PARAM_PLUS: // Use Alternative Value
 		if (value == NULL || (wp->colon && is_null_word(value))) {
-			*result = create_word_string("");
+			*result = create_word_string(ctx->arena, "");
 		} else {
-			*result = copy_word_or_null(wp->arg);
+			*result = copy_word_or_null(ctx->arena, wp->arg);
 		}
-		mrsh_word_destroy(value);
+		ast_word_destroy(ctx->arena, value);
 		return 0;
 	default:
 		abort(); // unreachable
 	}
 }
 
-static char *trim_str(const char *str, const char *cut, bool suffix) {
+static char *trim_str(struct mrsh_arena *arena, const char *str,
+		const char *cut, bool suffix) {
 	size_t len = strlen(str);
 	size_t cut_len = strlen(cut);
 	if (cut_len <= len) {
 		if (!suffix && memcmp(str, cut, cut_len) == 0) {
-			return strdup(str + cut_len);
+			return ast_strdup(arena, str + cut_len);
 		}
 		if (suffix && memcmp(str + len - cut_len, cut, cut_len) == 0) {
-			return strndup(str, len - cut_len);
+			return ast_strndup(arena, str, len - cut_len);
 		}
 	}
-	return strdup(str);
+	return ast_strdup(arena, str);
 }
 
-static char *trim_pattern(const char *str, const char *pattern, bool suffix,
-		bool largest) {
+static char *trim_pattern(struct mrsh_arena *arena, const char *str,
+		const char *pattern, bool suffix, bool largest) {
 	size_t len = strlen(str);
 	ssize_t begin, end, delta;
 	if ((!suffix && !largest) || (suffix && largest)) {
@@ -387,7 +424,7 @@ static char *trim_pattern(const char *str, const char *pattern, bool suffix,
 		}
 
 		if (fnmatch(pattern, match, 0) == 0) {
-			char *result = strdup(trimmed);
+			char *result = ast_strdup(arena, trimmed);
 			free(buf);
 			return result;
 		}
@@ -396,7 +433,7 @@ static char *trim_pattern(const char *str, const char *pattern, bool suffix,
 	}
 	free(buf);
 
-	return strdup(str);
+	return ast_strdup(arena, str);
 }
 
 static int apply_parameter_str_op(struct mrsh_context *ctx,
@@ -415,7 +452,7 @@ static int apply_parameter_str_op(struct mrsh_context *ctx,
 		}
 		char len_str[32];
 		snprintf(len_str, sizeof(len_str), "%d", len);
-		*result = create_word_string(len_str);
+		*result = create_word_string(ctx->arena, len_str);
 		return 0;
 	case MRSH_PARAM_PERCENT: // Remove Smallest Suffix Pattern
 	case MRSH_PARAM_DPERCENT: // Remove Largest Suffix Pattern
@@ -425,7 +462,7 @@ static int apply_parameter_str_op(struct mrsh_context *ctx,
 			*result = NULL;
 			return 0;
 		} else if (wp->arg == NULL) {
-			*result = create_word_string(str);
+			*result = create_word_string(ctx->arena, str);
 			return 0;
 		}
 
@@ -434,27 +471,28 @@ static int apply_parameter_str_op(struct mrsh_context *ctx,
 		bool largest = wp->op == MRSH_PARAM_DPERCENT ||
 			wp->op == MRSH_PARAM_DHASH;
 
-		struct mrsh_word *pattern = mrsh_word_copy(wp->arg);
+		struct mrsh_word *pattern = word_copy(ctx->arena, wp->arg);
 		int ret = run_word(ctx, &pattern);
 		if (ret < 0) {
 			return ret;
 		}
 
 		char *result_str;
-		char *pattern_str = word_to_pattern(pattern);
+		char *pattern_str = word_to_pattern(ctx->arena, pattern);
 		if (pattern_str == NULL) {
-			char *arg = mrsh_word_str(pattern);
-			mrsh_word_destroy(pattern);
-			result_str = trim_str(str, arg, suffix);
-			free(arg);
+			char *arg = ast_word_str(ctx->arena, pattern);
+			ast_word_destroy(ctx->arena, pattern);
+			result_str = trim_str(ctx->arena, str, arg, suffix);
+			ast_free(ctx->arena, arg);
 		} else {
-			mrsh_word_destroy(pattern);
-			result_str = trim_pattern(str, pattern_str, suffix, largest);
-			free(pattern_str);
+			ast_word_destroy(ctx->arena, pattern);
+			result_str = trim_pattern(ctx->arena, str, pattern_str, suffix,
+				largest);
+			ast_free(ctx->arena, pattern_str);
 		}
 
 		struct mrsh_word_string *result_ws =
-			mrsh_word_string_create(result_str, false);
+			word_string_create(ctx->arena, result_str, false);
 		*result = &result_ws->word;
 		return 0;
 	default:
@@ -473,13 +511,15 @@ static int _run_word(struct mrsh_context *ctx, struct mrsh_word **word_ptr,
 	case MRSH_WORD_PARAMETER:;
 		struct mrsh_word_parameter *wp = mrsh_word_get_parameter(word);
 
-		const char *value = parameter_get_value(ctx->state, wp->name);
+		const char *value = parameter_get_value(ctx->state, wp);
 		char lineno[16];
-		if (value == NULL && strcmp(wp->name, "LINENO") == 0) {
+		if (value == NULL && wp->kind == MRSH_PARAM_KIND_LINENO) {
 			struct mrsh_position pos;
 			mrsh_word_range(word, &pos, NULL);
+			struct mrsh_location loc;
+			line_table_lookup(ctx->lines, &pos, &loc);
 
-			snprintf(lineno, sizeof(lineno), "%d", pos.line);
+			snprintf(lineno, sizeof(lineno), "%d", loc.line);
 
 			value = lineno;
 		}
@@ -492,15 +532,16 @@ static int _run_word(struct mrsh_context *ctx, struct mrsh_word **word_ptr,
 		case MRSH_PARAM_QMARK:
 		case MRSH_PARAM_PLUS:;
 			struct mrsh_word *value_word;
-			if (strcmp(wp->name, "@") == 0) {
+			if (wp->kind == MRSH_PARAM_KIND_AT) {
 				// $@ expands to quoted fields only if it's inside double quotes
 				// TODO: error out if expansion is unspecified
 				value_word = expand_positional_params(ctx->state,
-					double_quoted);
-			} else if (strcmp(wp->name, "*") == 0) {
-				value_word = expand_positional_params(ctx->state, false);
+					ctx->arena, double_quoted);
+			} else if (wp->kind == MRSH_PARAM_KIND_STAR) {
+				value_word = expand_positional_params(ctx->state,
+					ctx->arena, false);
 			} else if (value != NULL) {
-				value_word = create_word_string(value);
+				value_word = create_word_string(ctx->arena, value);
 			} else {
 				value_word = NULL;
 			}
@@ -515,12 +556,13 @@ static int _run_word(struct mrsh_context *ctx, struct mrsh_word **word_ptr,
 		case MRSH_PARAM_DPERCENT:
 		case MRSH_PARAM_HASH:
 		case MRSH_PARAM_DHASH:
-			if (strcmp(wp->name, "@") == 0 || strcmp(wp->name, "*") == 0 ||
+			if (wp->kind == MRSH_PARAM_KIND_AT ||
+					wp->kind == MRSH_PARAM_KIND_STAR ||
 					(wp->op != MRSH_PARAM_LEADING_HASH &&
-					strcmp(wp->name, "#") == 0)) {
+					wp->kind == MRSH_PARAM_KIND_HASH)) {
 				fprintf(stderr, "%s: using this parameter operator on $%s "
 					"is undefined behaviour\n",
-					ctx->state->frame->argv[0], wp->name);
+					ctx->state->frame->argv_0, wp->name);
 				return TASK_STATUS_ERROR;
 			}
 
@@ -534,10 +576,10 @@ static int _run_word(struct mrsh_context *ctx, struct mrsh_word **word_ptr,
 		if (result == NULL) {
 			if ((ctx->state->options & MRSH_OPT_NOUNSET)) {
 				fprintf(stderr, "%s: %s: unbound variable\n",
-						ctx->state->frame->argv[0], wp->name);
+						ctx->state->frame->argv_0, wp->name);
 				return TASK_STATUS_ERROR;
 			}
-			result = create_word_string("");
+			result = create_word_string(ctx->arena, "");
 		}
 		mark_word_split_fields(result);
 		if (result->type != MRSH_WORD_STRING) {
@@ -546,7 +588,7 @@ static int _run_word(struct mrsh_context *ctx, struct mrsh_word **word_ptr,
 				return ret;
 			}
 		}
-		swap_words(word_ptr, result);
+		swap_words(ctx, word_ptr, result);
 		return 0;
 	case MRSH_WORD_COMMAND:
 		return run_word_command(ctx, word_ptr);
@@ -559,19 +601,19 @@ static int _run_word(struct mrsh_context *ctx, struct mrsh_word **word_ptr,
 			return ret;
 		}
 
-		char *body_str = mrsh_word_str(wa->body);
+		char *body_str = ast_word_str(ctx->arena, wa->body);
 		struct mrsh_parser *parser =
 			mrsh_parser_with_data(body_str, strlen(body_str));
-		free(body_str);
+		ast_free(ctx->arena, body_str);
 		struct mrsh_arithm_expr *expr = mrsh_parse_arithm_expr(parser);
 		if (expr == NULL) {
-			struct mrsh_position err_pos;
-			const char *err_msg = mrsh_parser_error(parser, &err_pos);
+			struct mrsh_location err_loc;
+			const char *err_msg = mrsh_parser_error(parser, &err_loc);
 			if (err_msg != NULL) {
 				// TODO: improve error line/column
 				fprintf(stderr, "%s (arithmetic %d:%d): %s\n",
-					ctx->state->frame->argv[0], err_pos.line,
-					err_pos.column, err_msg);
+					ctx->state->frame->argv_0, err_loc.line,
+					err_loc.column, err_msg);
 			} else {
 				fprintf(stderr, "expected an arithmetic expression\n");
 			}
@@ -584,10 +626,10 @@ static int _run_word(struct mrsh_context *ctx, struct mrsh_word **word_ptr,
 				char buf[32];
 				snprintf(buf, sizeof(buf), "%ld", result);
 
-				struct mrsh_word_string *ws =
-					mrsh_word_string_create(strdup(buf), false);
+				struct mrsh_word_string *ws = word_string_create(ctx->arena,
+					ast_strdup(ctx->arena, buf), false);
 				ws->split_fields = true;
-				swap_words(word_ptr, &ws->word);
+				swap_words(ctx, word_ptr, &ws->word);
 				ret = 0;
 			}
 		}
@@ -606,7 +648,7 @@ static int _run_word(struct mrsh_context *ctx, struct mrsh_word **word_ptr,
 			if ((*child_ptr)->type == MRSH_WORD_PARAMETER) {
 				struct mrsh_word_parameter *wp =
 					mrsh_word_get_parameter(*child_ptr);
-				is_at_sign = strcmp(wp->name, "@") == 0;
+				is_at_sign = wp->kind == MRSH_PARAM_KIND_AT;
 			}
 
 			ret = _run_word(ctx, child_ptr,
@@ -633,31 +675,32 @@ static int _run_word(struct mrsh_context *ctx, struct mrsh_word **word_ptr,
 				wl->children.data[i] = NULL; // steal the child
 				if (at_sign_idx >= at_sign_words.len ||
 						child != at_sign_words.data[at_sign_idx]) {
-					mrsh_array_add(&quoted, child);
+					ast_array_add(ctx->arena, &quoted, child);
 					continue;
 				}
 
 				if (quoted.len > 0) {
 					struct mrsh_word_list *quoted_wl =
-						mrsh_word_list_create(&quoted, true);
-					mrsh_array_add(&unquoted, &quoted_wl->word);
-					// `unquoted` has been stolen by mrsh_word_list_create
+						word_list_create(ctx->arena, &quoted, true);
+					ast_array_add(ctx->arena, &unquoted, &quoted_wl->word);
+					// `unquoted` has been stolen by word_list_create
 					quoted = (struct mrsh_array){0};
 				}
 
-				mrsh_array_add(&unquoted, at_sign_words.data[at_sign_idx]);
+				ast_array_add(ctx->arena, &unquoted,
+					at_sign_words.data[at_sign_idx]);
 
 				at_sign_idx++;
 			}
 			if (quoted.len > 0) {
 				struct mrsh_word_list *quoted_wl =
-					mrsh_word_list_create(&quoted, true);
-				mrsh_array_add(&unquoted, &quoted_wl->word);
+					word_list_create(ctx->arena, &quoted, true);
+				ast_array_add(ctx->arena, &unquoted, &quoted_wl->word);
 			}
 
 			struct mrsh_word_list *unquoted_wl =
-				mrsh_word_list_create(&unquoted, false);
-			swap_words(word_ptr, &unquoted_wl->word);
+				word_list_create(ctx->arena, &unquoted, false);
+			swap_words(ctx, word_ptr, &unquoted_wl->word);
 		}
 		mrsh_array_finish(&at_sign_words);
 
@@ -670,10 +713,32 @@ int run_word(struct mrsh_context *ctx, struct mrsh_word **word_ptr) {
 	return _run_word(ctx, word_ptr, false);
 }
 
+static int expand_quoted_at_sign(struct mrsh_context *ctx,
+		struct mrsh_array *expanded_fields) {
+	struct mrsh_state *state = ctx->state;
+	int nargs = mrsh_call_frame_nargs(state->frame);
+	// Leave room for the NULL terminator of argv
+	if (!ast_array_reserve(ctx->arena, expanded_fields,
+			expanded_fields->len + nargs + 1)) {
+		return TASK_STATUS_ERROR;
+	}
+	for (int i = 1; i <= nargs; ++i) {
+		ast_array_add(ctx->arena, expanded_fields, ast_strdup(ctx->arena,
+			mrsh_call_frame_get_arg(state->frame, i)));
+	}
+	return 0;
+}
+
 int expand_word(struct mrsh_context *ctx, const struct mrsh_word *_word,
 		struct mrsh_array *expanded_fields) {
-	struct mrsh_word *word = mrsh_word_copy(_word);
-	expand_tilde(ctx->state, &word, false);
+	if (is_quoted_at_sign(_word)) {
+		// "$@" expands to the positional parameters as-is, without field
+		// splitting nor pathname expansion
+		return expand_quoted_at_sign(ctx, expanded_fields);
+	}
+
+	struct mrsh_word *word = word_copy(ctx->arena, _word);
+	expand_tilde(ctx->state, ctx->arena, &word, false);
 
 	int ret = run_word(ctx, &word);
 	if (ret < 0) {
@@ -682,21 +747,22 @@ int expand_word(struct mrsh_context *ctx, const struct mrsh_word *_word,
 
 	struct mrsh_array fields = {0};
 	const char *ifs = mrsh_env_get(ctx->state, "IFS", NULL);
-	split_fields(&fields, word, ifs);
-	mrsh_word_destroy(word);
+	split_fields(ctx->arena, &fields, word, ifs);
+	ast_word_destroy(ctx->arena, word);
 
 	if (ctx->state->options & MRSH_OPT_NOGLOB) {
-		get_fields_str(expanded_fields, &fields);
+		get_fields_str(ctx->arena, expanded_fields, &fields);
 	} else {
-		if (!expand_pathnames(expanded_fields, &fields)) {
+		if (!expand_pathnames(ctx->state, ctx->arena, expanded_fields,
+				&fields)) {
 			return TASK_STATUS_ERROR;
 		}
 	}
 
 	for (size_t i = 0; i < fields.len; ++i) {
-		mrsh_word_destroy(fields.data[i]);
+		ast_word_destroy(ctx->arena, fields.data[i]);
 	}
-	mrsh_array_finish(&fields);
+	ast_array_finish(ctx->arena, &fields);
 
 	return ret;
 }
@@ -0,0 +1,281 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "shell/shell.h"
+#include "shell/trace.h"
+
+// Children mostly exit without destroying the shell, their buffered events
+// are written when they do
+static struct mrsh_trace *exit_trace = NULL;
+
+static void write_all(int fd, const char *data, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n < 0) {
+			return;
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+static void flush(struct mrsh_trace *trace) {
+	// The file is opened in append mode, so that each write of a process
+	// lands after the ones of the others
+	write_all(trace->fd, trace->buf.data, trace->buf.len);
+	trace->buf.len = 0;
+}
+
+static void flush_at_exit(void) {
+	if (exit_trace != NULL) {
+		flush(exit_trace);
+	}
+}
+
+static void trace_destroy(struct mrsh_trace *trace) {
+	if (trace == NULL) {
+		return;
+	}
+	flush(trace);
+	close(trace->fd);
+	mrsh_buffer_finish(&trace->buf);
+	if (exit_trace == trace) {
+		exit_trace = NULL;
+	}
+	free(trace);
+}
+
+static struct mrsh_trace *trace_create(const char *path) {
+	int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "failed to open %s for tracing: %s\n",
+			path, strerror(errno));
+		return NULL;
+	}
+
+	struct mrsh_trace *trace = calloc(1, sizeof(struct mrsh_trace));
+	if (trace == NULL) {
+		close(fd);
+		return NULL;
+	}
+	trace->fd = fd;
+	trace->pid = getpid();
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size == 0) {
+		write_all(fd, "[\n", 2);
+	}
+
+	static bool registered = false;
+	if (!registered) {
+		registered = atexit(flush_at_exit) == 0;
+	}
+	exit_trace = trace;
+	return trace;
+}
+
+void trace_update(struct mrsh_state *state, const char *path) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	trace_destroy(priv->trace);
+	priv->trace = NULL;
+	if (path != NULL && path[0] != '\0') {
+		priv->trace = trace_create(path);
+	}
+}
+
+void trace_flush(struct mrsh_state *state) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	if (priv->trace != NULL) {
+		flush(priv->trace);
+	}
+}
+
+void trace_finish(struct mrsh_state *state) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	trace_destroy(priv->trace);
+	priv->trace = NULL;
+}
+
+void trace_init_child(struct mrsh_state *state) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	if (priv->trace != NULL) {
+		priv->trace->pid = getpid();
+	}
+}
+
+static uint64_t now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t trace_begin(struct mrsh_state *state) {
+	struct mrsh_state_priv *priv = state_get_priv(state);
+	if (priv->trace == NULL) {
+		return 0;
+	}
+	return now();
+}
+
+static void append_str(struct mrsh_buffer *buf, const char *str) {
+	mrsh_buffer_append(buf, str, strlen(str));
+}
+
+static void append_json_chars(struct mrsh_buffer *buf, const char *str) {
+	for (; *str != '\0'; ++str) {
+		unsigned char c = *str;
+		if (c == '"' || c == '\\') {
+			mrsh_buffer_append_char(buf, '\\');
+			mrsh_buffer_append_char(buf, c);
+		} else if (c < 0x20) {
+			char esc[8];
+			snprintf(esc, sizeof(esc), "\\u%04x", c);
+			append_str(buf, esc);
+		} else {
+			mrsh_buffer_append_char(buf, c);
+		}
+	}
+}
+
+static void append_json_str(struct mrsh_buffer *buf, const char *str) {
+	mrsh_buffer_append_char(buf, '"');
+	append_json_chars(buf, str);
+	mrsh_buffer_append_char(buf, '"');
+}
+
+static void append_json_argv(struct mrsh_buffer *buf, int argc,
+		char **argv) {
+	mrsh_buffer_append_char(buf, '"');
+	for (int i = 0; i < argc; ++i) {
+		if (i > 0) {
+			mrsh_buffer_append_char(buf, ' ');
+		}
+		append_json_chars(buf, argv[i]);
+	}
+	mrsh_buffer_append_char(buf, '"');
+}
+
+/**
+ * Begins an event, up to its arguments. Timestamps are in microseconds.
+ */
+static void begin_event(struct mrsh_trace *trace, const char *category,
+		const char *name, char phase, uint64_t ts) {
+	struct mrsh_buffer *buf = &trace->buf;
+	append_str(buf, "{\"name\":");
+	append_json_str(buf, name);
+	char str[128];
+	snprintf(str, sizeof(str), ",\"cat\":\"%s\",\"ph\":\"%c\","
+		"\"ts\":%" PRIu64 ".%03u,\"pid\":%d,\"tid\":%d",
+		category, phase, ts / 1000, (unsigned)(ts % 1000),
+		(int)trace->pid, (int)trace->pid);
+	append_str(buf, str);
+	if (phase == 'i') {
+		append_str(buf, ",\"s\":\"t\"");
+	}
+}
+
+static void append_duration(struct mrsh_trace *trace, uint64_t begin) {
+	uint64_t dur = now() - begin;
+	char str[64];
+	snprintf(str, sizeof(str), ",\"dur\":%" PRIu64 ".%03u",
+		dur / 1000, (unsigned)(dur % 1000));
+	append_str(&trace->buf, str);
+}
+
+static void end_event(struct mrsh_trace *trace) {
+	append_str(&trace->buf, "},\n");
+	if (trace->buf.len >= TRACE_BUFFER_SIZE) {
+		flush(trace);
+	}
+}
+
+void trace_fork(struct mrsh_state *state, pid_t pid, struct mrsh_node *node) {
+	struct mrsh_trace *trace = state_get_priv(state)->trace;
+	if (trace == NULL) {
+		return;
+	}
+
+	begin_event(trace, "process", "fork", 'i', now());
+	char str[64];
+	snprintf(str, sizeof(str), ",\"args\":{\"child\":%d", (int)pid);
+	append_str(&trace->buf, str);
+	if (node != NULL) {
+		char *cmd = mrsh_node_format(node);
+		append_str(&trace->buf, ",\"command\":");
+		append_json_str(&trace->buf, cmd);
+		free(cmd);
+	}
+	append_str(&trace->buf, "}");
+	end_event(trace);
+}
+
+void trace_exec(struct mrsh_state *state, const char *path, char **argv) {
+	struct mrsh_trace *trace = state_get_priv(state)->trace;
+	if (trace == NULL) {
+		return;
+	}
+
+	int argc = 0;
+	while (argv[argc] != NULL) {
+		++argc;
+	}
+
+	begin_event(trace, "process", "exec", 'i', now());
+	append_str(&trace->buf, ",\"args\":{\"path\":");
+	append_json_str(&trace->buf, path);
+	append_str(&trace->buf, ",\"command\":");
+	append_json_argv(&trace->buf, argc, argv);
+	append_str(&trace->buf, "}");
+	end_event(trace);
+	flush(trace);
+}
+
+void trace_wait(struct mrsh_state *state, uint64_t begin, pid_t pid,
+		int stat) {
+	struct mrsh_trace *trace = state_get_priv(state)->trace;
+	if (trace == NULL || begin == 0) {
+		return;
+	}
+
+	begin_event(trace, "process", "wait", 'X', begin);
+	append_duration(trace, begin);
+	char str[128];
+	if (WIFEXITED(stat)) {
+		snprintf(str, sizeof(str), ",\"args\":{\"child\":%d,\"status\":%d}",
+			(int)pid, WEXITSTATUS(stat));
+	} else if (WIFSIGNALED(stat)) {
+		snprintf(str, sizeof(str), ",\"args\":{\"child\":%d,\"signal\":%d}",
+			(int)pid, WTERMSIG(stat));
+	} else {
+		snprintf(str, sizeof(str), ",\"args\":{\"child\":%d,\"stopped\":%d}",
+			(int)pid, WSTOPSIG(stat));
+	}
+	append_str(&trace->buf, str);
+	end_event(trace);
+}
+
+void trace_command(struct mrsh_state *state, uint64_t begin,
+		const char *category, int argc, char **argv) {
+	struct mrsh_trace *trace = state_get_priv(state)->trace;
+	if (trace == NULL || begin == 0) {
+		return;
+	}
+
+	begin_event(trace, category, argv[0], 'X', begin);
+	append_duration(trace, begin);
+	append_str(&trace->buf, ",\"args\":{\"command\":");
+	append_json_argv(&trace->buf, argc, argv);
+	append_str(&trace->buf, "}");
+	end_event(trace);
+}
@@ -2,11 +2,11 @@
 #include <assert.h>
 #include <ctype.h>
 #include <glob.h>
-#include <mrsh/buffer.h>
 #include <pwd.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include "ast.h"
 #include "shell/shell.h"
 #include "shell/word.h"
 
@@ -16,8 +16,9 @@ static bool is_logname_char(char c) {
 		(c >= '0' && c <= '9') || c == '.' || c == '_' || c == '-';
 }
 
-static ssize_t expand_tilde_at(struct mrsh_state *state, const char *str,
-		bool last, char **expanded_ptr) {
+static ssize_t expand_tilde_at(struct mrsh_state *state,
+		struct mrsh_arena *arena, const char *str, bool last,
+		char **expanded_ptr) {
 	if (str[0] != '~') {
 		return -1;
 	}
@@ -53,12 +54,12 @@ static ssize_t expand_tilde_at(struct mrsh_state *state, const char *str,
 		return -1;
 	}
 
-	*expanded_ptr = strdup(dir);
+	*expanded_ptr = ast_strdup(arena, dir);
 	return slash - str;
 }
 
-static void _expand_tilde(struct mrsh_state *state, struct mrsh_word **word_ptr,
-		bool assignment, bool first, bool last) {
+static void _expand_tilde(struct mrsh_state *state, struct mrsh_arena *arena,
+		struct mrsh_word **word_ptr, bool assignment, bool first, bool last) {
 	struct mrsh_word *word = *word_ptr;
 	switch (word->type) {
 	case MRSH_WORD_STRING:;
@@ -72,10 +73,11 @@ static void _expand_tilde(struct mrsh_state *state, struct mrsh_word **word_ptr,
 		const char *str = ws->str;
 		if (first) {
 			char *expanded;
-			ssize_t offset = expand_tilde_at(state, str, last, &expanded);
+			ssize_t offset =
+				expand_tilde_at(state, arena, str, last, &expanded);
 			if (offset >= 0) {
-				mrsh_array_add(&words,
-					mrsh_word_string_create(expanded, true));
+				ast_array_add(arena, &words,
+					word_string_create(arena, expanded, true));
 				str += offset;
 			}
 		}
@@ -87,30 +89,32 @@ static void _expand_tilde(struct mrsh_state *state, struct mrsh_word **word_ptr,
 					break;
 				}
 
-				char *slice = strndup(str, colon - str + 1);
-				mrsh_array_add(&words,
-					mrsh_word_string_create(slice, false));
+				char *slice = ast_strndup(arena, str, colon - str + 1);
+				ast_array_add(arena, &words,
+					word_string_create(arena, slice, false));
 
 				str = colon + 1;
 
 				char *expanded;
-				ssize_t offset = expand_tilde_at(state, str, last, &expanded);
+				ssize_t offset =
+					expand_tilde_at(state, arena, str, last, &expanded);
 				if (offset >= 0) {
-					mrsh_array_add(&words,
-						mrsh_word_string_create(expanded, true));
+					ast_array_add(arena, &words,
+						word_string_create(arena, expanded, true));
 					str += offset;
 				}
 			}
 		}
 
 		if (words.len > 0) {
-			char *trailing = strdup(str);
-			mrsh_array_add(&words,
-				mrsh_word_string_create(trailing, false));
+			char *trailing = ast_strdup(arena, str);
+			ast_array_add(arena, &words,
+				word_string_create(arena, trailing, false));
 
-			struct mrsh_word_list *wl = mrsh_word_list_create(&words, false);
+			struct mrsh_word_list *wl =
+				word_list_create(arena, &words, false);
 			*word_ptr = &wl->word;
-			mrsh_word_destroy(word);
+			ast_word_destroy(arena, word);
 		}
 		break;
 	case MRSH_WORD_LIST:;
@@ -121,8 +125,8 @@ static void _expand_tilde(struct mrsh_state *state, struct mrsh_word **word_ptr,
 		for (size_t i = 0; i < wl->children.len; ++i) {
 			struct mrsh_word **child_ptr =
 				(struct mrsh_word **)&wl->children.data[i];
-			_expand_tilde(state, child_ptr, assignment, first && i == 0,
-				last && i == wl->children.len - 1);
+			_expand_tilde(state, arena, child_ptr, assignment,
+				first && i == 0, last && i == wl->children.len - 1);
 		}
 		break;
 	default:
@@ -130,25 +134,35 @@ static void _expand_tilde(struct mrsh_state *state, struct mrsh_word **word_ptr,
 	}
 }
 
-void expand_tilde(struct mrsh_state *state, struct mrsh_word **word_ptr,
-		bool assignment) {
-	_expand_tilde(state, word_ptr, assignment, true, true);
+void expand_tilde(struct mrsh_state *state, struct mrsh_arena *arena,
+		struct mrsh_word **word_ptr, bool assignment) {
+	_expand_tilde(state, arena, word_ptr, assignment, true, true);
 }
 
 struct split_fields_data {
+	struct mrsh_arena *arena;
 	struct mrsh_array *fields;
-	struct mrsh_word_list *cur_field;
+	struct mrsh_array cur_field; // struct mrsh_word *
+	bool has_cur_field;
 	const char *ifs, *ifs_non_space;
 	bool in_ifs, in_ifs_non_space;
 };
 
 static void add_to_cur_field(struct split_fields_data *data,
 		struct mrsh_word *word) {
-	if (data->cur_field == NULL) {
-		data->cur_field = mrsh_word_list_create(NULL, false);
-		mrsh_array_add(data->fields, data->cur_field);
+	data->has_cur_field = true;
+	ast_array_add(data->arena, &data->cur_field, word);
+}
+
+static void end_cur_field(struct split_fields_data *data) {
+	if (!data->has_cur_field) {
+		return;
 	}
-	mrsh_array_add(&data->cur_field->children, word);
+	struct mrsh_word_list *wl =
+		word_list_create(data->arena, &data->cur_field, false);
+	ast_array_add(data->arena, data->fields, wl);
+	data->cur_field = (struct mrsh_array){0};
+	data->has_cur_field = false;
 }
 
 static void _split_fields(struct split_fields_data *data,
@@ -158,48 +172,47 @@ static void _split_fields(struct split_fields_data *data,
 		const struct mrsh_word_string *ws = mrsh_word_get_string(word);
 
 		if (ws->single_quoted || !ws->split_fields) {
-			add_to_cur_field(data, mrsh_word_copy(word));
+			add_to_cur_field(data, word_copy(data->arena, word));
 			data->in_ifs = data->in_ifs_non_space = false;
 			return;
 		}
 
-		struct mrsh_buffer buf = {0};
+		// Start of the current run of non-IFS characters
+		size_t start = 0;
 		size_t len = strlen(ws->str);
 		for (size_t i = 0; i < len; ++i) {
 			char c = ws->str[i];
 			if (strchr(data->ifs, c) == NULL) {
-				mrsh_buffer_append_char(&buf, c);
 				data->in_ifs = data->in_ifs_non_space = false;
 				continue;
 			}
 
 			bool is_ifs_non_space = strchr(data->ifs_non_space, c) != NULL;
 			if (!data->in_ifs || (is_ifs_non_space && data->in_ifs_non_space)) {
-				mrsh_buffer_append_char(&buf, '\0');
-				char *str = mrsh_buffer_steal(&buf);
+				char *str =
+					ast_strndup(data->arena, &ws->str[start], i - start);
 				add_to_cur_field(data,
-					&mrsh_word_string_create(str, false)->word);
-				data->cur_field = NULL;
+					&word_string_create(data->arena, str, false)->word);
+				end_cur_field(data);
 				data->in_ifs = true;
 			} else if (is_ifs_non_space) {
 				data->in_ifs_non_space = true;
 			}
+			start = i + 1;
 		}
 
 		if (!data->in_ifs) {
-			mrsh_buffer_append_char(&buf, '\0');
-			char *str = mrsh_buffer_steal(&buf);
+			char *str =
+				ast_strndup(data->arena, &ws->str[start], len - start);
 			add_to_cur_field(data,
-				&mrsh_word_string_create(str, false)->word);
+				&word_string_create(data->arena, str, false)->word);
 		}
-
-		mrsh_buffer_finish(&buf);
 		break;
 	case MRSH_WORD_LIST:;
 		const struct mrsh_word_list *wl = mrsh_word_get_list(word);
 
 		if (wl->double_quoted) {
-			add_to_cur_field(data, mrsh_word_copy(word));
+			add_to_cur_field(data, word_copy(data->arena, word));
 			return;
 		}
 
@@ -213,39 +226,41 @@ static void _split_fields(struct split_fields_data *data,
 	}
 }
 
-void split_fields(struct mrsh_array *fields, const struct mrsh_word *word,
-		const char *ifs) {
+void split_fields(struct mrsh_arena *arena, struct mrsh_array *fields,
+		const struct mrsh_word *word, const char *ifs) {
 	if (ifs == NULL) {
 		ifs = " \t\n";
 	} else if (ifs[0] == '\0') {
-		mrsh_array_add(fields, mrsh_word_copy(word));
+		ast_array_add(arena, fields, word_copy(arena, word));
 		return;
 	}
 
 	size_t ifs_len = strlen(ifs);
-	char *ifs_non_space = calloc(ifs_len, sizeof(char));
+	char ifs_non_space[ifs_len + 1];
 	size_t ifs_non_space_len = 0;
 	for (size_t i = 0; i < ifs_len; ++i) {
 		if (!isspace(ifs[i])) {
 			ifs_non_space[ifs_non_space_len++] = ifs[i];
 		}
 	}
+	ifs_non_space[ifs_non_space_len] = '\0';
 
 	struct split_fields_data data = {
+		.arena = arena,
 		.fields = fields,
 		.ifs = ifs,
 		.ifs_non_space = ifs_non_space,
 		.in_ifs = true,
 	};
 	_split_fields(&data, word);
-
-	free(ifs_non_space);
+	end_cur_field(&data);
 }
 
-void get_fields_str(struct mrsh_array *strs, const struct mrsh_array *fields) {
+void get_fields_str(struct mrsh_arena *arena, struct mrsh_array *strs,
+		const struct mrsh_array *fields) {
 	for (size_t i = 0; i < fields->len; i++) {
 		struct mrsh_word *word = fields->data[i];
-		mrsh_array_add(strs, mrsh_word_str(word));
+		ast_array_add(arena, strs, ast_word_str(arena, word));
 	}
 }
 
@@ -295,8 +310,12 @@ static bool needs_pathname_expansion(const struct mrsh_word *word) {
 
 }
 
-static void _word_to_pattern(struct mrsh_buffer *buf,
-		const struct mrsh_word *word, bool quoted) {
+/**
+ * Writes the pattern to `dst` if it isn't NULL, and returns its length.
+ */
+static size_t _word_to_pattern(char *dst, const struct mrsh_word *word,
+		bool quoted) {
+	size_t n = 0;
 	switch (word->type) {
 	case MRSH_WORD_STRING:;
 		const struct mrsh_word_string *ws = mrsh_word_get_string(word);
@@ -305,62 +324,91 @@ static void _word_to_pattern(struct mrsh_buffer *buf,
 		for (size_t i = 0; i < len; i++) {
 			char c = ws->str[i];
 			if (is_pathname_metachar(c) && (quoted || ws->single_quoted)) {
-				mrsh_buffer_append_char(buf, '\\');
+				if (dst != NULL) {
+					dst[n] = '\\';
+				}
+				n++;
+			}
+			if (dst != NULL) {
+				dst[n] = c;
 			}
-			mrsh_buffer_append_char(buf, c);
+			n++;
 		}
-		break;
+		return n;
 	case MRSH_WORD_LIST:;
 		const struct mrsh_word_list *wl = mrsh_word_get_list(word);
 
 		for (size_t i = 0; i < wl->children.len; i++) {
 			const struct mrsh_word *child = wl->children.data[i];
-			_word_to_pattern(buf, child, quoted || wl->double_quoted);
+			n += _word_to_pattern(dst != NULL ? &dst[n] : NULL, child,
+				quoted || wl->double_quoted);
 		}
-		break;
+		return n;
 	default:
 		abort();
 	}
 }
 
-char *word_to_pattern(const struct mrsh_word *word) {
+char *word_to_pattern(struct mrsh_arena *arena, const struct mrsh_word *word) {
 	if (!needs_pathname_expansion(word)) {
 		return NULL;
 	}
 
-	struct mrsh_buffer buf = {0};
-	_word_to_pattern(&buf, word, false);
-	mrsh_buffer_append_char(&buf, '\0');
-	return mrsh_buffer_steal(&buf);
+	size_t len = _word_to_pattern(NULL, word, false);
+	char *pattern = ast_alloc(arena, len + 1);
+	if (pattern == NULL) {
+		return NULL;
+	}
+	_word_to_pattern(pattern, word, false);
+	pattern[len] = '\0';
+	return pattern;
 }
 
-bool expand_pathnames(struct mrsh_array *expanded,
-		const struct mrsh_array *fields) {
+bool is_quoted_at_sign(const struct mrsh_word *word) {
+	if (word->type != MRSH_WORD_LIST) {
+		return false;
+	}
+	const struct mrsh_word_list *wl = mrsh_word_get_list(word);
+	if (!wl->double_quoted || wl->children.len != 1) {
+		return false;
+	}
+	const struct mrsh_word *child = wl->children.data[0];
+	if (child->type != MRSH_WORD_PARAMETER) {
+		return false;
+	}
+	const struct mrsh_word_parameter *wp = mrsh_word_get_parameter(child);
+	return wp->op == MRSH_PARAM_NONE && wp->kind == MRSH_PARAM_KIND_AT;
+}
+
+bool expand_pathnames(struct mrsh_state *state, struct mrsh_arena *arena,
+		struct mrsh_array *expanded, const struct mrsh_array *fields) {
 	for (size_t i = 0; i < fields->len; ++i) {
 		const struct mrsh_word *field = fields->data[i];
 
-		char *pattern = word_to_pattern(field);
+		char *pattern = word_to_pattern(arena, field);
 		if (pattern == NULL) {
-			mrsh_array_add(expanded, mrsh_word_str(field));
+			ast_array_add(arena, expanded, ast_word_str(arena, field));
 			continue;
 		}
+		++state_get_priv(state)->stats.globs;
 
 		glob_t glob_buf;
 		int ret = glob(pattern, GLOB_NOSORT, NULL, &glob_buf);
 		if (ret == 0) {
 			for (size_t i = 0; i < glob_buf.gl_pathc; ++i) {
-				mrsh_array_add(expanded, strdup(glob_buf.gl_pathv[i]));
+				ast_array_add(arena, expanded,
+					ast_strdup(arena, glob_buf.gl_pathv[i]));
 			}
 			globfree(&glob_buf);
 		} else if (ret == GLOB_NOMATCH) {
-			mrsh_array_add(expanded, mrsh_word_str(field));
+			ast_array_add(arena, expanded, ast_word_str(arena, field));
 		} else {
 			fprintf(stderr, "glob failed: %d\n", ret);
-			free(pattern);
+			ast_free(arena, pattern);
 			return false;
 		}
 
-		free(pattern);
+		ast_free(arena, pattern);
 	}
 
 	return true;
@@ -0,0 +1,3 @@
+#include "stats.h"
+
+struct lib_stats lib_stats = {0};
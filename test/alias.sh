@@ -0,0 +1,35 @@
+#!/bin/sh -e
+
+alias greet='echo hello'
+greet world
+
+echo "Multi-line replacement"
+alias two='echo one
+echo two'
+two
+
+echo "Trailing blank"
+alias e='echo ' w=world
+e w
+e e w
+
+echo "Nested aliases"
+alias l='e '
+l w
+
+echo "Recursive aliases"
+alias ls='ls -d'
+ls /
+a() {
+	echo no more aliases
+}
+alias a=b b=a
+a
+
+echo "Replacement read as input"
+alias q='echo "a b'
+q c"
+alias brace='{ echo braces; }'
+brace
+alias empty=''
+empty echo empty
@@ -6,3 +6,33 @@ func
 func -a
 func -ab
 func -abc
+
+set -- a b c d
+shift
+echo "$# $*"
+shift 2
+echo "$# $*"
+
+count() {
+	echo "$#"
+	shift
+	echo "$@"
+}
+set -- a b c d
+count "$@"
+echo "$# $*"
+(shift 2; echo "$*")
+echo "$*"
+
+set -- "a  b" "" "*"
+for arg in "$@"; do
+	echo "[$arg]"
+done
+set --
+for arg in x "$@" y; do
+	echo "[$arg]"
+done
+
+set -- a b c d e f g h i j k
+echo "$1 ${10} ${11} [${12}] [${99999999999}] $10"
+echo "${#11} ${1:-x} ${12:-x}"
@@ -89,3 +89,28 @@ case hello in
 	*)
 		echo pass
 esac
+
+echo "patterns are expanded each time"
+for y in hello world; do
+	case "$y" in
+		$y)
+			echo pass
+			;;
+		*)
+			echo fail
+			;;
+	esac
+done
+
+echo "case in a function"
+f() {
+	case "$1" in
+		"$2"*)
+			echo "$1"
+			;;
+		*)
+			echo fail
+			;;
+	esac
+}
+f hello he
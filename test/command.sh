@@ -23,3 +23,19 @@ then
 else
 	echo "ko"
 fi
+
+# Utilities are searched again when $PATH changes
+dir=$(mktemp -d)
+mkdir "$dir/a" "$dir/b"
+printf '#!/bin/sh\necho "tool a"\n' >"$dir/a/tool"
+printf '#!/bin/sh\necho "tool b"\n' >"$dir/b/tool"
+chmod +x "$dir/a/tool" "$dir/b/tool"
+saved_path=$PATH
+for p in a b a; do
+	PATH="$dir/$p:$saved_path"
+	tool
+done
+hash -r
+tool
+PATH=$saved_path
+rm -rf "$dir"
@@ -0,0 +1,48 @@
+#!/bin/sh
+
+dir=$(mktemp -d)
+script="$dir/script.sh"
+MRSH_CACHE_DIR="$dir/cache"
+
+cat >"$script" <<'END'
+greet() {
+	echo "hello $1"
+}
+for i in 1 2; do
+	greet "$i"
+done
+case $count in
+1) echo "first" ;;
+*) echo "again" ;;
+esac
+count=$((count + 1))
+END
+
+count=1
+. "$script"
+. "$script"
+echo "count $count"
+
+echo 'echo "modified"' >>"$script"
+. "$script"
+
+cat >"$script" <<'END'
+cat <<EOF
+here-document
+EOF
+echo "after here-document"
+END
+. "$script"
+
+# Cache directories others can write to aren't used
+mkdir -m 777 "$dir/shared"
+MRSH_CACHE_DIR="$dir/shared"
+echo 'echo "shared cache"' >"$script"
+. "$script"
+ls "$dir/shared" | wc -l
+MRSH_CACHE_DIR="$dir/cache"
+
+# Files which aren't regular files are executed as they're read
+printf 'echo "from a pipe"\necho "line 2"\n' | . /dev/stdin
+
+rm -rf "$dir"
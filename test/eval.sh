@@ -0,0 +1,38 @@
+#!/bin/sh
+
+for i in 1 2 3; do
+	eval "v$i=\$i"
+	eval 'echo "v=$i"'
+done
+echo "$v1 $v2 $v3"
+
+eval 'f() { echo "f $1"; }'
+f a
+eval 'f() { echo "g $1"; }'
+f b
+
+eval 'if [ "$x" = "" ]; then echo "empty"; fi'
+x=1
+eval 'if [ "$x" = "" ]; then echo "empty"; else echo "not empty"; fi'
+
+# Evaluating many different strings while an eval is running
+n=0
+eval '
+	for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20; do
+		for j in 1 2; do
+			eval "n=\$((n + $i * $j))"
+		done
+	done
+	echo "n=$n"
+'
+
+# Long strings aren't cached, but still run
+long="x=0"
+i=0
+while [ "$i" -lt 600 ]; do
+	long="$long; x=\$((x + 1))"
+	i=$((i + 1))
+done
+eval "$long"
+eval "$long"
+echo "x=$x ${#long}"
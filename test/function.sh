@@ -35,3 +35,32 @@ func_e hello
 
 output=$(func_a)
 echo "output is $output"
+
+# Functions are looked up again when they're redefined or removed
+for i in 1 2; do
+	func_f() {
+		echo "func f $i"
+	}
+	func_f
+	unset -f func_f
+	command -v func_f || echo "no func f"
+done
+(func_a() { echo "func a in subshell"; }; func_a)
+func_a
+
+# A function can redefine or unset itself while it runs
+func_g() {
+	func_g() {
+		echo "new func g"
+	}
+	echo "old func g"
+}
+func_g
+func_g
+func_h() {
+	unset -f func_h
+	echo "func h"
+	echo "still func h"
+}
+func_h
+command -v func_h || echo "no func h"
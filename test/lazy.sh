@@ -0,0 +1,35 @@
+#!/bin/sh -e
+# Function bodies are parsed when the function is first called if the shell
+# supports it
+(set -o lazyfuncs) 2>/dev/null && set -o lazyfuncs
+
+f() {
+	case "$1" in
+	a|b) echo "ab $1" ;;
+	*) echo "other $(echo "$1" | tr a-z A-Z)" ;;
+	esac
+	cat <<END
+here $1 }
+END
+}
+f a
+f zz
+f a
+
+g() (
+	echo "quotes '}' \"{\" ${1:-x} $((1 + 2))" `echo back}`
+	h() { echo "nested $1"; }
+	h g
+)
+g
+g x
+
+i() { { echo braces; } ; }
+i
+
+j() {
+	echo "redefined"
+	j() { echo "j again"; }
+}
+j
+j
@@ -0,0 +1,41 @@
+#!/bin/sh -e
+
+echo
+echo foo bar
+echo "foo  bar" baz
+echo -n foo
+echo -n
+echo bar
+echo -- -n
+
+printf 'plain\n'
+printf '%s\n' foo
+printf '%s-%s\n' a b c d e
+printf '%s %d\n' a 1 b
+printf '[%5s|%-5s|%.2s]\n' ab cd efgh
+printf '[%*s|%-*.*s]\n' 4 a 6 2 bcd
+printf '%d %i %o %u %x %X\n' 42 -42 8 42 255 255
+printf '%d %d %d\n' 0x10 010 "'A"
+printf '%+d % d %05d %-4d|\n' 1 2 3 4
+printf '%.3f %e %g\n' 3.14159 1000 0.5
+printf '%c%c\n' hello world
+printf '%%\n'
+printf 'tab\there\101\n'
+printf '%b\n' 'a\tb' 'octal \0101' 'backslash \\'
+printf '[%5b]\n' 'x\n'
+printf '%b' 'stop\c' ignored
+echo
+printf 'no args: %s %d|\n'
+if printf '%d\n' 1x 2>/dev/null; then
+	echo "accepted 1x"
+fi
+printf '%s\n' "$(printf 'sub %s\n' stitution)"
+
+# Output written by builtins stays in order with other commands
+echo first
+sh -c 'echo second'
+printf 'third\n'
+(echo fourth)
+echo fifth | cat
+printf 'sixth\n' >/dev/null
+echo seventh
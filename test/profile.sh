@@ -0,0 +1,45 @@
+#!/bin/sh -e
+# Profiling must not change what scripts do, if the shell supports it
+MRSH_PROFILE=/dev/null
+(set -o profile) 2>/dev/null && set -o profile
+
+fib() {
+	if [ "$1" -le 1 ]; then
+		echo "$1"
+		return
+	fi
+	a=$(fib $(($1 - 1)))
+	b=$(fib $(($1 - 2)))
+	echo $((a + b))
+}
+fib 7
+
+count() {
+	i=0
+	while [ $i -lt "$1" ]; do
+		i=$((i + 1))
+	done
+	echo "$i"
+}
+count 50 | cat
+for n in 1 2 3; do
+	count $n
+done
+case "$(count 2)" in
+2) echo "two" ;;
+esac
+{ echo "group"; } | tr a-z A-Z
+(echo "subshell")
+
+# Functions run by child processes are part of the profile
+if (set -o profile) 2>/dev/null && [ -x "/proc/$$/exe" ]; then
+	report=$(mktemp)
+	MRSH_PROFILE="$report" "/proc/$$/exe" -o profile -c \
+		'f() { :; }; f | cat; (f); x=$(f); f'
+	calls=$(sed -n 's/^ *\([0-9]*\) .*  f$/\1/p' "$report")
+	rm "$report"
+	[ "$calls" -eq 4 ] || echo "f: $calls calls"
+fi
+
+(set +o profile) 2>/dev/null && set +o profile
+count 3
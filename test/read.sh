@@ -15,3 +15,20 @@ printf "a\nb\nc\n" | while read line; do
 done
 
 [ $i = 3 ] && echo "correct!"
+
+dir=$(mktemp -d)
+printf "a1\na2\n" >"$dir/a"
+printf "b1\nb2\n" >"$dir/b"
+
+# Only one line is consumed from each file
+read a <"$dir/a"
+read b <"$dir/b"
+echo "$a $b"
+
+printf "p1\np2\n" | {
+  read x
+  read y <&0
+  echo "$x $y"
+}
+
+rm -r "$dir"
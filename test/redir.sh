@@ -9,3 +9,48 @@ uname >&2
 echo 2>&1 "stderr to stdout"
 uname 2>&1
 #(echo >&2 asdf) 2>&1
+
+dir=$(mktemp -d)
+
+: >"$dir/empty"
+[ -s "$dir/empty" ] || echo "empty"
+
+for i in 1 2 3; do
+	printf "%s\n" "$i" >>"$dir/log"
+done
+cat "$dir/log"
+
+echo "through fd 3" 3>"$dir/out" >&3
+cat "$dir/out"
+
+# Output larger than the buffers of builtins is written in full
+s=0123456789abcdef
+for i in 1 2 3 4 5 6 7 8 9 10; do
+	s="$s$s"
+done
+printf "%s\n" "$s" "$s" "$s" "$s" >"$dir/big"
+wc -c <"$dir/big"
+
+# Write errors fail the builtin
+if [ -w /dev/full ]; then
+	echo "lost" >/dev/full 2>/dev/null
+	echo "echo: $?"
+	printf "%s\n" "lost" >/dev/full 2>/dev/null
+	echo "printf: $?"
+fi
+
+# A failed redirection only fails a regular builtin
+echo "lost" >"$dir/missing/file" 2>/dev/null || echo "echo failed"
+printf "lost" >"$dir/missing/file" 2>/dev/null
+[ $? -ne 0 ] && echo "printf failed"
+cd . 3>"$dir/fd" >"$dir/missing/file" 2>/dev/null || echo "cd failed"
+echo "still running"
+
+# Diagnostics of builtins stay in order with their output when both go to the
+# same file
+if [ -x "/proc/$$/exe" ]; then
+	"/proc/$$/exe" -c 'echo one; cd /nonexistent; printf "two\n"
+		cd /nonexistent; echo three' 2>&1 | sed 's/.*cd.*/error/'
+fi
+
+rm -r "$dir"
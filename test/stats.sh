@@ -0,0 +1,25 @@
+#!/bin/sh -e
+# Counting must not change what scripts do
+
+x=$(echo "substitution")
+echo "$x"
+cat <<EOF
+here-document
+EOF
+for f in /*; do
+	:
+done
+echo "pipeline" | tr a-z A-Z
+f() {
+	echo "function $1"
+}
+f a
+sleep 0 &
+wait
+
+# The counters can be read if the shell supports it
+if command -v stats >/dev/null; then
+	stats | grep '^forks [0-9]*$' >/dev/null && echo "counters"
+else
+	echo "counters"
+fi
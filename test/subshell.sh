@@ -17,3 +17,38 @@ echo "Multi-line subshell"
 	echo a
 	echo b
 )
+
+echo "Subshell exit status"
+(exit 3)
+echo $?
+
+echo "Subshell working directory"
+old=$(pwd)
+(cd / && pwd)
+[ "$(pwd)" = "$old" ] && echo "unchanged"
+
+echo "Subshell functions"
+f() { echo f; }
+(f() { echo g; }; f; unset -f f)
+f
+
+echo "Subshell positional parameters"
+set -- a b c
+(shift; set -- x; echo "$@")
+echo "$@"
+
+echo "Subshell options"
+(set -f; echo *.sh)
+case $- in
+*f*) echo "noglob set";;
+*) echo "noglob unset";;
+esac
+
+echo "Nested subshells"
+a=1
+(a=2; (a=3; echo $a); echo $a)
+echo $a
+
+echo "Subshell return"
+g() { (return 4); echo $?; }
+g
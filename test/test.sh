@@ -0,0 +1,96 @@
+#!/bin/sh -e
+
+check() {
+	if "$@" 2>/dev/null; then
+		echo "true: $*"
+	else
+		echo "false ($?): $*"
+	fi
+}
+
+# Number of arguments
+check test
+check test ""
+check test foo
+check [ ]
+check [ -n ]
+check [ ! ]
+check [ ! "" ]
+check [ ! = x ]
+check [ "(" = "(" ]
+check [ "(" foo ")" ]
+check [ "(" -z "" ")" ]
+check [ ! -z foo ]
+check [ ! "(" foo ")" ]
+
+# Strings
+check [ -n foo ]
+check [ -n "" ]
+check [ -z "" ]
+check [ -z foo ]
+check [ foo = foo ]
+check [ foo = bar ]
+check [ foo != bar ]
+check [ -n = -n ]
+
+# Integers
+check [ 1 -eq 1 ]
+check [ " 2" -eq 2 ]
+check [ -3 -lt 2 ]
+check [ 10 -gt 9 ]
+check [ 10 -ge 10 ]
+check [ 10 -le 9 ]
+check [ 10 -ne 9 ]
+check [ foo -eq 1 ]
+check [ 1 -eq "" ]
+
+# Files
+dir=$(mktemp -d)
+cd "$dir"
+: >empty
+echo foo >file
+ln -s file link
+mkfifo fifo
+chmod +x file
+touch -t 200001010000 old
+check [ -e file ]
+check [ -e missing ]
+check [ -f file ]
+check [ -f . ]
+check [ -d . ]
+check [ -d file ]
+check [ -s file ]
+check [ -s empty ]
+check [ -h link ]
+check [ -L file ]
+check [ -f link ]
+check [ -p fifo ]
+check [ -r file ]
+check [ -x file ]
+check [ -x empty ]
+check [ -c /dev/null ]
+check [ -b /dev/null ]
+check [ -t 99 ]
+check [ file -ef link ]
+check [ file -ef empty ]
+check [ file -nt old ]
+check [ file -ot old ]
+check [ old -ot file ]
+cd - >/dev/null
+rm -r "$dir"
+
+# Logical operators
+check [ foo -a "" ]
+check [ foo -o "" ]
+check [ "" -o "" -o foo ]
+check [ foo -a foo -a "" ]
+check [ "" -a foo -o foo ]
+check [ ! "" -a foo ]
+check [ "(" foo -o "" ")" -a "" ]
+check [ 1 -eq 1 -a 2 -gt 1 ]
+
+# Errors
+check [ foo
+check [ foo bar ]
+check [ "(" foo ]
+check test 1 -eq
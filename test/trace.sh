@@ -0,0 +1,20 @@
+#!/bin/sh -e
+# Tracing must not change what scripts do
+trace=$(mktemp)
+MRSH_TRACE="$trace"
+
+f() {
+	echo "f $1"
+}
+f a
+x=$(f b)
+echo "$x" | cat | tr a-z A-Z
+(echo "subshell")
+sleep 0 &
+wait
+env true
+
+unset MRSH_TRACE
+MRSH_TRACE=/dev/null echo "prefix"
+echo "${MRSH_TRACE-unset}"
+rm -f "$trace"
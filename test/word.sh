@@ -112,3 +112,25 @@ echo `
 # Field Splitting
 # Pathname Expansion
 # Quote Removal
+
+# Variables are found whichever way they were set
+read_var=unset
+unset read_var
+echo "${read_var-unset}"
+read read_var <<EOF
+read
+EOF
+echo "$read_var ${read_var}"
+export read_var=exported
+echo "$read_var $(echo $read_var)"
+for read_var in for; do echo "$read_var"; done
+: ${read_var:=default} ${new_var:=default}
+echo "$read_var $new_var"
+
+# Names of variables which are unset and set again
+for i in 1 2 3; do
+	eval "dyn_$i=$i"
+	unset "dyn_$i"
+	eval "dyn_$i=\$((i * 2))"
+done
+echo "$dyn_1 $dyn_2 $dyn_3 ${dyn_4-unset}"